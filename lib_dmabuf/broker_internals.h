@@ -0,0 +1,114 @@
+
+#ifndef BROKER_INTERNALS_H_
+#define BROKER_INTERNALS_H_
+
+/**
+ * @file broker_internals.h
+ * @author Alberto Scolari
+ * @brief Header for the broker side of the protocol in @ref dma_broker.h: the consumption of
+ * the job rings and the bookkeeping of the UDMA buffers and of their slices, against which jobs
+ * are checked; the daemon (tools/dma_brokerd) adds the hardware.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+#include "dma_broker.h"
+
+#define DMA_BROKER_MAX_BUFFERS 8U
+#define DMA_BROKER_MAX_SLICES 256U
+
+/**
+ * @brief The dma_broker_slice_entry struct records a slice granted to a client
+ */
+struct dma_broker_slice_entry {
+    int owner; /**< client slot, -1 if the entry is unused */
+    unsigned buf; /**< UDMA buffer index */
+    unsigned offset; /**< offset of the slice within the UDMA buffer */
+    unsigned size; /**< size of the slice */
+};
+
+/**
+ * @brief The dma_broker_table struct stores the resources of the broker and who owns them
+ *
+ * Clients map the UDMA buffers they allocate from whole, so a buffer belongs to a single
+ * client from its first slice until the client disconnects, and goes to another client
+ * only once the process of the former owner exited, taking its mappings with it.
+ */
+struct dma_broker_table {
+    struct dma_broker_slice_entry slices[DMA_BROKER_MAX_SLICES]; /**< slices granted */
+    int buf_owner[DMA_BROKER_MAX_BUFFERS]; /**< client slot owning each buffer, -1 if none */
+    pid_t buf_pid[DMA_BROKER_MAX_BUFFERS]; /**< process of the last owner, 0 if none */
+    unsigned long buf_size[DMA_BROKER_MAX_BUFFERS]; /**< size of each buffer */
+    unsigned num_buffers; /**< number of UDMA buffers */
+    unsigned num_engines; /**< number of DMA engines */
+    unsigned num_ctrl; /**< number of control interfaces */
+};
+
+/**
+ * @brief dma_broker_table_init sets @p table up with no slices and no owners
+ * @param sizes sizes of the @p num_buffers buffers, at most DMA_BROKER_MAX_BUFFERS
+ */
+void dma_broker_table_init(struct dma_broker_table *table, unsigned num_buffers,
+    const unsigned long *sizes, unsigned num_engines, unsigned num_ctrl);
+
+/**
+ * @brief dma_broker_slice_alloc allocates (first fit) a slice of @p size bytes of buffer @p buf
+ * to client @p owner, of process @p pid
+ *
+ * The buffer is granted to the client if it has no owner and its last owner was the same
+ * process or exited; the data left in a buffer granted must be cleared by the caller.
+ *
+ * @param size size of the slice, a multiple of the page size
+ * @param offset set to the offset of the slice within the buffer
+ * @param granted set to 1 if the buffer was just granted to the client, to 0 otherwise
+ * @return 0 for success, non-0 if the buffer belongs to another client or has no space left
+ */
+int dma_broker_slice_alloc(struct dma_broker_table *table, int owner, pid_t pid, unsigned buf,
+    unsigned size, unsigned *offset, int *granted);
+
+/**
+ * @brief dma_broker_slice_free releases the slice of client @p owner at @p offset of @p buf;
+ * the buffer stays with the client
+ * @return 0 for success, non-0 if the client has no such slice
+ */
+int dma_broker_slice_free(struct dma_broker_table *table, int owner, unsigned buf,
+    unsigned offset);
+
+/**
+ * @brief dma_broker_client_gone releases the slices and the buffers of client @p owner; its
+ * buffers go to other processes once its process exited
+ */
+void dma_broker_client_gone(struct dma_broker_table *table, int owner);
+
+/**
+ * @brief dma_broker_check_job checks that @p job uses existing engines and control interfaces,
+ * and that each of its transactions lies within a slice of client @p owner
+ * @return 0 if the job can run, non-0 otherwise
+ */
+int dma_broker_check_job(const struct dma_broker_table *table, int owner,
+    const struct dma_broker_job *job);
+
+/**
+ * @brief dma_broker_take_job copies the oldest job of @p rings into @p job, so that the client
+ * cannot change it while it runs, and removes it from the submission ring
+ * @return the completion entry to fill for the job, NULL if no job is queued or if the
+ * completion ring is full
+ */
+struct dma_broker_completion *dma_broker_take_job(struct dma_broker_rings *rings,
+    struct dma_broker_job *job);
+
+/**
+ * @brief dma_broker_post_completion publishes the completion filled after
+ * @ref dma_broker_take_job
+ */
+void dma_broker_post_completion(struct dma_broker_rings *rings);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BROKER_INTERNALS_H_ */
@@ -0,0 +1,50 @@
+#ifndef COPY_INTERNALS_H_
+#define COPY_INTERNALS_H_
+
+/**
+ * @file copy_internals.h
+ * @author Alberto Scolari
+ * @brief Header for the vectorized loops of dma_copy.c that are built in translation units
+ * of their own, with the compiler flags enabling their instruction set.
+ *
+ * ARMv7 toolchains do not enable NEON by default: only dma_copy_neon.c is built with it,
+ * so that the rest of the library still runs on cores without NEON, where the loops
+ * are never selected.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/* unit of the vectorized loops, matching a full AXI burst of the HP ports */
+#define COPY_BLOCK 64U
+
+#if defined(__aarch64__) || defined(__arm__)
+#define COPY_NEON
+
+/**
+ * @brief dma_copy_neon_to_uncached copies @p length bytes, a multiple of COPY_BLOCK,
+ * to the COPY_BLOCK-aligned uncached @p dst
+ */
+void dma_copy_neon_to_uncached(void *dst, const void *src, size_t length);
+
+/**
+ * @brief dma_copy_neon_from_uncached copies @p length bytes, a multiple of COPY_BLOCK,
+ * from the COPY_BLOCK-aligned uncached @p src
+ */
+void dma_copy_neon_from_uncached(void *dst, const void *src, size_t length);
+
+/**
+ * @brief dma_copy_neon_fill fills @p length bytes, a multiple of COPY_BLOCK,
+ * of the COPY_BLOCK-aligned uncached @p dst with @p value
+ */
+void dma_copy_neon_fill(void *dst, int value, size_t length);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COPY_INTERNALS_H_ */
@@ -0,0 +1,256 @@
+
+/**
+ * @file dma_batch.c
+ * @author Alberto Scolari
+ * @brief Implementation of the coalescing of small messages into framed batches.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dma_batch.h"
+#include "dma_copy.h"
+#include "dma_stats.h"
+
+#define PADDED(length) (((length) + DMA_BATCH_ALIGN - 1U) & ~(DMA_BATCH_ALIGN - 1U))
+
+/* bytes a message takes within a batch */
+static unsigned msg_size(unsigned length)
+{
+    return (unsigned)sizeof(struct dma_batch_msg_header) + PADDED(length);
+}
+
+int dma_batch_init(struct dma_batch *batch, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slice_size, unsigned flush_bytes, unsigned flush_us,
+    unsigned usleep_timeout, dma_batch_callback on_result, void *cb_arg)
+{
+    unsigned num_slices = on_result != NULL ? 2 : 1;
+
+    if (slice_size == 0)
+    {
+        slice_size = engine->tuning.chunk_size & ~(DMA_BATCH_ALIGN - 1U);
+    }
+    if (slice_size <= sizeof(struct dma_batch_header) + sizeof(struct dma_batch_msg_header)
+        || slice_size > dma_max_length(engine) || slice_size % DMA_BATCH_ALIGN != 0
+        || offset + (unsigned long)slice_size * num_slices > buf->size)
+    {
+        printf("%s: slices of %u bytes do not fit into the UDMA buffer\n", __func__, slice_size);
+        return -1;
+    }
+    memset(batch, 0, sizeof(*batch));
+    batch->engine = engine;
+    batch->buf = buf;
+    batch->offset = offset;
+    batch->slice_size = slice_size;
+    batch->flush_bytes = flush_bytes == 0 || flush_bytes > slice_size ? slice_size : flush_bytes;
+    batch->flush_ns = (uint64_t)flush_us * 1000ULL;
+    batch->fill = sizeof(struct dma_batch_header);
+    batch->usleep_timeout = usleep_timeout;
+    batch->on_result = on_result;
+    batch->cb_arg = cb_arg;
+    return 0;
+}
+
+/*
+ * hands the messages of the response to the callback, counting them in batch->delivered;
+ * returns -1 if the response is malformed, after delivering its valid messages
+ */
+static int split_response(struct dma_batch *batch, unsigned received)
+{
+    unsigned rx_offset = batch->offset + batch->slice_size, pos, i;
+    struct dma_batch_header header;
+
+    if (received < sizeof(header))
+    {
+        printf("%s: response of %u bytes has no header\n", __func__, received);
+        return -1;
+    }
+    udmabuf_copy_out(&header, batch->buf, rx_offset, sizeof(header));
+    if (header.bytes < sizeof(header) || header.bytes > received)
+    {
+        printf("%s: response header claims %u bytes, %u received\n", __func__, header.bytes,
+            received);
+        return -1;
+    }
+    pos = sizeof(header);
+    for (i = 0; i < header.count; i++)
+    {
+        struct dma_batch_msg_header msg;
+
+        if (header.bytes - pos < sizeof(msg))
+        {
+            break;
+        }
+        udmabuf_copy_out(&msg, batch->buf, rx_offset + pos, sizeof(msg));
+        pos += sizeof(msg);
+        if (msg.length > header.bytes - pos)
+        {
+            break;
+        }
+        batch->on_result(batch->cb_arg, msg.tag, (char *)batch->buf->vaddr + rx_offset + pos,
+            msg.length);
+        batch->delivered++;
+        pos += PADDED(msg.length) < header.bytes - pos ? PADDED(msg.length) : header.bytes - pos;
+    }
+    if (i < header.count)
+    {
+        printf("%s: response truncated after %u of %u messages\n", __func__, i, header.count);
+        return -1;
+    }
+    return 0;
+}
+
+/* leaves no transaction the batch started running, so that the engine can be used again */
+static void cancel_batch(struct dma_batch *batch, int tx_started, int rx_started)
+{
+    if (tx_started && batch->engine->to_dev.status == STARTED)
+    {
+        cancel_simple_transfer_to_device(batch->engine);
+    }
+    if (rx_started && batch->engine->from_dev.status == STARTED)
+    {
+        cancel_simple_transfer_from_device(batch->engine);
+    }
+}
+
+/* the messages of the current batch are accounted for and dropped, also when sending fails */
+static void reset_batch(struct dma_batch *batch)
+{
+    batch->batches++;
+    batch->messages += batch->count;
+    batch->count = 0;
+    batch->fill = sizeof(struct dma_batch_header);
+}
+
+/* sends the current batch, adding the response messages it delivers to batch->delivered */
+static int flush_batch(struct dma_batch *batch)
+{
+    struct dma_batch_header header;
+    enum dma_err_status err = NO_ERROR;
+    int ret = 0, tx_started = 0, rx_started = 0;
+
+    if (batch->count == 0)
+    {
+        return 0;
+    }
+    header.count = batch->count;
+    header.bytes = batch->fill;
+    udmabuf_copy_in(batch->buf, batch->offset, &header, sizeof(header));
+
+    /* the response transaction must be armed before the logic starts answering */
+    if (batch->on_result != NULL)
+    {
+        err = set_simple_transfer_from_device(batch->engine, batch->buf,
+            batch->offset + batch->slice_size, batch->slice_size);
+        if (err == NO_ERROR)
+        {
+            err = start_simple_transfer_from_device(batch->engine);
+            rx_started = err == NO_ERROR;
+        }
+    }
+    if (err == NO_ERROR)
+    {
+        err = set_simple_transfer_to_device(batch->engine, batch->buf, batch->offset, batch->fill);
+    }
+    if (err == NO_ERROR)
+    {
+        err = start_simple_transfer_to_device(batch->engine);
+        tx_started = err == NO_ERROR;
+    }
+    if (err == NO_ERROR)
+    {
+        err = wait_simple_transfer_to_device(batch->engine, batch->usleep_timeout);
+    }
+    if (err == NO_ERROR && batch->on_result != NULL)
+    {
+        err = wait_simple_transfer_from_device(batch->engine, batch->usleep_timeout);
+    }
+    if (err != NO_ERROR)
+    {
+        printf("%s: DMA transaction failed (error %d)\n", __func__, (int)err);
+        cancel_batch(batch, tx_started, rx_started);
+        reset_batch(batch);
+        return -1;
+    }
+    if (err_status_to_device(batch->engine) != 0
+        || (batch->on_result != NULL && err_status_from_device(batch->engine) != 0))
+    {
+        printf("%s: DMA engine error 0x%x 0x%x\n", __func__, err_status_to_device(batch->engine),
+            err_status_from_device(batch->engine));
+        ret = -1;
+    }
+    reset_batch(batch);
+    if (ret == 0 && batch->on_result != NULL)
+    {
+        ret = split_response(batch, transferred_length_from_device(batch->engine));
+    }
+    return ret;
+}
+
+int dma_batch_flush(struct dma_batch *batch)
+{
+    batch->delivered = 0;
+    return flush_batch(batch) < 0 ? -1 : (int)batch->delivered;
+}
+
+static int flush_if_old(struct dma_batch *batch)
+{
+    if (batch->count != 0 && batch->flush_ns != 0
+        && dma_stats_now() - batch->first_ns >= batch->flush_ns)
+    {
+        return flush_batch(batch);
+    }
+    return 0;
+}
+
+int dma_batch_add(struct dma_batch *batch, uint32_t tag, const void *data, unsigned length)
+{
+    struct dma_batch_msg_header msg;
+    unsigned size = msg_size(length);
+    int ret;
+
+    batch->delivered = 0;
+    if (size > batch->slice_size - sizeof(struct dma_batch_header))
+    {
+        printf("%s: message of %u bytes does not fit into a batch\n", __func__, length);
+        return -1;
+    }
+    if (batch->fill + size > batch->slice_size && flush_batch(batch) < 0)
+    {
+        return -1;
+    }
+    if (batch->count == 0 && batch->flush_ns != 0)
+    {
+        batch->first_ns = dma_stats_now();
+    }
+    msg.length = length;
+    msg.tag = tag;
+    udmabuf_copy_in(batch->buf, batch->offset + batch->fill, &msg, sizeof(msg));
+    udmabuf_copy_in(batch->buf, batch->offset + batch->fill + (unsigned)sizeof(msg), data, length);
+    /* the logic sees the padding as well: it must not carry stale data of previous batches */
+    udmabuf_fill(batch->buf, batch->offset + batch->fill + (unsigned)sizeof(msg) + length, 0,
+        size - (unsigned)sizeof(msg) - length);
+    batch->fill += size;
+    batch->count++;
+
+    if (batch->fill >= batch->flush_bytes)
+    {
+        ret = flush_batch(batch);
+    } else
+    {
+        ret = flush_if_old(batch);
+    }
+    return ret < 0 ? -1 : (int)batch->delivered;
+}
+
+int dma_batch_poll(struct dma_batch *batch)
+{
+    batch->delivered = 0;
+    return flush_if_old(batch) < 0 ? -1 : (int)batch->delivered;
+}
+
+void dma_batch_destroy(struct dma_batch *batch)
+{
+    dma_batch_flush(batch);
+    memset(batch, 0, sizeof(*batch));
+}
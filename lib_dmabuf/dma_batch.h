@@ -0,0 +1,151 @@
+
+#ifndef DMA_BATCH_H_
+#define DMA_BATCH_H_
+
+/**
+ * @file dma_batch.h
+ * @author Alberto Scolari
+ * @brief Header with API to coalesce many small messages into framed batches, each sent
+ * to the FPGA logic with a single DMA transaction, and to split the framed response into
+ * per-message results.
+ *
+ * Each transaction has a fixed cost (programming, start and wait) that dominates with payloads
+ * of a few hundred bytes. Messages are instead appended to a slice of a UDMA buffer and the whole
+ * slice is sent once it is full, the given number of bytes is reached, or the oldest message has
+ * waited for the given time. A batch is framed as a @ref dma_batch_header followed by its messages,
+ * each being a @ref dma_batch_msg_header followed by the payload, padded to @ref DMA_BATCH_ALIGN
+ * bytes; all fields are little-endian 32 bits words.
+ *
+ * The FPGA logic answers with a batch in the same format, ending it with TLAST, whose messages
+ * are handed to the result callback in order; tags let the logic drop, reorder or merge
+ * messages. Without a callback, batches are only sent.
+ *
+ * A batch whose transactions fail is dropped, its transactions being cancelled so that
+ * the engine can be used again, and the call returns an error. Messages of a response
+ * are delivered until an engine error or a malformed frame is found: @ref dma_batch.delivered
+ * tells how many the failed call delivered.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "dma_engine_buf.h"
+
+#define DMA_BATCH_ALIGN 8U /**< alignment of each message within a batch */
+
+/**
+ * @brief The dma_batch_header struct starts each batch
+ */
+struct dma_batch_header {
+    uint32_t count; /**< number of messages */
+    uint32_t bytes; /**< size of the batch, including this header */
+} __attribute__((packed));
+
+/**
+ * @brief The dma_batch_msg_header struct precedes the payload of each message
+ */
+struct dma_batch_msg_header {
+    uint32_t length; /**< payload length, without padding */
+    uint32_t tag; /**< user tag, identifying the message */
+} __attribute__((packed));
+
+/**
+ * @brief callback invoked for each message of a response batch
+ *
+ * @param arg user argument, as given in @ref dma_batch_init
+ * @param tag tag of the message
+ * @param data payload, inside the UDMA buffer; valid only during the call
+ * @param length payload length
+ */
+typedef void (*dma_batch_callback)(void *arg, uint32_t tag, const void *data, unsigned length);
+
+/**
+ * @brief The dma_batch struct stores the state of a coalescing layer
+ */
+struct dma_batch {
+    struct dma_engine *engine; /**< DMA engine batches are sent and received with */
+    struct udmabuf *buf; /**< UDMA buffer hosting the slices */
+    unsigned offset; /**< offset of the slice to device; the one from device follows it */
+    unsigned slice_size; /**< size of each slice, i.e. the maximum batch size */
+    unsigned flush_bytes; /**< batch size triggering a flush */
+    uint64_t flush_ns; /**< age of the oldest message triggering a flush, 0 for none */
+    uint64_t first_ns; /**< time the oldest message of the batch was added at */
+    unsigned fill; /**< bytes of the current batch, including its header */
+    unsigned count; /**< messages in the current batch */
+    unsigned usleep_timeout; /**< sleeping interval to wait for transactions */
+    dma_batch_callback on_result; /**< result callback, NULL if there are no responses */
+    void *cb_arg; /**< argument of @ref on_result */
+    unsigned long long batches; /**< batches sent so far */
+    unsigned long long messages; /**< messages sent so far, including those of failed batches */
+    unsigned delivered; /**< response messages delivered by the last add, poll or flush call,
+                             also when it failed */
+};
+
+/**
+ * @brief dma_batch_init prepares a coalescing layer over two slices of @p slice_size bytes,
+ * starting at @p offset inside @p buf: the first for batches to device, the second for
+ * responses (only if @p on_result is not NULL)
+ *
+ * @param batch the user-allocated struct to initialize
+ * @param engine the DMA engine, used exclusively while batches are flushed
+ * @param buf the UDMA buffer hosting the slices
+ * @param offset offset of the first slice within @p buf
+ * @param slice_size size of each slice, a multiple of @ref DMA_BATCH_ALIGN up to @ref dma_max_length;
+ * 0 for the chunk size calibrated for @p engine (see dma_tune.h)
+ * @param flush_bytes batch size triggering a flush; 0 or values beyond @p slice_size flush only
+ * full batches
+ * @param flush_us age in microseconds of the oldest message triggering a flush, checked when
+ * messages are added and via @ref dma_batch_poll; 0 for no time threshold
+ * @param usleep_timeout sleeping interval to wait for transactions, as for the wait calls
+ * @param on_result callback receiving each message of the response batches, NULL if the FPGA logic
+ * does not respond
+ * @param cb_arg argument for @p on_result
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_batch_init(struct dma_batch *batch, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slice_size, unsigned flush_bytes, unsigned flush_us,
+    unsigned usleep_timeout, dma_batch_callback on_result, void *cb_arg);
+
+/**
+ * @brief dma_batch_add appends a message to the current batch, flushing it before if the message
+ * does not fit and after if a threshold is reached
+ *
+ * @param batch the coalescing layer
+ * @param tag user tag of the message
+ * @param data payload
+ * @param length payload length; the message must fit into an empty batch
+ * @return number of response messages delivered by flushes, negative value on error, the current
+ * batch being dropped
+ */
+int dma_batch_add(struct dma_batch *batch, uint32_t tag, const void *data, unsigned length);
+
+/**
+ * @brief dma_batch_poll flushes the current batch if its oldest message reached the time threshold;
+ * to be called periodically when no messages are added
+ *
+ * @return number of response messages delivered, negative value on error
+ */
+int dma_batch_poll(struct dma_batch *batch);
+
+/**
+ * @brief dma_batch_flush sends the current batch, if not empty, waits for the response and
+ * delivers its messages to the result callback
+ *
+ * @return number of response messages delivered, negative value on error, including malformed
+ * responses, whose valid messages are delivered anyway and counted in @ref dma_batch.delivered
+ */
+int dma_batch_flush(struct dma_batch *batch);
+
+/**
+ * @brief dma_batch_destroy flushes the current batch and clears @p batch
+ */
+void dma_batch_destroy(struct dma_batch *batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_BATCH_H_ */
@@ -0,0 +1,590 @@
+/**
+ * @file dma_bitstream.c
+ * @author Alberto Scolari
+ * @brief Implementation of the loading of bitstreams via the FPGA manager, device tree
+ * overlays or xdevcfg, with the record of the image loaded.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "dma_bitstream.h"
+
+/* interfaces of the kernel; overridable at build time, e.g. to test against plain files */
+#ifndef FPGA_MGR_DIR
+#define FPGA_MGR_DIR "/sys/class/fpga_manager/fpga0"
+#endif
+#ifndef OVERLAYS_DIR
+#define OVERLAYS_DIR "/sys/kernel/config/device-tree/overlays"
+#endif
+#ifndef FIRMWARE_DIR
+#define FIRMWARE_DIR "/lib/firmware"
+#endif
+#ifndef XDEVCFG_DEV
+#define XDEVCFG_DEV "/dev/xdevcfg"
+#endif
+#ifndef XDEVCFG_PROG_DONE
+#define XDEVCFG_PROG_DONE "/sys/class/xdevcfg/xdevcfg/device/prog_done"
+#endif
+
+/* name of the overlay directory owned by the library */
+#define OVERLAY_NAME "dmabuf"
+
+#define MAX_PATH 512
+#define MAX_ATTR 64
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static const char *method_names[] = { "none", "fpga_manager", "overlay", "xdevcfg" };
+
+static const char *state_path(void)
+{
+    const char *env = getenv(DMA_BITSTREAM_STATE_ENV);
+    return env != NULL ? env : DMA_BITSTREAM_DEF_STATE;
+}
+
+uint64_t dma_bitstream_hash(const void *data, size_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t hash = FNV_OFFSET;
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        hash = (hash ^ p[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+const char *dma_bitstream_method_name(enum dma_bitstream_method method)
+{
+    return (unsigned)method < sizeof(method_names) / sizeof(method_names[0]) ?
+        method_names[method] : "unknown";
+}
+
+/*
+ * ------ file utilities ------
+ */
+
+static int write_all(int fd, const void *data, size_t length)
+{
+    const char *p = (const char *)data;
+    while (length > 0)
+    {
+        ssize_t written = write(fd, p, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+static int write_file(const char *path, const void *data, size_t length)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644), err;
+    if (fd < 0)
+    {
+        return -1;
+    }
+    err = write_all(fd, data, length);
+    if (close(fd) != 0)
+    {
+        err = -1;
+    }
+    return err;
+}
+
+static int write_attr(const char *path, const char *value)
+{
+    return write_file(path, value, strlen(value));
+}
+
+/* reads the first line of @p path into @p value, without the newline */
+static int read_attr(const char *path, char *value, size_t size)
+{
+    FILE *in = fopen(path, "r");
+    int err = 0;
+
+    if (in == NULL)
+    {
+        return -1;
+    }
+    if (fgets(value, (int)size, in) == NULL)
+    {
+        err = -1;
+    }
+    else
+    {
+        value[strcspn(value, "\n")] = '\0';
+    }
+    fclose(in);
+    return err;
+}
+
+static int read_file(const char *path, unsigned char **data, size_t *length)
+{
+    FILE *in = fopen(path, "rb");
+    long size;
+    int err = -1;
+
+    *data = NULL;
+    if (in == NULL)
+    {
+        return -1;
+    }
+    if (fseek(in, 0, SEEK_END) == 0 && (size = ftell(in)) > 0 && fseek(in, 0, SEEK_SET) == 0)
+    {
+        *data = malloc((size_t)size);
+        if (*data != NULL && fread(*data, 1, (size_t)size, in) == (size_t)size)
+        {
+            *length = (size_t)size;
+            err = 0;
+        }
+    }
+    fclose(in);
+    if (err != 0)
+    {
+        free(*data);
+        *data = NULL;
+    }
+    return err;
+}
+
+static int exists(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+/*
+ * ------ images ------
+ */
+
+/* name of the bitstream at @p path, without directories and extension */
+static void image_name(const char *path, char *name, size_t size)
+{
+    const char *base = strrchr(path, '/'), *dot;
+    size_t length;
+
+    base = base != NULL ? base + 1 : path;
+    dot = strrchr(base, '.');
+    length = dot != NULL && dot != base ? (size_t)(dot - base) : strlen(base);
+    if (length >= size)
+    {
+        length = size - 1;
+    }
+    memcpy(name, base, length);
+    name[length] = '\0';
+}
+
+/* path of the .dtbo file next to the bitstream at @p path */
+static void overlay_path(const char *path, char *dtbo, size_t size)
+{
+    const char *base = strrchr(path, '/'), *dot;
+    size_t length;
+
+    base = base != NULL ? base + 1 : path;
+    dot = strrchr(base, '.');
+    length = dot != NULL && dot != base ? (size_t)(dot - path) : strlen(path);
+    snprintf(dtbo, size, "%.*s.dtbo", (int)length, path);
+}
+
+/*
+ * configuration data of a .bit file: after a fixed preamble, fields 'a' to 'd' (design,
+ * part, date, time) with 16 bits big-endian lengths, then field 'e' with a 32 bits length
+ * and the data; files without the preamble are taken as raw images
+ */
+static int bit_payload(const unsigned char *bit, size_t length, size_t *offset, size_t *size)
+{
+    static const unsigned char preamble[] = {
+        0x00, 0x09, 0x0f, 0xf0, 0x0f, 0xf0, 0x0f, 0xf0, 0x0f, 0xf0, 0x00, 0x00, 0x01
+    };
+    size_t pos = sizeof(preamble);
+
+    if (length < sizeof(preamble) || memcmp(bit, preamble, sizeof(preamble)) != 0)
+    {
+        *offset = 0;
+        *size = length;
+        return 0;
+    }
+    while (pos < length)
+    {
+        unsigned char key = bit[pos++];
+        if (key == 'e')
+        {
+            size_t data_len;
+            if (pos + 4 > length)
+            {
+                return -1;
+            }
+            data_len = ((size_t)bit[pos] << 24) | ((size_t)bit[pos + 1] << 16)
+                | ((size_t)bit[pos + 2] << 8) | bit[pos + 3];
+            pos += 4;
+            if (data_len > length - pos)
+            {
+                return -1;
+            }
+            *offset = pos;
+            *size = data_len;
+            return 0;
+        }
+        if (key < 'a' || key > 'd' || pos + 2 > length)
+        {
+            return -1;
+        }
+        pos += 2 + (((size_t)bit[pos] << 8) | bit[pos + 1]);
+    }
+    return -1;
+}
+
+/*
+ * the FPGA manager wants the sync word 0xAA995566 as little-endian words, while .bit files store
+ * it big-endian: swap the bytes of each word unless the image is already in that order
+ */
+static int to_fpga_mgr_order(unsigned char *image, size_t size)
+{
+    size_t i;
+
+    if (size % 4 != 0)
+    {
+        return -1;
+    }
+    for (i = 0; i + 4 <= size; i += 4)
+    {
+        if (image[i] == 0x66 && image[i + 1] == 0x55 && image[i + 2] == 0x99
+            && image[i + 3] == 0xaa)
+        {
+            return 0;
+        }
+        if (image[i] == 0xaa && image[i + 1] == 0x99 && image[i + 2] == 0x55
+            && image[i + 3] == 0x66)
+        {
+            break;
+        }
+    }
+    if (i + 4 > size)
+    {
+        return -1;
+    }
+    for (i = 0; i < size; i += 4)
+    {
+        unsigned char t = image[i];
+        image[i] = image[i + 3];
+        image[i + 3] = t;
+        t = image[i + 1];
+        image[i + 1] = image[i + 2];
+        image[i + 2] = t;
+    }
+    return 0;
+}
+
+/* converts the bitstream into a firmware image, stored as "<name>.bin" */
+static int store_firmware(const char *path, unsigned char *bit, size_t length, char *firmware,
+    size_t size)
+{
+    char name[MAX_PATH / 2], target[MAX_PATH];
+    size_t offset, payload;
+
+    if (bit_payload(bit, length, &offset, &payload) != 0
+        || to_fpga_mgr_order(bit + offset, payload) != 0)
+    {
+        printf("%s: %s is not a valid bitstream\n", __func__, path);
+        return -1;
+    }
+    image_name(path, name, sizeof(name));
+    snprintf(firmware, size, "%s.bin", name);
+    snprintf(target, sizeof(target), "%s/%s", FIRMWARE_DIR, firmware);
+    if (write_file(target, bit + offset, payload) != 0)
+    {
+        printf("%s: cannot write %s\n", __func__, target);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * ------ interfaces ------
+ */
+
+static int fpga_mgr_load(const char *path, unsigned char *bit, size_t length)
+{
+    char firmware[MAX_PATH], state[MAX_ATTR] = "unknown";
+
+    if (store_firmware(path, bit, length, firmware, sizeof(firmware)) != 0)
+    {
+        return -1;
+    }
+    /* full reconfiguration */
+    if (write_attr(FPGA_MGR_DIR "/flags", "0") != 0
+        || write_attr(FPGA_MGR_DIR "/firmware", firmware) != 0)
+    {
+        printf("%s: the FPGA manager refused %s\n", __func__, firmware);
+        return -1;
+    }
+    if (read_attr(FPGA_MGR_DIR "/state", state, sizeof(state)) != 0
+        || strcmp(state, "operating") != 0)
+    {
+        printf("%s: FPGA manager in state %s after loading %s\n", __func__, state, firmware);
+        return -1;
+    }
+    return 0;
+}
+
+static int overlay_load(const char *path, unsigned char *bit, size_t length)
+{
+    char firmware[MAX_PATH], dtbo_path[MAX_PATH], status[MAX_ATTR];
+    const char *dir = OVERLAYS_DIR "/" OVERLAY_NAME;
+    unsigned char *dtbo;
+    size_t dtbo_length;
+    int err;
+
+    overlay_path(path, dtbo_path, sizeof(dtbo_path));
+    if (read_file(dtbo_path, &dtbo, &dtbo_length) != 0)
+    {
+        printf("%s: cannot read %s\n", __func__, dtbo_path);
+        return -1;
+    }
+    err = store_firmware(path, bit, length, firmware, sizeof(firmware));
+    /* removing the previous overlay releases its region, so that the new one can program it */
+    if (err == 0 && exists(dir) && rmdir(dir) != 0)
+    {
+        printf("%s: cannot remove the previous overlay\n", __func__);
+        err = -1;
+    }
+    if (err == 0 && mkdir(dir, 0755) != 0)
+    {
+        printf("%s: cannot create %s\n", __func__, dir);
+        err = -1;
+    }
+    if (err == 0 && write_file(OVERLAYS_DIR "/" OVERLAY_NAME "/dtbo", dtbo, dtbo_length) != 0)
+    {
+        printf("%s: the overlay %s was refused\n", __func__, dtbo_path);
+        err = -1;
+    }
+    if (err == 0 && (read_attr(OVERLAYS_DIR "/" OVERLAY_NAME "/status", status,
+        sizeof(status)) != 0 || strcmp(status, "applied") != 0))
+    {
+        printf("%s: the overlay %s was not applied\n", __func__, dtbo_path);
+        err = -1;
+    }
+    free(dtbo);
+    return err;
+}
+
+static int xdevcfg_load(unsigned char *bit, size_t length)
+{
+    int fd = open(XDEVCFG_DEV, O_WRONLY), err;
+
+    if (fd < 0)
+    {
+        printf("%s: cannot open " XDEVCFG_DEV "\n", __func__);
+        return -1;
+    }
+    /* the driver takes .bit files as they are, header included */
+    err = write_all(fd, bit, length);
+    if (close(fd) != 0 || err != 0)
+    {
+        printf("%s: programming via " XDEVCFG_DEV " failed\n", __func__);
+        return -1;
+    }
+    return 0;
+}
+
+enum dma_bitstream_method dma_bitstream_method(const char *path)
+{
+    char dtbo[MAX_PATH];
+
+    if (exists(FPGA_MGR_DIR "/firmware"))
+    {
+        return DMA_BITSTREAM_FPGA_MGR;
+    }
+    overlay_path(path, dtbo, sizeof(dtbo));
+    if (exists(OVERLAYS_DIR) && exists(dtbo))
+    {
+        return DMA_BITSTREAM_OVERLAY;
+    }
+    if (exists(XDEVCFG_DEV))
+    {
+        return DMA_BITSTREAM_XDEVCFG;
+    }
+    return DMA_BITSTREAM_NONE;
+}
+
+/* whether the interface still reports the fabric as programmed; unknown counts as yes */
+static int still_programmed(enum dma_bitstream_method method)
+{
+    char value[MAX_ATTR];
+
+    switch (method)
+    {
+    case DMA_BITSTREAM_FPGA_MGR:
+        return read_attr(FPGA_MGR_DIR "/state", value, sizeof(value)) != 0
+            || strcmp(value, "operating") == 0;
+    case DMA_BITSTREAM_OVERLAY:
+        return read_attr(OVERLAYS_DIR "/" OVERLAY_NAME "/status", value, sizeof(value)) == 0
+            && strcmp(value, "applied") == 0;
+    case DMA_BITSTREAM_XDEVCFG:
+        return read_attr(XDEVCFG_PROG_DONE, value, sizeof(value)) != 0
+            || strcmp(value, "1") == 0;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * ------ record of the loaded image ------
+ */
+
+/*
+ * opens the state, trusting it only if it is a private regular file of this user: a file another
+ * user planted, e.g. with the path given via the environment, or a link to a file of this user
+ * must be neither read nor overwritten
+ */
+static int open_state(int flags)
+{
+    struct stat st;
+    int fd = open(state_path(), flags | O_NOFOLLOW, 0600);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid()
+        || st.st_nlink != 1 || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+    {
+        printf("%s: ignoring %s, which is not a private file of this user\n", __func__,
+            state_path());
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int dma_bitstream_loaded(uint64_t *hash, enum dma_bitstream_method *method)
+{
+    char line[MAX_ATTR * 2], name[MAX_ATTR];
+    unsigned long long h;
+    unsigned i;
+    ssize_t length;
+    int fd = open_state(O_RDONLY);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    length = read(fd, line, sizeof(line) - 1);
+    close(fd);
+    if (length <= 0)
+    {
+        return -1;
+    }
+    line[length] = '\0';
+    if (sscanf(line, "%llx %63s", &h, name) != 2)
+    {
+        return -1;
+    }
+    *hash = (uint64_t)h;
+    if (method != NULL)
+    {
+        *method = DMA_BITSTREAM_NONE;
+        for (i = 0; i < sizeof(method_names) / sizeof(method_names[0]); i++)
+        {
+            if (strcmp(name, method_names[i]) == 0)
+            {
+                *method = (enum dma_bitstream_method)i;
+            }
+        }
+    }
+    return 0;
+}
+
+void dma_bitstream_forget(void)
+{
+    unlink(state_path());
+}
+
+static int record_loaded(uint64_t hash, enum dma_bitstream_method method)
+{
+    char line[MAX_ATTR * 2];
+    /* truncated only once trusted */
+    int fd = open_state(O_WRONLY | O_CREAT), err;
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    snprintf(line, sizeof(line), "%016llx %s\n", (unsigned long long)hash,
+        dma_bitstream_method_name(method));
+    err = ftruncate(fd, 0) != 0 || write_all(fd, line, strlen(line)) != 0 ? -1 : 0;
+    if (close(fd) != 0)
+    {
+        err = -1;
+    }
+    return err;
+}
+
+int dma_bitstream_load(const char *path, unsigned flags)
+{
+    enum dma_bitstream_method method = dma_bitstream_method(path), loaded_method;
+    unsigned char *bit;
+    size_t length;
+    uint64_t hash, loaded_hash;
+    int err;
+
+    if (read_file(path, &bit, &length) != 0)
+    {
+        printf("%s: cannot read %s\n", __func__, path);
+        return -1;
+    }
+    hash = dma_bitstream_hash(bit, length);
+    if ((flags & DMA_BITSTREAM_FORCE) == 0
+        && dma_bitstream_loaded(&loaded_hash, &loaded_method) == 0
+        && loaded_hash == hash && still_programmed(loaded_method))
+    {
+        free(bit);
+        return 1;
+    }
+
+    /* a failed load leaves the fabric in an unknown state */
+    dma_bitstream_forget();
+    switch (method)
+    {
+    case DMA_BITSTREAM_FPGA_MGR:
+        err = fpga_mgr_load(path, bit, length);
+        break;
+    case DMA_BITSTREAM_OVERLAY:
+        err = overlay_load(path, bit, length);
+        break;
+    case DMA_BITSTREAM_XDEVCFG:
+        err = xdevcfg_load(bit, length);
+        break;
+    default:
+        printf("%s: no interface to program the FPGA\n", __func__);
+        err = -1;
+        break;
+    }
+    free(bit);
+    if (err != 0)
+    {
+        return -1;
+    }
+    if (record_loaded(hash, method) != 0)
+    {
+        printf("%s: cannot record the image into %s\n", __func__, state_path());
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#ifndef DMA_BITSTREAM_H_
+#define DMA_BITSTREAM_H_
+
+/**
+ * @file dma_bitstream.h
+ * @author Alberto Scolari
+ * @brief Header with API to program the FPGA with a bitstream, skipping the reconfiguration
+ * when the same image is already loaded.
+ *
+ * Bitstreams are loaded through the first interface available among:
+ * - the sysfs interface of the Linux FPGA manager of Xilinx kernels
+ *   (/sys/class/fpga_manager/fpga0/firmware), which loads the image from /lib/firmware
+ * - a device tree overlay applied via configfs (/sys/kernel/config/device-tree/overlays), if
+ *   a .dtbo file with the same name as the bitstream sits next to it; its fpga-region node must
+ *   name the image as firmware-name = "<bitstream name without extension>.bin"
+ * - the /dev/xdevcfg device of older Zynq-7000 kernels, written directly
+ *
+ * For the first two, the .bit file is converted into the .bin image the FPGA manager expects
+ * (no header, bytes swapped within 32 bits words) and stored into /lib/firmware.
+ *
+ * The content hash (64 bits FNV-1a) of the last image loaded is recorded into a state file,
+ * read from the path in the environment variable DMA_BITSTREAM_STATE, if set, or from
+ * DMA_BITSTREAM_DEF_STATE, which is in tmpfs as the fabric does not survive reboots, and in
+ * a directory only root can write to. The state is opened without following symbolic links
+ * and trusted only if it is a regular file owned by the user, with no other link and writable
+ * by nobody else; otherwise it is ignored, and the image is loaded.
+ * Loading an image with the same hash does nothing, as long as the interface still reports the
+ * fabric as programmed; after programming the FPGA by other means, call
+ * @ref dma_bitstream_forget or load with DMA_BITSTREAM_FORCE.
+ * All functions need root permissions.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DMA_BITSTREAM_STATE_ENV "DMA_BITSTREAM_STATE" /**< variable with the path of the state */
+#define DMA_BITSTREAM_DEF_STATE "/run/dmabuf_bitstream" /**< default path of the state */
+
+#define DMA_BITSTREAM_FORCE 0x1U /**< flag to reprogram even if the same image is loaded */
+
+/**
+ * @brief The dma_bitstream_method enum lists the interfaces to program the FPGA
+ */
+enum dma_bitstream_method {
+    DMA_BITSTREAM_NONE, /**< no interface available */
+    DMA_BITSTREAM_FPGA_MGR, /**< sysfs interface of the FPGA manager */
+    DMA_BITSTREAM_OVERLAY, /**< device tree overlay via configfs */
+    DMA_BITSTREAM_XDEVCFG /**< the /dev/xdevcfg device */
+};
+
+/**
+ * @brief dma_bitstream_load programs the FPGA with the bitstream (.bit or .bin) at @p path,
+ * unless the same image is already loaded
+ *
+ * @param path the bitstream file
+ * @param flags 0 or DMA_BITSTREAM_FORCE
+ * @return 0 if the FPGA was programmed, 1 if the image was already loaded,
+ * negative value if the file cannot be read or programming failed
+ */
+int dma_bitstream_load(const char *path, unsigned flags);
+
+/**
+ * @brief dma_bitstream_method returns the interface @ref dma_bitstream_load would use
+ * for the bitstream at @p path (which matters only for the overlay interface, needing a .dtbo)
+ */
+enum dma_bitstream_method dma_bitstream_method(const char *path);
+
+/**
+ * @brief dma_bitstream_method_name returns a printable name of @p method
+ */
+const char *dma_bitstream_method_name(enum dma_bitstream_method method);
+
+/**
+ * @brief dma_bitstream_loaded reads the record of the last image loaded
+ *
+ * @param hash where to store its content hash
+ * @param method where to store the interface that loaded it; may be NULL
+ * @return 0 for success, non-0 if no image is recorded
+ */
+int dma_bitstream_loaded(uint64_t *hash, enum dma_bitstream_method *method);
+
+/**
+ * @brief dma_bitstream_forget deletes the record of the last image loaded, so that the next
+ * load programs the FPGA anyway
+ */
+void dma_bitstream_forget(void);
+
+/**
+ * @brief dma_bitstream_hash returns the content hash of @p length bytes from @p data,
+ * as recorded for loaded images
+ */
+uint64_t dma_bitstream_hash(const void *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_BITSTREAM_H_ */
@@ -0,0 +1,479 @@
+
+/**
+ * @file dma_broker.c
+ * @author Alberto Scolari
+ * @brief Implementation of the client side of the DMA broker protocol and of the bookkeeping
+ * of its broker side.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "dma_broker.h"
+#include "broker_internals.h"
+#include "map_internals.h"
+
+int dma_broker_send_msg(int sock, const struct dma_broker_msg *msg, int fd)
+{
+    struct msghdr hdr;
+    struct iovec iov;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    ssize_t ret;
+
+    memset(&hdr, 0, sizeof(hdr));
+    iov.iov_base = (void *)msg;
+    iov.iov_len = sizeof(*msg);
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    if (fd >= 0)
+    {
+        struct cmsghdr *cmsg;
+        memset(&ctrl, 0, sizeof(ctrl));
+        hdr.msg_control = ctrl.buf;
+        hdr.msg_controllen = sizeof(ctrl.buf);
+        cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    do {
+        ret = sendmsg(sock, &hdr, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    return ret == (ssize_t)sizeof(*msg) ? 0 : -1;
+}
+
+int dma_broker_recv_msg(int sock, struct dma_broker_msg *msg, int *fd)
+{
+    struct msghdr hdr;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    ssize_t ret;
+
+    memset(&hdr, 0, sizeof(hdr));
+    iov.iov_base = msg;
+    iov.iov_len = sizeof(*msg);
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = ctrl.buf;
+    hdr.msg_controllen = sizeof(ctrl.buf);
+    do {
+        ret = recvmsg(sock, &hdr, MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && errno == EINTR);
+    if (ret != (ssize_t)sizeof(*msg))
+    {
+        return -1;
+    }
+    if (fd != NULL)
+    {
+        *fd = -1;
+        for (cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            {
+                memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * wait for the reply of type @p type, skipping doorbells
+ * that may have been queued in the meantime
+ */
+static int wait_reply(struct dma_broker_client *client, uint32_t type,
+    struct dma_broker_msg *msg, int *fd)
+{
+    do {
+        if (dma_broker_recv_msg(client->sock, msg, fd) != 0)
+        {
+            return -1;
+        }
+        if (msg->type != type && fd != NULL && *fd >= 0)
+        {
+            close(*fd);
+        }
+    } while (msg->type != type);
+    return 0;
+}
+
+int dma_broker_connect(struct dma_broker_client *client, const char *path)
+{
+    struct sockaddr_un addr;
+    struct dma_broker_msg msg;
+    int fd;
+    void *rings;
+
+    if (path == NULL)
+    {
+        path = DMA_BROKER_DEF_SOCKET;
+    }
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("%s: socket path %s is too long\n", __func__, path);
+        return -1;
+    }
+    client->sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (client->sock < 0)
+    {
+        printf("%s: cannot create socket\n", __func__);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(client->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        printf("%s: cannot connect to %s\n", __func__, path);
+        close(client->sock);
+        return -1;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = DMA_BROKER_HELLO;
+    if (dma_broker_send_msg(client->sock, &msg, -1) != 0
+        || wait_reply(client, DMA_BROKER_HELLO, &msg, &fd) != 0 || msg.status != 0 || fd < 0)
+    {
+        printf("%s: broker handshake failed\n", __func__);
+        close(client->sock);
+        return -1;
+    }
+    rings = mmap(NULL, msg.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (rings == MAP_FAILED)
+    {
+        printf("%s: cannot mmap job rings\n", __func__);
+        close(client->sock);
+        return -1;
+    }
+    client->rings = (struct dma_broker_rings *)rings;
+    client->rings_size = msg.size;
+    client->num_engines = msg.buf;
+    client->num_ctrl = msg.offset;
+    return 0;
+}
+
+int dma_broker_alloc(struct dma_broker_client *client, unsigned buf, unsigned size,
+    struct dma_broker_slice *slice)
+{
+    struct dma_broker_msg msg;
+    int fd;
+    void *vaddr;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = DMA_BROKER_ALLOC;
+    msg.buf = buf;
+    msg.size = size;
+    if (dma_broker_send_msg(client->sock, &msg, -1) != 0
+        || wait_reply(client, DMA_BROKER_ALLOC, &msg, &fd) != 0)
+    {
+        return -1;
+    }
+    if (msg.status != 0 || fd < 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    /* the file is the whole UDMA buffer, which belongs to this client */
+    vaddr = map_device_memory(fd, msg.size, (off_t)msg.offset, 1);
+    close(fd);
+    slice->buf = msg.buf;
+    slice->offset = msg.offset;
+    slice->size = msg.size;
+    slice->paddr = (phys_addr_t)msg.paddr;
+    if (vaddr == MAP_FAILED)
+    {
+        printf("%s: cannot mmap slice\n", __func__);
+        slice->vaddr = NULL;
+        dma_broker_free(client, slice);
+        return -1;
+    }
+    slice->vaddr = vaddr;
+    return 0;
+}
+
+void dma_broker_free(struct dma_broker_client *client, struct dma_broker_slice *slice)
+{
+    struct dma_broker_msg msg;
+
+    if (slice->vaddr != NULL)
+    {
+        unmap_device_memory(slice->vaddr, slice->size);
+        slice->vaddr = NULL;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.type = DMA_BROKER_FREE;
+    msg.buf = slice->buf;
+    msg.offset = slice->offset;
+    msg.size = slice->size;
+    if (dma_broker_send_msg(client->sock, &msg, -1) == 0)
+    {
+        wait_reply(client, DMA_BROKER_FREE, &msg, NULL);
+    }
+}
+
+int dma_broker_submit(struct dma_broker_client *client, const struct dma_broker_job *job)
+{
+    struct dma_broker_rings *rings = client->rings;
+    struct dma_broker_msg msg;
+    uint32_t tail = rings->sq_tail;
+
+    if (tail - __atomic_load_n(&rings->sq_head, __ATOMIC_ACQUIRE) >= DMA_BROKER_RING_SIZE)
+    {
+        return -1;
+    }
+    rings->sq[tail % DMA_BROKER_RING_SIZE] = *job;
+    __atomic_store_n(&rings->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = DMA_BROKER_DOORBELL;
+    return dma_broker_send_msg(client->sock, &msg, -1);
+}
+
+int dma_broker_wait(struct dma_broker_client *client, struct dma_broker_completion *compl)
+{
+    struct dma_broker_rings *rings = client->rings;
+    struct dma_broker_msg msg;
+    uint32_t head = rings->cq_head;
+
+    while (head == __atomic_load_n(&rings->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        if (wait_reply(client, DMA_BROKER_DOORBELL, &msg, NULL) != 0)
+        {
+            return -1;
+        }
+    }
+    *compl = rings->cq[head % DMA_BROKER_RING_SIZE];
+    __atomic_store_n(&rings->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void dma_broker_disconnect(struct dma_broker_client *client)
+{
+    munmap(client->rings, client->rings_size);
+    close(client->sock);
+}
+
+void dma_broker_table_init(struct dma_broker_table *table, unsigned num_buffers,
+    const unsigned long *sizes, unsigned num_engines, unsigned num_ctrl)
+{
+    unsigned i;
+
+    memset(table, 0, sizeof(*table));
+    for (i = 0; i < DMA_BROKER_MAX_SLICES; i++)
+    {
+        table->slices[i].owner = -1;
+    }
+    for (i = 0; i < DMA_BROKER_MAX_BUFFERS; i++)
+    {
+        table->buf_owner[i] = -1;
+        table->buf_size[i] = i < num_buffers ? sizes[i] : 0;
+    }
+    table->num_buffers = num_buffers;
+    table->num_engines = num_engines;
+    table->num_ctrl = num_ctrl;
+}
+
+/*
+ * a buffer left by a client may still be mapped by its process:
+ * it can go to the same process or, once it exited, to any other
+ */
+static int buffer_available(struct dma_broker_table *table, pid_t pid, unsigned buf)
+{
+    pid_t last = table->buf_pid[buf];
+
+    if (last == 0 || last == pid)
+    {
+        return 1;
+    }
+    if (kill(last, 0) != 0 && errno == ESRCH)
+    {
+        table->buf_pid[buf] = 0;
+        return 1;
+    }
+    return 0;
+}
+
+int dma_broker_slice_alloc(struct dma_broker_table *table, int owner, pid_t pid, unsigned buf,
+    unsigned size, unsigned *offset, int *granted)
+{
+    unsigned long candidate = 0;
+    unsigned i;
+    int moved, free_entry = -1;
+
+    *granted = 0;
+    if (buf >= table->num_buffers || size == 0 || size > table->buf_size[buf])
+    {
+        return -1;
+    }
+    if (table->buf_owner[buf] < 0)
+    {
+        if ( !buffer_available(table, pid, buf) )
+        {
+            return -1;
+        }
+    } else if (table->buf_owner[buf] != owner)
+    {
+        return -1;
+    }
+    for (i = 0; i < DMA_BROKER_MAX_SLICES; i++)
+    {
+        if (table->slices[i].owner < 0)
+        {
+            free_entry = (int)i;
+            break;
+        }
+    }
+    if (free_entry < 0)
+    {
+        return -1;
+    }
+    do {
+        moved = 0;
+        for (i = 0; i < DMA_BROKER_MAX_SLICES; i++)
+        {
+            const struct dma_broker_slice_entry *s = table->slices + i;
+            if (s->owner >= 0 && s->buf == buf && candidate < (unsigned long)s->offset + s->size
+                && s->offset < candidate + size)
+            {
+                candidate = (unsigned long)s->offset + s->size;
+                moved = 1;
+            }
+        }
+    } while (moved);
+    /* slices lie within the buffer, and so does candidate */
+    if (size > table->buf_size[buf] - candidate)
+    {
+        return -1;
+    }
+    if (table->buf_owner[buf] < 0)
+    {
+        table->buf_owner[buf] = owner;
+        table->buf_pid[buf] = pid;
+        *granted = 1;
+    }
+    table->slices[free_entry].owner = owner;
+    table->slices[free_entry].buf = buf;
+    table->slices[free_entry].offset = (unsigned)candidate;
+    table->slices[free_entry].size = size;
+    *offset = (unsigned)candidate;
+    return 0;
+}
+
+int dma_broker_slice_free(struct dma_broker_table *table, int owner, unsigned buf,
+    unsigned offset)
+{
+    unsigned i;
+
+    for (i = 0; i < DMA_BROKER_MAX_SLICES; i++)
+    {
+        struct dma_broker_slice_entry *s = table->slices + i;
+        if (s->owner == owner && s->buf == buf && s->offset == offset)
+        {
+            s->owner = -1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void dma_broker_client_gone(struct dma_broker_table *table, int owner)
+{
+    unsigned i;
+
+    for (i = 0; i < DMA_BROKER_MAX_SLICES; i++)
+    {
+        if (table->slices[i].owner == owner)
+        {
+            table->slices[i].owner = -1;
+        }
+    }
+    /* buf_pid stays, until the process exits */
+    for (i = 0; i < table->num_buffers; i++)
+    {
+        if (table->buf_owner[i] == owner)
+        {
+            table->buf_owner[i] = -1;
+        }
+    }
+}
+
+/*
+ * @return non-0 if a slice of @p owner contains @p length bytes from @p offset of @p buf
+ */
+static int in_slice(const struct dma_broker_table *table, int owner, unsigned buf,
+    unsigned offset, unsigned length)
+{
+    unsigned i;
+
+    for (i = 0; i < DMA_BROKER_MAX_SLICES; i++)
+    {
+        const struct dma_broker_slice_entry *s = table->slices + i;
+        if (s->owner == owner && s->buf == buf && offset >= s->offset && length <= s->size
+            && offset - s->offset <= s->size - length)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int dma_broker_check_job(const struct dma_broker_table *table, int owner,
+    const struct dma_broker_job *job)
+{
+    unsigned i;
+
+    if (job->num_xfers > DMA_BROKER_MAX_XFERS || job->num_args > DMA_BROKER_MAX_ARGS
+        || job->kernel < -1 || job->kernel >= (int32_t)table->num_ctrl)
+    {
+        return -1;
+    }
+    for (i = 0; i < job->num_xfers; i++)
+    {
+        const struct dma_broker_xfer *x = job->xfers + i;
+        if (x->engine >= table->num_engines || x->buf >= table->num_buffers
+            || x->dir > DMA_BROKER_FROM_DEV || !in_slice(table, owner, x->buf, x->offset, x->length))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+struct dma_broker_completion *dma_broker_take_job(struct dma_broker_rings *rings,
+    struct dma_broker_job *job)
+{
+    uint32_t head = rings->sq_head, cq_tail = rings->cq_tail;
+
+    if (head == __atomic_load_n(&rings->sq_tail, __ATOMIC_ACQUIRE)
+        || cq_tail - __atomic_load_n(&rings->cq_head, __ATOMIC_ACQUIRE) >= DMA_BROKER_RING_SIZE)
+    {
+        return NULL;
+    }
+    *job = rings->sq[head % DMA_BROKER_RING_SIZE];
+    __atomic_store_n(&rings->sq_head, head + 1, __ATOMIC_RELEASE);
+    return rings->cq + cq_tail % DMA_BROKER_RING_SIZE;
+}
+
+void dma_broker_post_completion(struct dma_broker_rings *rings)
+{
+    __atomic_store_n(&rings->cq_tail, rings->cq_tail + 1, __ATOMIC_RELEASE);
+}
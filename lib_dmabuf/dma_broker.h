@@ -0,0 +1,211 @@
+
+#ifndef DMA_BROKER_H_
+#define DMA_BROKER_H_
+
+/**
+ * @file dma_broker.h
+ * @author Alberto Scolari
+ * @brief Header with the protocol and the client API of the DMA broker daemon.
+ *
+ * The broker daemon (tools/dma_brokerd) owns the UDMA buffers, the DMA engines and the AXI
+ * control interfaces, so that many processes can share the FPGA logic without loading the
+ * udmabuf module, mapping /dev/mem and resetting the engines themselves.
+ * Clients connect to the broker via a Unix socket (accessible to root and to the group
+ * the broker is configured with) and receive:
+ * - a shared-memory segment with a job submission ring and a completion ring
+ * - for each slice of the UDMA buffers they allocate, the file descriptor (via SCM_RIGHTS) of
+ *   the UDMA buffer, to mmap() the slice into the client address space
+ *
+ * Data go between the client and the FPGA logic with no copy. To keep clients from seeing each
+ * other's data, each UDMA buffer belongs to a single client, from its first slice until the client
+ * disconnects, and goes to another client only once the process of the former owner exited,
+ * cleared. Slices are mapped uncached, like the UDMA buffers of @ref load_udma_buffers; clients
+ * must not pass their mappings to other processes.
+ *
+ * Jobs describe a set of DMA transactions and an optional kernel invocation; the broker runs
+ * them in submission order and posts a completion for each job. Jobs not over within the
+ * timeout of the broker fail with DMA_TRANS_TIMEOUT, their transactions being cancelled;
+ * a kernel that did not end makes the jobs using its control interface fail with
+ * DMA_TRANS_RUNNING, until it ends.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "dma_engine_buf.h"
+
+/**
+ * @brief default socket of the broker, in a directory only root can write to
+ */
+#define DMA_BROKER_DEF_SOCKET "/run/zu_dma_broker/broker.sock"
+
+#define DMA_BROKER_RING_SIZE 64U
+#define DMA_BROKER_MAX_XFERS 4U
+#define DMA_BROKER_MAX_ARGS 8U
+
+/**
+ * @brief type of messages exchanged over the broker socket
+ */
+enum dma_broker_msg_type { DMA_BROKER_HELLO = 1, /**< connection set-up, carries the rings fd */
+                           DMA_BROKER_ALLOC, /**< slice allocation, carries the fd of the UDMA buffer */
+                           DMA_BROKER_FREE, /**< slice release */
+                           DMA_BROKER_DOORBELL /**< new jobs (client) or new completions (broker) */
+                         };
+
+/**
+ * @brief The dma_broker_msg struct is the fixed-size message exchanged over the broker socket
+ */
+struct dma_broker_msg {
+    uint32_t type; /**< one of @ref dma_broker_msg_type */
+    int32_t status; /**< 0 for success, non-0 otherwise (replies only) */
+    uint32_t buf; /**< UDMA buffer index (slices), number of engines (hello) */
+    uint32_t offset; /**< offset of the slice in the buffer, number of control interfaces (hello) */
+    uint32_t size; /**< size of the slice, size of the rings segment (hello) */
+    uint32_t pad;
+    uint64_t paddr; /**< physical address of the slice */
+};
+
+/**
+ * @brief direction of a DMA transaction within a broker job
+ */
+enum dma_broker_dir { DMA_BROKER_TO_DEV = 0, /**< transaction to FPGA logic */
+                      DMA_BROKER_FROM_DEV /**< transaction from FPGA logic */
+                    };
+
+/**
+ * @brief The dma_broker_xfer struct describes a DMA transaction of a job
+ */
+struct dma_broker_xfer {
+    uint32_t engine; /**< index of the DMA engine */
+    uint32_t dir; /**< one of @ref dma_broker_dir */
+    uint32_t buf; /**< UDMA buffer index, as from the slice */
+    uint32_t offset; /**< offset within the UDMA buffer (not within the slice) */
+    uint32_t length; /**< number of bytes to transmit */
+};
+
+/**
+ * @brief The dma_broker_job struct describes a job submitted to the broker
+ *
+ * The broker programs and starts all transactions from device, then all transactions to device,
+ * then the kernel (if any), and finally waits for all of them.
+ */
+struct dma_broker_job {
+    uint64_t cookie; /**< user value, returned in the completion */
+    uint32_t num_xfers; /**< number of valid entries in @ref xfers */
+    int32_t kernel; /**< index of the control interface to start, -1 for no kernel */
+    uint32_t num_args; /**< number of 32 bits kernel arguments, at offsets 0..num_args-1 */
+    uint32_t args[DMA_BROKER_MAX_ARGS]; /**< kernel arguments */
+    struct dma_broker_xfer xfers[DMA_BROKER_MAX_XFERS]; /**< DMA transactions */
+};
+
+/**
+ * @brief The dma_broker_completion struct describes the outcome of a job
+ */
+struct dma_broker_completion {
+    uint64_t cookie; /**< cookie of the job */
+    int32_t status; /**< 0 for success, a @ref dma_err_status value (DMA_TRANS_TIMEOUT if the job
+                         did not end in time, DMA_TRANS_ERROR if an engine halted on an error,
+                         DMA_TRANS_RUNNING if its kernel is still running from a job timed out)
+                         or -1 otherwise */
+    uint32_t err_mask; /**< OR of the hardware error bitmasks of the job's transactions */
+};
+
+/**
+ * @brief The dma_broker_rings struct is the layout of the shared-memory segment between
+ * a client and the broker; each ring has a single producer and a single consumer
+ */
+struct dma_broker_rings {
+    uint32_t sq_head; /**< next job to be consumed, written by the broker */
+    uint32_t sq_tail; /**< next free job slot, written by the client */
+    uint32_t cq_head; /**< next completion to be consumed, written by the client */
+    uint32_t cq_tail; /**< next free completion slot, written by the broker */
+    struct dma_broker_job sq[DMA_BROKER_RING_SIZE]; /**< submission ring */
+    struct dma_broker_completion cq[DMA_BROKER_RING_SIZE]; /**< completion ring */
+};
+
+/**
+ * @brief The dma_broker_client struct stores the client-side state of a broker connection
+ */
+struct dma_broker_client {
+    int sock; /**< connected socket to the broker */
+    struct dma_broker_rings *rings; /**< shared rings, mmap()ed from the broker's segment */
+    unsigned rings_size; /**< size of the shared rings mapping */
+    unsigned num_engines; /**< number of DMA engines owned by the broker */
+    unsigned num_ctrl; /**< number of control interfaces owned by the broker */
+};
+
+/**
+ * @brief The dma_broker_slice struct describes a slice of a UDMA buffer granted by the broker
+ */
+struct dma_broker_slice {
+    unsigned buf; /**< UDMA buffer index */
+    unsigned offset; /**< offset of the slice within the UDMA buffer */
+    unsigned size; /**< size of the slice */
+    void *vaddr; /**< pointer to access the slice (uncached), in process virtual memory space */
+    phys_addr_t paddr; /**< physical address of the slice */
+};
+
+/**
+ * @brief dma_broker_connect connects to the broker listening on @p path and maps the job rings
+ * @param client the user-allocated client struct to fill
+ * @param path socket path; if NULL, @ref DMA_BROKER_DEF_SOCKET is used
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_broker_connect(struct dma_broker_client *client, const char *path);
+
+/**
+ * @brief dma_broker_alloc asks the broker for a slice of @p size bytes of UDMA buffer @p buf
+ * and maps it into the process memory; the buffer must have no other client
+ * @param client the broker connection
+ * @param buf index of the UDMA buffer to allocate from
+ * @param size size of the slice, rounded up to the page size
+ * @param slice the user-allocated slice struct to fill
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_broker_alloc(struct dma_broker_client *client, unsigned buf, unsigned size,
+    struct dma_broker_slice *slice);
+
+/**
+ * @brief dma_broker_free unmaps @p slice and gives it back to the broker
+ */
+void dma_broker_free(struct dma_broker_client *client, struct dma_broker_slice *slice);
+
+/**
+ * @brief dma_broker_submit enqueues @p job and notifies the broker
+ * @return 0 for success, non-0 if the submission ring is full or the broker is unreachable
+ */
+int dma_broker_submit(struct dma_broker_client *client, const struct dma_broker_job *job);
+
+/**
+ * @brief dma_broker_wait waits for the oldest job completion and copies it to @p compl
+ * @return 0 for success, non-0 if the broker is unreachable
+ */
+int dma_broker_wait(struct dma_broker_client *client, struct dma_broker_completion *compl);
+
+/**
+ * @brief dma_broker_disconnect unmaps the rings and closes the connection; slices still
+ * allocated are released by the broker
+ */
+void dma_broker_disconnect(struct dma_broker_client *client);
+
+/**
+ * @brief dma_broker_send_msg sends @p msg over @p sock, along with @p fd if non-negative
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_broker_send_msg(int sock, const struct dma_broker_msg *msg, int fd);
+
+/**
+ * @brief dma_broker_recv_msg receives a message from @p sock and, if @p fd is not NULL,
+ * the file descriptor passed along with it (-1 if none)
+ * @return 0 for success, non-0 otherwise (including peer disconnection)
+ */
+int dma_broker_recv_msg(int sock, struct dma_broker_msg *msg, int *fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_BROKER_H_ */
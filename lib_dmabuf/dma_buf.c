@@ -15,8 +15,8 @@
 #include <unistd.h>
 
 #include "dma_engine_buf.h"
+#include "map_internals.h"
 
-static char param_string[ 145 ];
 
 #ifndef MODPATH
 #error "MODPATH must be defined!"
@@ -24,7 +24,7 @@ static char param_string[ 145 ];
 
 #define MODNAME "udmabuf"
 
-static char command_str[ 170 ] = "insmod " MODPATH "/" MODNAME ".ko";
+static const char insmod_cmd[] = "insmod " MODPATH "/" MODNAME ".ko";
 
 static char rmmod_cmd[] = "sudo rmmod " MODNAME;
 
@@ -33,10 +33,14 @@ static int run_command(const char *cmd)
     return system(cmd);
 }
 
-static void insert_module(unsigned int num, const unsigned long *sizes)
+/* longest argument of a buffer: " udmabuf<unsigned>=<unsigned long>" */
+#define MODARG_LEN (sizeof(" " MODNAME "=") + 3 * sizeof(unsigned) + 3 * sizeof(unsigned long))
+
+static int insert_module(unsigned int num, const unsigned long *sizes)
 {
     unsigned int i;
-    char *buf = param_string;
+    size_t size = sizeof(insmod_cmd) + num * MODARG_LEN, used;
+    char *command_str;
     int retval = run_command("lsmod | grep " MODNAME);
     if (retval == 0)
     {
@@ -44,36 +48,54 @@ static void insert_module(unsigned int num, const unsigned long *sizes)
         if (retval != 0)
         {
             printf("cannot unload the module\n");
-            exit(-1);
+            return -1;
         }
     }
 
-    for(i = 0; i < num; i++)
+    command_str = malloc(size);
+    if (command_str == NULL)
+    {
+        return -1;
+    }
+    used = (size_t)snprintf(command_str, size, "%s", insmod_cmd);
+    for(i = 0; i < num && used < size; i++)
+    {
+        int written = snprintf(command_str + used, size - used, " " MODNAME "%u=%lu", i, sizes[i]);
+        if (written < 0)
+        {
+            break;
+        }
+        used += (size_t)written;
+    }
+    if (i < num || used >= size)
     {
-        int written = sprintf(buf, " udmabuf%u=%lu", i, sizes[i]);
-        buf += written;
+        printf("%s: the module arguments do not fit the command\n", __func__);
+        free(command_str);
+        return -1;
     }
 
-    strcat(command_str, param_string);
     printf("running: %s\n", command_str);
     retval = run_command(command_str);
+    free(command_str);
     if (retval != 0)
     {
         printf("cannot insert module\n");
-        exit(-1);
+        return -1;
     }
+    return 0;
 }
 
 #define BUFPATH "/dev/" MODNAME
 #define PHYSPATH "/sys/class/" MODNAME "/" MODNAME
 #define PHYSNAME "/phys_addr"
+#define SIZENAME "/size"
 #define SYNCMODE "/sync_mode"
 #define SYNCDIR "/sync_direction"
 
-static void read_buf_data(unsigned int num, unsigned long size, struct udmabuf *buffer)
+static int read_buf_data(unsigned int num, unsigned long size, struct udmabuf *buffer)
 {
     int fd;
-    unsigned long parsed_size;
+    unsigned long long parsed_addr = 0;
     FILE *file;
     char bufname[60];
 
@@ -86,7 +108,7 @@ static void read_buf_data(unsigned int num, unsigned long size, struct udmabuf *
     if (file == NULL)
     {
         printf("cannot open file %s\n", bufname);
-        exit(-1);
+        return -1;
     }
     fprintf(file, "1");
     fclose(file);
@@ -99,7 +121,7 @@ static void read_buf_data(unsigned int num, unsigned long size, struct udmabuf *
     if (file == NULL)
     {
         printf("cannot open file %s\n", bufname);
-        exit(-1);
+        return -1;
     }
     fprintf(file, "0");
     fclose(file);
@@ -112,9 +134,16 @@ static void read_buf_data(unsigned int num, unsigned long size, struct udmabuf *
     if (fd == -1)
     {
         printf("cannot open file %s\n", bufname);
-        exit(-1);
+        return -1;
+    }
+    buffer->vaddr = map_device_memory(fd, size, 0, 1);
+    if (buffer->vaddr == MAP_FAILED)
+    {
+        printf("cannot mmap file %s\n", bufname);
+        close(fd);
+        buffer->fd = -1;
+        return -1;
     }
-    buffer->vaddr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     buffer->size = size;
 
     /*
@@ -122,9 +151,21 @@ static void read_buf_data(unsigned int num, unsigned long size, struct udmabuf *
      */
     sprintf(bufname, "%s%u%s", PHYSPATH, num, PHYSNAME);
     file = fopen(bufname, "r");
-    fscanf(file, "%lx", &parsed_size);
+    if (file == NULL)
+    {
+        printf("cannot open file %s\n", bufname);
+        return -1;
+    }
+    /* buffers may be above 4 GiB even with 32 bits userspace */
+    if (fscanf(file, "%llx", &parsed_addr) != 1)
+    {
+        printf("cannot parse physical address from %s\n", bufname);
+        fclose(file);
+        return -1;
+    }
     fclose(file);
-    buffer->paddr = (phys_addr_t)parsed_size;
+    buffer->paddr = (phys_addr_t)parsed_addr;
+    return 0;
 }
 
 int load_udma_buffers(unsigned int num, const unsigned long *sizes, struct udmabuf *buffers)
@@ -134,23 +175,88 @@ int load_udma_buffers(unsigned int num, const unsigned long *sizes, struct udmab
     {
             return 0;
     }
-    insert_module(num, sizes);
     for( i = 0; i < num; i++)
     {
-        read_buf_data(i, sizes[i], buffers + i);
+        buffers[i].fd = -1;
+    }
+    if (insert_module(num, sizes) != 0)
+    {
+        return -1;
+    }
+    for( i = 0; i < num; i++)
+    {
+        if (read_buf_data(i, sizes[i], buffers + i) != 0)
+        {
+            /* release the buffers mapped so far and the module */
+            unload_udma_buffers(num, buffers);
+            return -1;
+        }
     }
-    return num;
+    return 0;
 }
 
 void unload_udma_buffers(unsigned int num, struct udmabuf *buffers)
+{
+    detach_udma_buffers(num, buffers);
+    run_command(rmmod_cmd);
+}
+
+/*
+ * read the size of an existing buffer, to check it can host what the caller expects
+ */
+static int read_buf_size(unsigned int num, unsigned long *size)
+{
+    char bufname[60];
+    FILE *file;
+    int ret;
+
+    sprintf(bufname, "%s%u%s", PHYSPATH, num, SIZENAME);
+    file = fopen(bufname, "r");
+    if (file == NULL)
+    {
+        printf("cannot open file %s: is the module loaded?\n", bufname);
+        return -1;
+    }
+    ret = fscanf(file, "%lu", size) == 1 ? 0 : -1;
+    fclose(file);
+    return ret;
+}
+
+int attach_udma_buffers(unsigned int num, const unsigned long *sizes, struct udmabuf *buffers)
+{
+    unsigned int i;
+    unsigned long size;
+
+    for( i = 0; i < num; i++)
+    {
+        buffers[i].fd = -1;
+    }
+    for( i = 0; i < num; i++)
+    {
+        if (read_buf_size(i, &size) != 0 || size < sizes[i])
+        {
+            printf("%s: udmabuf%u is missing or smaller than %lu bytes\n", __func__, i, sizes[i]);
+            detach_udma_buffers(num, buffers);
+            return -1;
+        }
+        if (read_buf_data(i, sizes[i], buffers + i) != 0)
+        {
+            detach_udma_buffers(num, buffers);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void detach_udma_buffers(unsigned int num, struct udmabuf *buffers)
 {
     unsigned int i;
     for(i = 0; i < num; i++)
     {
         if (buffers[i].fd < 0) continue;
-        munmap(buffers[i].vaddr, buffers[i].size);
+        unmap_device_memory(buffers[i].vaddr, buffers[i].size);
         close(buffers[i].fd);
+        buffers[i].fd = -1;
     }
-    run_command(rmmod_cmd);
 }
 
@@ -0,0 +1,242 @@
+
+/**
+ * @file dma_capture.c
+ * @author Alberto Scolari
+ * @brief Implementation of continuous capture via the cyclic mode of AXI DMA S2MM channels.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dma_capture.h"
+#include "xhw_internals.h"
+#include "wait_internals.h"
+
+static phys_addr_t desc_paddr(struct dma_capture *cap, unsigned index)
+{
+    return cap->desc_buf->paddr + cap->desc_offset + index * AXI_DMA_SG_DESC_ALIGN;
+}
+
+static volatile struct axi_dma_sg_desc *desc_vaddr(struct dma_capture *cap, unsigned index)
+{
+    return (volatile struct axi_dma_sg_desc *)((char *)cap->desc_buf->vaddr
+        + cap->desc_offset + index * AXI_DMA_SG_DESC_ALIGN);
+}
+
+/*
+ * the soft reset of a channel resets the whole engine, aborting MM2S too: it is refused while
+ * a transaction towards the device runs, and leaves both directions not started
+ */
+static enum dma_err_status reset_s2mm(struct dma_engine *engine)
+{
+    volatile struct axi_direct_dma_regs *regs =
+        (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
+
+    if (engine->to_dev.status == STARTED)
+    {
+        printf("%s: a transaction towards the device is running\n", __func__);
+        return DMA_TRANS_RUNNING;
+    }
+    engine->to_dev.status = NOT_STARTED;
+    engine->from_dev.status = NOT_STARTED;
+    regs->s2mm_control = 4;
+    if (dma_reset_done(&regs->s2mm_control) != 0)
+    {
+        printf("%s: DMA engine does not complete its reset\n", __func__);
+        return DMA_ENGINE_HUNG;
+    }
+    return NO_ERROR;
+}
+
+int dma_capture_init(struct dma_capture *cap, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slot_size, unsigned num_slots,
+    struct udmabuf *desc_buf, unsigned desc_offset)
+{
+    unsigned i;
+
+    if ( !engine->sg_mode )
+    {
+        printf("%s: DMA engine is not in Scatter/Gather mode\n", __func__);
+        return -1;
+    }
+    if (num_slots < 2 || slot_size == 0 || slot_size > dma_max_length(engine)
+        || offset + (unsigned long)slot_size * num_slots > buf->size
+        || (desc_buf->paddr + desc_offset) % AXI_DMA_SG_DESC_ALIGN != 0
+        || desc_offset + (unsigned long)num_slots * AXI_DMA_SG_DESC_ALIGN > desc_buf->size)
+    {
+        printf("%s: slots or descriptors do not fit into the UDMA buffers\n", __func__);
+        return -1;
+    }
+    if (engine->addr_width < 64
+        && ((buf->paddr + buf->size - 1) >> engine->addr_width != 0
+            || (desc_buf->paddr + desc_buf->size - 1) >> engine->addr_width != 0))
+    {
+        printf("%s: UDMA buffers are beyond the %u address bits of the DMA engine\n", __func__,
+            engine->addr_width);
+        return -1;
+    }
+    memset(cap, 0, sizeof(*cap));
+    cap->lengths = calloc(num_slots, sizeof(unsigned));
+    cap->err_masks = calloc(num_slots, sizeof(unsigned));
+    if (cap->lengths == NULL || cap->err_masks == NULL)
+    {
+        printf("%s: cannot allocate capture state\n", __func__);
+        free(cap->lengths);
+        free(cap->err_masks);
+        return -1;
+    }
+    cap->engine = engine;
+    cap->buf = buf;
+    cap->offset = offset;
+    cap->slot_size = slot_size;
+    cap->num_slots = num_slots;
+    cap->desc_buf = desc_buf;
+    cap->desc_offset = desc_offset;
+
+    /* one descriptor per slot, chained into a loop */
+    for (i = 0; i < num_slots; i++)
+    {
+        volatile struct axi_dma_sg_desc *desc = desc_vaddr(cap, i);
+        phys_addr_t next = desc_paddr(cap, (i + 1) % num_slots);
+        phys_addr_t addr = buf->paddr + offset + (unsigned long)i * slot_size;
+
+        memset((void *)desc, 0, sizeof(*desc));
+        desc->next_desc_low = (uint32_t)next;
+        desc->buffer_addr_low = (uint32_t)addr;
+        desc->next_desc_high = (uint32_t)(next >> 32);
+        desc->buffer_addr_high = (uint32_t)(addr >> 32);
+        desc->control = slot_size;
+    }
+    /* the ring is fetched only once the capture starts, after its doorbell barrier */
+    return 0;
+}
+
+enum dma_err_status dma_capture_start(struct dma_capture *cap)
+{
+    volatile struct axi_direct_dma_regs *regs =
+        (volatile struct axi_direct_dma_regs *)cap->engine->regs_vaddr;
+    phys_addr_t first = desc_paddr(cap, 0);
+    /* in cyclic mode, the tail must point outside the descriptor loop */
+    phys_addr_t tail = desc_paddr(cap, cap->num_slots);
+    unsigned i;
+    enum dma_err_status err;
+
+    if (cap->running)
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    for (i = 0; i < cap->num_slots; i++)
+    {
+        desc_vaddr(cap, i)->status = 0;
+    }
+    cap->produced = cap->consumed = cap->dropped = 0;
+    err = reset_s2mm(cap->engine);
+    if (err != NO_ERROR)
+    {
+        return err;
+    }
+
+    regs->s2mm_cur_desc_low = (uint32_t)first;
+    regs->s2mm_cur_desc_high = (uint32_t)(first >> 32);
+    regs->s2mm_tail_desc_high = (uint32_t)(tail >> 32);
+    /* run, cyclic mode */
+    regs->s2mm_control = (1U << 0) | (1U << 4);
+    /* descriptors reset above must be in memory before the tail write starts the engine */
+    __doorbell_barrier();
+    regs->s2mm_tail_desc_low = (uint32_t)tail;
+    cap->running = 1;
+    return NO_ERROR;
+}
+
+unsigned long long dma_capture_poll(struct dma_capture *cap)
+{
+    unsigned scanned;
+
+    if ( !cap->running )
+    {
+        return cap->produced;
+    }
+    /*
+     * the engine does not check the Cmplt bit in cyclic mode: clear it once seen,
+     * so that it marks the slots written since the last poll
+     */
+    for (scanned = 0; scanned < cap->num_slots; scanned++)
+    {
+        unsigned slot = (unsigned)(cap->produced % cap->num_slots);
+        volatile struct axi_dma_sg_desc *desc = desc_vaddr(cap, slot);
+        uint32_t status = desc->status;
+
+        if ( !BIT(status, 31) )
+        {
+            break;
+        }
+        cap->lengths[slot] = BITFIELD(status, 0, 25);
+        cap->err_masks[slot] = BITFIELD(status, 28, 30);
+        desc->status = 0;
+        cap->produced++;
+    }
+    /* slots are read after their status words */
+    __mmio_rmb();
+    /* the engine has reached the oldest slot held by the consumer: drop the window */
+    if (cap->produced - cap->consumed >= cap->num_slots)
+    {
+        cap->dropped += cap->produced - cap->consumed;
+        cap->consumed = cap->produced;
+    }
+    return cap->produced;
+}
+
+unsigned dma_capture_window(struct dma_capture *cap, struct dma_capture_window *win)
+{
+    unsigned long long avail;
+    unsigned first, to_end;
+
+    dma_capture_poll(cap);
+    avail = cap->produced - cap->consumed;
+    first = (unsigned)(cap->consumed % cap->num_slots);
+    to_end = cap->num_slots - first;
+
+    win->index = cap->consumed;
+    win->first_slot = first;
+    win->num_slots = avail < to_end ? (unsigned)avail : to_end;
+    win->data = (char *)cap->buf->vaddr + cap->offset + (unsigned long)first * cap->slot_size;
+    return win->num_slots;
+}
+
+unsigned dma_capture_slot_length(struct dma_capture *cap, unsigned slot)
+{
+    return slot < cap->num_slots ? cap->lengths[slot] : 0;
+}
+
+void dma_capture_release(struct dma_capture *cap, unsigned num_slots)
+{
+    unsigned long long held = cap->produced - cap->consumed;
+    cap->consumed += num_slots < held ? num_slots : held;
+}
+
+enum dma_err_status dma_capture_stop(struct dma_capture *cap)
+{
+    enum dma_err_status err;
+
+    if ( !cap->running )
+    {
+        return NO_ERROR;
+    }
+    err = reset_s2mm(cap->engine);
+    if (err != DMA_TRANS_RUNNING)
+    {
+        cap->running = 0;
+    }
+    return err;
+}
+
+void dma_capture_destroy(struct dma_capture *cap)
+{
+    dma_capture_stop(cap);
+    free(cap->lengths);
+    free(cap->err_masks);
+    cap->lengths = cap->err_masks = NULL;
+}
@@ -0,0 +1,146 @@
+
+#ifndef DMA_CAPTURE_H_
+#define DMA_CAPTURE_H_
+
+/**
+ * @file dma_capture.h
+ * @author Alberto Scolari
+ * @brief Header with API for continuous capture from the FPGA logic into a circular
+ * UDMA buffer region, without re-arming the DMA engine.
+ *
+ * The capture needs an AXI DMA engine in Scatter/Gather mode (see @ref dma_engine.sg_mode):
+ * its S2MM channel runs in cyclic mode over a ring of descriptors, one per slot of the region,
+ * and keeps writing slot after slot with no CPU intervention, wrapping around at the end.
+ * The consumer tracks the producer index (the total number of slots written so far) and reads
+ * the captured slots in place, as a sliding window over the region, releasing them once done.
+ * Since the engine never waits for the consumer, a consumer lagging by a whole ring is detected
+ * as an overrun: the slots in the window are then dropped and the capture continues from the
+ * most recent data.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dma_engine_buf.h"
+
+/**
+ * @brief The dma_capture struct stores the state of a continuous capture
+ */
+struct dma_capture {
+    struct dma_engine *engine; /**< DMA engine in Scatter/Gather mode */
+    struct udmabuf *buf; /**< UDMA buffer hosting the capture region */
+    unsigned offset; /**< offset of the capture region within @ref buf */
+    unsigned slot_size; /**< size of each slot */
+    unsigned num_slots; /**< number of slots of the region */
+    struct udmabuf *desc_buf; /**< UDMA buffer hosting the descriptors */
+    unsigned desc_offset; /**< offset of the first descriptor within @ref desc_buf */
+    unsigned *lengths; /**< number of bytes captured in each slot */
+    unsigned *err_masks; /**< hardware error bitmask of each slot */
+    unsigned long long produced; /**< producer index: number of slots written since the start */
+    unsigned long long consumed; /**< number of slots released by the consumer since the start */
+    unsigned long long dropped; /**< number of slots dropped because of overruns */
+    int running; /**< 1 if the capture is running */
+};
+
+/**
+ * @brief The dma_capture_window struct describes the captured slots available to the consumer,
+ * which are contiguous in memory
+ */
+struct dma_capture_window {
+    void *data; /**< pointer to the first slot of the window, inside the UDMA buffer */
+    unsigned long long index; /**< producer index of the first slot */
+    unsigned first_slot; /**< slot number of the first slot */
+    unsigned num_slots; /**< number of slots of the window */
+};
+
+/**
+ * @brief dma_capture_init prepares a capture over @p num_slots slots of @p slot_size bytes
+ * each, starting at @p offset inside @p buf, with the descriptors at @p desc_offset
+ * inside @p desc_buf
+ *
+ * @param cap the user-allocated struct to initialize
+ * @param engine the DMA engine, in Scatter/Gather mode; its S2MM channel is used exclusively
+ * @param buf the UDMA buffer hosting the capture region
+ * @param offset offset of the capture region within @p buf
+ * @param slot_size size of each slot (at most @ref dma_max_length)
+ * @param num_slots number of slots, at least 2
+ * @param desc_buf the UDMA buffer to store the descriptors into (can be @p buf itself,
+ * outside the capture region)
+ * @param desc_offset offset of the first descriptor, aligned to 64 bytes; @p num_slots
+ * descriptors of 64 bytes each are stored
+ * @return 0 for success, non-0 if the engine is not in Scatter/Gather mode
+ * or the parameters are invalid
+ */
+int dma_capture_init(struct dma_capture *cap, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slot_size, unsigned num_slots,
+    struct udmabuf *desc_buf, unsigned desc_offset);
+
+/**
+ * @brief dma_capture_start starts the engine in cyclic mode, after which it captures
+ * continuously until @ref dma_capture_stop
+ *
+ * The engine is reset first, which aborts its MM2S channel too: the start is refused while
+ * a transaction towards the device is running.
+ *
+ * @param cap the capture
+ * @return an @ref dma_err_status value describing success or failure reason:
+ * DMA_TRANS_RUNNING if the capture or a transaction towards the device is running,
+ * DMA_ENGINE_HUNG if the engine does not complete its reset
+ */
+enum dma_err_status dma_capture_start(struct dma_capture *cap);
+
+/**
+ * @brief dma_capture_poll updates the producer index with the slots written by the engine
+ * since the last call, detecting overruns
+ *
+ * @param cap the capture
+ * @return the producer index, i.e. the number of slots written since the start
+ */
+unsigned long long dma_capture_poll(struct dma_capture *cap);
+
+/**
+ * @brief dma_capture_window polls the capture and describes in @p win the captured slots
+ * not released yet; the window ends at the end of the region, the following slots being
+ * available after those are released
+ *
+ * @param cap the capture
+ * @param win the user-allocated struct to fill
+ * @return the number of slots of the window
+ */
+unsigned dma_capture_window(struct dma_capture *cap, struct dma_capture_window *win);
+
+/**
+ * @brief dma_capture_slot_length returns the number of bytes captured in @p slot,
+ * which may be less than the slot size if the FPGA logic asserted TLAST earlier
+ */
+unsigned dma_capture_slot_length(struct dma_capture *cap, unsigned slot);
+
+/**
+ * @brief dma_capture_release gives back to the capture the @p num_slots oldest slots
+ * of the window
+ */
+void dma_capture_release(struct dma_capture *cap, unsigned num_slots);
+
+/**
+ * @brief dma_capture_stop stops the capture by resetting the engine, which leaves both its
+ * directions not started; as for @ref dma_capture_start, the reset is refused while
+ * a transaction towards the device is running
+ *
+ * @return NO_ERROR if the capture is stopped, DMA_TRANS_RUNNING if it is still running because
+ * of a transaction towards the device, DMA_ENGINE_HUNG if the engine does not complete its reset
+ * (the capture is then marked stopped, but the engine is not usable)
+ */
+enum dma_err_status dma_capture_stop(struct dma_capture *cap);
+
+/**
+ * @brief dma_capture_destroy releases the capture state, stopping it via
+ * @ref dma_capture_stop if still running
+ */
+void dma_capture_destroy(struct dma_capture *cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_CAPTURE_H_ */
@@ -0,0 +1,361 @@
+
+/**
+ * @file dma_cdma.c
+ * @author Alberto Scolari
+ * @brief Implementation of memory copies via AXI Central DMA engines.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dma_cdma.h"
+#include "xhw_internals.h"
+#include "wait_internals.h"
+#include "map_internals.h"
+
+#define LINUX_MEM_DEV "/dev/mem"
+
+/* largest length the bytes-to-transfer field can hold */
+#define MAX_COPY_LENGTH ((1U << 26) - 1U)
+
+/* the descriptors set via set_sg_descriptors are kept */
+static int cdma_engine_init(struct cdma_engine *engine)
+{
+    volatile struct axi_cdma_regs *regs = (volatile struct axi_cdma_regs *)engine->regs_vaddr;
+
+    /* reset everything, no interrupt mode, simple mode */
+    engine->copy.status = NOT_STARTED;
+    engine->num_descs = 0;
+    engine->sg_status = NOT_STARTED;
+    regs->control = 4;
+    if (dma_reset_done(&regs->control) != 0)
+    {
+        printf("%s: CDMA engine does not complete its reset\n", __func__);
+        return -1;
+    }
+
+    engine->sg_capable = (int)BIT(regs->status, 3);
+    SET_BITFIELD(regs->status, 12, 14, 0);
+    regs->source_addr_high = 0;
+    regs->dest_addr_high = 0;
+    regs->cur_desc_high = 0;
+    regs->tail_desc_high = 0;
+    return 0;
+}
+
+int get_cdma_interfaces(unsigned num_cdma, phys_addr_t *offsets,
+    unsigned *lengths, struct cdma_engine *engines)
+{
+    char *result;
+    int fd;
+    unsigned i;
+
+    fd = open(LINUX_MEM_DEV, O_RDWR | O_SYNC);
+    if (fd == -1)
+    {
+        printf("%s: impossible to open %s\n", __func__, LINUX_MEM_DEV);
+        return -1;
+    }
+
+    for(i = 0; i < num_cdma; i++) {
+        phys_addr_t __offset = offsets == NULL ? AXI_CDMA_REGISTER_LOCATION : offsets[i];
+        unsigned __length = lengths == NULL ? DESCRIPTOR_REGISTERS_SIZE : lengths[i];
+
+        engines[i].fd = fd;
+        engines[i].regs_vaddr = result = map_device_memory(fd, __length, __offset, 0);
+        engines[i].length = __length;
+        engines[i].desc_buf = NULL;
+        engines[i].max_descs = 0;
+        if ( result == MAP_FAILED )
+        {
+            printf("%s: impossible to mmap %s\n", __func__, LINUX_MEM_DEV);
+        } else if (cdma_engine_init(engines + i) != 0)
+        {
+            printf("%s: CDMA engine at 0x%llx is not usable\n", __func__,
+                (unsigned long long)__offset);
+            unmap_device_memory(result, __length);
+            result = MAP_FAILED;
+        }
+        if ( result == MAP_FAILED )
+        {
+            unsigned j;
+            for( j = 0; j < i; j++) {
+                unmap_device_memory((void*)engines[j].regs_vaddr, engines[j].length);
+            }
+            close(fd);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void destroy_cdma_interfaces(unsigned num_cdma, struct cdma_engine *engines)
+{
+    unsigned i;
+    for( i = 0; i < num_cdma; i++) {
+        unmap_device_memory((void*)engines[i].regs_vaddr, engines[i].length);
+    }
+    if (num_cdma > 0)
+    {
+        /* all engines share the same file descriptor */
+        close(engines[0].fd);
+    }
+}
+
+enum dma_err_status reset_cdma_engine(struct cdma_engine *engine)
+{
+    return cdma_engine_init(engine) == 0 ? DMA_ENGINE_RESET : DMA_ENGINE_HUNG;
+}
+
+/* DMAIntErr, DMASlvErr, DMADecErr and their Scatter/Gather counterparts, which halt the engine */
+#define CDMA_ERR_MASK (0x7U << 4 | 0x7U << 8)
+
+/* wait until the engine is idle, or halted on an error, or until @p deadline_ns passes */
+static enum dma_err_status wait_cdma_idle(volatile struct axi_cdma_regs *regs,
+    unsigned usleep_timeout, uint64_t deadline_ns)
+{
+    uint32_t status;
+
+    while ( !BIT(status = regs->status, 1) && (status & CDMA_ERR_MASK) == 0 ) {
+        if (deadline_ns != DMA_NO_DEADLINE && dma_stats_now() >= deadline_ns) {
+            return DMA_TRANS_TIMEOUT;
+        }
+        if (usleep_timeout != 0) {
+            usleep_nano(usleep_timeout);
+        }
+    }
+    if ((status & CDMA_ERR_MASK) != 0)
+    {
+        return DMA_TRANS_ERROR;
+    }
+    /* the copied data can be read only after the engine is seen idle */
+    __mmio_rmb();
+    return NO_ERROR;
+}
+
+static int cdma_is_busy(struct cdma_engine *engine)
+{
+    return engine->copy.status == STARTED || engine->sg_status == STARTED;
+}
+
+enum dma_err_status set_simple_copy_phys(struct cdma_engine *engine, phys_addr_t dst_addr,
+    phys_addr_t src_addr, unsigned length)
+{
+    volatile struct axi_cdma_regs *regs = (volatile struct axi_cdma_regs *)engine->regs_vaddr;
+
+    if ( cdma_is_busy(engine) )
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    if (length == 0 || length > MAX_COPY_LENGTH)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    regs->source_addr_low = engine->copy.src_low = (uint32_t)src_addr;
+    regs->dest_addr_low = engine->copy.dst_low = (uint32_t)dst_addr;
+    regs->source_addr_high = engine->copy.src_high = (uint32_t)(src_addr >> 32);
+    regs->dest_addr_high = engine->copy.dst_high = (uint32_t)(dst_addr >> 32);
+
+    engine->copy.length = length;
+    engine->copy.status = PROGRAMMED;
+    return NO_ERROR;
+}
+
+enum dma_err_status set_simple_copy(struct cdma_engine *engine, struct udmabuf *dst_buf,
+    unsigned dst_offset, struct udmabuf *src_buf, unsigned src_offset, unsigned length)
+{
+    return set_simple_copy_phys(engine, dst_buf->paddr + dst_offset,
+        src_buf->paddr + src_offset, length);
+}
+
+enum dma_err_status start_simple_copy(struct cdma_engine *engine)
+{
+    volatile struct axi_cdma_regs *regs = (volatile struct axi_cdma_regs *)engine->regs_vaddr;
+
+    if (engine->copy.status == NOT_STARTED)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    if ( cdma_is_busy(engine) )
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    /* writing the length starts the copy, after the addresses and the source data */
+    __doorbell_barrier();
+    SET_BITFIELD(regs->bytes_to_transfer, 0, 25, engine->copy.length);
+    engine->copy.status = STARTED;
+    return NO_ERROR;
+}
+
+enum dma_err_status wait_simple_copy(struct cdma_engine *engine, unsigned usleep_timeout)
+{
+    return wait_simple_copy_until(engine, usleep_timeout, DMA_NO_DEADLINE);
+}
+
+enum dma_err_status wait_simple_copy_until(struct cdma_engine *engine, unsigned usleep_timeout,
+    uint64_t deadline_ns)
+{
+    enum dma_err_status err;
+
+    if (engine->copy.status != STARTED)
+    {
+        return DMA_TRANS_NOT_STARTED;
+    }
+    err = wait_cdma_idle((volatile struct axi_cdma_regs *)engine->regs_vaddr, usleep_timeout,
+        deadline_ns);
+    if (err != DMA_TRANS_TIMEOUT)
+    {
+        engine->copy.status = PROGRAMMED;
+    }
+    return err;
+}
+
+unsigned err_status_copy(struct cdma_engine *engine)
+{
+    volatile struct axi_cdma_regs *regs = (volatile struct axi_cdma_regs *)engine->regs_vaddr;
+    uint32_t value = regs->status;
+
+    /* DMA and Scatter/Gather errors only */
+    SET_BITFIELD(value, 0, 3, 0);
+    SET_BITFIELD(value, 11, 31, 0);
+    UNSET_BIT(value, 7);
+    return value;
+}
+
+int set_sg_descriptors(struct cdma_engine *engine, struct udmabuf *desc_buf,
+    unsigned desc_offset, unsigned max_descs)
+{
+    if ( !engine->sg_capable )
+    {
+        printf("%s: CDMA engine has no Scatter/Gather logic\n", __func__);
+        return -1;
+    }
+    if ( (desc_buf->paddr + desc_offset) % AXI_CDMA_SG_DESC_ALIGN != 0
+        || desc_offset + (unsigned long)max_descs * AXI_CDMA_SG_DESC_ALIGN > desc_buf->size)
+    {
+        printf("%s: descriptors are not aligned or do not fit into the UDMA buffer\n", __func__);
+        return -1;
+    }
+    if (engine->sg_status == STARTED)
+    {
+        return -1;
+    }
+    engine->desc_buf = desc_buf;
+    engine->desc_offset = desc_offset;
+    engine->max_descs = max_descs;
+    engine->num_descs = 0;
+    engine->sg_status = NOT_STARTED;
+    return 0;
+}
+
+static phys_addr_t desc_paddr(struct cdma_engine *engine, unsigned index)
+{
+    return engine->desc_buf->paddr + engine->desc_offset + index * AXI_CDMA_SG_DESC_ALIGN;
+}
+
+static volatile struct axi_cdma_sg_desc *desc_vaddr(struct cdma_engine *engine, unsigned index)
+{
+    return (volatile struct axi_cdma_sg_desc *)((char *)engine->desc_buf->vaddr
+        + engine->desc_offset + index * AXI_CDMA_SG_DESC_ALIGN);
+}
+
+enum dma_err_status add_sg_copy_phys(struct cdma_engine *engine, phys_addr_t dst_addr,
+    phys_addr_t src_addr, unsigned length)
+{
+    volatile struct axi_cdma_sg_desc *desc;
+    phys_addr_t this_desc;
+
+    if (engine->sg_status == STARTED)
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    if (engine->num_descs == engine->max_descs || length == 0 || length > MAX_COPY_LENGTH)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    this_desc = desc_paddr(engine, engine->num_descs);
+    desc = desc_vaddr(engine, engine->num_descs);
+    desc->next_desc_low = 0;
+    desc->next_desc_high = 0;
+    desc->source_addr_low = (uint32_t)src_addr;
+    desc->dest_addr_low = (uint32_t)dst_addr;
+    desc->source_addr_high = (uint32_t)(src_addr >> 32);
+    desc->dest_addr_high = (uint32_t)(dst_addr >> 32);
+    desc->control = length;
+    desc->status = 0;
+    if (engine->num_descs > 0)
+    {
+        volatile struct axi_cdma_sg_desc *prev = desc_vaddr(engine, engine->num_descs - 1);
+        prev->next_desc_low = (uint32_t)this_desc;
+        prev->next_desc_high = (uint32_t)(this_desc >> 32);
+    }
+    engine->num_descs++;
+    engine->sg_status = PROGRAMMED;
+    return NO_ERROR;
+}
+
+enum dma_err_status add_sg_copy(struct cdma_engine *engine, struct udmabuf *dst_buf,
+    unsigned dst_offset, struct udmabuf *src_buf, unsigned src_offset, unsigned length)
+{
+    return add_sg_copy_phys(engine, dst_buf->paddr + dst_offset,
+        src_buf->paddr + src_offset, length);
+}
+
+enum dma_err_status start_sg_copy(struct cdma_engine *engine)
+{
+    volatile struct axi_cdma_regs *regs = (volatile struct axi_cdma_regs *)engine->regs_vaddr;
+    phys_addr_t first, last;
+
+    if (engine->sg_status == NOT_STARTED)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    if ( cdma_is_busy(engine) )
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    first = desc_paddr(engine, 0);
+    last = desc_paddr(engine, engine->num_descs - 1);
+    SET_BIT(regs->control, 3);
+    regs->cur_desc_low = (uint32_t)first;
+    regs->cur_desc_high = (uint32_t)(first >> 32);
+    regs->tail_desc_high = (uint32_t)(last >> 32);
+    /* writing the tail descriptor starts the run: descriptors must be in memory before */
+    __doorbell_barrier();
+    regs->tail_desc_low = (uint32_t)last;
+    engine->sg_status = STARTED;
+    return NO_ERROR;
+}
+
+enum dma_err_status wait_sg_copy(struct cdma_engine *engine, unsigned usleep_timeout)
+{
+    return wait_sg_copy_until(engine, usleep_timeout, DMA_NO_DEADLINE);
+}
+
+enum dma_err_status wait_sg_copy_until(struct cdma_engine *engine, unsigned usleep_timeout,
+    uint64_t deadline_ns)
+{
+    volatile struct axi_cdma_regs *regs = (volatile struct axi_cdma_regs *)engine->regs_vaddr;
+    enum dma_err_status err;
+
+    if (engine->sg_status != STARTED)
+    {
+        return DMA_TRANS_NOT_STARTED;
+    }
+    err = wait_cdma_idle(regs, usleep_timeout, deadline_ns);
+    if (err == DMA_TRANS_TIMEOUT)
+    {
+        return err;
+    }
+    /* back to simple mode, ready for a new run */
+    UNSET_BIT(regs->control, 3);
+    __mmio_wmb();
+    engine->num_descs = 0;
+    engine->sg_status = NOT_STARTED;
+    return err;
+}
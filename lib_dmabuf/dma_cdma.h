@@ -0,0 +1,226 @@
+
+#ifndef DMA_CDMA_H_
+#define DMA_CDMA_H_
+
+/**
+ * @file dma_cdma.h
+ * @author Alberto Scolari
+ * @brief Header with API to copy memory areas via Xilinx AXI Central DMA engines.
+ *
+ * Unlike AXI DMA, which moves data between memory and the FPGA logic via AXI streams,
+ * AXI Central DMA (CDMA) copies data between two memory-mapped areas, e.g. between
+ * UDMA buffers or from a UDMA buffer to memory attached to the FPGA logic, leaving the CPU free.
+ * Copies follow the same conventions of DMA transactions: a copy is set, started and waited for;
+ * several copies can be chained into a single Scatter/Gather run if the engine includes
+ * the Scatter/Gather logic.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dma_engine_buf.h"
+
+/**
+ * @brief The cdma_transaction struct encodes the information of a memory copy,
+ * either to be run or currently running.
+ */
+struct cdma_transaction {
+    uint32_t src_low; /**< low 32 bits of source address */
+    uint32_t dst_low; /**< low 32 bits of destination address */
+    uint32_t src_high; /**< high 32 bits of source address */
+    uint32_t dst_high; /**< high 32 bits of destination address */
+    uint32_t length; /**< number of bytes to be copied */
+    enum dma_trans_status status; /**< current status of the copy */
+};
+
+/**
+ * @brief The cdma_engine struct stores the information about an AXI CDMA engine.
+ *
+ * The CDMA engine is mapped from /dev/mem according to the addresses in Vivado Address Editor.
+ */
+struct cdma_engine {
+    int fd; /**< file descriptor of /dev/mem */
+    unsigned length; /**< length of mmaped() area */
+    volatile char *regs_vaddr; /**< pointer to CDMA register area */
+    int sg_capable; /**< 1 if the engine includes the Scatter/Gather logic */
+    struct cdma_transaction copy; /**< information about the simple copy */
+    struct udmabuf *desc_buf; /**< UDMA buffer hosting the Scatter/Gather descriptors */
+    unsigned desc_offset; /**< offset of the first descriptor within @ref desc_buf */
+    unsigned max_descs; /**< number of descriptors available */
+    unsigned num_descs; /**< number of descriptors of the current Scatter/Gather run */
+    enum dma_trans_status sg_status; /**< current status of the Scatter/Gather run */
+};
+
+/**
+ * @brief get_cdma_interfaces loads the CDMA engines from physical memory,
+ * making them available to the process, and resets them
+ *
+ * @param num_cdma number of CDMA engines
+ * @param offsets physical address of CDMA engines, as from Vivado Address Editor;
+ * if num_cdma == 1, offsets can be NULL and the default location AXI_CDMA_REGISTER_LOCATION
+ * is used
+ * @param lengths lengths of CDMA register areas to be mapped; if NULL, the default length
+ * DESCRIPTOR_REGISTERS_SIZE is used
+ * @param engines the user-allocated array of @ref cdma_engine to fill
+ * @return 0 for success, non-0 otherwise, also if an engine does not complete its reset
+ */
+int get_cdma_interfaces(unsigned num_cdma, phys_addr_t *offsets,
+    unsigned *lengths, struct cdma_engine *engines);
+
+/**
+ * @brief destroy_cdma_interfaces releases the CDMA engines
+ *
+ * @param num_cdma number of CDMA engines
+ * @param engines the CDMA engines to release
+ */
+void destroy_cdma_interfaces(unsigned num_cdma, struct cdma_engine *engines);
+
+/**
+ * @brief set_simple_copy programs a copy of @p length bytes from @p src_buf at @p src_offset
+ * to @p dst_buf at @p dst_offset
+ *
+ * @param engine the CDMA engine pointer
+ * @return an @ref dma_err_status value describing success or failure reason
+ */
+enum dma_err_status set_simple_copy(struct cdma_engine *engine, struct udmabuf *dst_buf,
+    unsigned dst_offset, struct udmabuf *src_buf, unsigned src_offset, unsigned length);
+
+/**
+ * @brief set_simple_copy_phys programs a copy of @p length bytes between physical addresses,
+ * e.g. to reach memory attached to the FPGA logic
+ *
+ * @param engine the CDMA engine pointer
+ * @param dst_addr physical address to copy to
+ * @param src_addr physical address to copy from
+ * @param length how many bytes to copy (at most 2^26 - 1)
+ * @return an @ref dma_err_status value describing success or failure reason
+ */
+enum dma_err_status set_simple_copy_phys(struct cdma_engine *engine, phys_addr_t dst_addr,
+    phys_addr_t src_addr, unsigned length);
+
+/**
+ * @brief start_simple_copy actually starts the copy programmed in @p engine
+ *
+ * @param engine the CDMA engine pointer
+ * @return an @ref dma_err_status value describing success or failure reason
+ */
+enum dma_err_status start_simple_copy(struct cdma_engine *engine);
+
+/**
+ * @brief wait_simple_copy waits for the completion of the copy.
+ * Users can optionally specify sleeping time via @p usleep_timeout
+ *
+ * @param engine the CDMA engine pointer
+ * @param usleep_timeout sleeping intervals to wait for the copy end; 0 means busy wait,
+ * as does DMA_USLEEP_AUTO, CDMA engines not being calibrated
+ * @return an @ref dma_err_status value saying whether the copy has ended successfully,
+ * or why it failed; DMA_TRANS_ERROR if the engine halted on an error (see @ref err_status_copy),
+ * after which it takes new copies only once recovered via @ref reset_cdma_engine
+ */
+enum dma_err_status wait_simple_copy(struct cdma_engine *engine, unsigned usleep_timeout);
+
+/**
+ * @brief wait_simple_copy_until waits like @ref wait_simple_copy, giving up at @p deadline_ns
+ *
+ * @param engine the CDMA engine pointer
+ * @param usleep_timeout sleeping intervals, as for @ref wait_simple_copy
+ * @param deadline_ns absolute deadline, as for @ref wait_simple_transfer_to_device_until
+ * @return as @ref wait_simple_copy, or DMA_TRANS_TIMEOUT if the deadline passed: the copy
+ * is still running, and can be waited for again or aborted via @ref reset_cdma_engine
+ */
+enum dma_err_status wait_simple_copy_until(struct cdma_engine *engine, unsigned usleep_timeout,
+    uint64_t deadline_ns);
+
+/**
+ * @brief err_status_copy retrieves the hardware-related error bitmask after a copy
+ * (simple or Scatter/Gather) is unsuccessful.
+ *
+ * @param engine the CDMA engine pointer
+ */
+unsigned err_status_copy(struct cdma_engine *engine);
+
+/**
+ * @brief set_sg_descriptors gives @p engine the memory to store up to @p max_descs
+ * Scatter/Gather descriptors, at @p desc_offset inside @p desc_buf
+ *
+ * @param engine the CDMA engine pointer
+ * @param desc_buf the UDMA buffer to store descriptors into
+ * @param desc_offset offset of the first descriptor, aligned to 64 bytes
+ * @param max_descs maximum number of copies in a Scatter/Gather run
+ * @return 0 for success, non-0 if the engine has no Scatter/Gather logic
+ * or the descriptors do not fit into @p desc_buf
+ */
+int set_sg_descriptors(struct cdma_engine *engine, struct udmabuf *desc_buf,
+    unsigned desc_offset, unsigned max_descs);
+
+/**
+ * @brief add_sg_copy appends a copy to the Scatter/Gather run of @p engine, with the same
+ * parameters of @ref set_simple_copy
+ *
+ * @return an @ref dma_err_status value describing success or failure reason;
+ * DMA_TRANS_NOT_PROGRAMMED if no descriptor is left
+ */
+enum dma_err_status add_sg_copy(struct cdma_engine *engine, struct udmabuf *dst_buf,
+    unsigned dst_offset, struct udmabuf *src_buf, unsigned src_offset, unsigned length);
+
+/**
+ * @brief add_sg_copy_phys appends a copy to the Scatter/Gather run of @p engine, with the same
+ * parameters of @ref set_simple_copy_phys
+ *
+ * @return an @ref dma_err_status value describing success or failure reason;
+ * DMA_TRANS_NOT_PROGRAMMED if no descriptor is left
+ */
+enum dma_err_status add_sg_copy_phys(struct cdma_engine *engine, phys_addr_t dst_addr,
+    phys_addr_t src_addr, unsigned length);
+
+/**
+ * @brief start_sg_copy starts all the copies added since the last run, which the engine
+ * performs one after the other without CPU intervention
+ *
+ * @param engine the CDMA engine pointer
+ * @return an @ref dma_err_status value describing success or failure reason
+ */
+enum dma_err_status start_sg_copy(struct cdma_engine *engine);
+
+/**
+ * @brief wait_sg_copy waits for the completion of all the copies of the Scatter/Gather run,
+ * after which the engine accepts simple copies and new Scatter/Gather runs again
+ *
+ * @param engine the CDMA engine pointer
+ * @param usleep_timeout sleeping intervals to wait for the copies end; 0 means busy wait,
+ * as does DMA_USLEEP_AUTO
+ * @return an @ref dma_err_status value saying whether the copies have ended successfully,
+ * or why they failed; DMA_TRANS_ERROR if the engine halted on an error, as for
+ * @ref wait_simple_copy
+ */
+enum dma_err_status wait_sg_copy(struct cdma_engine *engine, unsigned usleep_timeout);
+
+/**
+ * @brief wait_sg_copy_until waits like @ref wait_sg_copy, giving up at @p deadline_ns
+ *
+ * @param engine the CDMA engine pointer
+ * @param usleep_timeout sleeping intervals, as for @ref wait_sg_copy
+ * @param deadline_ns absolute deadline, as for @ref wait_simple_transfer_to_device_until
+ * @return as @ref wait_sg_copy, or DMA_TRANS_TIMEOUT if the deadline passed: the run
+ * is still going on, and can be waited for again or aborted via @ref reset_cdma_engine
+ */
+enum dma_err_status wait_sg_copy_until(struct cdma_engine *engine, unsigned usleep_timeout,
+    uint64_t deadline_ns);
+
+/**
+ * @brief reset_cdma_engine resets @p engine as @ref get_cdma_interfaces does, clearing errors
+ * and aborting the copies in flight; the descriptors set via @ref set_sg_descriptors are kept
+ *
+ * The reset is given a few milliseconds to complete.
+ *
+ * @param engine the CDMA engine pointer
+ * @return DMA_ENGINE_RESET if the engine is usable again, DMA_ENGINE_HUNG otherwise
+ */
+enum dma_err_status reset_cdma_engine(struct cdma_engine *engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_CDMA_H_ */
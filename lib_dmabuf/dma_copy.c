@@ -0,0 +1,407 @@
+
+/**
+ * @file dma_copy.c
+ * @author Alberto Scolari
+ * @brief Implementation of bulk copy and fill routines for uncached UDMA memory,
+ * with runtime selection of the widest vector unit available.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+
+#include "dma_copy.h"
+#include "copy_internals.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COPY_X86
+#include <immintrin.h>
+#elif defined(COPY_NEON) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+
+/* chunk of the cached bounce buffer for copies between uncached areas */
+#define BOUNCE_SIZE 4096U
+
+/**
+ * @brief The copy_impl struct describes an implementation of the bulk loops; the loops
+ * work on sizes multiple of COPY_BLOCK and require the uncached side to be COPY_BLOCK-aligned
+ */
+struct copy_impl {
+    const char *name;
+    int (*available)(void);
+    void (*to_uncached)(void *dst, const void *src, size_t length);
+    void (*from_uncached)(void *dst, const void *src, size_t length);
+    void (*fill)(void *dst, int value, size_t length);
+};
+
+static int always_available(void)
+{
+    return 1;
+}
+
+/*
+ * ------ scalar implementation: 64 bits accesses ------
+ * volatile accesses on the uncached side prevent the compiler from turning
+ * the loops back into memcpy()/memset() calls
+ */
+
+static void scalar_to_uncached(void *dst, const void *src, size_t length)
+{
+    volatile uint64_t *d = (volatile uint64_t *)dst;
+    const unsigned char *s = (const unsigned char *)src;
+    size_t i;
+    for (i = 0; i < length / sizeof(uint64_t); i++)
+    {
+        uint64_t w;
+        memcpy(&w, s + i * sizeof(uint64_t), sizeof(w));
+        d[i] = w;
+    }
+}
+
+static void scalar_from_uncached(void *dst, const void *src, size_t length)
+{
+    unsigned char *d = (unsigned char *)dst;
+    const volatile uint64_t *s = (const volatile uint64_t *)src;
+    size_t i;
+    for (i = 0; i < length / sizeof(uint64_t); i++)
+    {
+        uint64_t w = s[i];
+        memcpy(d + i * sizeof(uint64_t), &w, sizeof(w));
+    }
+}
+
+static void scalar_fill(void *dst, int value, size_t length)
+{
+    volatile uint64_t *d = (volatile uint64_t *)dst;
+    uint64_t w = 0x0101010101010101ULL * (unsigned char)value;
+    size_t i;
+    for (i = 0; i < length / sizeof(uint64_t); i++)
+    {
+        d[i] = w;
+    }
+}
+
+#ifdef COPY_X86
+
+/*
+ * ------ x86 implementations: 128/256 bits accesses, non-temporal stores ------
+ */
+
+static int sse2_available(void)
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+__attribute__((target("sse2")))
+static void sse2_to_uncached(void *dst, const void *src, size_t length)
+{
+    __m128i *d = (__m128i *)dst;
+    const __m128i *s = (const __m128i *)src;
+    size_t i;
+    for (i = 0; i < length / 16; i += 4)
+    {
+        __m128i a = _mm_loadu_si128(s + i), b = _mm_loadu_si128(s + i + 1);
+        __m128i c = _mm_loadu_si128(s + i + 2), e = _mm_loadu_si128(s + i + 3);
+        _mm_stream_si128(d + i, a);
+        _mm_stream_si128(d + i + 1, b);
+        _mm_stream_si128(d + i + 2, c);
+        _mm_stream_si128(d + i + 3, e);
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("sse2")))
+static void sse2_from_uncached(void *dst, const void *src, size_t length)
+{
+    __m128i *d = (__m128i *)dst;
+    const __m128i *s = (const __m128i *)src;
+    size_t i;
+    for (i = 0; i < length / 16; i += 4)
+    {
+        __m128i a = _mm_load_si128(s + i), b = _mm_load_si128(s + i + 1);
+        __m128i c = _mm_load_si128(s + i + 2), e = _mm_load_si128(s + i + 3);
+        _mm_storeu_si128(d + i, a);
+        _mm_storeu_si128(d + i + 1, b);
+        _mm_storeu_si128(d + i + 2, c);
+        _mm_storeu_si128(d + i + 3, e);
+    }
+}
+
+__attribute__((target("sse2")))
+static void sse2_fill(void *dst, int value, size_t length)
+{
+    __m128i *d = (__m128i *)dst;
+    __m128i v = _mm_set1_epi8((char)value);
+    size_t i;
+    for (i = 0; i < length / 16; i += 4)
+    {
+        _mm_stream_si128(d + i, v);
+        _mm_stream_si128(d + i + 1, v);
+        _mm_stream_si128(d + i + 2, v);
+        _mm_stream_si128(d + i + 3, v);
+    }
+    _mm_sfence();
+}
+
+static int avx_available(void)
+{
+    return __builtin_cpu_supports("avx");
+}
+
+__attribute__((target("avx")))
+static void avx_to_uncached(void *dst, const void *src, size_t length)
+{
+    __m256i *d = (__m256i *)dst;
+    const __m256i *s = (const __m256i *)src;
+    size_t i;
+    for (i = 0; i < length / 32; i += 2)
+    {
+        __m256i a = _mm256_loadu_si256(s + i), b = _mm256_loadu_si256(s + i + 1);
+        _mm256_stream_si256(d + i, a);
+        _mm256_stream_si256(d + i + 1, b);
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("avx")))
+static void avx_from_uncached(void *dst, const void *src, size_t length)
+{
+    __m256i *d = (__m256i *)dst;
+    const __m256i *s = (const __m256i *)src;
+    size_t i;
+    for (i = 0; i < length / 32; i += 2)
+    {
+        __m256i a = _mm256_load_si256(s + i), b = _mm256_load_si256(s + i + 1);
+        _mm256_storeu_si256(d + i, a);
+        _mm256_storeu_si256(d + i + 1, b);
+    }
+}
+
+__attribute__((target("avx")))
+static void avx_fill(void *dst, int value, size_t length)
+{
+    __m256i *d = (__m256i *)dst;
+    __m256i v = _mm256_set1_epi8((char)value);
+    size_t i;
+    for (i = 0; i < length / 32; i += 2)
+    {
+        _mm256_stream_si256(d + i, v);
+        _mm256_stream_si256(d + i + 1, v);
+    }
+    _mm_sfence();
+}
+
+#endif /* COPY_X86 */
+
+#ifdef COPY_NEON
+
+/*
+ * ------ ARM implementation: 128 bits NEON accesses, in dma_copy_neon.c ------
+ */
+
+static int neon_available(void)
+{
+#ifdef __aarch64__
+    return 1;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+
+#endif /* COPY_NEON */
+
+/* ordered from the least to the most preferred */
+static const struct copy_impl impls[] = {
+    { "scalar", always_available, scalar_to_uncached, scalar_from_uncached, scalar_fill },
+#ifdef COPY_NEON
+    { "neon", neon_available, dma_copy_neon_to_uncached, dma_copy_neon_from_uncached,
+        dma_copy_neon_fill },
+#endif
+#ifdef COPY_X86
+    { "sse2", sse2_available, sse2_to_uncached, sse2_from_uncached, sse2_fill },
+    { "avx", avx_available, avx_to_uncached, avx_from_uncached, avx_fill },
+#endif
+};
+
+#define NUM_IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+static const struct copy_impl *current_impl;
+
+static const struct copy_impl *get_impl(void)
+{
+    if (current_impl == NULL)
+    {
+        unsigned i;
+        const struct copy_impl *best = impls;
+#ifdef COPY_X86
+        __builtin_cpu_init();
+#endif
+        for (i = 1; i < NUM_IMPLS; i++)
+        {
+            if (impls[i].available())
+            {
+                best = impls + i;
+            }
+        }
+        current_impl = best;
+    }
+    return current_impl;
+}
+
+const char *udmabuf_copy_impl(void)
+{
+    return get_impl()->name;
+}
+
+int udmabuf_copy_select(const char *name)
+{
+    unsigned i;
+#ifdef COPY_X86
+    __builtin_cpu_init();
+#endif
+    for (i = 0; i < NUM_IMPLS; i++)
+    {
+        if (strcmp(impls[i].name, name) == 0 && impls[i].available())
+        {
+            current_impl = impls + i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * head and tail handling with the widest aligned scalar accesses on the uncached side
+ */
+
+static size_t head_length(const void *uncached, size_t length)
+{
+    size_t head = (COPY_BLOCK - ((uintptr_t)uncached % COPY_BLOCK)) % COPY_BLOCK;
+    return head < length ? head : length;
+}
+
+static void small_to_uncached(unsigned char *dst, const unsigned char *src, size_t length)
+{
+    while (length > 0 && ((uintptr_t)dst % sizeof(uint64_t)) != 0)
+    {
+        *(volatile unsigned char *)dst++ = *src++;
+        length--;
+    }
+    scalar_to_uncached(dst, src, length & ~(sizeof(uint64_t) - 1));
+    dst += length & ~(sizeof(uint64_t) - 1);
+    src += length & ~(sizeof(uint64_t) - 1);
+    length &= sizeof(uint64_t) - 1;
+    while (length-- > 0)
+    {
+        *(volatile unsigned char *)dst++ = *src++;
+    }
+}
+
+static void small_from_uncached(unsigned char *dst, const unsigned char *src, size_t length)
+{
+    while (length > 0 && ((uintptr_t)src % sizeof(uint64_t)) != 0)
+    {
+        *dst++ = *(const volatile unsigned char *)src++;
+        length--;
+    }
+    scalar_from_uncached(dst, src, length & ~(sizeof(uint64_t) - 1));
+    dst += length & ~(sizeof(uint64_t) - 1);
+    src += length & ~(sizeof(uint64_t) - 1);
+    length &= sizeof(uint64_t) - 1;
+    while (length-- > 0)
+    {
+        *dst++ = *(const volatile unsigned char *)src++;
+    }
+}
+
+static void small_fill(unsigned char *dst, int value, size_t length)
+{
+    while (length > 0 && ((uintptr_t)dst % sizeof(uint64_t)) != 0)
+    {
+        *(volatile unsigned char *)dst++ = (unsigned char)value;
+        length--;
+    }
+    scalar_fill(dst, value, length & ~(sizeof(uint64_t) - 1));
+    dst += length & ~(sizeof(uint64_t) - 1);
+    length &= sizeof(uint64_t) - 1;
+    while (length-- > 0)
+    {
+        *(volatile unsigned char *)dst++ = (unsigned char)value;
+    }
+}
+
+void copy_to_uncached(void *dst, const void *src, size_t length)
+{
+    const struct copy_impl *impl = get_impl();
+    unsigned char *d = (unsigned char *)dst;
+    const unsigned char *s = (const unsigned char *)src;
+    size_t head = head_length(d, length), body;
+
+    small_to_uncached(d, s, head);
+    body = (length - head) & ~(size_t)(COPY_BLOCK - 1);
+    impl->to_uncached(d + head, s + head, body);
+    small_to_uncached(d + head + body, s + head + body, length - head - body);
+}
+
+void copy_from_uncached(void *dst, const void *src, size_t length)
+{
+    const struct copy_impl *impl = get_impl();
+    unsigned char *d = (unsigned char *)dst;
+    const unsigned char *s = (const unsigned char *)src;
+    size_t head = head_length(s, length), body;
+
+    small_from_uncached(d, s, head);
+    body = (length - head) & ~(size_t)(COPY_BLOCK - 1);
+    impl->from_uncached(d + head, s + head, body);
+    small_from_uncached(d + head + body, s + head + body, length - head - body);
+}
+
+void fill_uncached(void *dst, int value, size_t length)
+{
+    const struct copy_impl *impl = get_impl();
+    unsigned char *d = (unsigned char *)dst;
+    size_t head = head_length(d, length), body;
+
+    small_fill(d, value, head);
+    body = (length - head) & ~(size_t)(COPY_BLOCK - 1);
+    impl->fill(d + head, value, body);
+    small_fill(d + head + body, value, length - head - body);
+}
+
+void udmabuf_copy_in(struct udmabuf *buf, unsigned offset, const void *src, size_t length)
+{
+    copy_to_uncached((char *)buf->vaddr + offset, src, length);
+}
+
+void udmabuf_copy_out(void *dst, struct udmabuf *buf, unsigned offset, size_t length)
+{
+    copy_from_uncached(dst, (const char *)buf->vaddr + offset, length);
+}
+
+void udmabuf_copy(struct udmabuf *dst_buf, unsigned dst_offset,
+    struct udmabuf *src_buf, unsigned src_offset, size_t length)
+{
+    /* both sides need aligned accesses: go through a cached bounce buffer */
+    unsigned char bounce[BOUNCE_SIZE] __attribute__((aligned(COPY_BLOCK)));
+    char *d = (char *)dst_buf->vaddr + dst_offset;
+    const char *s = (const char *)src_buf->vaddr + src_offset;
+
+    while (length > 0)
+    {
+        size_t chunk = length < BOUNCE_SIZE ? length : BOUNCE_SIZE;
+        copy_from_uncached(bounce, s, chunk);
+        copy_to_uncached(d, bounce, chunk);
+        d += chunk;
+        s += chunk;
+        length -= chunk;
+    }
+}
+
+void udmabuf_fill(struct udmabuf *buf, unsigned offset, int value, size_t length)
+{
+    fill_uncached((char *)buf->vaddr + offset, value, length);
+}
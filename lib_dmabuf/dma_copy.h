@@ -0,0 +1,85 @@
+
+#ifndef DMA_COPY_H_
+#define DMA_COPY_H_
+
+/**
+ * @file dma_copy.h
+ * @author Alberto Scolari
+ * @brief Header with bulk copy and fill routines for UDMA buffers.
+ *
+ * UDMA buffers are mapped uncached, so that each CPU access becomes a separate bus transaction:
+ * plain memcpy() and scalar loops are therefore very slow on them (and, on ARM, memcpy() may even
+ * perform unaligned accesses, which uncached memory does not allow).
+ * These routines access UDMA memory only with aligned accesses as wide as the CPU allows
+ * (NEON on ARM, SSE2/AVX on x86, 64 bits words otherwise), in blocks of 64 bytes to issue
+ * full bursts, with non-temporal hints for stores where available.
+ * The implementation is chosen at runtime according to the CPU capabilities.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "dma_engine_buf.h"
+
+/**
+ * @brief udmabuf_copy_in copies @p length bytes from @p src (cached memory) into @p buf
+ * at @p offset
+ */
+void udmabuf_copy_in(struct udmabuf *buf, unsigned offset, const void *src, size_t length);
+
+/**
+ * @brief udmabuf_copy_out copies @p length bytes from @p buf at @p offset into @p dst
+ * (cached memory)
+ */
+void udmabuf_copy_out(void *dst, struct udmabuf *buf, unsigned offset, size_t length);
+
+/**
+ * @brief udmabuf_copy copies @p length bytes from @p src_buf at @p src_offset into
+ * @p dst_buf at @p dst_offset; the two areas must not overlap
+ */
+void udmabuf_copy(struct udmabuf *dst_buf, unsigned dst_offset,
+    struct udmabuf *src_buf, unsigned src_offset, size_t length);
+
+/**
+ * @brief udmabuf_fill sets @p length bytes of @p buf from @p offset to @p value
+ */
+void udmabuf_fill(struct udmabuf *buf, unsigned offset, int value, size_t length);
+
+/**
+ * @brief copy_to_uncached copies @p length bytes from @p src (cached memory)
+ * to @p dst (uncached memory); it is the pointer-based version of @ref udmabuf_copy_in
+ */
+void copy_to_uncached(void *dst, const void *src, size_t length);
+
+/**
+ * @brief copy_from_uncached copies @p length bytes from @p src (uncached memory)
+ * to @p dst (cached memory); it is the pointer-based version of @ref udmabuf_copy_out
+ */
+void copy_from_uncached(void *dst, const void *src, size_t length);
+
+/**
+ * @brief fill_uncached sets @p length bytes of @p dst (uncached memory) to @p value;
+ * it is the pointer-based version of @ref udmabuf_fill
+ */
+void fill_uncached(void *dst, int value, size_t length);
+
+/**
+ * @brief udmabuf_copy_impl returns the name of the implementation in use
+ * ("scalar", "neon", "sse2" or "avx")
+ */
+const char *udmabuf_copy_impl(void);
+
+/**
+ * @brief udmabuf_copy_select forces the implementation named @p name, e.g. for benchmarking
+ * @return 0 for success, non-0 if the implementation is not available on this CPU
+ */
+int udmabuf_copy_select(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_COPY_H_ */
@@ -0,0 +1,69 @@
+/**
+ * @file dma_copy_neon.c
+ * @author Alberto Scolari
+ * @brief Implementation of the NEON loops of dma_copy.c: 128 bits accesses, with non-temporal
+ * pair stores on AArch64.
+ */
+
+#include <stdint.h>
+
+#include "copy_internals.h"
+
+#ifdef COPY_NEON
+#include <arm_neon.h>
+
+static inline void neon_store_block(uint8_t *d, uint8x16_t a, uint8x16_t b,
+    uint8x16_t c, uint8x16_t e)
+{
+#ifdef __aarch64__
+    asm volatile("stnp %q0, %q1, [%2]\n\t"
+                 "stnp %q3, %q4, [%2, #32]"
+                 :: "w"(a), "w"(b), "r"(d), "w"(c), "w"(e) : "memory");
+#else
+    vst1q_u8(d, a);
+    vst1q_u8(d + 16, b);
+    vst1q_u8(d + 32, c);
+    vst1q_u8(d + 48, e);
+#endif
+}
+
+void dma_copy_neon_to_uncached(void *dst, const void *src, size_t length)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    size_t i;
+    for (i = 0; i < length; i += COPY_BLOCK)
+    {
+        neon_store_block(d + i, vld1q_u8(s + i), vld1q_u8(s + i + 16),
+            vld1q_u8(s + i + 32), vld1q_u8(s + i + 48));
+    }
+}
+
+void dma_copy_neon_from_uncached(void *dst, const void *src, size_t length)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    size_t i;
+    for (i = 0; i < length; i += COPY_BLOCK)
+    {
+        uint8x16_t a = vld1q_u8(s + i), b = vld1q_u8(s + i + 16);
+        uint8x16_t c = vld1q_u8(s + i + 32), e = vld1q_u8(s + i + 48);
+        vst1q_u8(d + i, a);
+        vst1q_u8(d + i + 16, b);
+        vst1q_u8(d + i + 32, c);
+        vst1q_u8(d + i + 48, e);
+    }
+}
+
+void dma_copy_neon_fill(void *dst, int value, size_t length)
+{
+    uint8_t *d = (uint8_t *)dst;
+    uint8x16_t v = vdupq_n_u8((uint8_t)value);
+    size_t i;
+    for (i = 0; i < length; i += COPY_BLOCK)
+    {
+        neon_store_block(d + i, v, v, v, v);
+    }
+}
+
+#endif /* COPY_NEON */
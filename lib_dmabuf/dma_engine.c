@@ -16,48 +16,134 @@
 #include <stdlib.h>
 
 #include "dma_engine_buf.h"
+#include "dma_tune.h"
 #include "xhw_internals.h"
+#include "wait_internals.h"
+#include "map_internals.h"
+#include "trace_internals.h"
+#include "stats_internals.h"
 
-static const char sg_err_msg[] = "ERROR: DMA engine is set in Scatter/Gather mode; can handle only Direct Register Mode";
+static const char sg_err_msg[] = "DMA engine is in Scatter/Gather mode; simple transactions need Direct Register Mode";
 
-static void xdma_engine_init(struct dma_engine *engine)
+/*
+ * probe the address width of a channel via its high address register, which keeps only
+ * the bits the engine implements (none with 32 bits addresses); the channel must not be running
+ */
+static unsigned xdma_probe_addr_width(volatile uint32_t *high_reg)
+{
+    uint32_t bits;
+    unsigned width = 32;
+
+    *high_reg = 0xFFFFFFFFU;
+    __mmio_mb();
+    for (bits = *high_reg; bits != 0; bits >>= 1)
+    {
+        width += bits & 1U;
+    }
+    *high_reg = 0;
+    __mmio_wmb();
+    return width;
+}
+
+/* time given to halts, which take a few cycles of the engine clocks */
+#define HALT_TIMEOUT_NS 10000000ULL
+
+static int xdma_engine_init(struct dma_engine *engine)
 {
     volatile struct axi_direct_dma_regs *regs = (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
 
     /* reset everything, no interrupt mode */
     engine->to_dev.status = NOT_STARTED;
+    engine->from_dev.status = NOT_STARTED;
     regs->mm2s_control = 4;
-    while(regs->mm2s_control & 4);
-
-    if ( BIT(regs->mm2s_status, 3) )
+    if (dma_reset_done(&regs->mm2s_control) != 0)
     {
-        printf("%s\n", sg_err_msg);
-        exit(-1);
+        printf("%s: DMA engine does not complete its reset\n", __func__);
+        return -1;
     }
+
+    /* Scatter/Gather engines are usable only via the cyclic capture API */
+    engine->sg_mode = (int)BIT(regs->mm2s_status, 3);
     SET_BITFIELD(regs->mm2s_status, 12, 14, 0);
-#ifndef __64BITS__
-    regs->mm2s_source_addr_high = 0;
-#endif
+    engine->addr_width = xdma_probe_addr_width(engine->sg_mode ?
+        &regs->mm2s_cur_desc_high : &regs->mm2s_source_addr_high);
 
-    engine->from_dev.status = NOT_STARTED;
     regs->s2mm_control = 4;
-    while(regs->s2mm_control & 4);
-
-    if ( BIT(regs->s2mm_status, 3) )
+    if (dma_reset_done(&regs->s2mm_control) != 0)
     {
-        printf("%s\n", sg_err_msg);
-        exit(-1);
+        printf("%s: DMA engine does not complete its reset\n", __func__);
+        return -1;
     }
+
     SET_BITFIELD(regs->s2mm_status, 12, 14, 0);
-#ifndef __64BITS__
     regs->s2mm_dest_addr_high = 0;
-#endif
+    regs->s2mm_cur_desc_high = 0;
+    return 0;
 }
 
 #define LINUX_MEM_DEV "/dev/mem"
 
-int get_dma_interfaces(unsigned num_dma, phys_addr_t *offsets,
-    unsigned *lengths, struct dma_engine *engines)
+/*
+ * an error bit is set, or a reset is still in progress: the channel is not reusable as-is
+ */
+static int xdma_channel_needs_reset(volatile uint32_t *regs)
+{
+    uint32_t status = *(regs + 1);
+    return BIT(*regs, 2) || BITFIELD(status, 4, 6) != 0;
+}
+
+/*
+ * rebuild the transaction state of a channel from its registers
+ */
+static void xdma_channel_attach(volatile uint32_t *regs, struct dma_transaction *trans)
+{
+    uint32_t status = *(regs + 1);
+
+    trans->addr_low = *(regs + 6);
+    trans->addr_high = *(regs + 7);
+    trans->length = BITFIELD(*(regs + 10), 0, 25);
+    if ( BIT(*regs, 0) && !BIT(status, 0) && !BIT(status, 1) )
+    {
+        /* running and neither halted nor idle: someone else's transaction is in flight */
+        trans->status = STARTED;
+    } else if (trans->addr_low != 0 && trans->length != 0)
+    {
+        trans->status = PROGRAMMED;
+    } else
+    {
+        trans->status = NOT_STARTED;
+    }
+}
+
+static int xdma_engine_attach(struct dma_engine *engine)
+{
+    volatile struct axi_direct_dma_regs *regs = (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
+
+    if ( BIT(regs->mm2s_status, 3) || BIT(regs->s2mm_status, 3)
+        || xdma_channel_needs_reset(&regs->mm2s_control)
+        || xdma_channel_needs_reset(&regs->s2mm_control) )
+    {
+        return xdma_engine_init(engine);
+    }
+    engine->sg_mode = 0;
+    xdma_channel_attach(&regs->mm2s_control, &engine->to_dev);
+    xdma_channel_attach(&regs->s2mm_control, &engine->from_dev);
+    /* probing overwrites the high address: restore it for the transaction to resume */
+    engine->addr_width = 32;
+    if (engine->to_dev.status != STARTED)
+    {
+        engine->addr_width = xdma_probe_addr_width(&regs->mm2s_source_addr_high);
+        regs->mm2s_source_addr_high = engine->to_dev.addr_high;
+    } else if (engine->from_dev.status != STARTED)
+    {
+        engine->addr_width = xdma_probe_addr_width(&regs->s2mm_dest_addr_high);
+        regs->s2mm_dest_addr_high = engine->from_dev.addr_high;
+    }
+    return 0;
+}
+
+static int map_dma_interfaces(unsigned num_dma, phys_addr_t *offsets,
+    unsigned *lengths, struct dma_engine *engines, int (*engine_setup)(struct dma_engine *))
 {
     char *result;
     int fd;
@@ -79,7 +165,8 @@ int get_dma_interfaces(unsigned num_dma, phys_addr_t *offsets,
     }
 
     for(i = 0; i < num_dma; i++) {
-        unsigned __offset, __length;
+        phys_addr_t __offset;
+        unsigned __length;
         if (offsets == NULL)
         {
             __offset = AXI_DMA_REGISTER_LOCATION ;
@@ -95,27 +182,68 @@ int get_dma_interfaces(unsigned num_dma, phys_addr_t *offsets,
             __length = lengths[i];
         }
         engines[i].fd = fd;
-        engines[i].regs_vaddr = result = mmap(NULL, __length,
-            PROT_READ | PROT_WRITE, MAP_SHARED, fd, __offset);
+        engines[i].length_width = DMA_DEF_LENGTH_WIDTH;
+        engines[i].regs_vaddr = result = map_device_memory(fd, __length, __offset, 0);
         engines[i].length = __length;
-        if ( result == NULL )
+        if ( result == MAP_FAILED )
         {
-            unsigned j;
             printf("%s: impossible to mmap %s\n", __func__, LINUX_MEM_DEV);
+        } else if (engine_setup(engines + i) != 0)
+        {
+            printf("%s: DMA engine at 0x%llx is not usable\n", __func__,
+                (unsigned long long)__offset);
+            unmap_device_memory(result, __length);
+            result = MAP_FAILED;
+        }
+        if ( result == MAP_FAILED )
+        {
+            unsigned j;
             for( j = 0; j < i; j++) {
-                munmap((void*)engines[j].regs_vaddr, DESCRIPTOR_REGISTERS_SIZE);
+                unmap_device_memory((void*)engines[j].regs_vaddr, engines[j].length);
+                dma_stats_release(engines[j].stats != NULL ? &engines[j].stats->in_use : NULL);
             }
             close(fd);
             return -1;
         }
-        xdma_engine_init(engines + i);
+        engines[i].stats = dma_stats_engine_slot(__offset);
+        engines[i].phys_addr = __offset;
+        dma_tune_apply(engines + i);
     }
     return 0;
 }
 
+int get_dma_interfaces(unsigned num_dma, phys_addr_t *offsets,
+    unsigned *lengths, struct dma_engine *engines)
+{
+    return map_dma_interfaces(num_dma, offsets, lengths, engines, xdma_engine_init);
+}
+
+int attach_dma_interfaces(unsigned num_dma, phys_addr_t *offsets,
+    unsigned *lengths, struct dma_engine *engines)
+{
+    return map_dma_interfaces(num_dma, offsets, lengths, engines, xdma_engine_attach);
+}
+
+void set_dma_address_width(struct dma_engine *engine, unsigned bits)
+{
+    engine->addr_width = bits < 32 ? 32 : (bits > 64 ? 64 : bits);
+}
+
+void set_dma_length_width(struct dma_engine *engine, unsigned bits)
+{
+    engine->length_width = bits < 8 ? 8 : (bits > 26 ? 26 : bits);
+}
+
+unsigned dma_max_length(const struct dma_engine *engine)
+{
+    return (1U << engine->length_width) - 1U;
+}
+
 static void destroy_dma_interface(struct dma_engine *engine)
 {
-    munmap((void*)engine->regs_vaddr, engine->length);
+    unmap_device_memory((void*)engine->regs_vaddr, engine->length);
+    dma_stats_release(engine->stats != NULL ? &engine->stats->in_use : NULL);
+    engine->stats = NULL;
     close(engine->fd);
 }
 
@@ -144,25 +272,37 @@ static void check_transfer_alignment( __unused__ phys_addr_t addr)
 #endif
 }
 
-static enum dma_err_status set_simple_transfer_common(volatile uint32_t *reg_addr,
-    struct dma_transaction *trans, struct udmabuf *buf, 
-    unsigned offset, unsigned length)
+/*
+ * check that the engine can reach @p length bytes from @p addr
+ */
+static int check_transfer_range(struct dma_engine *engine, phys_addr_t addr, unsigned length)
 {
-    uint32_t low;
-#ifdef __64BIT__
-    uint32_t high = (uint32_t)( (buf->paddr + offset) >> 32 );
-#endif
+    if (engine->addr_width < 64 && ((addr + length - 1) >> engine->addr_width) != 0)
+    {
+        printf("%s: address 0x%llx is beyond the %u bits of the DMA engine\n", __func__,
+            (unsigned long long)addr, engine->addr_width);
+        return -1;
+    }
+    return 0;
+}
 
+static enum dma_err_status set_simple_transfer_common(struct dma_engine *engine,
+    volatile uint32_t *reg_addr, struct dma_transaction *trans, phys_addr_t addr, unsigned length)
+{
     if ( trans->status == STARTED )
     {
         return DMA_TRANS_RUNNING;
     }
-    low = (uint32_t)(buf->paddr + offset);
-    *(reg_addr + 6) = trans->addr_low = low;
-#ifdef __64BIT__
-    *(reg_addr + 7) = trans->addr_high = high;
-#endif
-    __mem_full_barrier();
+    if (length > dma_max_length(engine))
+    {
+        printf("%s: %u bytes exceed the %u bits length register\n", __func__, length,
+            engine->length_width);
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    *(reg_addr + 6) = trans->addr_low = (uint32_t)addr;
+    /* always written, as a previous transaction may have left it set */
+    *(reg_addr + 7) = trans->addr_high = (uint32_t)(addr >> 32);
+    /* no barrier: the doorbell barrier in the start call orders these writes */
 
     trans->length = length;
     trans->status = PROGRAMMED;
@@ -175,8 +315,24 @@ enum dma_err_status set_simple_transfer_to_device(struct dma_engine *engine, str
     
     volatile struct axi_direct_dma_regs *regs =
         (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
+    enum dma_err_status err;
+
+    if (engine->sg_mode)
+    {
+        printf("%s: %s\n", __func__, sg_err_msg);
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
     check_transfer_alignment(buf->paddr + offset);
-    return set_simple_transfer_common(&regs->mm2s_control, &engine->to_dev, buf, offset, length);
+    if (check_transfer_range(engine, buf->paddr + offset, length) != 0)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    err = set_simple_transfer_common(engine, &regs->mm2s_control, &engine->to_dev, buf->paddr + offset, length);
+    if (err == NO_ERROR)
+    {
+        DMA_TRACE(engine, DMA_TRACE_TO_DEV, DMA_TRACE_SET, length);
+    }
+    return err;
 }
 
 enum dma_err_status set_simple_transfer_from_device(struct dma_engine *engine, struct udmabuf *buf, 
@@ -185,11 +341,38 @@ enum dma_err_status set_simple_transfer_from_device(struct dma_engine *engine, s
     
     volatile struct axi_direct_dma_regs *regs =
         (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
+    enum dma_err_status err;
+
+    if (engine->sg_mode)
+    {
+        printf("%s: %s\n", __func__, sg_err_msg);
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
     check_transfer_alignment(buf->paddr + offset);
-    return set_simple_transfer_common(&regs->s2mm_control, &engine->from_dev, buf, offset, length);
+    if (check_transfer_range(engine, buf->paddr + offset, length) != 0)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    err = set_simple_transfer_common(engine, &regs->s2mm_control, &engine->from_dev, buf->paddr + offset, length);
+    if (err == NO_ERROR)
+    {
+        DMA_TRACE(engine, DMA_TRACE_FROM_DEV, DMA_TRACE_SET, length);
+    }
+    return err;
+}
+
+static struct dma_stats_channel *to_dev_stats(struct dma_engine *engine)
+{
+    return engine->stats != NULL ? &engine->stats->to_dev : NULL;
+}
+
+static struct dma_stats_channel *from_dev_stats(struct dma_engine *engine)
+{
+    return engine->stats != NULL ? &engine->stats->from_dev : NULL;
 }
 
-static enum dma_err_status start_simple_transfer_common(volatile uint32_t *regs, struct dma_transaction *trans)
+static enum dma_err_status start_simple_transfer_common(volatile uint32_t *regs, struct dma_transaction *trans,
+    struct dma_stats_channel *stats)
 {
     if (trans->status == NOT_STARTED)
     {
@@ -200,24 +383,40 @@ static enum dma_err_status start_simple_transfer_common(volatile uint32_t *regs,
         return DMA_TRANS_RUNNING;
     }
     SET_BIT(*regs, 0);
-    __mem_full_barrier();
 
+    if (stats != NULL)
+    {
+        stats->started_ns = dma_stats_time();
+    }
+    /* writing the length starts the engine: addresses, run bit and buffer data must precede it */
+    __doorbell_barrier();
     SET_BITFIELD(*(regs + 10), 0, 25, (uint32_t)trans->length);
-    __mem_full_barrier();
     trans->status = STARTED;
     return NO_ERROR;
 }
 
 enum dma_err_status start_simple_transfer_to_device(struct dma_engine *engine)
 {
-    return start_simple_transfer_common((volatile uint32_t *)engine->regs_vaddr, &engine->to_dev);
+    enum dma_err_status err = start_simple_transfer_common((volatile uint32_t *)engine->regs_vaddr,
+        &engine->to_dev, to_dev_stats(engine));
+    if (err == NO_ERROR)
+    {
+        DMA_TRACE(engine, DMA_TRACE_TO_DEV, DMA_TRACE_START, engine->to_dev.length);
+    }
+    return err;
 }
 
 enum dma_err_status start_simple_transfer_from_device(struct dma_engine *engine)
 {
     volatile struct axi_direct_dma_regs *regs =
         (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
-    return start_simple_transfer_common(&regs->s2mm_control, &engine->from_dev);
+    enum dma_err_status err = start_simple_transfer_common(&regs->s2mm_control, &engine->from_dev,
+        from_dev_stats(engine));
+    if (err == NO_ERROR)
+    {
+        DMA_TRACE(engine, DMA_TRACE_FROM_DEV, DMA_TRACE_START, engine->from_dev.length);
+    }
+    return err;
 }
 
 static inline int engine_is_idle(volatile uint32_t *regs)
@@ -230,43 +429,260 @@ static inline int engine_is_halted(volatile uint32_t *regs)
     return BIT(*(regs + 1), 0) == 1;
 }
 
-static void usleep_nano(unsigned utime)
+/*
+ * a channel stops either idle, at the end of its transaction, or halted, on an error
+ * (DMAIntErr, DMASlvErr, DMADecErr) that leaves it not idle
+ */
+static inline int channel_stopped(uint32_t status)
+{
+    return BIT(status, 1) || BIT(status, 0) || BITFIELD(status, 4, 6) != 0;
+}
+
+/*
+ * poll the status of a channel until it stops or @p deadline_ns passes, counting the reads
+ * into @p spins; the last status read is stored into @p status
+ */
+static enum dma_err_status wait_channel_stop(volatile uint32_t *regs, unsigned usleep_timeout,
+    uint64_t deadline_ns, uint32_t *status, uint64_t *spins)
 {
-	struct timespec __time;
-	__time.tv_sec = utime % 1000000;
-	__time.tv_nsec = utime * 1000;
-	nanosleep(&__time, NULL);
+    /* the status read for idleness also provides the error bits */
+    while ( !channel_stopped(*status = *(regs + 1)) ) {
+        if (deadline_ns != DMA_NO_DEADLINE && dma_stats_now() >= deadline_ns) {
+            return DMA_TRANS_TIMEOUT;
+        }
+        (*spins)++;
+        if (usleep_timeout != 0) {
+            usleep_nano(usleep_timeout);
+        }
+    }
+    if ( !BIT(*status, 1) || BITFIELD(*status, 4, 6) != 0 )
+    {
+        return DMA_TRANS_ERROR;
+    }
+    /* the data the engine wrote can be read only after it is seen idle */
+    __mmio_rmb();
+    return NO_ERROR;
 }
 
 static enum dma_err_status wait_simple_transfer_common(volatile uint32_t *regs,
-    struct dma_transaction *trans, unsigned usleep_timeout)
+    struct dma_transaction *trans, unsigned usleep_timeout, uint64_t deadline_ns,
+    struct dma_stats_channel *stats)
 {
+    uint64_t begin = 0, spins = 1;
+    uint32_t status;
+    enum dma_err_status err;
+
     if (trans->status != STARTED)
     {
         return DMA_TRANS_NOT_STARTED;
     }
-    while( !engine_is_idle(regs)
-        /* || !engine_is_halted(regs) */ ) {
-        if (usleep_timeout != 0) {
-            usleep_nano(usleep_timeout);
+    if (stats != NULL)
+    {
+        begin = dma_stats_time();
+    }
+    err = wait_channel_stop(regs, usleep_timeout, deadline_ns, &status, &spins);
+    /* a channel halted on an error is over as well, until reset */
+    if (err != DMA_TRANS_TIMEOUT)
+    {
+        trans->status = PROGRAMMED;
+    }
+    if (stats != NULL)
+    {
+        uint64_t end = dma_stats_time();
+        stats->wait_ns += end - begin;
+        stats->spins += spins;
+        if (err != DMA_TRANS_TIMEOUT)
+        {
+            dma_stats_complete(stats, err == NO_ERROR ? trans->length : 0, status, end);
         }
     }
-    trans->status = PROGRAMMED;
-    return NO_ERROR;
+    return err;
+}
+
+/* records the wait and the completion it observes around a wait call */
+static enum dma_err_status traced_wait(struct dma_engine *engine, enum dma_trace_track track,
+    volatile uint32_t *regs, struct dma_transaction *trans, unsigned usleep_timeout,
+    uint64_t deadline_ns)
+{
+    struct dma_stats_channel *stats = track == DMA_TRACE_TO_DEV ?
+        to_dev_stats(engine) : from_dev_stats(engine);
+    enum dma_err_status err;
+
+    usleep_timeout = dma_tune_usleep(engine, trans->length, usleep_timeout);
+    if ( !dma_trace_active || trans->status != STARTED )
+    {
+        return wait_simple_transfer_common(regs, trans, usleep_timeout, deadline_ns, stats);
+    }
+    dma_trace_record(engine, track, DMA_TRACE_WAIT_BEGIN, 0);
+    err = wait_simple_transfer_common(regs, trans, usleep_timeout, deadline_ns, stats);
+    if (err == NO_ERROR)
+    {
+        dma_trace_record(engine, track, DMA_TRACE_COMPLETE, 0);
+    }
+    dma_trace_record(engine, track, DMA_TRACE_WAIT_END, 0);
+    return err;
 }
 
 enum dma_err_status wait_simple_transfer_to_device(struct dma_engine *engine, unsigned usleep_timeout)
 {
-    return wait_simple_transfer_common((volatile uint32_t *)engine->regs_vaddr,
-        &engine->to_dev, usleep_timeout);
+    return wait_simple_transfer_to_device_until(engine, usleep_timeout, DMA_NO_DEADLINE);
 }
 
 enum dma_err_status wait_simple_transfer_from_device(struct dma_engine *engine, unsigned usleep_timeout)
+{
+    return wait_simple_transfer_from_device_until(engine, usleep_timeout, DMA_NO_DEADLINE);
+}
+
+enum dma_err_status wait_simple_transfer_to_device_until(struct dma_engine *engine,
+    unsigned usleep_timeout, uint64_t deadline_ns)
+{
+    return traced_wait(engine, DMA_TRACE_TO_DEV, (volatile uint32_t *)engine->regs_vaddr,
+        &engine->to_dev, usleep_timeout, deadline_ns);
+}
+
+enum dma_err_status wait_simple_transfer_from_device_until(struct dma_engine *engine,
+    unsigned usleep_timeout, uint64_t deadline_ns)
+{
+    volatile struct axi_direct_dma_regs *regs =
+        (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
+    return traced_wait(engine, DMA_TRACE_FROM_DEV, &regs->s2mm_control,
+        &engine->from_dev, usleep_timeout, deadline_ns);
+}
+
+enum dma_err_status reset_dma_engine(struct dma_engine *engine)
+{
+    /* keep a width set via set_dma_address_width */
+    unsigned addr_width = engine->addr_width;
+
+    if (xdma_engine_init(engine) != 0)
+    {
+        return DMA_ENGINE_HUNG;
+    }
+    engine->addr_width = addr_width;
+    return DMA_ENGINE_RESET;
+}
+
+/*
+ * halt a channel by clearing its run bit; the AXI DMA resets both channels together,
+ * so the reset is the last resort
+ */
+static enum dma_err_status cancel_simple_transfer_common(struct dma_engine *engine,
+    volatile uint32_t *regs, struct dma_transaction *trans)
+{
+    uint64_t deadline;
+
+    if (trans->status != STARTED)
+    {
+        /* a transaction a wait returned DMA_TRANS_ERROR for left the channel halted */
+        if (xdma_channel_needs_reset(regs))
+        {
+            return reset_dma_engine(engine);
+        }
+        return DMA_TRANS_NOT_STARTED;
+    }
+    UNSET_BIT(*regs, 0);
+    __mmio_wmb();
+    deadline = dma_stats_now() + HALT_TIMEOUT_NS;
+    while ( !engine_is_halted(regs) )
+    {
+        if (dma_stats_now() >= deadline)
+        {
+            printf("%s: DMA channel does not halt, resetting the engine\n", __func__);
+            return reset_dma_engine(engine);
+        }
+    }
+    if (BITFIELD(*(regs + 1), 4, 6) != 0)
+    {
+        return reset_dma_engine(engine);
+    }
+    trans->status = PROGRAMMED;
+    return NO_ERROR;
+}
+
+enum dma_err_status cancel_simple_transfer_to_device(struct dma_engine *engine)
+{
+    enum dma_err_status err = cancel_simple_transfer_common(engine,
+        (volatile uint32_t *)engine->regs_vaddr, &engine->to_dev);
+    if (err != DMA_TRANS_NOT_STARTED)
+    {
+        DMA_TRACE(engine, DMA_TRACE_TO_DEV, DMA_TRACE_COMPLETE, 0);
+    }
+    return err;
+}
+
+enum dma_err_status cancel_simple_transfer_from_device(struct dma_engine *engine)
+{
+    volatile struct axi_direct_dma_regs *regs =
+        (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
+    enum dma_err_status err = cancel_simple_transfer_common(engine, &regs->s2mm_control,
+        &engine->from_dev);
+    if (err != DMA_TRANS_NOT_STARTED)
+    {
+        DMA_TRACE(engine, DMA_TRACE_FROM_DEV, DMA_TRACE_COMPLETE, 0);
+    }
+    return err;
+}
+
+static enum dma_err_status poll_simple_transfer_common(volatile uint32_t *regs,
+    struct dma_transaction *trans, struct dma_stats_channel *stats)
+{
+    uint32_t status;
+
+    if (trans->status != STARTED)
+    {
+        return DMA_TRANS_NOT_STARTED;
+    }
+    status = *(regs + 1);
+    if ( !channel_stopped(status) )
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    trans->status = PROGRAMMED;
+    if ( !BIT(status, 1) || BITFIELD(status, 4, 6) != 0 )
+    {
+        if (stats != NULL)
+        {
+            dma_stats_complete(stats, 0, status, dma_stats_time());
+        }
+        return DMA_TRANS_ERROR;
+    }
+    __mmio_rmb();
+    if (stats != NULL)
+    {
+        dma_stats_complete(stats, trans->length, status, dma_stats_time());
+    }
+    return NO_ERROR;
+}
+
+enum dma_err_status poll_simple_transfer_to_device(struct dma_engine *engine)
+{
+    enum dma_err_status err = poll_simple_transfer_common((volatile uint32_t *)engine->regs_vaddr,
+        &engine->to_dev, to_dev_stats(engine));
+    if (err == NO_ERROR)
+    {
+        DMA_TRACE(engine, DMA_TRACE_TO_DEV, DMA_TRACE_COMPLETE, 0);
+    }
+    return err;
+}
+
+enum dma_err_status poll_simple_transfer_from_device(struct dma_engine *engine)
+{
+    volatile struct axi_direct_dma_regs *regs =
+        (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
+    enum dma_err_status err = poll_simple_transfer_common(&regs->s2mm_control, &engine->from_dev,
+        from_dev_stats(engine));
+    if (err == NO_ERROR)
+    {
+        DMA_TRACE(engine, DMA_TRACE_FROM_DEV, DMA_TRACE_COMPLETE, 0);
+    }
+    return err;
+}
+
+unsigned transferred_length_from_device(struct dma_engine *engine)
 {
     volatile struct axi_direct_dma_regs *regs =
         (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
-    return wait_simple_transfer_common(&regs->s2mm_control,
-        &engine->from_dev, usleep_timeout);
+    return BITFIELD(regs->s2mm_length, 0, 25);
 }
 
 static unsigned err_status_common(volatile uint32_t *regs)
@@ -294,6 +710,157 @@ unsigned err_status_from_device(struct dma_engine *engine)
     return err_status_common(&regs->s2mm_status);
 }
 
+/*
+ * @p max_length is the largest length a single transaction can move, kept aligned to DEF_ALIGN;
+ * the deadline applies to the whole transfer
+ */
+static enum dma_err_status transfer_2d_common(volatile uint32_t *regs,
+    struct dma_transaction *trans, unsigned max_length, struct udmabuf *buf, unsigned offset,
+    unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout,
+    uint64_t deadline_ns, struct dma_stats_channel *stats)
+{
+    unsigned rows_per_run = 1, row = 0;
+    uint64_t spins = 0;
+    uint32_t status = 0;
+    phys_addr_t addr;
+    enum dma_err_status err = NO_ERROR;
+
+    if (trans->status == STARTED)
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    if (rows == 0 || row_bytes == 0)
+    {
+        return NO_ERROR;
+    }
+    if (row_bytes > max_length || (rows > 1 && stride < row_bytes)
+        || offset + (unsigned long)(rows - 1) * stride + row_bytes > buf->size)
+    {
+        printf("%s: invalid 2D area\n", __func__);
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    /* rows adjacent in memory are moved by a single transaction */
+    if (stride == row_bytes)
+    {
+        rows_per_run = max_length / row_bytes;
+    }
+
+    if (stats != NULL)
+    {
+        stats->started_ns = dma_stats_time();
+    }
+    SET_BIT(*regs, 0);
+    while (row < rows)
+    {
+        unsigned run = rows - row < rows_per_run ? rows - row : rows_per_run;
+
+        addr = buf->paddr + offset + (unsigned long)row * stride;
+        check_transfer_alignment(addr);
+        *(regs + 6) = trans->addr_low = (uint32_t)addr;
+        *(regs + 7) = trans->addr_high = (uint32_t)(addr >> 32);
+        trans->length = run * row_bytes;
+        __doorbell_barrier();
+        SET_BITFIELD(*(regs + 10), 0, 25, (uint32_t)trans->length);
+        trans->status = STARTED;
+
+        /* status reads, the last one seeing the engine stopped */
+        spins++;
+        err = wait_channel_stop(regs, usleep_timeout, deadline_ns, &status, &spins);
+        if (err == DMA_TRANS_TIMEOUT)
+        {
+            /* the row in flight is left to a wait or a cancellation */
+            break;
+        }
+        trans->status = PROGRAMMED;
+        if (err != NO_ERROR)
+        {
+            break;
+        }
+        row += run;
+    }
+    /* the whole 2D transfer accounts as one, the calling thread waiting for all of it */
+    if (stats != NULL)
+    {
+        uint64_t end = dma_stats_time();
+        stats->wait_ns += end - stats->started_ns;
+        stats->spins += spins;
+        dma_stats_complete(stats, row * row_bytes, status, end);
+    }
+    return err;
+}
+
+/* a 2D transfer is busy and keeps the calling thread waiting from its start to its end */
+static enum dma_err_status traced_transfer_2d(struct dma_engine *engine, enum dma_trace_track track,
+    volatile uint32_t *regs, struct dma_transaction *trans, struct udmabuf *buf, unsigned offset,
+    unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout,
+    uint64_t deadline_ns)
+{
+    struct dma_stats_channel *stats = track == DMA_TRACE_TO_DEV ?
+        to_dev_stats(engine) : from_dev_stats(engine);
+    unsigned max_length = dma_max_length(engine) & ~(DEF_ALIGN - 1U);
+    enum dma_err_status err;
+
+    if (engine->sg_mode)
+    {
+        printf("%s: %s\n", __func__, sg_err_msg);
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    /* rows may be anywhere in the buffer: the whole of it must be reachable */
+    if (check_transfer_range(engine, buf->paddr, 1) != 0
+        || check_transfer_range(engine, buf->paddr + buf->size - 1, 1) != 0)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    usleep_timeout = dma_tune_usleep(engine, row_bytes, usleep_timeout);
+    if ( !dma_trace_active || trans->status == STARTED )
+    {
+        return transfer_2d_common(regs, trans, max_length, buf, offset, row_bytes, rows, stride,
+            usleep_timeout, deadline_ns, stats);
+    }
+    dma_trace_record(engine, track, DMA_TRACE_START, row_bytes * rows);
+    dma_trace_record(engine, track, DMA_TRACE_WAIT_BEGIN, 0);
+    err = transfer_2d_common(regs, trans, max_length, buf, offset, row_bytes, rows, stride,
+        usleep_timeout, deadline_ns, stats);
+    if (err != DMA_TRANS_TIMEOUT)
+    {
+        dma_trace_record(engine, track, DMA_TRACE_COMPLETE, 0);
+    }
+    dma_trace_record(engine, track, DMA_TRACE_WAIT_END, 0);
+    return err;
+}
+
+enum dma_err_status transfer_2d_to_device(struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout)
+{
+    return transfer_2d_to_device_until(engine, buf, offset, row_bytes, rows, stride,
+        usleep_timeout, DMA_NO_DEADLINE);
+}
+
+enum dma_err_status transfer_2d_from_device(struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout)
+{
+    return transfer_2d_from_device_until(engine, buf, offset, row_bytes, rows, stride,
+        usleep_timeout, DMA_NO_DEADLINE);
+}
+
+enum dma_err_status transfer_2d_to_device_until(struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout,
+    uint64_t deadline_ns)
+{
+    return traced_transfer_2d(engine, DMA_TRACE_TO_DEV, (volatile uint32_t *)engine->regs_vaddr,
+        &engine->to_dev, buf, offset, row_bytes, rows, stride, usleep_timeout, deadline_ns);
+}
+
+enum dma_err_status transfer_2d_from_device_until(struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout,
+    uint64_t deadline_ns)
+{
+    volatile struct axi_direct_dma_regs *regs =
+        (volatile struct axi_direct_dma_regs *)engine->regs_vaddr;
+    return traced_transfer_2d(engine, DMA_TRACE_FROM_DEV, &regs->s2mm_control,
+        &engine->from_dev, buf, offset, row_bytes, rows, stride, usleep_timeout, deadline_ns);
+}
+
 static inline int kernel_is_idle(volatile struct axi_control_base_regs *regs)
 {
     return BIT(regs->control, 2) == 1;
@@ -337,8 +904,24 @@ static int axi_control_init(struct control_interface *intf)
     return 0;
 }
 
-int get_control_interface(phys_addr_t phys_addr, unsigned length,
-    struct control_interface *ctrl_intf)
+/*
+ * interrupts are enabled or pending: the interface needs the full initialization;
+ * a running kernel is left untouched
+ */
+static int axi_control_attach(struct control_interface *intf)
+{
+    volatile struct axi_control_base_regs *regs = 
+        ( volatile struct axi_control_base_regs *)intf->control_regs_vaddr;
+    if ( BIT(regs->global_int, 0) || BITFIELD(regs->ip_int, 0, 1) != 0
+        || BITFIELD(regs->ip_int_status, 0, 1) != 0 )
+    {
+        return axi_control_init(intf);
+    }
+    return 0;
+}
+
+static int map_control_interface(phys_addr_t phys_addr, unsigned length,
+    struct control_interface *ctrl_intf, int (*intf_setup)(struct control_interface *))
 {
     int fd;
     phys_addr_t __phys_addr = phys_addr;
@@ -362,9 +945,8 @@ int get_control_interface(phys_addr_t phys_addr, unsigned length,
         __length = AXI_CONTROL_REGS_LEN_DEF;
     }
     
-    result = mmap(NULL, __length,
-    	PROT_READ | PROT_WRITE, MAP_SHARED, fd, __phys_addr);
-    if ( result == NULL )
+    result = map_device_memory(fd, __length, __phys_addr, 0);
+    if ( result == MAP_FAILED )
     {
         printf("%s: impossible to mmap %s\n", __func__, LINUX_MEM_DEV);
         close(fd);
@@ -373,34 +955,96 @@ int get_control_interface(phys_addr_t phys_addr, unsigned length,
     ctrl_intf->length = __length;
     ctrl_intf->control_regs_vaddr = result;
     ctrl_intf->user_args = (volatile char *)( result + AXI_CONTROL_USER_DATA_OFFS);
-    return axi_control_init(ctrl_intf);
+    ctrl_intf->stats = dma_stats_kernel_slot(__phys_addr);
+    return intf_setup(ctrl_intf);
+}
+
+int get_control_interface(phys_addr_t phys_addr, unsigned length,
+    struct control_interface *ctrl_intf)
+{
+    return map_control_interface(phys_addr, length, ctrl_intf, axi_control_init);
+}
+
+int attach_control_interface(phys_addr_t phys_addr, unsigned length,
+    struct control_interface *ctrl_intf)
+{
+    return map_control_interface(phys_addr, length, ctrl_intf, axi_control_attach);
 }
 
 void destroy_control_interface(struct control_interface *ctrl_intf)
 {
-    munmap((void*)ctrl_intf->control_regs_vaddr, ctrl_intf->length);
+    unmap_device_memory((void*)ctrl_intf->control_regs_vaddr, ctrl_intf->length);
     close(ctrl_intf->fd);
+    dma_stats_release(ctrl_intf->stats != NULL ? &ctrl_intf->stats->in_use : NULL);
+    ctrl_intf->stats = NULL;
 }
 
 void start_kernel(struct control_interface *ctrl_intf)
 {
     volatile struct axi_control_base_regs *regs = 
         ( volatile struct axi_control_base_regs *)ctrl_intf->control_regs_vaddr;
-    __mem_full_barrier();
+    if (ctrl_intf->stats != NULL)
+    {
+        ctrl_intf->stats->invocations++;
+        ctrl_intf->stats->started_ns = dma_stats_time();
+    }
+    /* arguments and input data must be visible before ap_start */
+    __doorbell_barrier();
     SET_BIT(regs->control, 0);
-    __mem_full_barrier();
+    DMA_TRACE(ctrl_intf, DMA_TRACE_KERNEL, DMA_TRACE_START, 0);
 }
 
 void wait_kernel(struct control_interface *ctrl_intf, unsigned usleep_timeout)
+{
+    wait_kernel_until(ctrl_intf, usleep_timeout, DMA_NO_DEADLINE);
+}
+
+enum dma_err_status wait_kernel_until(struct control_interface *ctrl_intf, unsigned usleep_timeout,
+    uint64_t deadline_ns)
 {
     volatile struct axi_control_base_regs *regs = 
         ( volatile struct axi_control_base_regs *)ctrl_intf->control_regs_vaddr;
-    while( !kernel_is_ready(regs) )
+    struct dma_stats_kernel *stats = ctrl_intf->stats;
+    uint64_t begin = 0, spins = 1;
+    int ended;
+
+    if (stats != NULL)
+    {
+        begin = dma_stats_time();
+    }
+    DMA_TRACE(ctrl_intf, DMA_TRACE_KERNEL, DMA_TRACE_WAIT_BEGIN, 0);
+    while( !(ended = kernel_is_ready(regs)) )
     {
+        if (deadline_ns != DMA_NO_DEADLINE && dma_stats_now() >= deadline_ns)
+        {
+            break;
+        }
+        spins++;
         if (usleep_timeout != 0)
         {
             usleep_nano(usleep_timeout);
         }
     }
+    if (ended)
+    {
+        __mmio_rmb();
+    }
+    if (stats != NULL)
+    {
+        uint64_t end = dma_stats_time();
+        stats->wait_ns += end - begin;
+        stats->spins += spins;
+        if (ended && stats->started_ns != 0)
+        {
+            stats->busy_ns += end - stats->started_ns;
+            stats->started_ns = 0;
+        }
+    }
+    if (ended)
+    {
+        DMA_TRACE(ctrl_intf, DMA_TRACE_KERNEL, DMA_TRACE_COMPLETE, 0);
+    }
+    DMA_TRACE(ctrl_intf, DMA_TRACE_KERNEL, DMA_TRACE_WAIT_END, 0);
+    return ended ? NO_ERROR : DMA_TRANS_TIMEOUT;
 }
 
@@ -17,15 +17,39 @@ extern "C" {
 
 #include <stdint.h>
 
-#if defined(__aarch64__) || defined(__amd64__)
-    #define __64BITS__
-#endif
+/**
+ * @brief physical address, 64 bits wide regardless of the host ABI: ZynqMP devices
+ * can place DDR (and thus UDMA buffers) and FPGA interfaces above 4 GiB;
+ * DMA engines may support narrower addresses, see @ref dma_engine.addr_width
+ */
+typedef uint64_t phys_addr_t;
 
-#ifdef __64BITS__
-	typedef unsigned long phys_addr_t;
-#else
-	typedef unsigned int phys_addr_t;
-#endif
+/*
+ * ========== MAPPING POLICY ==========
+ */
+
+#define DMA_MAP_DEFAULT 0U /**< plain mappings, faulted in on first access */
+#define DMA_MAP_POPULATE (1U << 0) /**< pre-fault all pages at mapping time */
+#define DMA_MAP_LOCK (1U << 1) /**< lock mappings into memory via mlock() */
+#define DMA_MAP_HUGE (1U << 2) /**< align large mappings to 2 MiB, for the driver to possibly use huge mappings */
+
+/**
+ * @brief set_mapping_policy sets how UDMA buffers and register areas are mmap()ed
+ * by the following calls to @ref load_udma_buffers, @ref get_dma_interfaces and
+ * @ref get_control_interface (and their variants)
+ *
+ * Pre-faulted and locked mappings move the cost of page faults from the first
+ * transactions to load time, so that latency from the first job on matches the
+ * steady state.
+ *
+ * @param flags OR of DMA_MAP_* values
+ */
+void set_mapping_policy(unsigned flags);
+
+/**
+ * @brief get_mapping_policy returns the current mapping policy, as OR of DMA_MAP_* values
+ */
+unsigned get_mapping_policy(void);
 
 /*
  * ========== USERSPACE DMA BUFFER INTERFACES ==========
@@ -70,6 +94,26 @@ int load_udma_buffers(unsigned int num, const unsigned long *sizes, struct udmab
  */
 void unload_udma_buffers(unsigned int num, struct udmabuf *buffers);
 
+/**
+ * @brief attach_udma_buffers maps the UDMA buffers of the udmabuf module already loaded,
+ * like @ref load_udma_buffers but without reloading the module, so that the buffers
+ * (and the transactions in flight on them) survive a restart of the application
+ *
+ * @param num number of buffers to map
+ * @param sizes size to map of each buffer, which must not exceed the size it was loaded with
+ * @param buffers user-allocated buffer to be filled with information of UDMA buffers
+ * @return 0 for success, non-0 for error, also if a buffer is missing or too small
+ */
+int attach_udma_buffers(unsigned int num, const unsigned long *sizes, struct udmabuf *buffers);
+
+/**
+ * @brief detach_udma_buffers unmaps the UDMA buffers, leaving the udmabuf module loaded
+ *
+ * @param num number of buffers to unmap
+ * @param buffers array with UDMA buffers information
+ */
+void detach_udma_buffers(unsigned int num, struct udmabuf *buffers);
+
 /*
  * ========== AXI DMA INTERFACES ==========
  */
@@ -89,13 +133,25 @@ enum dma_trans_status { NOT_STARTED, /**< transaction has not started yet, and w
  */
 struct dma_transaction {
     uint32_t addr_low; /**< low 32 bits of source/destination address */
-#ifdef __64BITS__
     uint32_t addr_high; /**< high 32 bits of source/destination address */
-#endif
     uint32_t length; /**< number of bytes to be transmitted */
     enum dma_trans_status status; /**< current status of the transaction */
 };
 
+/**
+ * @brief The dma_tuning struct stores the parameters calibrated for a DMA engine
+ * (see dma_tune.h), or defaults if the engine is not in the tuning profile
+ */
+struct dma_tuning {
+    unsigned chunk_size; /**< smallest transaction size reaching near-peak bandwidth */
+    unsigned depth; /**< transactions to keep in flight in pipelines */
+    unsigned usleep_timeout; /**< sleeping interval to wait for chunks, 0 for busy wait */
+    unsigned setup_ns; /**< cost of programming and starting a transaction */
+    unsigned latency_ns; /**< time from the end of a transfer to its completion being observed */
+    unsigned sleep_ns; /**< actual duration of the shortest sleep */
+    unsigned bytes_per_us; /**< steady-state bandwidth; 0 if not calibrated */
+};
+
 /**
  * @brief The dma_engine struct stores the information about the entire DMA engine.
  *
@@ -107,21 +163,49 @@ struct dma_engine {
     volatile char *regs_vaddr; /**< pointer to DMA register area */
     struct dma_transaction to_dev; /**< information about transaction towards FPGA logic */
     struct dma_transaction from_dev; /**< information about transaction from FPGA logic */
+    int sg_mode; /**< 1 if the engine is in Scatter/Gather mode, usable only via @ref dma_capture */
+    unsigned addr_width; /**< number of address bits the engine supports, from 32 to 64 */
+    unsigned length_width; /**< number of bits of the length register, from 8 to 26 */
+    struct dma_stats_engine *stats; /**< telemetry counters in shared memory, NULL if disabled */
+    phys_addr_t phys_addr; /**< physical address of the engine registers */
+    struct dma_tuning tuning; /**< calibrated parameters, loaded when the engine is mapped */
 };
 
+/**
+ * @brief value of usleep_timeout making waits follow the policy calibrated for the engine,
+ * based on the transaction length: busy wait for short transactions, sleeping intervals
+ * proportional to the expected duration for long ones (see dma_tune.h)
+ */
+#define DMA_USLEEP_AUTO (~0U)
+
 /**
  * @brief error status of DMA-related calls
  */
 enum dma_err_status { NO_ERROR = 0, /**< no error occurred */
                       DMA_TRANS_RUNNING, /**< DMa transaction is running */
                       DMA_TRANS_NOT_PROGRAMMED, /**< DMA transaction has not been programmed */
-                      DMA_TRANS_NOT_STARTED /**< DMA transaction has not been started */
+                      DMA_TRANS_NOT_STARTED, /**< DMA transaction has not been started */
+                      DMA_TRANS_TIMEOUT, /**< the deadline passed before the end, which is still awaited */
+                      DMA_ENGINE_RESET, /**< the engine was reset, aborting the transactions of both directions */
+                      DMA_ENGINE_HUNG, /**< the engine does not complete its reset, and cannot be used */
+                      DMA_TRANS_ERROR /**< the engine reported an error, to be read from the error status */
                     };
 
+/**
+ * @brief deadline of the waits never expiring
+ */
+#define DMA_NO_DEADLINE 0ULL
+
 /**
  * @brief get_dma_interfaces loads the DMA interfaces from physical memory,
  * making them available to the process
  *
+ * The address width of each engine is detected by probing its high address registers;
+ * transactions on buffers beyond it are refused.
+ * Engines with the Scatter/Gather logic are marked via @ref dma_engine.sg_mode: they cannot run
+ * simple transactions, but can run a continuous capture (see dma_capture.h).
+ * The tuning of each engine is taken from the tuning profile, if any (see dma_tune.h).
+ *
  * @param num_dma number of DMA interfaces
  * @param offsets physical address of DMA interfaces, as from Vivado Address Editor;
  * if num_dma == 1, offsets can be NULL and the default location AXI_DMA_REGISTER_LOCATION
@@ -129,11 +213,65 @@ enum dma_err_status { NO_ERROR = 0, /**< no error occurred */
  * @param lengths lengths of DMA register areas to be mapped; if NULL, the default length
  * DESCRIPTOR_REGISTERS_SIZE is used
  * @param engines the struct @ref dma_engine
- * @return 0 for success, non-0 otherwise
+ * @return 0 for success, non-0 otherwise, also if an engine does not complete its reset
  */
 int get_dma_interfaces(unsigned num_dma, phys_addr_t *offsets,
     unsigned *lengths, struct dma_engine *engines);
 
+/**
+ * @brief attach_dma_interfaces loads the DMA interfaces like @ref get_dma_interfaces,
+ * but reuses each engine as-is instead of resetting it
+ *
+ * The current state of each engine is read from its registers: if both channels are free
+ * from errors, the @ref dma_transaction state of both directions is rebuilt from the registers
+ * (a transaction found running is marked as STARTED and can be waited for); otherwise,
+ * the engine is reset as in @ref get_dma_interfaces.
+ * This avoids the reset latency on service restarts and preserves transactions in flight.
+ * The address width is probed on a channel not running: if both are, 32 bits are assumed
+ * (see @ref set_dma_address_width).
+ *
+ * @param num_dma number of DMA interfaces
+ * @param offsets physical address of DMA interfaces, as for @ref get_dma_interfaces
+ * @param lengths lengths of DMA register areas to be mapped, as for @ref get_dma_interfaces
+ * @param engines the struct @ref dma_engine
+ * @return 0 for success, non-0 otherwise
+ */
+int attach_dma_interfaces(unsigned num_dma, phys_addr_t *offsets,
+    unsigned *lengths, struct dma_engine *engines);
+
+/**
+ * @brief set_dma_address_width overrides the address width of @p engine, as configured
+ * in Vivado, in case the detected one is not correct
+ *
+ * @param engine the DMA engine pointer
+ * @param bits number of address bits, from 32 to 64
+ */
+void set_dma_address_width(struct dma_engine *engine, unsigned bits);
+
+/**
+ * @brief default width of the length register of the engines, as set by the Width of Buffer
+ * Length Register (c_sg_length_width) of the designs in Vivado
+ */
+#define DMA_DEF_LENGTH_WIDTH 23
+
+/**
+ * @brief set_dma_length_width overrides the width of the length register of @p engine,
+ * DMA_DEF_LENGTH_WIDTH by default, as configured in Vivado; it cannot be detected
+ *
+ * @param engine the DMA engine pointer
+ * @param bits number of bits of the length register, from 8 to 26
+ */
+void set_dma_length_width(struct dma_engine *engine, unsigned bits);
+
+/**
+ * @brief dma_max_length returns the largest length of a transaction of @p engine,
+ * given by the width of its length register
+ *
+ * @param engine the DMA engine pointer
+ * @return the largest length in bytes
+ */
+unsigned dma_max_length(const struct dma_engine *engine);
+
 /**
  * @brief destroy_dma_interfaces destroys the DMA interfaces by unmmap()ing their memory
  * @param num_dma number of DMA interfaces
@@ -147,7 +285,7 @@ void destroy_dma_interfaces(unsigned num_dma, struct dma_engine *engines);
  * @param engine the DMA engine pointer
  * @param buf the UDMA buf to read data from
  * @param offset the offset within the UDMA buffer
- * @param length how many bytes to trasmit
+ * @param length how many bytes to trasmit, up to @ref dma_max_length
  * @return an @ref dma_err_status value describing success or failure reason
  */
 enum dma_err_status set_simple_transfer_to_device(struct dma_engine *engine, struct udmabuf *buf, 
@@ -159,7 +297,7 @@ enum dma_err_status set_simple_transfer_to_device(struct dma_engine *engine, str
  * @param engine the DMA engine pointer
  * @param buf the UDMA buf to write data to
  * @param offset the offset within the UDMA buffer
- * @param length how many bytes to trasmit
+ * @param length how many bytes to trasmit, up to @ref dma_max_length
  * @return an @ref dma_err_status value describing success or failure reason
  */
 enum dma_err_status set_simple_transfer_from_device(struct dma_engine *engine, struct udmabuf *buf, 
@@ -190,9 +328,12 @@ enum dma_err_status start_simple_transfer_from_device(struct dma_engine *engine)
  * Users can optionally specify sleeping time via @p usleep_timeout
  *
  * @param engine the DMA engine pointer
- * @param usleep_timeout sleeping intervals to wait for the transaction end; 0 means busy wait
+ * @param usleep_timeout sleeping intervals to wait for the transaction end; 0 means busy wait,
+ * DMA_USLEEP_AUTO the calibrated policy
  * @return an @ref dma_err_status value saying whether the transaction has ended successfully,
- * or describing why it was not possible to wait
+ * or describing why it was not possible to wait; DMA_TRANS_ERROR if the engine halted on an
+ * error (see @ref err_status_to_device): the transaction is over, and the engine takes new
+ * ones only once recovered via @ref cancel_simple_transfer_to_device
  */
 enum dma_err_status wait_simple_transfer_to_device(struct dma_engine *engine, unsigned usleep_timeout);
 
@@ -201,12 +342,178 @@ enum dma_err_status wait_simple_transfer_to_device(struct dma_engine *engine, un
  * Users can optionally specify sleeping time via @p usleep_timeout
  *
  * @param engine the DMA engine pointer
- * @param usleep_timeout sleeping intervals to wait for the transaction end; 0 means busy wait
+ * @param usleep_timeout sleeping intervals to wait for the transaction end; 0 means busy wait,
+ * DMA_USLEEP_AUTO the calibrated policy
  * @return an @ref dma_err_status value saying whether the transaction has ended successfully,
- * or describing why it was not possible to wait
+ * or describing why it was not possible to wait; DMA_TRANS_ERROR if the engine halted on an
+ * error (see @ref err_status_from_device): the transaction is over, and the engine takes new
+ * ones only once recovered via @ref cancel_simple_transfer_from_device
  */
 enum dma_err_status wait_simple_transfer_from_device(struct dma_engine *engine, unsigned usleep_timeout);
 
+/**
+ * @brief wait_simple_transfer_to_device_until waits like @ref wait_simple_transfer_to_device,
+ * giving up at @p deadline_ns
+ *
+ * @param engine the DMA engine pointer
+ * @param usleep_timeout sleeping intervals, as for @ref wait_simple_transfer_to_device
+ * @param deadline_ns absolute deadline, in the time of @ref dma_stats_now (CLOCK_MONOTONIC);
+ * DMA_NO_DEADLINE to wait forever
+ * @return as @ref wait_simple_transfer_to_device, or DMA_TRANS_TIMEOUT if the deadline passed:
+ * the transaction is still running, and can be waited for again or cancelled via
+ * @ref cancel_simple_transfer_to_device
+ */
+enum dma_err_status wait_simple_transfer_to_device_until(struct dma_engine *engine,
+    unsigned usleep_timeout, uint64_t deadline_ns);
+
+/**
+ * @brief wait_simple_transfer_from_device_until waits like @ref wait_simple_transfer_from_device,
+ * giving up at @p deadline_ns
+ *
+ * @param engine the DMA engine pointer
+ * @param usleep_timeout sleeping intervals, as for @ref wait_simple_transfer_from_device
+ * @param deadline_ns absolute deadline, as for @ref wait_simple_transfer_to_device_until
+ * @return as @ref wait_simple_transfer_from_device, or DMA_TRANS_TIMEOUT if the deadline passed:
+ * the transaction is still running, and can be waited for again or cancelled via
+ * @ref cancel_simple_transfer_from_device
+ */
+enum dma_err_status wait_simple_transfer_from_device_until(struct dma_engine *engine,
+    unsigned usleep_timeout, uint64_t deadline_ns);
+
+/**
+ * @brief cancel_simple_transfer_to_device stops the transaction to FPGA logic, e.g. after
+ * a wait timed out
+ *
+ * The channel is halted by clearing its run bit, which lets the transaction in flight drain;
+ * the transaction from FPGA logic is untouched. If the channel does not halt within
+ * a few milliseconds (the logic stopped accepting data), or halts with an error, the engine
+ * is recovered via @ref reset_dma_engine: the AXI DMA has no per-channel reset, so this
+ * aborts the transaction from FPGA logic as well. Other engines are never affected.
+ * A channel a wait or a poll found halted on an error (DMA_TRANS_ERROR) is recovered the same way.
+ * The transaction can be programmed and started again afterwards.
+ *
+ * @param engine the DMA engine pointer
+ * @return NO_ERROR if the channel halted, DMA_TRANS_NOT_STARTED if no transaction was started
+ * and the channel has no error, otherwise as @ref reset_dma_engine
+ */
+enum dma_err_status cancel_simple_transfer_to_device(struct dma_engine *engine);
+
+/**
+ * @brief cancel_simple_transfer_from_device stops the transaction from FPGA logic, like
+ * @ref cancel_simple_transfer_to_device does for the other direction
+ *
+ * @param engine the DMA engine pointer
+ * @return NO_ERROR if the channel halted, DMA_TRANS_NOT_STARTED if no transaction was started,
+ * otherwise as @ref reset_dma_engine
+ */
+enum dma_err_status cancel_simple_transfer_from_device(struct dma_engine *engine);
+
+/**
+ * @brief reset_dma_engine re-initializes @p engine as @ref get_dma_interfaces does, clearing
+ * errors and aborting the transactions of both directions, while other engines keep running
+ *
+ * The reset is given a few milliseconds to complete: an engine whose stream clock stopped
+ * never completes it.
+ *
+ * @param engine the DMA engine pointer
+ * @return DMA_ENGINE_RESET if the engine is usable again, DMA_ENGINE_HUNG otherwise
+ */
+enum dma_err_status reset_dma_engine(struct dma_engine *engine);
+
+/**
+ * @brief transfer_2d_to_device sends to FPGA logic a 2D area of @p buf made of @p rows rows
+ * of @p row_bytes bytes each, the first one starting at @p offset and each following one
+ * @p stride bytes after the previous one, e.g. a tile of a row-major matrix; it returns
+ * once the whole area has been sent
+ *
+ * The rows are sent in order as a single stream: the engine is re-armed on each row
+ * as soon as the previous one is over, without going through the set/start/wait calls,
+ * and adjacent rows (@p stride == @p row_bytes) are moved with a single transaction, as long
+ * as it fits into @ref dma_max_length; @p row_bytes cannot exceed it.
+ * If the engine reports an error, the remaining rows are not sent and DMA_TRANS_ERROR is
+ * returned: @ref err_status_to_device tells which error occurred, and the engine, halted,
+ * takes new transactions only after @ref reset_dma_engine.
+ *
+ * @param engine the DMA engine pointer
+ * @param buf the UDMA buf to read data from
+ * @param offset the offset of the first row within the UDMA buffer
+ * @param row_bytes how many bytes to transmit for each row
+ * @param rows number of rows
+ * @param stride distance in bytes between the start of two consecutive rows
+ * @param usleep_timeout sleeping intervals to wait for each row; 0 means busy wait,
+ * DMA_USLEEP_AUTO the calibrated policy
+ * @return an @ref dma_err_status value describing success or failure reason;
+ * DMA_TRANS_NOT_PROGRAMMED if the area does not fit into @p buf, DMA_TRANS_ERROR if the engine
+ * reported an error
+ */
+enum dma_err_status transfer_2d_to_device(struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout);
+
+/**
+ * @brief transfer_2d_from_device receives from FPGA logic a 2D area into @p buf, with the same
+ * layout and semantics as @ref transfer_2d_to_device; it returns once the whole area
+ * has been received, or DMA_TRANS_ERROR once the engine reported an error
+ * (see @ref err_status_from_device)
+ */
+enum dma_err_status transfer_2d_from_device(struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout);
+
+/**
+ * @brief transfer_2d_to_device_until sends a 2D area like @ref transfer_2d_to_device,
+ * giving up at @p deadline_ns
+ *
+ * @param deadline_ns absolute deadline of the whole area, as for
+ * @ref wait_simple_transfer_to_device_until
+ * @return as @ref transfer_2d_to_device, or DMA_TRANS_TIMEOUT if the deadline passed: the rows
+ * after the one in flight are not sent, and the transaction of the row in flight is still running,
+ * to be waited for or cancelled via @ref cancel_simple_transfer_to_device
+ */
+enum dma_err_status transfer_2d_to_device_until(struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout,
+    uint64_t deadline_ns);
+
+/**
+ * @brief transfer_2d_from_device_until receives a 2D area like @ref transfer_2d_from_device,
+ * giving up at @p deadline_ns as @ref transfer_2d_to_device_until does
+ */
+enum dma_err_status transfer_2d_from_device_until(struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned row_bytes, unsigned rows, unsigned stride, unsigned usleep_timeout,
+    uint64_t deadline_ns);
+
+/**
+ * @brief poll_simple_transfer_to_device checks, without waiting, whether the DMA transaction
+ * to FPGA logic is complete
+ *
+ * @param engine the DMA engine pointer
+ * @return NO_ERROR if the transaction has ended (as after @ref wait_simple_transfer_to_device),
+ * DMA_TRANS_RUNNING if it is still running, DMA_TRANS_NOT_STARTED if no transaction was started,
+ * DMA_TRANS_ERROR if the engine halted on an error (as for @ref wait_simple_transfer_to_device)
+ */
+enum dma_err_status poll_simple_transfer_to_device(struct dma_engine *engine);
+
+/**
+ * @brief poll_simple_transfer_from_device checks, without waiting, whether the DMA transaction
+ * from FPGA logic is complete
+ *
+ * @param engine the DMA engine pointer
+ * @return NO_ERROR if the transaction has ended (as after @ref wait_simple_transfer_from_device),
+ * DMA_TRANS_RUNNING if it is still running, DMA_TRANS_NOT_STARTED if no transaction was started,
+ * DMA_TRANS_ERROR if the engine halted on an error (as for @ref wait_simple_transfer_from_device)
+ */
+enum dma_err_status poll_simple_transfer_from_device(struct dma_engine *engine);
+
+/**
+ * @brief transferred_length_from_device returns the number of bytes actually written to memory
+ * by the last completed transaction from FPGA logic
+ *
+ * The FPGA logic may end a transaction early by asserting TLAST: in that case, this value is
+ * smaller than the length given in @ref set_simple_transfer_from_device.
+ * It is valid only after the transaction is complete.
+ *
+ * @param engine the DMA engine pointer
+ */
+unsigned transferred_length_from_device(struct dma_engine *engine);
+
 /**
  * @brief err_status_to_device retrieves the hardware-related error bitmask after a transaction to FPGA
  * is unseuccessful.
@@ -236,6 +543,7 @@ struct control_interface {
     unsigned length; /**< length of control interface */
     volatile char *control_regs_vaddr; /**< pointer to beginning of memory-mapped control registers */
     volatile char *user_args; /**< pointer to user-logic control registers, where kernel arguments go */
+    struct dma_stats_kernel *stats; /**< telemetry counters in shared memory, NULL if disabled */
 };
 
 /**
@@ -249,6 +557,19 @@ struct control_interface {
  */
 int get_control_interface(phys_addr_t phys_addr, unsigned length, struct control_interface *ctrl_intf);
 
+/**
+ * @brief attach_control_interface mmap()s the control interface like @ref get_control_interface,
+ * but runs the full initialization only if interrupts are enabled or pending
+ *
+ * A kernel found running is left untouched, and can be waited for via @ref wait_kernel.
+ *
+ * @param phys_addr physical address of control interface registers, as for @ref get_control_interface
+ * @param length length of control interface, as for @ref get_control_interface
+ * @param ctrl_intf pointer of user-allocated @ref struct control_interface to be filled
+ * @return 0 for success, non-0 otherwise
+ */
+int attach_control_interface(phys_addr_t phys_addr, unsigned length, struct control_interface *ctrl_intf);
+
 /**
  * @brief destroy_control_interface releases the control interface memory via unmap()
  * @param ctrl_intf control interface to release
@@ -338,10 +659,25 @@ void start_kernel(struct control_interface *ctrl_intf);
  * @brief wait_kernel waits for the kernel to be done
  *
  * @param ctrl_intf the control interface pointer
- * @param usleep_timeout sleeping intervals to wait for the computation end; 0 means busy wait
+ * @param usleep_timeout sleeping intervals to wait for the computation end; 0 means busy wait,
+ * as does DMA_USLEEP_AUTO, kernels not being calibrated
  */
 void wait_kernel(struct control_interface *ctrl_intf, unsigned usleep_timeout);
 
+/**
+ * @brief wait_kernel_until waits like @ref wait_kernel, giving up at @p deadline_ns
+ *
+ * HLS kernels have no abort signal: a kernel that never ends needs the logic to be reset,
+ * e.g. by flashing the bitstream again.
+ *
+ * @param ctrl_intf the control interface pointer
+ * @param usleep_timeout sleeping intervals, as for @ref wait_kernel
+ * @param deadline_ns absolute deadline, as for @ref wait_simple_transfer_to_device_until
+ * @return NO_ERROR if the kernel is done, DMA_TRANS_TIMEOUT if the deadline passed
+ */
+enum dma_err_status wait_kernel_until(struct control_interface *ctrl_intf, unsigned usleep_timeout,
+    uint64_t deadline_ns);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,213 @@
+#ifndef DMA_ENGINE_FAST_H_
+#define DMA_ENGINE_FAST_H_
+
+/**
+ * @file dma_engine_fast.h
+ * @author Alberto Scolari
+ * @brief Header with inline versions of the calls to set, start and wait for simple transactions
+ * and to start and wait for kernels, for loops issuing many small transactions.
+ *
+ * The calls of dma_engine_buf.h are out-of-line, check the state of the engine and
+ * of the transaction at each call, read the clock for telemetry and tracing and choose the wait
+ * policy from the tuning. The calls here access the registers as the library does and keep
+ * the state of the transactions in @ref dma_engine up to date, so that the two APIs can be mixed
+ * on the same engine, but:
+ * - they are inlined into the caller, with no function call and no clock reads
+ * - they check the state of the transactions (and the mode, the address width and the length
+ *   width of the engine) only if DMA_FAST_CHECKS is non-0, by default unless NDEBUG is defined:
+ *   release builds compile the checks out, and only waits fail, with DMA_TRANS_ERROR on engine
+ *   errors
+ * - starting a transaction writes its length without reading the length register first
+ * - waits spin on the status register, without sleeping and without deadline, until the channel
+ *   is idle or halted on an error
+ * - the transactions and kernel runs issued here are not counted in the telemetry
+ *   (see dma_stats.h) nor recorded in traces (see dma_trace.h)
+ * The library is unchanged: applications not including this header are not affected.
+ */
+
+#include <stdint.h>
+
+#include "dma_engine_buf.h"
+#include "xhw_internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef DMA_FAST_CHECKS
+#ifdef NDEBUG
+#define DMA_FAST_CHECKS 0
+#else
+#define DMA_FAST_CHECKS 1
+#endif
+#endif
+
+/* first register of each channel, in 32 bits words */
+#define DMA_FAST_MM2S 0
+#define DMA_FAST_S2MM 12
+
+static inline enum dma_err_status dma_fast_set(struct dma_engine *engine, unsigned channel,
+    struct dma_transaction *trans, struct udmabuf *buf, unsigned offset, unsigned length)
+{
+    volatile uint32_t *regs = (volatile uint32_t *)engine->regs_vaddr + channel;
+    phys_addr_t addr = buf->paddr + offset;
+
+#if DMA_FAST_CHECKS
+    if (engine->sg_mode)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    if (engine->addr_width < 64 && ((addr + length - 1) >> engine->addr_width) != 0)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    if ((length >> engine->length_width) != 0)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    if (trans->status == STARTED)
+    {
+        return DMA_TRANS_RUNNING;
+    }
+#endif
+    *(regs + 6) = trans->addr_low = (uint32_t)addr;
+    *(regs + 7) = trans->addr_high = (uint32_t)(addr >> 32);
+    trans->length = length;
+    trans->status = PROGRAMMED;
+    return NO_ERROR;
+}
+
+static inline enum dma_err_status dma_fast_start(struct dma_engine *engine, unsigned channel,
+    struct dma_transaction *trans)
+{
+    volatile uint32_t *regs = (volatile uint32_t *)engine->regs_vaddr + channel;
+
+#if DMA_FAST_CHECKS
+    if (trans->status == NOT_STARTED)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    if (trans->status == STARTED)
+    {
+        return DMA_TRANS_RUNNING;
+    }
+#endif
+    SET_BIT(*regs, 0);
+    /* writing the length starts the engine: addresses, run bit and buffer data must precede it */
+    __doorbell_barrier();
+    /* the bits of the length register beyond its width are reserved */
+    *(regs + 10) = trans->length & ((1U << engine->length_width) - 1U);
+    trans->status = STARTED;
+    return NO_ERROR;
+}
+
+static inline enum dma_err_status dma_fast_wait(struct dma_engine *engine, unsigned channel,
+    struct dma_transaction *trans)
+{
+    volatile uint32_t *regs = (volatile uint32_t *)engine->regs_vaddr + channel;
+    uint32_t status;
+
+#if DMA_FAST_CHECKS
+    if (trans->status != STARTED)
+    {
+        return DMA_TRANS_NOT_STARTED;
+    }
+#endif
+    /* idle at the end, or halted (with an error bit among 4-6) on an error */
+    while (((status = *(regs + 1)) & 0x73U) == 0)
+    {
+    }
+    trans->status = PROGRAMMED;
+    if ((status & 0x72U) != 0x2U)
+    {
+        return DMA_TRANS_ERROR;
+    }
+    /* the data the engine wrote can be read only after it is seen idle */
+    __mmio_rmb();
+    return NO_ERROR;
+}
+
+/**
+ * @brief dma_fast_set_to_device is the inline version of @ref set_simple_transfer_to_device
+ */
+static inline enum dma_err_status dma_fast_set_to_device(struct dma_engine *engine,
+    struct udmabuf *buf, unsigned offset, unsigned length)
+{
+    return dma_fast_set(engine, DMA_FAST_MM2S, &engine->to_dev, buf, offset, length);
+}
+
+/**
+ * @brief dma_fast_set_from_device is the inline version of @ref set_simple_transfer_from_device
+ */
+static inline enum dma_err_status dma_fast_set_from_device(struct dma_engine *engine,
+    struct udmabuf *buf, unsigned offset, unsigned length)
+{
+    return dma_fast_set(engine, DMA_FAST_S2MM, &engine->from_dev, buf, offset, length);
+}
+
+/**
+ * @brief dma_fast_start_to_device is the inline version of @ref start_simple_transfer_to_device
+ */
+static inline enum dma_err_status dma_fast_start_to_device(struct dma_engine *engine)
+{
+    return dma_fast_start(engine, DMA_FAST_MM2S, &engine->to_dev);
+}
+
+/**
+ * @brief dma_fast_start_from_device is the inline version of
+ * @ref start_simple_transfer_from_device
+ */
+static inline enum dma_err_status dma_fast_start_from_device(struct dma_engine *engine)
+{
+    return dma_fast_start(engine, DMA_FAST_S2MM, &engine->from_dev);
+}
+
+/**
+ * @brief dma_fast_wait_to_device is the inline version of @ref wait_simple_transfer_to_device
+ * with busy wait
+ */
+static inline enum dma_err_status dma_fast_wait_to_device(struct dma_engine *engine)
+{
+    return dma_fast_wait(engine, DMA_FAST_MM2S, &engine->to_dev);
+}
+
+/**
+ * @brief dma_fast_wait_from_device is the inline version of @ref wait_simple_transfer_from_device
+ * with busy wait
+ */
+static inline enum dma_err_status dma_fast_wait_from_device(struct dma_engine *engine)
+{
+    return dma_fast_wait(engine, DMA_FAST_S2MM, &engine->from_dev);
+}
+
+/**
+ * @brief dma_fast_start_kernel is the inline version of @ref start_kernel
+ */
+static inline void dma_fast_start_kernel(struct control_interface *ctrl_intf)
+{
+    volatile struct axi_control_base_regs *regs =
+        (volatile struct axi_control_base_regs *)ctrl_intf->control_regs_vaddr;
+    /* arguments and input data must be visible before ap_start */
+    __doorbell_barrier();
+    SET_BIT(regs->control, 0);
+}
+
+/**
+ * @brief dma_fast_wait_kernel is the inline version of @ref wait_kernel with busy wait
+ */
+static inline void dma_fast_wait_kernel(struct control_interface *ctrl_intf)
+{
+    volatile struct axi_control_base_regs *regs =
+        (volatile struct axi_control_base_regs *)ctrl_intf->control_regs_vaddr;
+    /* ap_start is cleared once the kernel takes new inputs, as the library checks */
+    while (BIT(regs->control, 0) != 0)
+    {
+    }
+    __mmio_rmb();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_ENGINE_FAST_H_ */
@@ -0,0 +1,322 @@
+
+/**
+ * @file dma_ingest.c
+ * @author Alberto Scolari
+ * @brief Implementation of file-to-FPGA streaming via io_uring reads into UDMA slices.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dma_stream_io.h"
+#include "dma_stats.h"
+#include "uring_internals.h"
+
+int dma_ingest_init(struct dma_ingest *ingest, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slice_size, unsigned num_slices,
+    dma_slice_callback on_slice, void *cb_arg)
+{
+    unsigned long area;
+
+    /* calibrated values, or defaults, for the engine */
+    if (slice_size == 0)
+    {
+        slice_size = engine->tuning.chunk_size;
+    }
+    if (num_slices == 0)
+    {
+        num_slices = engine->tuning.depth;
+    }
+    area = (unsigned long)slice_size * num_slices;
+    if (num_slices < 2 || slice_size == 0 || offset + area > buf->size)
+    {
+        printf("%s: slices do not fit into the UDMA buffer\n", __func__);
+        return -1;
+    }
+    memset(ingest, 0, sizeof(*ingest));
+    ingest->ring = malloc(sizeof(struct dma_uring));
+    ingest->filled = calloc(num_slices, sizeof(unsigned));
+    ingest->wanted = calloc(num_slices, sizeof(unsigned));
+    if (ingest->ring == NULL || ingest->filled == NULL || ingest->wanted == NULL)
+    {
+        printf("%s: cannot allocate pipeline state\n", __func__);
+        goto err_alloc;
+    }
+    if (dma_uring_init(ingest->ring, num_slices) != 0)
+    {
+        goto err_alloc;
+    }
+    /* pinning may fail on uncached UDMA mappings: plain reads are used then */
+    dma_uring_register_buffer(ingest->ring, (char *)buf->vaddr + offset, area);
+
+    ingest->engine = engine;
+    ingest->buf = buf;
+    ingest->offset = offset;
+    ingest->slice_size = slice_size;
+    ingest->num_slices = num_slices;
+    ingest->on_slice = on_slice;
+    ingest->cb_arg = cb_arg;
+    ingest->slice_timeout_ns = DMA_STREAM_SLICE_TIMEOUT_NS;
+    return 0;
+
+err_alloc:
+    free(ingest->ring);
+    free(ingest->filled);
+    free(ingest->wanted);
+    ingest->ring = NULL;
+    return -1;
+}
+
+static char *slice_addr(struct dma_ingest *ingest, unsigned slice)
+{
+    return (char *)ingest->buf->vaddr + ingest->offset + (unsigned long)slice * ingest->slice_size;
+}
+
+static int queue_read(struct dma_ingest *ingest, int fd, unsigned slice,
+    unsigned long long file_offset)
+{
+    struct io_uring_sqe *sqe = dma_uring_get_sqe(ingest->ring);
+    unsigned done = ingest->filled[slice];
+
+    if (sqe == NULL)
+    {
+        return -1;
+    }
+    sqe->opcode = ingest->ring->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = file_offset + done;
+    sqe->addr = (unsigned long)(slice_addr(ingest, slice) + done);
+    sqe->len = ingest->wanted[slice] - done;
+    sqe->buf_index = 0;
+    sqe->user_data = slice;
+    ingest->reads_in_flight++;
+    return 0;
+}
+
+/*
+ * reap the completions of all reads in flight, so that none is left in the ring
+ * to be taken for a read of the next call
+ */
+static int drain_reads(struct dma_ingest *ingest)
+{
+    while (ingest->reads_in_flight > 0)
+    {
+        if (dma_uring_wait_cqe(ingest->ring) == NULL)
+        {
+            return -1;
+        }
+        dma_uring_cqe_seen(ingest->ring);
+        ingest->reads_in_flight--;
+    }
+    return 0;
+}
+
+/*
+ * wait for the slice being sent: the engine halts on errors, and the stream must stop;
+ * a halted or stuck engine is recovered for the next stream
+ */
+static int wait_dma(struct dma_ingest *ingest, unsigned usleep_timeout)
+{
+    uint64_t deadline = ingest->slice_timeout_ns == 0 ? DMA_NO_DEADLINE
+        : dma_stats_now() + ingest->slice_timeout_ns;
+    enum dma_err_status err = wait_simple_transfer_to_device_until(ingest->engine,
+        usleep_timeout, deadline);
+
+    if (err == NO_ERROR)
+    {
+        return 0;
+    }
+    if (err == DMA_TRANS_ERROR)
+    {
+        printf("%s: DMA engine reported error 0x%x\n", __func__,
+            err_status_to_device(ingest->engine));
+    } else if (err == DMA_TRANS_TIMEOUT)
+    {
+        printf("%s: DMA transaction not over in %llu ms\n", __func__,
+            (unsigned long long)(ingest->slice_timeout_ns / 1000000ULL));
+    } else
+    {
+        printf("%s: cannot wait for DMA transaction (error %d)\n", __func__, (int)err);
+        return -1;
+    }
+    cancel_simple_transfer_to_device(ingest->engine);
+    return -1;
+}
+
+/*
+ * reap completions until @p slice is filled (or the file is over);
+ * reads completing out of order are accounted in their own slices
+ */
+static int wait_slice(struct dma_ingest *ingest, int fd, unsigned slice,
+    unsigned long long *slice_offsets, int *eof)
+{
+    while (ingest->filled[slice] < ingest->wanted[slice])
+    {
+        struct io_uring_cqe *cqe = dma_uring_wait_cqe(ingest->ring);
+        unsigned s;
+        int res;
+
+        if (cqe == NULL)
+        {
+            return -1;
+        }
+        s = (unsigned)cqe->user_data;
+        res = cqe->res;
+        dma_uring_cqe_seen(ingest->ring);
+        ingest->reads_in_flight--;
+        if (res < 0)
+        {
+            printf("%s: read failed: %s\n", __func__, strerror(-res));
+            return -1;
+        }
+        if (res == 0)
+        {
+            /* end of file: the slice carries what was read so far */
+            ingest->wanted[s] = ingest->filled[s];
+            *eof = 1;
+            continue;
+        }
+        ingest->filled[s] += (unsigned)res;
+        if (ingest->filled[s] < ingest->wanted[s])
+        {
+            /* short read: ask for the rest */
+            if (queue_read(ingest, fd, s, slice_offsets[s]) != 0 ||
+                dma_uring_submit(ingest->ring, 0) < 0)
+            {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+long long dma_ingest_file(struct dma_ingest *ingest, int fd, unsigned long long file_offset,
+    unsigned long long length, unsigned usleep_timeout)
+{
+    unsigned long long *slice_offsets;
+    unsigned long long queued = 0, sent = 0;
+    unsigned i, next = 0, in_flight = 0;
+    int dma_running = 0, eof = 0, prev = -1;
+    enum dma_err_status err;
+
+    /* a previous call failed with reads still in flight */
+    if (drain_reads(ingest) != 0)
+    {
+        printf("%s: reads of a previous stream cannot be reaped\n", __func__);
+        return -1;
+    }
+    slice_offsets = malloc(ingest->num_slices * sizeof(unsigned long long));
+    if (slice_offsets == NULL)
+    {
+        return -1;
+    }
+
+    /* fill the pipeline */
+    for (i = 0; i < ingest->num_slices && queued < length; i++)
+    {
+        unsigned long long left = length - queued;
+        ingest->filled[i] = 0;
+        ingest->wanted[i] = left < ingest->slice_size ? (unsigned)left : ingest->slice_size;
+        slice_offsets[i] = file_offset + queued;
+        if (queue_read(ingest, fd, i, slice_offsets[i]) != 0)
+        {
+            goto err;
+        }
+        queued += ingest->wanted[i];
+        in_flight++;
+    }
+    if (dma_uring_submit(ingest->ring, 0) < 0)
+    {
+        goto err;
+    }
+
+    while (in_flight > 0)
+    {
+        if (wait_slice(ingest, fd, next, slice_offsets, &eof) != 0)
+        {
+            goto err;
+        }
+        if (dma_running)
+        {
+            dma_running = 0;
+            if (wait_dma(ingest, usleep_timeout) != 0)
+            {
+                goto err;
+            }
+        }
+
+        /* the slice is filled: send it and recycle the previous one */
+        if (ingest->filled[next] > 0)
+        {
+            if (ingest->on_slice != NULL)
+            {
+                ingest->on_slice(ingest->cb_arg, next, ingest->filled[next]);
+            }
+            err = set_simple_transfer_to_device(ingest->engine, ingest->buf,
+                ingest->offset + next * ingest->slice_size, ingest->filled[next]);
+            if (err == NO_ERROR)
+            {
+                err = start_simple_transfer_to_device(ingest->engine);
+            }
+            if (err != NO_ERROR)
+            {
+                printf("%s: cannot start DMA transaction (error %d)\n", __func__, (int)err);
+                goto err;
+            }
+            dma_running = 1;
+            sent += ingest->filled[next];
+        }
+        in_flight--;
+
+        if (prev >= 0 && !eof && queued < length)
+        {
+            unsigned long long left = length - queued;
+            unsigned p = (unsigned)prev;
+            ingest->filled[p] = 0;
+            ingest->wanted[p] = left < ingest->slice_size ? (unsigned)left : ingest->slice_size;
+            slice_offsets[p] = file_offset + queued;
+            if (queue_read(ingest, fd, p, slice_offsets[p]) != 0
+                || dma_uring_submit(ingest->ring, 0) < 0)
+            {
+                goto err;
+            }
+            queued += ingest->wanted[p];
+            in_flight++;
+        }
+        prev = (int)next;
+        next = (next + 1) % ingest->num_slices;
+    }
+    free(slice_offsets);
+    if (dma_running && wait_dma(ingest, usleep_timeout) != 0)
+    {
+        return -1;
+    }
+    return (long long)sent;
+
+err:
+    if (dma_running)
+    {
+        wait_dma(ingest, usleep_timeout);
+    }
+    /* the slices being read are reused by the next call */
+    if (dma_uring_submit(ingest->ring, 0) < 0 || drain_reads(ingest) != 0)
+    {
+        printf("%s: reads in flight cannot be reaped\n", __func__);
+    }
+    free(slice_offsets);
+    return -1;
+}
+
+void dma_ingest_destroy(struct dma_ingest *ingest)
+{
+    if (ingest->ring != NULL)
+    {
+        dma_uring_exit(ingest->ring);
+        free(ingest->ring);
+        ingest->ring = NULL;
+    }
+    free(ingest->filled);
+    free(ingest->wanted);
+    ingest->filled = ingest->wanted = NULL;
+}
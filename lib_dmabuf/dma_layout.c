@@ -0,0 +1,670 @@
+
+/**
+ * @file dma_layout.c
+ * @author Alberto Scolari
+ * @brief Implementation of the layout conversions into and out of uncached UDMA memory,
+ * with runtime selection of the vector unit available.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+
+#include "dma_layout.h"
+#include "dma_copy.h"
+#include "layout_internals.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LAYOUT_X86
+#include <immintrin.h>
+#elif defined(LAYOUT_NEON) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+
+/* alignment of the vector accesses to uncached memory */
+#define VEC_ALIGN 16U
+
+/* values per field of the cached bounce buffers, for fields of different alignments */
+#define BOUNCE_COUNT 256U
+
+/**
+ * @brief The layout_impl struct describes an implementation of the conversion loops; the loops
+ * require the uncached side to be VEC_ALIGN-aligned, and return how many records or values
+ * they converted, from the first: the callers convert the others with the scalar loops
+ */
+struct layout_impl {
+    const char *name;
+    int (*available)(void);
+    size_t (*split)(uint32_t *const *dsts, const unsigned char *src, unsigned fields,
+        size_t count);
+    size_t (*merge)(unsigned char *dst, const uint32_t *const *srcs, unsigned fields,
+        size_t count);
+    size_t (*widen)(uint32_t *dst, const unsigned char *src, enum dma_narrow_type type,
+        size_t count);
+    size_t (*narrow)(unsigned char *dst, enum dma_narrow_type type, const uint32_t *src,
+        size_t count);
+};
+
+static int always_available(void)
+{
+    return 1;
+}
+
+/* accesses to word @p index of the cached side, which may be unaligned */
+static inline uint32_t load_word(const unsigned char *p, size_t index)
+{
+    uint32_t w;
+    memcpy(&w, p + index * sizeof(w), sizeof(w));
+    return w;
+}
+
+static inline void store_word(unsigned char *p, size_t index, uint32_t w)
+{
+    memcpy(p + index * sizeof(w), &w, sizeof(w));
+}
+
+/*
+ * ------ scalar implementation: 32 bits accesses ------
+ * volatile accesses on the uncached side, as in dma_copy.c; the cached side may be unaligned
+ */
+
+static size_t scalar_split(uint32_t *const *dsts, const unsigned char *src, unsigned fields,
+    size_t count)
+{
+    size_t i;
+    unsigned f;
+    for (i = 0; i < count; i++)
+    {
+        for (f = 0; f < fields; f++)
+        {
+            ((volatile uint32_t *)dsts[f])[i] = load_word(src, i * fields + f);
+        }
+    }
+    return count;
+}
+
+static size_t scalar_merge(unsigned char *dst, const uint32_t *const *srcs, unsigned fields,
+    size_t count)
+{
+    size_t i;
+    unsigned f;
+    for (i = 0; i < count; i++)
+    {
+        for (f = 0; f < fields; f++)
+        {
+            store_word(dst, i * fields + f, ((const volatile uint32_t *)srcs[f])[i]);
+        }
+    }
+    return count;
+}
+
+static size_t scalar_widen(uint32_t *dst, const unsigned char *src, enum dma_narrow_type type,
+    size_t count)
+{
+    volatile uint32_t *d = (volatile uint32_t *)dst;
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        int16_t s16;
+        uint16_t u16;
+        switch (type)
+        {
+        case DMA_NARROW_S8:
+            d[i] = (uint32_t)(int32_t)(int8_t)src[i];
+            break;
+        case DMA_NARROW_U8:
+            d[i] = src[i];
+            break;
+        case DMA_NARROW_S16:
+            memcpy(&s16, src + i * sizeof(s16), sizeof(s16));
+            d[i] = (uint32_t)(int32_t)s16;
+            break;
+        default:
+            memcpy(&u16, src + i * sizeof(u16), sizeof(u16));
+            d[i] = u16;
+            break;
+        }
+    }
+    return count;
+}
+
+static size_t scalar_narrow(unsigned char *dst, enum dma_narrow_type type, const uint32_t *src,
+    size_t count)
+{
+    const volatile uint32_t *s = (const volatile uint32_t *)src;
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        uint32_t w = s[i];
+        if (narrow_size(type) == 1U)
+        {
+            dst[i] = (unsigned char)w;
+        }
+        else
+        {
+            uint16_t h = (uint16_t)w;
+            memcpy(dst + i * sizeof(h), &h, sizeof(h));
+        }
+    }
+    return count;
+}
+
+#ifdef LAYOUT_X86
+
+/*
+ * ------ x86 implementation: 128 bits accesses, shuffles in registers, non-temporal stores ------
+ */
+
+static int sse2_available(void)
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_split(uint32_t *const *dsts, const unsigned char *src, unsigned fields,
+    size_t count)
+{
+    const __m128i *s = (const __m128i *)src;
+    size_t i;
+    unsigned f;
+
+    if (fields == 2)
+    {
+        for (i = 0; i + 4 <= count; i += 4, s += 2)
+        {
+            /* a0 b0 a1 b1, a2 b2 a3 b3 -> a0 a1 b0 b1, a2 a3 b2 b3 */
+            __m128i x = _mm_shuffle_epi32(_mm_loadu_si128(s), _MM_SHUFFLE(3, 1, 2, 0));
+            __m128i y = _mm_shuffle_epi32(_mm_loadu_si128(s + 1), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_stream_si128((__m128i *)(dsts[0] + i), _mm_unpacklo_epi64(x, y));
+            _mm_stream_si128((__m128i *)(dsts[1] + i), _mm_unpackhi_epi64(x, y));
+        }
+    }
+    else if (fields == 4)
+    {
+        for (i = 0; i + 4 <= count; i += 4, s += 4)
+        {
+            /* 4x4 transpose */
+            __m128i r0 = _mm_loadu_si128(s), r1 = _mm_loadu_si128(s + 1);
+            __m128i r2 = _mm_loadu_si128(s + 2), r3 = _mm_loadu_si128(s + 3);
+            __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3);
+            __m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3);
+            _mm_stream_si128((__m128i *)(dsts[0] + i), _mm_unpacklo_epi64(t0, t1));
+            _mm_stream_si128((__m128i *)(dsts[1] + i), _mm_unpackhi_epi64(t0, t1));
+            _mm_stream_si128((__m128i *)(dsts[2] + i), _mm_unpacklo_epi64(t2, t3));
+            _mm_stream_si128((__m128i *)(dsts[3] + i), _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+    else
+    {
+        /* gather from 4 records on the cached side, to keep wide stores to the uncached one */
+        uint32_t t[4 * DMA_LAYOUT_MAX_FIELDS];
+        for (i = 0; i + 4 <= count; i += 4)
+        {
+            memcpy(t, src + i * fields * sizeof(uint32_t), 4 * fields * sizeof(uint32_t));
+            for (f = 0; f < fields; f++)
+            {
+                __m128i v = _mm_set_epi32((int)t[3 * fields + f], (int)t[2 * fields + f],
+                    (int)t[fields + f], (int)t[f]);
+                _mm_stream_si128((__m128i *)(dsts[f] + i), v);
+            }
+        }
+    }
+    _mm_sfence();
+    return count & ~(size_t)3;
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_merge(unsigned char *dst, const uint32_t *const *srcs, unsigned fields,
+    size_t count)
+{
+    __m128i *d = (__m128i *)dst;
+    size_t i;
+    unsigned f;
+
+    if (fields == 2)
+    {
+        for (i = 0; i + 4 <= count; i += 4, d += 2)
+        {
+            __m128i a = _mm_load_si128((const __m128i *)(srcs[0] + i));
+            __m128i b = _mm_load_si128((const __m128i *)(srcs[1] + i));
+            _mm_storeu_si128(d, _mm_unpacklo_epi32(a, b));
+            _mm_storeu_si128(d + 1, _mm_unpackhi_epi32(a, b));
+        }
+    }
+    else if (fields == 4)
+    {
+        for (i = 0; i + 4 <= count; i += 4, d += 4)
+        {
+            /* the transpose is its own inverse */
+            __m128i r0 = _mm_load_si128((const __m128i *)(srcs[0] + i));
+            __m128i r1 = _mm_load_si128((const __m128i *)(srcs[1] + i));
+            __m128i r2 = _mm_load_si128((const __m128i *)(srcs[2] + i));
+            __m128i r3 = _mm_load_si128((const __m128i *)(srcs[3] + i));
+            __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3);
+            __m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3);
+            _mm_storeu_si128(d, _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128(d + 1, _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128(d + 2, _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128(d + 3, _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+    else
+    {
+        uint32_t t[4 * DMA_LAYOUT_MAX_FIELDS];
+        for (i = 0; i + 4 <= count; i += 4)
+        {
+            for (f = 0; f < fields; f++)
+            {
+                uint32_t v[4];
+                _mm_storeu_si128((__m128i *)v, _mm_load_si128((const __m128i *)(srcs[f] + i)));
+                t[f] = v[0];
+                t[fields + f] = v[1];
+                t[2 * fields + f] = v[2];
+                t[3 * fields + f] = v[3];
+            }
+            memcpy(dst + i * fields * sizeof(uint32_t), t, 4 * fields * sizeof(uint32_t));
+        }
+    }
+    return count & ~(size_t)3;
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_widen(uint32_t *dst, const unsigned char *src, enum dma_narrow_type type,
+    size_t count)
+{
+    __m128i *d = (__m128i *)dst, zero = _mm_setzero_si128();
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16, d += 4)
+    {
+        __m128i lo, hi;
+        if (narrow_size(type) == 1U)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            if (type == DMA_NARROW_S8)
+            {
+                /* replicate each byte into its 16 and then 32 bits lane, shift its sign in */
+                lo = _mm_unpacklo_epi8(x, x);
+                hi = _mm_unpackhi_epi8(x, x);
+                _mm_stream_si128(d, _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 24));
+                _mm_stream_si128(d + 1, _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 24));
+                _mm_stream_si128(d + 2, _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 24));
+                _mm_stream_si128(d + 3, _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 24));
+            }
+            else
+            {
+                lo = _mm_unpacklo_epi8(x, zero);
+                hi = _mm_unpackhi_epi8(x, zero);
+                _mm_stream_si128(d, _mm_unpacklo_epi16(lo, zero));
+                _mm_stream_si128(d + 1, _mm_unpackhi_epi16(lo, zero));
+                _mm_stream_si128(d + 2, _mm_unpacklo_epi16(hi, zero));
+                _mm_stream_si128(d + 3, _mm_unpackhi_epi16(hi, zero));
+            }
+        }
+        else
+        {
+            lo = _mm_loadu_si128((const __m128i *)(src + i * 2));
+            hi = _mm_loadu_si128((const __m128i *)(src + i * 2 + 16));
+            if (type == DMA_NARROW_S16)
+            {
+                _mm_stream_si128(d, _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16));
+                _mm_stream_si128(d + 1, _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16));
+                _mm_stream_si128(d + 2, _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16));
+                _mm_stream_si128(d + 3, _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16));
+            }
+            else
+            {
+                _mm_stream_si128(d, _mm_unpacklo_epi16(lo, zero));
+                _mm_stream_si128(d + 1, _mm_unpackhi_epi16(lo, zero));
+                _mm_stream_si128(d + 2, _mm_unpacklo_epi16(hi, zero));
+                _mm_stream_si128(d + 3, _mm_unpackhi_epi16(hi, zero));
+            }
+        }
+    }
+    _mm_sfence();
+    return i;
+}
+
+/* lower 16 bits of each lane, sign-extended so that the saturating pack keeps them as they are */
+__attribute__((target("sse2")))
+static inline __m128i sse2_low16(__m128i x)
+{
+    return _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+}
+
+/* lower 8 bits of each 16 bits lane, as above */
+__attribute__((target("sse2")))
+static inline __m128i sse2_low8(__m128i x)
+{
+    return _mm_srai_epi16(_mm_slli_epi16(x, 8), 8);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_narrow(unsigned char *dst, enum dma_narrow_type type, const uint32_t *src,
+    size_t count)
+{
+    const __m128i *s = (const __m128i *)src;
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16, s += 4)
+    {
+        __m128i a = sse2_low16(_mm_load_si128(s)), b = sse2_low16(_mm_load_si128(s + 1));
+        __m128i c = sse2_low16(_mm_load_si128(s + 2)), e = sse2_low16(_mm_load_si128(s + 3));
+        __m128i lo = _mm_packs_epi32(a, b), hi = _mm_packs_epi32(c, e);
+        if (narrow_size(type) == 1U)
+        {
+            _mm_storeu_si128((__m128i *)(dst + i),
+                _mm_packs_epi16(sse2_low8(lo), sse2_low8(hi)));
+        }
+        else
+        {
+            _mm_storeu_si128((__m128i *)(dst + i * 2), lo);
+            _mm_storeu_si128((__m128i *)(dst + i * 2 + 16), hi);
+        }
+    }
+    return i;
+}
+
+#endif /* LAYOUT_X86 */
+
+#ifdef LAYOUT_NEON
+
+/*
+ * ------ ARM implementation: structured NEON loads and stores, in dma_layout_neon.c ------
+ */
+
+static int neon_available(void)
+{
+#ifdef __aarch64__
+    return 1;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+
+#endif /* LAYOUT_NEON */
+
+/* ordered from the least to the most preferred */
+static const struct layout_impl impls[] = {
+    { "scalar", always_available, scalar_split, scalar_merge, scalar_widen, scalar_narrow },
+#ifdef LAYOUT_NEON
+    { "neon", neon_available, dma_layout_neon_split, dma_layout_neon_merge,
+        dma_layout_neon_widen, dma_layout_neon_narrow },
+#endif
+#ifdef LAYOUT_X86
+    { "sse2", sse2_available, sse2_split, sse2_merge, sse2_widen, sse2_narrow },
+#endif
+};
+
+#define NUM_IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+static const struct layout_impl *current_impl;
+
+static const struct layout_impl *get_impl(void)
+{
+    if (current_impl == NULL)
+    {
+        unsigned i;
+        const struct layout_impl *best = impls;
+#ifdef LAYOUT_X86
+        __builtin_cpu_init();
+#endif
+        for (i = 1; i < NUM_IMPLS; i++)
+        {
+            if (impls[i].available())
+            {
+                best = impls + i;
+            }
+        }
+        current_impl = best;
+    }
+    return current_impl;
+}
+
+const char *udmabuf_layout_impl(void)
+{
+    return get_impl()->name;
+}
+
+int udmabuf_layout_select(const char *name)
+{
+    unsigned i;
+#ifdef LAYOUT_X86
+    __builtin_cpu_init();
+#endif
+    for (i = 0; i < NUM_IMPLS; i++)
+    {
+        if (strcmp(impls[i].name, name) == 0 && impls[i].available())
+        {
+            current_impl = impls + i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * heads up to the alignment of the uncached side and tails are converted by the scalar loops
+ */
+
+/* 32 bits values before @p uncached is aligned for the vector loops */
+static size_t head_count(const void *uncached, size_t count)
+{
+    size_t head = (VEC_ALIGN - ((uintptr_t)uncached % VEC_ALIGN)) % VEC_ALIGN / sizeof(uint32_t);
+    return head < count ? head : count;
+}
+
+/* pointers to value @p index of each field */
+static void field_pointers(uint32_t **out, const void *const *fields_base, unsigned fields,
+    size_t index)
+{
+    unsigned f;
+    for (f = 0; f < fields; f++)
+    {
+        out[f] = (uint32_t *)fields_base[f] + index;
+    }
+}
+
+static int fields_aligned(uint32_t *const *ptrs, unsigned fields)
+{
+    unsigned f;
+    for (f = 0; f < fields; f++)
+    {
+        if ((uintptr_t)ptrs[f] % VEC_ALIGN != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* split via the cached bounce buffer, for fields of different alignments */
+static size_t bounce_split(const struct layout_impl *impl, uint32_t *const *dsts,
+    const unsigned char *src, unsigned fields, size_t count)
+{
+    uint32_t bounce[DMA_LAYOUT_MAX_FIELDS][BOUNCE_COUNT] __attribute__((aligned(VEC_ALIGN)));
+    uint32_t *b[DMA_LAYOUT_MAX_FIELDS];
+    size_t done = 0;
+    unsigned f;
+
+    for (f = 0; f < fields; f++)
+    {
+        b[f] = bounce[f];
+    }
+    while (done < count)
+    {
+        size_t chunk = count - done < BOUNCE_COUNT ? count - done : BOUNCE_COUNT;
+        size_t n = impl->split(b, src + done * fields * sizeof(uint32_t), fields, chunk);
+        for (f = 0; f < fields; f++)
+        {
+            copy_to_uncached(dsts[f] + done, bounce[f], n * sizeof(uint32_t));
+        }
+        done += n;
+        if (n < chunk)
+        {
+            break;
+        }
+    }
+    return done;
+}
+
+static size_t bounce_merge(const struct layout_impl *impl, unsigned char *dst,
+    uint32_t *const *srcs, unsigned fields, size_t count)
+{
+    uint32_t bounce[DMA_LAYOUT_MAX_FIELDS][BOUNCE_COUNT] __attribute__((aligned(VEC_ALIGN)));
+    const uint32_t *b[DMA_LAYOUT_MAX_FIELDS];
+    size_t done = 0;
+    unsigned f;
+
+    for (f = 0; f < fields; f++)
+    {
+        b[f] = bounce[f];
+    }
+    while (done < count)
+    {
+        size_t chunk = count - done < BOUNCE_COUNT ? count - done : BOUNCE_COUNT, n;
+        for (f = 0; f < fields; f++)
+        {
+            copy_from_uncached(bounce[f], srcs[f] + done, chunk * sizeof(uint32_t));
+        }
+        n = impl->merge(dst + done * fields * sizeof(uint32_t), b, fields, chunk);
+        done += n;
+        if (n < chunk)
+        {
+            break;
+        }
+    }
+    return done;
+}
+
+int split_to_uncached(void *const *dsts, const void *src, unsigned fields, size_t count)
+{
+    const struct layout_impl *impl = get_impl();
+    const unsigned char *s = (const unsigned char *)src;
+    size_t record = fields * sizeof(uint32_t), head, done;
+    uint32_t *d[DMA_LAYOUT_MAX_FIELDS];
+
+    if (fields == 0 || fields > DMA_LAYOUT_MAX_FIELDS)
+    {
+        return -1;
+    }
+    head = head_count(dsts[0], count);
+    field_pointers(d, (const void *const *)dsts, fields, 0);
+    scalar_split(d, s, fields, head);
+
+    field_pointers(d, (const void *const *)dsts, fields, head);
+    if (fields_aligned(d, fields))
+    {
+        done = head + impl->split(d, s + head * record, fields, count - head);
+    }
+    else
+    {
+        done = head + bounce_split(impl, d, s + head * record, fields, count - head);
+    }
+
+    field_pointers(d, (const void *const *)dsts, fields, done);
+    scalar_split(d, s + done * record, fields, count - done);
+    return 0;
+}
+
+int merge_from_uncached(void *dst, const void *const *srcs, unsigned fields, size_t count)
+{
+    const struct layout_impl *impl = get_impl();
+    unsigned char *d = (unsigned char *)dst;
+    size_t record = fields * sizeof(uint32_t), head, done;
+    uint32_t *s[DMA_LAYOUT_MAX_FIELDS];
+
+    if (fields == 0 || fields > DMA_LAYOUT_MAX_FIELDS)
+    {
+        return -1;
+    }
+    head = head_count(srcs[0], count);
+    field_pointers(s, srcs, fields, 0);
+    scalar_merge(d, (const uint32_t *const *)s, fields, head);
+
+    field_pointers(s, srcs, fields, head);
+    if (fields_aligned(s, fields))
+    {
+        done = head + impl->merge(d + head * record, (const uint32_t *const *)s, fields,
+            count - head);
+    }
+    else
+    {
+        done = head + bounce_merge(impl, d + head * record, s, fields, count - head);
+    }
+
+    field_pointers(s, srcs, fields, done);
+    scalar_merge(d + done * record, (const uint32_t *const *)s, fields, count - done);
+    return 0;
+}
+
+void widen_to_uncached(void *dst, const void *src, enum dma_narrow_type type, size_t count)
+{
+    uint32_t *d = (uint32_t *)dst;
+    const unsigned char *s = (const unsigned char *)src;
+    size_t size = narrow_size(type), head = head_count(d, count), done;
+
+    scalar_widen(d, s, type, head);
+    done = head + get_impl()->widen(d + head, s + head * size, type, count - head);
+    scalar_widen(d + done, s + done * size, type, count - done);
+}
+
+void narrow_from_uncached(void *dst, enum dma_narrow_type type, const void *src, size_t count)
+{
+    unsigned char *d = (unsigned char *)dst;
+    const uint32_t *s = (const uint32_t *)src;
+    size_t size = narrow_size(type), head = head_count(s, count), done;
+
+    scalar_narrow(d, type, s, head);
+    done = head + get_impl()->narrow(d + head * size, type, s + head, count - head);
+    scalar_narrow(d + done * size, type, s + done, count - done);
+}
+
+int udmabuf_split_in(struct udmabuf *bufs, unsigned offset, const void *src, unsigned fields,
+    size_t count)
+{
+    void *dsts[DMA_LAYOUT_MAX_FIELDS];
+    unsigned f;
+
+    if (fields == 0 || fields > DMA_LAYOUT_MAX_FIELDS)
+    {
+        return -1;
+    }
+    for (f = 0; f < fields; f++)
+    {
+        dsts[f] = (char *)bufs[f].vaddr + offset;
+    }
+    return split_to_uncached(dsts, src, fields, count);
+}
+
+int udmabuf_merge_out(void *dst, struct udmabuf *bufs, unsigned offset, unsigned fields,
+    size_t count)
+{
+    const void *srcs[DMA_LAYOUT_MAX_FIELDS];
+    unsigned f;
+
+    if (fields == 0 || fields > DMA_LAYOUT_MAX_FIELDS)
+    {
+        return -1;
+    }
+    for (f = 0; f < fields; f++)
+    {
+        srcs[f] = (const char *)bufs[f].vaddr + offset;
+    }
+    return merge_from_uncached(dst, srcs, fields, count);
+}
+
+void udmabuf_widen_in(struct udmabuf *buf, unsigned offset, const void *src,
+    enum dma_narrow_type type, size_t count)
+{
+    widen_to_uncached((char *)buf->vaddr + offset, src, type, count);
+}
+
+void udmabuf_narrow_out(void *dst, enum dma_narrow_type type, struct udmabuf *buf,
+    unsigned offset, size_t count)
+{
+    narrow_from_uncached(dst, type, (const char *)buf->vaddr + offset, count);
+}
@@ -0,0 +1,118 @@
+
+#ifndef DMA_LAYOUT_H_
+#define DMA_LAYOUT_H_
+
+/**
+ * @file dma_layout.h
+ * @author Alberto Scolari
+ * @brief Header with routines converting data layouts on their way into and out of UDMA buffers.
+ *
+ * Kernels with several input streams, like the 2D Vector Sum, take each field of the records
+ * as a separate stream from its own buffer, while applications usually keep arrays of records
+ * (array of structs): the split routines de-interleave records of 32 bits fields directly into
+ * the buffer of each field, and the merge routines interleave the fields of results back into
+ * records. Similarly, kernels work on 32 bits lanes while data may come as 8 or 16 bits
+ * integers: the widen routines extend them into 32 bits lanes, and the narrow routines
+ * truncate 32 bits results back.
+ *
+ * As the copy routines in dma_copy.h, these routines access UDMA memory with aligned accesses
+ * as wide as the CPU allows (NEON on ARM, SSE2 on x86), de-interleaving and converting in
+ * registers, with the implementation chosen at runtime according to the CPU capabilities.
+ * Offsets into UDMA buffers must be multiples of 4 bytes. When the fields of a record do not
+ * share the same alignment within their buffers, they go through a small cached buffer.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "dma_engine_buf.h"
+
+/**
+ * @brief largest number of fields per record of the split and merge routines
+ */
+#define DMA_LAYOUT_MAX_FIELDS 8U
+
+/**
+ * @brief The dma_narrow_type enum lists the narrow integer types converted to and from
+ * 32 bits lanes
+ */
+enum dma_narrow_type {
+    DMA_NARROW_S8, /**< int8_t, sign-extended */
+    DMA_NARROW_U8, /**< uint8_t, zero-extended */
+    DMA_NARROW_S16, /**< int16_t, sign-extended */
+    DMA_NARROW_U16 /**< uint16_t, zero-extended */
+};
+
+/**
+ * @brief udmabuf_split_in de-interleaves @p count records of @p fields 32 bits words from
+ * @p src (cached memory): field i of each record goes into @p bufs[i] from @p offset
+ * @return 0 for success, non-0 if @p fields is 0 or above @ref DMA_LAYOUT_MAX_FIELDS
+ */
+int udmabuf_split_in(struct udmabuf *bufs, unsigned offset, const void *src, unsigned fields,
+    size_t count);
+
+/**
+ * @brief udmabuf_merge_out interleaves @p count values of @p fields buffers, each from
+ * @p offset, into records of @p fields 32 bits words in @p dst (cached memory); it is the
+ * reverse of @ref udmabuf_split_in
+ * @return 0 for success, non-0 if @p fields is 0 or above @ref DMA_LAYOUT_MAX_FIELDS
+ */
+int udmabuf_merge_out(void *dst, struct udmabuf *bufs, unsigned offset, unsigned fields,
+    size_t count);
+
+/**
+ * @brief udmabuf_widen_in extends @p count integers of @p type from @p src (cached memory)
+ * into 32 bits lanes of @p buf from @p offset
+ */
+void udmabuf_widen_in(struct udmabuf *buf, unsigned offset, const void *src,
+    enum dma_narrow_type type, size_t count);
+
+/**
+ * @brief udmabuf_narrow_out truncates @p count 32 bits lanes of @p buf from @p offset into
+ * integers of @p type in @p dst (cached memory), keeping their lower bits as C casts do
+ */
+void udmabuf_narrow_out(void *dst, enum dma_narrow_type type, struct udmabuf *buf,
+    unsigned offset, size_t count);
+
+/**
+ * @brief split_to_uncached is the pointer-based version of @ref udmabuf_split_in, with a
+ * destination per field in @p dsts (uncached memory)
+ */
+int split_to_uncached(void *const *dsts, const void *src, unsigned fields, size_t count);
+
+/**
+ * @brief merge_from_uncached is the pointer-based version of @ref udmabuf_merge_out, with a
+ * source per field in @p srcs (uncached memory)
+ */
+int merge_from_uncached(void *dst, const void *const *srcs, unsigned fields, size_t count);
+
+/**
+ * @brief widen_to_uncached is the pointer-based version of @ref udmabuf_widen_in
+ */
+void widen_to_uncached(void *dst, const void *src, enum dma_narrow_type type, size_t count);
+
+/**
+ * @brief narrow_from_uncached is the pointer-based version of @ref udmabuf_narrow_out
+ */
+void narrow_from_uncached(void *dst, enum dma_narrow_type type, const void *src, size_t count);
+
+/**
+ * @brief udmabuf_layout_impl returns the name of the implementation in use
+ * ("scalar", "neon" or "sse2")
+ */
+const char *udmabuf_layout_impl(void);
+
+/**
+ * @brief udmabuf_layout_select forces the implementation named @p name, e.g. for benchmarking
+ * @return 0 for success, non-0 if the implementation is not available on this CPU
+ */
+int udmabuf_layout_select(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_LAYOUT_H_ */
@@ -0,0 +1,200 @@
+/**
+ * @file dma_layout_neon.c
+ * @author Alberto Scolari
+ * @brief Implementation of the NEON loops of dma_layout.c: structured NEON loads and stores.
+ */
+
+#include <string.h>
+
+#include "layout_internals.h"
+
+#ifdef LAYOUT_NEON
+#include <arm_neon.h>
+
+size_t dma_layout_neon_split(uint32_t *const *dsts, const unsigned char *src, unsigned fields,
+    size_t count)
+{
+    const uint32_t *s = (const uint32_t *)src;
+    size_t i;
+    unsigned f;
+
+    if (fields == 2)
+    {
+        for (i = 0; i + 4 <= count; i += 4, s += 8)
+        {
+            uint32x4x2_t v = vld2q_u32(s);
+            vst1q_u32(dsts[0] + i, v.val[0]);
+            vst1q_u32(dsts[1] + i, v.val[1]);
+        }
+    }
+    else if (fields == 3)
+    {
+        for (i = 0; i + 4 <= count; i += 4, s += 12)
+        {
+            uint32x4x3_t v = vld3q_u32(s);
+            vst1q_u32(dsts[0] + i, v.val[0]);
+            vst1q_u32(dsts[1] + i, v.val[1]);
+            vst1q_u32(dsts[2] + i, v.val[2]);
+        }
+    }
+    else if (fields == 4)
+    {
+        for (i = 0; i + 4 <= count; i += 4, s += 16)
+        {
+            uint32x4x4_t v = vld4q_u32(s);
+            vst1q_u32(dsts[0] + i, v.val[0]);
+            vst1q_u32(dsts[1] + i, v.val[1]);
+            vst1q_u32(dsts[2] + i, v.val[2]);
+            vst1q_u32(dsts[3] + i, v.val[3]);
+        }
+    }
+    else
+    {
+        uint32_t t[4 * DMA_LAYOUT_MAX_FIELDS];
+        for (i = 0; i + 4 <= count; i += 4)
+        {
+            memcpy(t, src + i * fields * sizeof(uint32_t), 4 * fields * sizeof(uint32_t));
+            for (f = 0; f < fields; f++)
+            {
+                uint32_t v[4] = { t[f], t[fields + f], t[2 * fields + f], t[3 * fields + f] };
+                vst1q_u32(dsts[f] + i, vld1q_u32(v));
+            }
+        }
+    }
+    return count & ~(size_t)3;
+}
+
+size_t dma_layout_neon_merge(unsigned char *dst, const uint32_t *const *srcs, unsigned fields,
+    size_t count)
+{
+    uint32_t *d = (uint32_t *)dst;
+    size_t i;
+    unsigned f;
+
+    if (fields == 2)
+    {
+        for (i = 0; i + 4 <= count; i += 4, d += 8)
+        {
+            uint32x4x2_t v;
+            v.val[0] = vld1q_u32(srcs[0] + i);
+            v.val[1] = vld1q_u32(srcs[1] + i);
+            vst2q_u32(d, v);
+        }
+    }
+    else if (fields == 3)
+    {
+        for (i = 0; i + 4 <= count; i += 4, d += 12)
+        {
+            uint32x4x3_t v;
+            v.val[0] = vld1q_u32(srcs[0] + i);
+            v.val[1] = vld1q_u32(srcs[1] + i);
+            v.val[2] = vld1q_u32(srcs[2] + i);
+            vst3q_u32(d, v);
+        }
+    }
+    else if (fields == 4)
+    {
+        for (i = 0; i + 4 <= count; i += 4, d += 16)
+        {
+            uint32x4x4_t v;
+            v.val[0] = vld1q_u32(srcs[0] + i);
+            v.val[1] = vld1q_u32(srcs[1] + i);
+            v.val[2] = vld1q_u32(srcs[2] + i);
+            v.val[3] = vld1q_u32(srcs[3] + i);
+            vst4q_u32(d, v);
+        }
+    }
+    else
+    {
+        uint32_t t[4 * DMA_LAYOUT_MAX_FIELDS];
+        for (i = 0; i + 4 <= count; i += 4)
+        {
+            for (f = 0; f < fields; f++)
+            {
+                uint32_t v[4];
+                vst1q_u32(v, vld1q_u32(srcs[f] + i));
+                t[f] = v[0];
+                t[fields + f] = v[1];
+                t[2 * fields + f] = v[2];
+                t[3 * fields + f] = v[3];
+            }
+            memcpy(dst + i * fields * sizeof(uint32_t), t, 4 * fields * sizeof(uint32_t));
+        }
+    }
+    return count & ~(size_t)3;
+}
+
+size_t dma_layout_neon_widen(uint32_t *dst, const unsigned char *src, enum dma_narrow_type type,
+    size_t count)
+{
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        uint32_t *d = dst + i;
+        if (type == DMA_NARROW_S8 || type == DMA_NARROW_S16)
+        {
+            int16x8_t lo, hi;
+            if (type == DMA_NARROW_S8)
+            {
+                int8x16_t x = vld1q_s8((const int8_t *)(src + i));
+                lo = vmovl_s8(vget_low_s8(x));
+                hi = vmovl_s8(vget_high_s8(x));
+            }
+            else
+            {
+                lo = vld1q_s16((const int16_t *)(src + i * 2));
+                hi = vld1q_s16((const int16_t *)(src + i * 2 + 16));
+            }
+            vst1q_u32(d, vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(lo))));
+            vst1q_u32(d + 4, vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(lo))));
+            vst1q_u32(d + 8, vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(hi))));
+            vst1q_u32(d + 12, vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(hi))));
+        }
+        else
+        {
+            uint16x8_t lo, hi;
+            if (type == DMA_NARROW_U8)
+            {
+                uint8x16_t x = vld1q_u8(src + i);
+                lo = vmovl_u8(vget_low_u8(x));
+                hi = vmovl_u8(vget_high_u8(x));
+            }
+            else
+            {
+                lo = vld1q_u16((const uint16_t *)(src + i * 2));
+                hi = vld1q_u16((const uint16_t *)(src + i * 2 + 16));
+            }
+            vst1q_u32(d, vmovl_u16(vget_low_u16(lo)));
+            vst1q_u32(d + 4, vmovl_u16(vget_high_u16(lo)));
+            vst1q_u32(d + 8, vmovl_u16(vget_low_u16(hi)));
+            vst1q_u32(d + 12, vmovl_u16(vget_high_u16(hi)));
+        }
+    }
+    return i;
+}
+
+size_t dma_layout_neon_narrow(unsigned char *dst, enum dma_narrow_type type, const uint32_t *src,
+    size_t count)
+{
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        const uint32_t *s = src + i;
+        uint16x8_t lo = vcombine_u16(vmovn_u32(vld1q_u32(s)), vmovn_u32(vld1q_u32(s + 4)));
+        uint16x8_t hi = vcombine_u16(vmovn_u32(vld1q_u32(s + 8)), vmovn_u32(vld1q_u32(s + 12)));
+        if (narrow_size(type) == 1U)
+        {
+            vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+        }
+        else
+        {
+            vst1q_u16((uint16_t *)(dst + i * 2), lo);
+            vst1q_u16((uint16_t *)(dst + i * 2 + 16), hi);
+        }
+    }
+    return i;
+}
+
+#endif /* LAYOUT_NEON */
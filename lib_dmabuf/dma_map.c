@@ -0,0 +1,121 @@
+
+/**
+ * @file dma_map.c
+ * @author Alberto Scolari
+ * @brief Implementation of the mapping policy for UDMA buffers and register areas.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "map_internals.h"
+
+/* alignment of large mappings, for the driver to possibly use block mappings */
+#define HUGE_MAP_ALIGN (2UL * 1024UL * 1024UL)
+
+static unsigned mapping_policy = DMA_MAP_DEFAULT;
+
+void set_mapping_policy(unsigned flags)
+{
+    mapping_policy = flags;
+}
+
+unsigned get_mapping_policy(void)
+{
+    return mapping_policy;
+}
+
+/*
+ * reserve an address range aligned to HUGE_MAP_ALIGN, to be replaced by the actual mapping
+ */
+static void *reserve_aligned(size_t length)
+{
+    char *base, *aligned;
+    size_t head, tail;
+
+    base = mmap(NULL, length + HUGE_MAP_ALIGN, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+    aligned = (char *)(((uintptr_t)base + HUGE_MAP_ALIGN - 1) & ~(uintptr_t)(HUGE_MAP_ALIGN - 1));
+    head = (size_t)(aligned - base);
+    tail = HUGE_MAP_ALIGN - head;
+    if (head != 0)
+    {
+        munmap(base, head);
+    }
+    if (tail != 0)
+    {
+        munmap(aligned + length, tail);
+    }
+    return aligned;
+}
+
+/*
+ * read one word per page, so that mappings whose driver does not honour MAP_POPULATE
+ * are faulted in anyway
+ */
+static void touch_pages(void *addr, size_t length)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE), i;
+    for (i = 0; i < length; i += page)
+    {
+        (void)*((volatile uint32_t *)((char *)addr + i));
+    }
+}
+
+void *map_device_memory(int fd, size_t length, off_t offset, int prefault)
+{
+    int flags = MAP_SHARED;
+    void *hint = NULL, *addr;
+
+    if (mapping_policy & DMA_MAP_POPULATE)
+    {
+        flags |= MAP_POPULATE;
+    }
+    if ((mapping_policy & DMA_MAP_HUGE) && length >= HUGE_MAP_ALIGN)
+    {
+        hint = reserve_aligned(length);
+        if (hint != NULL)
+        {
+            flags |= MAP_FIXED;
+        }
+    }
+    addr = mmap(hint, length, PROT_READ | PROT_WRITE, flags, fd, offset);
+    if (addr == MAP_FAILED)
+    {
+        if (hint != NULL)
+        {
+            munmap(hint, length);
+        }
+        return MAP_FAILED;
+    }
+    if (hint != NULL)
+    {
+        /* best effort: most drivers ignore it */
+        madvise(addr, length, MADV_HUGEPAGE);
+    }
+    if ((mapping_policy & DMA_MAP_POPULATE) && prefault)
+    {
+        touch_pages(addr, length);
+    }
+    if ((mapping_policy & DMA_MAP_LOCK) && mlock(addr, length) != 0)
+    {
+        printf("%s: cannot lock mapping of %lu bytes\n", __func__, (unsigned long)length);
+    }
+    return addr;
+}
+
+void unmap_device_memory(void *addr, size_t length)
+{
+    if (mapping_policy & DMA_MAP_LOCK)
+    {
+        munlock(addr, length);
+    }
+    munmap(addr, length);
+}
@@ -0,0 +1,330 @@
+
+/**
+ * @file dma_mcdma.c
+ * @author Alberto Scolari
+ * @brief Implementation of per-channel descriptor rings for AXI Multichannel DMA engines.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dma_mcdma.h"
+#include "xhw_internals.h"
+#include "wait_internals.h"
+#include "map_internals.h"
+
+#define LINUX_MEM_DEV "/dev/mem"
+
+/* largest length the buffer length field of descriptors can hold */
+#define MAX_MCDMA_LENGTH ((1U << 26) - 1U)
+
+static volatile struct axi_mcdma_common_regs *common_regs(struct mcdma_engine *engine,
+    enum mcdma_direction dir)
+{
+    volatile struct axi_mcdma_regs *regs = (volatile struct axi_mcdma_regs *)engine->regs_vaddr;
+    return dir == MCDMA_TO_DEVICE ? &regs->mm2s_common : &regs->s2mm_common;
+}
+
+static volatile struct axi_mcdma_channel_regs *channel_regs(struct mcdma_engine *engine,
+    enum mcdma_direction dir, unsigned channel)
+{
+    volatile struct axi_mcdma_regs *regs = (volatile struct axi_mcdma_regs *)engine->regs_vaddr;
+    return dir == MCDMA_TO_DEVICE ? regs->mm2s_channels + channel : regs->s2mm_channels + channel;
+}
+
+static struct mcdma_channel *get_channel(struct mcdma_engine *engine,
+    enum mcdma_direction dir, unsigned channel)
+{
+    if (channel >= MCDMA_MAX_CHANNELS)
+    {
+        return NULL;
+    }
+    return dir == MCDMA_TO_DEVICE ? engine->to_dev + channel : engine->from_dev + channel;
+}
+
+/* the channels must be set again afterwards */
+static int mcdma_engine_init(struct mcdma_engine *engine)
+{
+    volatile struct axi_mcdma_regs *regs = (volatile struct axi_mcdma_regs *)engine->regs_vaddr;
+
+    /* reset everything, no interrupt mode, all channels disabled */
+    memset(engine->to_dev, 0, sizeof(engine->to_dev));
+    memset(engine->from_dev, 0, sizeof(engine->from_dev));
+    regs->mm2s_common.control = 4;
+    if (dma_reset_done(&regs->mm2s_common.control) != 0)
+    {
+        printf("%s: MM2S side of the MCDMA engine does not complete its reset\n", __func__);
+        return -1;
+    }
+    regs->s2mm_common.control = 4;
+    if (dma_reset_done(&regs->s2mm_common.control) != 0)
+    {
+        printf("%s: S2MM side of the MCDMA engine does not complete its reset\n", __func__);
+        return -1;
+    }
+
+    regs->mm2s_common.channel_enable = 0;
+    regs->s2mm_common.channel_enable = 0;
+    regs->mm2s_common.sched_type = AXI_MCDMA_SCHED_RR;
+    SET_BIT(regs->mm2s_common.control, 0);
+    SET_BIT(regs->s2mm_common.control, 0);
+    __mmio_wmb();
+    return 0;
+}
+
+int get_mcdma_interfaces(unsigned num_mcdma, phys_addr_t *offsets,
+    unsigned *lengths, struct mcdma_engine *engines)
+{
+    char *result;
+    int fd;
+    unsigned i;
+
+    fd = open(LINUX_MEM_DEV, O_RDWR | O_SYNC);
+    if (fd == -1)
+    {
+        printf("%s: impossible to open %s\n", __func__, LINUX_MEM_DEV);
+        return -1;
+    }
+
+    for(i = 0; i < num_mcdma; i++) {
+        phys_addr_t __offset = offsets == NULL ? AXI_MCDMA_REGISTER_LOCATION : offsets[i];
+        unsigned __length = lengths == NULL ? DESCRIPTOR_REGISTERS_SIZE : lengths[i];
+
+        engines[i].fd = fd;
+        engines[i].regs_vaddr = result = map_device_memory(fd, __length, __offset, 0);
+        engines[i].length = __length;
+        if ( result == MAP_FAILED )
+        {
+            printf("%s: impossible to mmap %s\n", __func__, LINUX_MEM_DEV);
+        } else if (mcdma_engine_init(engines + i) != 0)
+        {
+            printf("%s: MCDMA engine at 0x%llx is not usable\n", __func__,
+                (unsigned long long)__offset);
+            unmap_device_memory(result, __length);
+            result = MAP_FAILED;
+        }
+        if ( result == MAP_FAILED )
+        {
+            unsigned j;
+            for( j = 0; j < i; j++) {
+                unmap_device_memory((void*)engines[j].regs_vaddr, engines[j].length);
+            }
+            close(fd);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void destroy_mcdma_interfaces(unsigned num_mcdma, struct mcdma_engine *engines)
+{
+    unsigned i;
+    for( i = 0; i < num_mcdma; i++) {
+        unmap_device_memory((void*)engines[i].regs_vaddr, engines[i].length);
+    }
+    if (num_mcdma > 0)
+    {
+        /* all engines share the same file descriptor */
+        close(engines[0].fd);
+    }
+}
+
+enum dma_err_status reset_mcdma_engine(struct mcdma_engine *engine)
+{
+    return mcdma_engine_init(engine) == 0 ? DMA_ENGINE_RESET : DMA_ENGINE_HUNG;
+}
+
+static phys_addr_t desc_paddr(struct mcdma_channel *ch, unsigned index)
+{
+    return ch->desc_buf->paddr + ch->desc_offset + index * AXI_MCDMA_SG_DESC_ALIGN;
+}
+
+static volatile struct axi_mcdma_sg_desc *desc_vaddr(struct mcdma_channel *ch, unsigned index)
+{
+    return (volatile struct axi_mcdma_sg_desc *)((char *)ch->desc_buf->vaddr
+        + ch->desc_offset + index * AXI_MCDMA_SG_DESC_ALIGN);
+}
+
+int set_mcdma_channel(struct mcdma_engine *engine, enum mcdma_direction dir, unsigned channel,
+    struct udmabuf *desc_buf, unsigned desc_offset, unsigned num_descs)
+{
+    struct mcdma_channel *ch = get_channel(engine, dir, channel);
+    volatile struct axi_mcdma_channel_regs *regs;
+    phys_addr_t first;
+    unsigned i;
+
+    if (ch == NULL || num_descs < 2 || (desc_buf->paddr + desc_offset) % AXI_MCDMA_SG_DESC_ALIGN != 0
+        || desc_offset + (unsigned long)num_descs * AXI_MCDMA_SG_DESC_ALIGN > desc_buf->size)
+    {
+        printf("%s: invalid channel or descriptor ring\n", __func__);
+        return -1;
+    }
+    if (ch->count > 0)
+    {
+        printf("%s: channel %u has transfers in flight\n", __func__, channel);
+        return -1;
+    }
+    ch->desc_buf = desc_buf;
+    ch->desc_offset = desc_offset;
+    ch->num_descs = num_descs;
+    ch->head = 0;
+    ch->count = 0;
+
+    /* chain the descriptors into a ring */
+    for (i = 0; i < num_descs; i++)
+    {
+        volatile struct axi_mcdma_sg_desc *desc = desc_vaddr(ch, i);
+        phys_addr_t next = desc_paddr(ch, (i + 1) % num_descs);
+
+        memset((void *)desc, 0, sizeof(*desc));
+        desc->next_desc_low = (uint32_t)next;
+        desc->next_desc_high = (uint32_t)(next >> 32);
+    }
+
+    /* the current descriptor can be written only while the channel does not fetch */
+    regs = channel_regs(engine, dir, channel);
+    UNSET_BIT(regs->control, 0);
+    __mmio_wmb();
+    first = desc_paddr(ch, 0);
+    regs->cur_desc_low = (uint32_t)first;
+    regs->cur_desc_high = (uint32_t)(first >> 32);
+    SET_BIT(common_regs(engine, dir)->channel_enable, channel);
+    /* the ring must be in memory once the channel may fetch from it */
+    __doorbell_barrier();
+    SET_BIT(regs->control, 0);
+    return 0;
+}
+
+void set_mcdma_weights(struct mcdma_engine *engine, const unsigned *weights, unsigned num_weights)
+{
+    volatile struct axi_mcdma_common_regs *common = common_regs(engine, MCDMA_TO_DEVICE);
+    uint32_t wrr[2] = { 0, 0 };
+    unsigned i;
+
+    if (weights == NULL)
+    {
+        common->sched_type = AXI_MCDMA_SCHED_RR;
+        return;
+    }
+    for (i = 0; i < num_weights && i < MCDMA_MAX_CHANNELS; i++)
+    {
+        unsigned w = weights[i] > 15 ? 15 : weights[i];
+        SET_BITFIELD(wrr[i / 8], (i % 8) * 4, (i % 8) * 4 + 3, w);
+    }
+    common->wrr_weights[0] = wrr[0];
+    common->wrr_weights[1] = wrr[1];
+    common->sched_type = AXI_MCDMA_SCHED_WRR;
+    __mmio_wmb();
+}
+
+enum dma_err_status submit_mcdma_transfer(struct mcdma_engine *engine, enum mcdma_direction dir,
+    unsigned channel, struct udmabuf *buf, unsigned offset, unsigned length)
+{
+    struct mcdma_channel *ch = get_channel(engine, dir, channel);
+    volatile struct axi_mcdma_channel_regs *regs;
+    volatile struct axi_mcdma_sg_desc *desc;
+    phys_addr_t addr = buf->paddr + offset, tail_addr;
+    unsigned tail;
+
+    if (ch == NULL || ch->num_descs == 0 || length == 0 || length > MAX_MCDMA_LENGTH)
+    {
+        return DMA_TRANS_NOT_PROGRAMMED;
+    }
+    if (ch->count == ch->num_descs - 1)
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    tail = (ch->head + ch->count) % ch->num_descs;
+    desc = desc_vaddr(ch, tail);
+    desc->buffer_addr_low = (uint32_t)addr;
+    desc->buffer_addr_high = (uint32_t)(addr >> 32);
+    /* towards the device, each transfer is a whole packet (SOF and EOF) */
+    desc->control = dir == MCDMA_TO_DEVICE ? (length | (1U << 31) | (1U << 30)) : length;
+    desc->words[0] = 0;
+    desc->words[1] = 0;
+
+    /* writing the tail descriptor lets the engine process it */
+    regs = channel_regs(engine, dir, channel);
+    tail_addr = desc_paddr(ch, tail);
+    regs->tail_desc_high = (uint32_t)(tail_addr >> 32);
+    /* the descriptor must be in memory before the engine fetches it */
+    __doorbell_barrier();
+    regs->tail_desc_low = (uint32_t)tail_addr;
+    ch->count++;
+    return NO_ERROR;
+}
+
+enum dma_err_status poll_mcdma_completion(struct mcdma_engine *engine, enum mcdma_direction dir,
+    unsigned channel, struct mcdma_completion *compl)
+{
+    struct mcdma_channel *ch = get_channel(engine, dir, channel);
+    uint32_t status;
+
+    if (ch == NULL || ch->count == 0)
+    {
+        return DMA_TRANS_NOT_STARTED;
+    }
+    status = desc_vaddr(ch, ch->head)->words[dir == MCDMA_TO_DEVICE ?
+        AXI_MCDMA_MM2S_STATUS : AXI_MCDMA_S2MM_STATUS];
+    if ( !BIT(status, 31) )
+    {
+        /* an engine halted on an error never completes the descriptor */
+        if (BIT(channel_regs(engine, dir, channel)->status, 7)
+            || BIT(common_regs(engine, dir)->status, 0))
+        {
+            return DMA_TRANS_ERROR;
+        }
+        return DMA_TRANS_RUNNING;
+    }
+    /* the data of a completed descriptor is read after its status */
+    __mmio_rmb();
+    compl->desc = ch->head;
+    compl->length = BITFIELD(status, 0, 25);
+    compl->err_mask = BITFIELD(status, 28, 30);
+    ch->head = (ch->head + 1) % ch->num_descs;
+    ch->count--;
+    return NO_ERROR;
+}
+
+enum dma_err_status wait_mcdma_completion(struct mcdma_engine *engine, enum mcdma_direction dir,
+    unsigned channel, struct mcdma_completion *compl, unsigned usleep_timeout)
+{
+    return wait_mcdma_completion_until(engine, dir, channel, compl, usleep_timeout,
+        DMA_NO_DEADLINE);
+}
+
+enum dma_err_status wait_mcdma_completion_until(struct mcdma_engine *engine,
+    enum mcdma_direction dir, unsigned channel, struct mcdma_completion *compl,
+    unsigned usleep_timeout, uint64_t deadline_ns)
+{
+    enum dma_err_status err;
+
+    while ( (err = poll_mcdma_completion(engine, dir, channel, compl)) == DMA_TRANS_RUNNING ) {
+        if (deadline_ns != DMA_NO_DEADLINE && dma_stats_now() >= deadline_ns) {
+            return DMA_TRANS_TIMEOUT;
+        }
+        if (usleep_timeout != 0) {
+            usleep_nano(usleep_timeout);
+        }
+    }
+    return err;
+}
+
+unsigned err_status_mcdma(struct mcdma_engine *engine, enum mcdma_direction dir, unsigned channel)
+{
+    if (channel >= MCDMA_MAX_CHANNELS)
+    {
+        return 0;
+    }
+    /* the error register is shared among channels: report it for the channel that raised it */
+    if ( !BIT(channel_regs(engine, dir, channel)->status, 7) )
+    {
+        return 0;
+    }
+    return BITFIELD(common_regs(engine, dir)->error, 0, 6);
+}
@@ -0,0 +1,203 @@
+
+#ifndef DMA_MCDMA_H_
+#define DMA_MCDMA_H_
+
+/**
+ * @file dma_mcdma.h
+ * @author Alberto Scolari
+ * @brief Header with API to drive Xilinx AXI Multichannel DMA (MCDMA) engines.
+ *
+ * An MCDMA engine multiplexes up to 16 logical streams per direction over a single AXI stream
+ * interface, the channel being identified by TDEST: a kernel with many input or output streams
+ * can thus be fed by one engine instead of an AXI DMA per stream.
+ * Each channel owns a ring of Scatter/Gather descriptors inside a UDMA buffer; transfers are
+ * submitted to a channel with a single register write and complete independently per channel.
+ * Channels are numbered from 0, i.e. channel 0 is the first channel of the IP.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dma_engine_buf.h"
+
+#define MCDMA_MAX_CHANNELS 16
+
+/**
+ * @brief direction of an MCDMA channel
+ */
+enum mcdma_direction { MCDMA_TO_DEVICE, /**< from memory to FPGA logic (MM2S) */
+                       MCDMA_FROM_DEVICE /**< from FPGA logic to memory (S2MM) */
+                     };
+
+/**
+ * @brief The mcdma_channel struct stores the state of the descriptor ring of a channel
+ */
+struct mcdma_channel {
+    struct udmabuf *desc_buf; /**< UDMA buffer hosting the descriptors */
+    unsigned desc_offset; /**< offset of the first descriptor within @ref desc_buf */
+    unsigned num_descs; /**< number of descriptors of the ring; 0 if the channel is not used */
+    unsigned head; /**< descriptor of the oldest transfer not completed yet */
+    unsigned count; /**< number of transfers submitted and not completed yet */
+};
+
+/**
+ * @brief The mcdma_engine struct stores the information about an AXI MCDMA engine.
+ *
+ * The MCDMA engine is mapped from /dev/mem according to the addresses in Vivado Address Editor.
+ */
+struct mcdma_engine {
+    int fd; /**< file descriptor of /dev/mem */
+    unsigned length; /**< length of mmaped() area */
+    volatile char *regs_vaddr; /**< pointer to MCDMA register area */
+    struct mcdma_channel to_dev[MCDMA_MAX_CHANNELS]; /**< channels towards FPGA logic */
+    struct mcdma_channel from_dev[MCDMA_MAX_CHANNELS]; /**< channels from FPGA logic */
+};
+
+/**
+ * @brief The mcdma_completion struct describes a completed transfer
+ */
+struct mcdma_completion {
+    unsigned desc; /**< descriptor of the ring the transfer used */
+    unsigned length; /**< number of bytes actually transferred */
+    unsigned err_mask; /**< hardware error bitmask of the transfer, 0 for success */
+};
+
+/**
+ * @brief get_mcdma_interfaces loads the MCDMA engines from physical memory,
+ * making them available to the process, and resets them
+ *
+ * @param num_mcdma number of MCDMA engines
+ * @param offsets physical address of MCDMA engines, as from Vivado Address Editor;
+ * if num_mcdma == 1, offsets can be NULL and the default location AXI_MCDMA_REGISTER_LOCATION
+ * is used
+ * @param lengths lengths of MCDMA register areas to be mapped; if NULL, the default length
+ * DESCRIPTOR_REGISTERS_SIZE is used
+ * @param engines the user-allocated array of @ref mcdma_engine to fill
+ * @return 0 for success, non-0 otherwise, also if an engine does not complete its reset
+ */
+int get_mcdma_interfaces(unsigned num_mcdma, phys_addr_t *offsets,
+    unsigned *lengths, struct mcdma_engine *engines);
+
+/**
+ * @brief destroy_mcdma_interfaces releases the MCDMA engines
+ *
+ * @param num_mcdma number of MCDMA engines
+ * @param engines the MCDMA engines to release
+ */
+void destroy_mcdma_interfaces(unsigned num_mcdma, struct mcdma_engine *engines);
+
+/**
+ * @brief reset_mcdma_engine resets @p engine as @ref get_mcdma_interfaces does, clearing errors
+ * and dropping the transfers in flight; all channels are disabled, and must be set again via
+ * @ref set_mcdma_channel
+ *
+ * @param engine the MCDMA engine pointer
+ * @return DMA_ENGINE_RESET if the engine is reset, DMA_ENGINE_HUNG if it does not complete
+ * the reset, e.g. because its clocks are stopped
+ */
+enum dma_err_status reset_mcdma_engine(struct mcdma_engine *engine);
+
+/**
+ * @brief set_mcdma_channel enables @p channel in direction @p dir, with a ring of @p num_descs
+ * descriptors at @p desc_offset inside @p desc_buf
+ *
+ * @param engine the MCDMA engine pointer
+ * @param dir direction of the channel
+ * @param channel channel number, from 0
+ * @param desc_buf UDMA buffer to store the descriptors into
+ * @param desc_offset offset of the first descriptor, aligned to 64 bytes
+ * @param num_descs number of descriptors, at least 2; at most @p num_descs - 1 transfers
+ * can be in flight on the channel
+ * @return 0 for success, non-0 if the parameters are invalid or the channel is busy
+ */
+int set_mcdma_channel(struct mcdma_engine *engine, enum mcdma_direction dir, unsigned channel,
+    struct udmabuf *desc_buf, unsigned desc_offset, unsigned num_descs);
+
+/**
+ * @brief set_mcdma_weights sets the weighted round robin scheduling of the channels
+ * towards FPGA logic, the engine serving each channel in proportion to its weight
+ *
+ * @param engine the MCDMA engine pointer
+ * @param weights weight of each channel, from 0 to 15; NULL restores plain round robin
+ * @param num_weights number of elements of @p weights, i.e. of the first channels to set
+ */
+void set_mcdma_weights(struct mcdma_engine *engine, const unsigned *weights, unsigned num_weights);
+
+/**
+ * @brief submit_mcdma_transfer queues on @p channel a transfer of @p length bytes to/from
+ * @p buf at @p offset, which the engine starts as soon as the channel is scheduled;
+ * towards FPGA logic, the transfer is a whole packet, terminated by TLAST
+ *
+ * @param engine the MCDMA engine pointer
+ * @param dir direction of the channel
+ * @param channel channel number, from 0
+ * @param buf the UDMA buffer to read data from or write data to
+ * @param offset the offset within the UDMA buffer
+ * @param length how many bytes to transmit (at most 2^26 - 1)
+ * @return an @ref dma_err_status value describing success or failure reason:
+ * DMA_TRANS_RUNNING if the ring of the channel is full,
+ * DMA_TRANS_NOT_PROGRAMMED if the channel is not set
+ */
+enum dma_err_status submit_mcdma_transfer(struct mcdma_engine *engine, enum mcdma_direction dir,
+    unsigned channel, struct udmabuf *buf, unsigned offset, unsigned length);
+
+/**
+ * @brief poll_mcdma_completion checks, without waiting, whether the oldest transfer
+ * of @p channel is complete, and in this case retires it and describes it in @p compl;
+ * transfers of a channel complete in submission order
+ *
+ * @param engine the MCDMA engine pointer
+ * @param dir direction of the channel
+ * @param channel channel number, from 0
+ * @param compl user-allocated struct to fill with the completion information
+ * @return NO_ERROR if a transfer has completed, DMA_TRANS_RUNNING if it is still running,
+ * DMA_TRANS_NOT_STARTED if no transfer is in flight on the channel, DMA_TRANS_ERROR if the
+ * channel raised an error (see @ref err_status_mcdma) or the engine halted: the transfer is
+ * not retired, and the channel takes new transfers only once recovered via
+ * @ref reset_mcdma_engine
+ */
+enum dma_err_status poll_mcdma_completion(struct mcdma_engine *engine, enum mcdma_direction dir,
+    unsigned channel, struct mcdma_completion *compl);
+
+/**
+ * @brief wait_mcdma_completion waits for the oldest transfer of @p channel to complete,
+ * like @ref poll_mcdma_completion; users can optionally specify sleeping time
+ * via @p usleep_timeout
+ *
+ * @param usleep_timeout sleeping intervals to wait for the transfer end; 0 means busy wait,
+ * as does DMA_USLEEP_AUTO, MCDMA engines not being calibrated
+ * @return NO_ERROR if a transfer has completed, DMA_TRANS_NOT_STARTED if no transfer
+ * is in flight on the channel, DMA_TRANS_ERROR as for @ref poll_mcdma_completion
+ */
+enum dma_err_status wait_mcdma_completion(struct mcdma_engine *engine, enum mcdma_direction dir,
+    unsigned channel, struct mcdma_completion *compl, unsigned usleep_timeout);
+
+/**
+ * @brief wait_mcdma_completion_until waits like @ref wait_mcdma_completion, giving up
+ * at @p deadline_ns
+ *
+ * @param deadline_ns absolute deadline, as for @ref wait_simple_transfer_to_device_until
+ * @return as @ref wait_mcdma_completion, or DMA_TRANS_TIMEOUT if the deadline passed: the
+ * transfer is still in flight, and can be waited for again or dropped via
+ * @ref reset_mcdma_engine
+ */
+enum dma_err_status wait_mcdma_completion_until(struct mcdma_engine *engine,
+    enum mcdma_direction dir, unsigned channel, struct mcdma_completion *compl,
+    unsigned usleep_timeout, uint64_t deadline_ns);
+
+/**
+ * @brief err_status_mcdma retrieves the hardware-related error bitmask of @p channel
+ * after a transfer is unsuccessful.
+ *
+ * @param engine the MCDMA engine pointer
+ * @param dir direction of the channel
+ * @param channel channel number, from 0
+ */
+unsigned err_status_mcdma(struct mcdma_engine *engine, enum mcdma_direction dir, unsigned channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_MCDMA_H_ */
@@ -0,0 +1,222 @@
+
+/**
+ * @file dma_offload.c
+ * @author Alberto Scolari
+ * @brief Implementation of the dispatcher of kernel calls to the FPGA or the CPU.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dma_offload.h"
+#include "dma_stats.h"
+
+int dma_offload_init(struct dma_offload *off, dma_offload_run_fn cpu_run,
+    dma_offload_run_fn fpga_start, dma_offload_wait_fn fpga_wait, void *ctx, unsigned fpga_max,
+    unsigned granule)
+{
+    if (cpu_run == NULL || fpga_start == NULL || fpga_wait == NULL || fpga_max == 0)
+    {
+        printf("%s: both backends and an FPGA limit are needed\n", __func__);
+        return -1;
+    }
+    memset(off, 0, sizeof(*off));
+    off->cpu_run = cpu_run;
+    off->fpga_start = fpga_start;
+    off->fpga_wait = fpga_wait;
+    off->ctx = ctx;
+    off->sample_period = DMA_OFFLOAD_DEF_SAMPLE_PERIOD;
+    off->granule = granule == 0 ? 1 : granule;
+    /* the FPGA part of split calls stays a multiple of the granule */
+    off->fpga_max = fpga_max >= off->granule ? fpga_max - fpga_max % off->granule : fpga_max;
+    return 0;
+}
+
+void dma_offload_record(struct dma_offload_fit *fit, unsigned items, uint64_t ns)
+{
+    double x = (double)items, y = (double)ns, det;
+
+    fit->n += 1.0;
+    fit->sum_x += x;
+    fit->sum_y += y;
+    fit->sum_xx += x * x;
+    fit->sum_xy += x * y;
+    det = fit->n * fit->sum_xx - fit->sum_x * fit->sum_x;
+    /* samples of a single size: cost proportional to the size */
+    if (det <= 1e-9 * fit->n * fit->sum_xx)
+    {
+        fit->fixed_ns = 0.0;
+        fit->ns_per_item = fit->sum_x > 0.0 ? fit->sum_y / fit->sum_x : 0.0;
+        return;
+    }
+    fit->ns_per_item = (fit->n * fit->sum_xy - fit->sum_x * fit->sum_y) / det;
+    fit->fixed_ns = (fit->sum_y - fit->ns_per_item * fit->sum_x) / fit->n;
+}
+
+double dma_offload_predict(const struct dma_offload_fit *fit, unsigned items)
+{
+    double ns = fit->fixed_ns + fit->ns_per_item * (double)items;
+    return ns > 0.0 ? ns : 0.0;
+}
+
+/* expected duration of a call with @p on_fpga of its @p count items on the FPGA */
+static double plan_cost(const struct dma_offload *off, unsigned count, unsigned on_fpga)
+{
+    double fpga = on_fpga > 0 ? dma_offload_predict(&off->fpga, on_fpga) : 0.0;
+    double cpu = on_fpga < count ? dma_offload_predict(&off->cpu, count - on_fpga) : 0.0;
+
+    return fpga > cpu ? fpga : cpu;
+}
+
+unsigned dma_offload_plan(const struct dma_offload *off, unsigned count)
+{
+    unsigned max = count < off->fpga_max ? count : off->fpga_max, best = 0, split;
+    double per_item, balance;
+
+    if (count == 0 || off->cpu.n == 0.0)
+    {
+        return 0;
+    }
+    if (off->fpga.n == 0.0)
+    {
+        return max;
+    }
+    if (max == count && plan_cost(off, count, count) < plan_cost(off, count, 0))
+    {
+        best = count;
+    }
+    /* the split evening out the expected durations of the two parts, run concurrently */
+    per_item = off->fpga.ns_per_item + off->cpu.ns_per_item;
+    if (per_item > 0.0)
+    {
+        balance = (off->cpu.fixed_ns + off->cpu.ns_per_item * (double)count - off->fpga.fixed_ns)
+            / per_item;
+        split = balance <= 0.0 ? 0 : (balance >= (double)max ? max : (unsigned)balance);
+        split -= split % off->granule;
+        if (split != 0 && split < count
+            && plan_cost(off, count, split) < plan_cost(off, count, best))
+        {
+            best = split;
+        }
+    }
+    return best;
+}
+
+/* the FPGA takes as many items as it can and runs alone, the CPU computing the others after it */
+static int run_sample(struct dma_offload *off, unsigned count)
+{
+    unsigned on_fpga = count < off->fpga_max ? count : off->fpga_max;
+    uint64_t start = dma_stats_now(), end;
+
+    if (off->fpga_start(off->ctx, 0, on_fpga) != 0 || off->fpga_wait(off->ctx) != 0)
+    {
+        printf("%s: FPGA backend failed\n", __func__);
+        return -1;
+    }
+    end = dma_stats_now();
+    dma_offload_record(&off->fpga, on_fpga, end - start);
+    off->since_sample = 0;
+    if (on_fpga == count)
+    {
+        off->fpga_calls++;
+        return 0;
+    }
+    start = dma_stats_now();
+    if (off->cpu_run(off->ctx, on_fpga, count - on_fpga) != 0)
+    {
+        printf("%s: CPU backend failed\n", __func__);
+        return -1;
+    }
+    dma_offload_record(&off->cpu, count - on_fpga, dma_stats_now() - start);
+    off->sample_calls++;
+    return 0;
+}
+
+int dma_offload_run(struct dma_offload *off, unsigned count)
+{
+    unsigned on_fpga = dma_offload_plan(off, count);
+    uint64_t start, cpu_start = 0, cpu_end = 0;
+    int err = 0;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+    /* calls the FPGA runs alone sample it anyway; the CPU model is built first */
+    if (on_fpga < count && off->cpu.n != 0.0 && (off->fpga.n == 0.0
+        || (off->sample_period != 0 && off->since_sample >= off->sample_period)))
+    {
+        return run_sample(off, count);
+    }
+    start = dma_stats_now();
+    if (on_fpga > 0 && off->fpga_start(off->ctx, 0, on_fpga) != 0)
+    {
+        printf("%s: cannot start the FPGA backend\n", __func__);
+        return -1;
+    }
+    if (on_fpga < count)
+    {
+        cpu_start = dma_stats_now();
+        err = off->cpu_run(off->ctx, on_fpga, count - on_fpga);
+        cpu_end = dma_stats_now();
+    }
+    if (on_fpga > 0 && off->fpga_wait(off->ctx) != 0)
+    {
+        err = -1;
+    }
+    if (err != 0)
+    {
+        printf("%s: backend failed\n", __func__);
+        return -1;
+    }
+    /* the FPGA model takes only calls run alone, as overlapping ones are not separable */
+    if (on_fpga == count)
+    {
+        dma_offload_record(&off->fpga, count, dma_stats_now() - start);
+        off->since_sample = 0;
+        off->fpga_calls++;
+    } else
+    {
+        dma_offload_record(&off->cpu, count - on_fpga, cpu_end - cpu_start);
+        off->since_sample++;
+        if (on_fpga == 0)
+        {
+            off->cpu_calls++;
+        } else
+        {
+            off->split_calls++;
+        }
+    }
+    return 0;
+}
+
+int dma_offload_calibrate(struct dma_offload *off, unsigned max_count, unsigned reps)
+{
+    unsigned size, r;
+    uint64_t start;
+
+    if (max_count > off->fpga_max)
+    {
+        max_count = off->fpga_max;
+    }
+    for (size = off->granule; size <= max_count && size != 0; size *= 2)
+    {
+        for (r = 0; r < reps; r++)
+        {
+            start = dma_stats_now();
+            if (off->cpu_run(off->ctx, 0, size) != 0)
+            {
+                return -1;
+            }
+            dma_offload_record(&off->cpu, size, dma_stats_now() - start);
+
+            start = dma_stats_now();
+            if (off->fpga_start(off->ctx, 0, size) != 0 || off->fpga_wait(off->ctx) != 0)
+            {
+                return -1;
+            }
+            dma_offload_record(&off->fpga, size, dma_stats_now() - start);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+
+#ifndef DMA_OFFLOAD_H_
+#define DMA_OFFLOAD_H_
+
+/**
+ * @file dma_offload.h
+ * @author Alberto Scolari
+ * @brief Header with API to dispatch calls of a kernel to the FPGA or to a CPU implementation,
+ * according to costs measured per call size.
+ *
+ * Offloading a call pays a fixed cost (copies into UDMA buffers, programming the engines,
+ * starting the kernel, waiting for completions) that small calls do not amortize. The dispatcher
+ * keeps a linear model of the duration of each backend, fixed cost plus cost per item, fitted by
+ * least squares on the durations of the calls it runs, and picks for each call the backend
+ * expected to finish first. Large calls can be split: the FPGA takes the first items while
+ * the CPU computes the others, in a proportion balancing the expected durations.
+ *
+ * The FPGA part of a split call overlaps the CPU part, and its duration cannot be told apart:
+ * the FPGA model learns from calls the FPGA runs alone and from sampling calls, whose FPGA part
+ * runs before the CPU part instead of concurrently. A call is a sampling one while the FPGA
+ * model is empty, and then once every @ref dma_offload.sample_period calls not timing the FPGA,
+ * so that the model follows the FPGA also after the CPU has been judged faster.
+ *
+ * Backends work on ranges of items, given by the first item and their number, of a call
+ * described by a user context. The FPGA backend is split into a start and a wait function,
+ * so that the CPU can work in between.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define DMA_OFFLOAD_DEF_SAMPLE_PERIOD 64U /**< default calls between two samples of the FPGA */
+
+/**
+ * @brief function computing or starting the computation of @p count items from @p first
+ * @return 0 for success, non-0 otherwise
+ */
+typedef int (*dma_offload_run_fn)(void *ctx, unsigned first, unsigned count);
+
+/**
+ * @brief function waiting for the computation started by the FPGA backend
+ * @return 0 for success, non-0 otherwise
+ */
+typedef int (*dma_offload_wait_fn)(void *ctx);
+
+/**
+ * @brief The dma_offload_fit struct stores the linear cost model of a backend
+ */
+struct dma_offload_fit {
+    double n; /**< number of samples */
+    double sum_x; /**< sum of the sizes */
+    double sum_y; /**< sum of the durations */
+    double sum_xx; /**< sum of the squared sizes */
+    double sum_xy; /**< sum of the products of size and duration */
+    double fixed_ns; /**< fitted fixed cost per call */
+    double ns_per_item; /**< fitted cost per item */
+};
+
+/**
+ * @brief The dma_offload struct stores the backends of a kernel and their cost models
+ */
+struct dma_offload {
+    dma_offload_run_fn cpu_run; /**< CPU backend */
+    dma_offload_run_fn fpga_start; /**< start of the FPGA backend */
+    dma_offload_wait_fn fpga_wait; /**< end of the FPGA backend */
+    void *ctx; /**< context passed to the backends */
+    unsigned fpga_max; /**< largest number of items the FPGA backend takes per call */
+    unsigned granule; /**< the FPGA part of a split call is a multiple of it */
+    struct dma_offload_fit cpu; /**< model of the CPU backend */
+    struct dma_offload_fit fpga; /**< model of the FPGA backend, from calls it ran alone */
+    unsigned sample_period; /**< calls not timing the FPGA before a sampling call, 0 for none
+                                 but while the FPGA model is empty */
+    unsigned since_sample; /**< calls not timing the FPGA since it was last timed */
+    unsigned long long cpu_calls; /**< calls run by the CPU only */
+    unsigned long long fpga_calls; /**< calls run by the FPGA only */
+    unsigned long long split_calls; /**< calls split between the two, run concurrently */
+    unsigned long long sample_calls; /**< calls whose FPGA part ran before the CPU one */
+};
+
+/**
+ * @brief dma_offload_init prepares a dispatcher, with empty cost models
+ *
+ * Until a backend has been timed, calls go to it, so that the models are built by the first
+ * calls; @ref dma_offload_calibrate builds them upfront. With samples of a single size, a model
+ * assumes a cost proportional to the size. The FPGA is sampled every
+ * DMA_OFFLOAD_DEF_SAMPLE_PERIOD calls, which @ref dma_offload.sample_period can change.
+ *
+ * @param off the user-allocated struct to initialize
+ * @param cpu_run the CPU backend
+ * @param fpga_start the start of the FPGA backend
+ * @param fpga_wait the wait of the FPGA backend
+ * @param ctx context passed to the backends
+ * @param fpga_max largest number of items the FPGA backend takes per call, e.g. as bound
+ * by the size of the UDMA buffers
+ * @param granule the FPGA part of split calls is a multiple of it, e.g. to keep transactions
+ * aligned; 0 means 1
+ * @return 0 for success, non-0 if a backend is missing or @p fpga_max is 0
+ */
+int dma_offload_init(struct dma_offload *off, dma_offload_run_fn cpu_run,
+    dma_offload_run_fn fpga_start, dma_offload_wait_fn fpga_wait, void *ctx, unsigned fpga_max,
+    unsigned granule);
+
+/**
+ * @brief dma_offload_calibrate times each backend alone on sizes from @p granule of
+ * @p off to @p max_count, doubling at each step, and adds the samples to the models
+ *
+ * @param max_count largest size timed, capped to the FPGA limit
+ * @param reps runs of each backend per size
+ * @return 0 for success, non-0 if a backend failed
+ */
+int dma_offload_calibrate(struct dma_offload *off, unsigned max_count, unsigned reps);
+
+/**
+ * @brief dma_offload_record adds a sample to the model @p fit and updates the fit
+ *
+ * @param items size of the call
+ * @param ns its duration in nanoseconds
+ */
+void dma_offload_record(struct dma_offload_fit *fit, unsigned items, uint64_t ns);
+
+/**
+ * @brief dma_offload_predict returns the duration the model @p fit expects for @p items,
+ * in nanoseconds
+ */
+double dma_offload_predict(const struct dma_offload_fit *fit, unsigned items);
+
+/**
+ * @brief dma_offload_plan chooses how to run a call of @p count items
+ *
+ * @return number of items, from the first, to run on the FPGA; the others go to the CPU
+ */
+unsigned dma_offload_plan(const struct dma_offload *off, unsigned count);
+
+/**
+ * @brief dma_offload_run runs a call of @p count items as chosen by @ref dma_offload_plan,
+ * or as a sampling call if the FPGA model needs a sample, and adds its durations to the models
+ *
+ * @return 0 for success, non-0 if a backend failed
+ */
+int dma_offload_run(struct dma_offload *off, unsigned count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_OFFLOAD_H_ */
@@ -0,0 +1,164 @@
+
+/**
+ * @file dma_packet.c
+ * @author Alberto Scolari
+ * @brief Implementation of the variable-length packet receiver.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dma_packet.h"
+
+static unsigned tail_slot(const struct dma_packet_rx *rx)
+{
+    return (rx->head + rx->count) % rx->num_slots;
+}
+
+/* program a transaction from device on the first free slot, if any */
+static enum dma_err_status arm_next(struct dma_packet_rx *rx)
+{
+    enum dma_err_status err;
+
+    if (rx->armed || rx->count == rx->num_slots)
+    {
+        return NO_ERROR;
+    }
+    err = set_simple_transfer_from_device(rx->engine, rx->buf,
+        rx->offset + tail_slot(rx) * rx->slot_size, rx->slot_size);
+    if (err == NO_ERROR)
+    {
+        err = start_simple_transfer_from_device(rx->engine);
+    }
+    if (err != NO_ERROR)
+    {
+        printf("%s: cannot start DMA transaction (error %d)\n", __func__, (int)err);
+        return err;
+    }
+    rx->armed = 1;
+    return NO_ERROR;
+}
+
+/* record the packet just completed in the armed slot and re-arm on the next one */
+static void collect(struct dma_packet_rx *rx)
+{
+    unsigned slot = tail_slot(rx);
+
+    rx->lengths[slot] = transferred_length_from_device(rx->engine);
+    rx->err_masks[slot] = err_status_from_device(rx->engine);
+    rx->armed = 0;
+    rx->count++;
+    arm_next(rx);
+}
+
+int dma_packet_rx_init(struct dma_packet_rx *rx, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slot_size, unsigned num_slots)
+{
+    unsigned long area = (unsigned long)slot_size * num_slots;
+    enum dma_err_status err;
+
+    if (num_slots == 0 || slot_size == 0 || slot_size > dma_max_length(engine)
+        || offset + area > buf->size)
+    {
+        printf("%s: slots do not fit into the UDMA buffer\n", __func__);
+        return -1;
+    }
+    memset(rx, 0, sizeof(*rx));
+    rx->lengths = calloc(num_slots, sizeof(unsigned));
+    rx->err_masks = calloc(num_slots, sizeof(unsigned));
+    if (rx->lengths == NULL || rx->err_masks == NULL)
+    {
+        printf("%s: cannot allocate receiver state\n", __func__);
+        free(rx->lengths);
+        free(rx->err_masks);
+        return -1;
+    }
+    rx->engine = engine;
+    rx->buf = buf;
+    rx->offset = offset;
+    rx->slot_size = slot_size;
+    rx->num_slots = num_slots;
+    err = arm_next(rx);
+    if (err != NO_ERROR)
+    {
+        dma_packet_rx_destroy(rx);
+    }
+    return (int)err;
+}
+
+unsigned dma_packet_rx_poll(struct dma_packet_rx *rx)
+{
+    enum dma_err_status err;
+
+    if (rx->armed)
+    {
+        err = poll_simple_transfer_from_device(rx->engine);
+        if (err == NO_ERROR)
+        {
+            collect(rx);
+        }
+        else if (err != DMA_TRANS_RUNNING)
+        {
+            /* nothing received: the slot is armed again, the next get reporting a halted engine */
+            rx->armed = 0;
+        }
+    }
+    else
+    {
+        arm_next(rx);
+    }
+    return rx->count;
+}
+
+enum dma_err_status dma_packet_rx_get(struct dma_packet_rx *rx, unsigned index,
+    struct dma_packet *pkt, unsigned usleep_timeout)
+{
+    unsigned slot;
+    enum dma_err_status err;
+
+    while (rx->count <= index)
+    {
+        /* not enough slots to receive into: the consumer must release some first */
+        if (index >= rx->num_slots)
+        {
+            return DMA_TRANS_NOT_STARTED;
+        }
+        if (!rx->armed && arm_next(rx) != NO_ERROR)
+        {
+            return DMA_TRANS_NOT_STARTED;
+        }
+        err = wait_simple_transfer_from_device(rx->engine, usleep_timeout);
+        if (err != NO_ERROR)
+        {
+            printf("%s: cannot receive a packet (error %d)\n", __func__, (int)err);
+            rx->armed = 0;
+            return err;
+        }
+        collect(rx);
+    }
+    slot = (rx->head + index) % rx->num_slots;
+    pkt->data = (char *)rx->buf->vaddr + rx->offset + slot * rx->slot_size;
+    pkt->length = rx->lengths[slot];
+    pkt->slot = slot;
+    pkt->err_mask = rx->err_masks[slot];
+    return NO_ERROR;
+}
+
+void dma_packet_rx_release(struct dma_packet_rx *rx)
+{
+    if (rx->count == 0)
+    {
+        return;
+    }
+    rx->head = (rx->head + 1) % rx->num_slots;
+    rx->count--;
+    arm_next(rx);
+}
+
+void dma_packet_rx_destroy(struct dma_packet_rx *rx)
+{
+    free(rx->lengths);
+    free(rx->err_masks);
+    rx->lengths = rx->err_masks = NULL;
+}
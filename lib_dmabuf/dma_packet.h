@@ -0,0 +1,109 @@
+
+#ifndef DMA_PACKET_H_
+#define DMA_PACKET_H_
+
+/**
+ * @file dma_packet.h
+ * @author Alberto Scolari
+ * @brief Header with API to receive variable-length packets from the FPGA logic
+ * into a ring of UDMA buffer slots.
+ *
+ * The FPGA logic terminates each packet by asserting TLAST: the transaction from device
+ * ends there, and the number of bytes actually written is read back from the engine.
+ * The receiver keeps a transaction from device armed on the next free slot at all times,
+ * re-arming it as soon as a packet is complete, and hands the received packets to the
+ * consumer in order, without copies; slots are recycled once the consumer releases them.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dma_engine_buf.h"
+
+/**
+ * @brief The dma_packet struct describes a received packet
+ */
+struct dma_packet {
+    void *data; /**< pointer to the packet data, inside the UDMA buffer */
+    unsigned length; /**< number of bytes of the packet */
+    unsigned slot; /**< slot of the ring holding the packet */
+    unsigned err_mask; /**< hardware error bitmask of the transaction, as from @ref err_status_from_device */
+};
+
+/**
+ * @brief The dma_packet_rx struct stores the state of a packet receiver
+ */
+struct dma_packet_rx {
+    struct dma_engine *engine; /**< DMA engine receiving packets */
+    struct udmabuf *buf; /**< UDMA buffer hosting the slots */
+    unsigned offset; /**< offset of the first slot within @ref buf */
+    unsigned slot_size; /**< size of each slot, i.e. the maximum packet size */
+    unsigned num_slots; /**< number of slots */
+    unsigned *lengths; /**< length of the packet in each slot */
+    unsigned *err_masks; /**< hardware error bitmask of the packet in each slot */
+    unsigned head; /**< slot of the oldest packet not released yet */
+    unsigned count; /**< number of received packets not released yet */
+    int armed; /**< 1 if a transaction is armed on slot (head + count) % num_slots */
+};
+
+/**
+ * @brief dma_packet_rx_init prepares a receiver over @p num_slots slots of @p slot_size bytes
+ * each, starting at @p offset inside @p buf, and arms the first transaction from device
+ *
+ * @param rx the user-allocated struct to initialize
+ * @param engine the DMA engine to receive with; its channel from device is used exclusively
+ * @param buf the UDMA buffer hosting the slots
+ * @param offset offset of the first slot within @p buf
+ * @param slot_size size of each slot, i.e. the maximum packet size (at most @ref dma_max_length)
+ * @param num_slots number of slots
+ * @return an @ref dma_err_status value describing success or failure reason; -1 if the slots
+ * do not fit into @p buf; on failure nothing is left to release
+ */
+int dma_packet_rx_init(struct dma_packet_rx *rx, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slot_size, unsigned num_slots);
+
+/**
+ * @brief dma_packet_rx_poll collects a completed packet (if any) without waiting, and re-arms
+ * the engine on the next free slot
+ *
+ * @param rx the packet receiver
+ * @return the number of packets received and not released yet
+ */
+unsigned dma_packet_rx_poll(struct dma_packet_rx *rx);
+
+/**
+ * @brief dma_packet_rx_get returns the packet at position @p index among those received
+ * and not released yet, waiting for it if needed
+ *
+ * @param rx the packet receiver
+ * @param index index of the packet among those not released yet (0 for the oldest)
+ * @param pkt the user-allocated struct to fill with the packet information
+ * @param usleep_timeout sleeping intervals to wait for a packet; 0 means busy wait
+ * @return NO_ERROR for success, DMA_TRANS_NOT_STARTED if @p index is beyond the packets that can
+ * be received with the free slots, or the error of the wait, e.g. DMA_TRANS_ERROR if the engine
+ * halted on an error: nothing is received, and the slot is armed again at the next call, once
+ * the engine is recovered via @ref cancel_simple_transfer_from_device
+ */
+enum dma_err_status dma_packet_rx_get(struct dma_packet_rx *rx, unsigned index,
+    struct dma_packet *pkt, unsigned usleep_timeout);
+
+/**
+ * @brief dma_packet_rx_release gives back to the receiver the slot of the oldest packet,
+ * re-arming the engine if it was stalled because all slots were in use
+ */
+void dma_packet_rx_release(struct dma_packet_rx *rx);
+
+/**
+ * @brief dma_packet_rx_destroy releases the receiver state
+ *
+ * A transaction still armed cannot be cancelled and keeps the slot in use: the engine should
+ * be reset before reusing the memory for other purposes.
+ */
+void dma_packet_rx_destroy(struct dma_packet_rx *rx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_PACKET_H_ */
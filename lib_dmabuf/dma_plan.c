@@ -0,0 +1,459 @@
+
+/**
+ * @file dma_plan.c
+ * @author Alberto Scolari
+ * @brief Implementation of job plans, recorded once and replayed with minimal register accesses.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "dma_plan.h"
+#include "dma_tune.h"
+#include "xhw_internals.h"
+#include "wait_internals.h"
+#include "stats_internals.h"
+#include "trace_internals.h"
+
+/* halted, DMAIntErr, DMASlvErr and DMADecErr bits of the status register */
+#define HALT_ERR_MASK ((1U << 0) | (1U << 4) | (1U << 5) | (1U << 6))
+
+int dma_plan_init(struct dma_plan *plan, unsigned max_steps)
+{
+    memset(plan, 0, sizeof(*plan));
+    if (max_steps == 0)
+    {
+        printf("%s: a plan needs at least one step\n", __func__);
+        return -1;
+    }
+    plan->steps = calloc(max_steps, sizeof(struct dma_plan_step));
+    if (plan->steps == NULL)
+    {
+        printf("%s: cannot allocate %u steps\n", __func__, max_steps);
+        return -1;
+    }
+    plan->max_steps = max_steps;
+    return 0;
+}
+
+static struct dma_plan_step *new_step(struct dma_plan *plan, enum dma_plan_op op)
+{
+    struct dma_plan_step *step;
+
+    if (plan->num_steps == plan->max_steps)
+    {
+        printf("%s: plan is full (%u steps)\n", __func__, plan->max_steps);
+        return NULL;
+    }
+    step = plan->steps + plan->num_steps;
+    memset(step, 0, sizeof(*step));
+    step->op = op;
+    step->dirty = 1;
+    return step;
+}
+
+/* the same checks as the set calls, done once when recording */
+static int check_transfer(struct dma_engine *engine, struct udmabuf *buf, unsigned offset,
+    unsigned length)
+{
+    phys_addr_t addr = buf->paddr + offset;
+
+    if (engine->sg_mode)
+    {
+        printf("%s: DMA engine is in Scatter/Gather mode\n", __func__);
+        return -1;
+    }
+    if (length == 0 || length > dma_max_length(engine) || (unsigned long)offset + length > buf->size)
+    {
+        printf("%s: transaction of %u bytes at offset %u does not fit\n", __func__, length, offset);
+        return -1;
+    }
+    if (engine->addr_width < 64 && ((addr + length - 1) >> engine->addr_width) != 0)
+    {
+        printf("%s: address 0x%llx is beyond the %u bits of the DMA engine\n", __func__,
+            (unsigned long long)addr, engine->addr_width);
+        return -1;
+    }
+    return 0;
+}
+
+static int record_transfer(struct dma_plan *plan, enum dma_plan_op op, struct dma_engine *engine,
+    struct udmabuf *buf, unsigned offset, unsigned length)
+{
+    struct dma_plan_step *step;
+
+    if (check_transfer(engine, buf, offset, length) != 0 || (step = new_step(plan, op)) == NULL)
+    {
+        return -1;
+    }
+    step->engine = engine;
+    step->buf = buf;
+    step->addr = buf->paddr + offset;
+    step->length = length;
+    return (int)plan->num_steps++;
+}
+
+int dma_plan_transfer_to_device(struct dma_plan *plan, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned length)
+{
+    return record_transfer(plan, DMA_PLAN_TO_DEVICE, engine, buf, offset, length);
+}
+
+int dma_plan_transfer_from_device(struct dma_plan *plan, struct dma_engine *engine,
+    struct udmabuf *buf, unsigned offset, unsigned length)
+{
+    return record_transfer(plan, DMA_PLAN_FROM_DEVICE, engine, buf, offset, length);
+}
+
+static int record_wait(struct dma_plan *plan, enum dma_plan_op op, struct dma_engine *engine,
+    struct control_interface *ctrl_intf, unsigned usleep_timeout)
+{
+    struct dma_plan_step *step = new_step(plan, op);
+
+    if (step == NULL)
+    {
+        return -1;
+    }
+    step->engine = engine;
+    step->ctrl_intf = ctrl_intf;
+    step->usleep_timeout = usleep_timeout;
+    return (int)plan->num_steps++;
+}
+
+int dma_plan_wait_to_device(struct dma_plan *plan, struct dma_engine *engine, unsigned usleep_timeout)
+{
+    return record_wait(plan, DMA_PLAN_WAIT_TO_DEVICE, engine, NULL, usleep_timeout);
+}
+
+int dma_plan_wait_from_device(struct dma_plan *plan, struct dma_engine *engine,
+    unsigned usleep_timeout)
+{
+    return record_wait(plan, DMA_PLAN_WAIT_FROM_DEVICE, engine, NULL, usleep_timeout);
+}
+
+int dma_plan_wait_kernel(struct dma_plan *plan, struct control_interface *ctrl_intf,
+    unsigned usleep_timeout)
+{
+    return record_wait(plan, DMA_PLAN_WAIT_KERNEL, NULL, ctrl_intf, usleep_timeout);
+}
+
+static int record_arg(struct dma_plan *plan, enum dma_plan_op op, struct control_interface *ctrl_intf,
+    unsigned offset, uint64_t value)
+{
+    struct dma_plan_step *step = new_step(plan, op);
+
+    if (step == NULL)
+    {
+        return -1;
+    }
+    step->ctrl_intf = ctrl_intf;
+    step->offset = offset;
+    step->value = value;
+    return (int)plan->num_steps++;
+}
+
+int dma_plan_kernel_arg_uint(struct dma_plan *plan, struct control_interface *ctrl_intf,
+    unsigned offset, uint32_t value)
+{
+    return record_arg(plan, DMA_PLAN_ARG_UINT, ctrl_intf, offset, value);
+}
+
+int dma_plan_kernel_arg_ulong(struct dma_plan *plan, struct control_interface *ctrl_intf,
+    unsigned offset, uint64_t value)
+{
+    return record_arg(plan, DMA_PLAN_ARG_ULONG, ctrl_intf, offset, value);
+}
+
+int dma_plan_start_kernel(struct dma_plan *plan, struct control_interface *ctrl_intf)
+{
+    return record_arg(plan, DMA_PLAN_START_KERNEL, ctrl_intf, 0, 0);
+}
+
+int dma_plan_set_arg(struct dma_plan *plan, unsigned step, uint64_t value)
+{
+    struct dma_plan_step *s = step < plan->num_steps ? plan->steps + step : NULL;
+
+    if (s == NULL || (s->op != DMA_PLAN_ARG_UINT && s->op != DMA_PLAN_ARG_ULONG))
+    {
+        printf("%s: step %u is not a kernel argument\n", __func__, step);
+        return -1;
+    }
+    if (s->op == DMA_PLAN_ARG_UINT)
+    {
+        value = (uint32_t)value;
+    }
+    if (s->value != value)
+    {
+        s->value = value;
+        s->dirty = 1;
+    }
+    return 0;
+}
+
+int dma_plan_set_transfer(struct dma_plan *plan, unsigned step, unsigned offset, unsigned length)
+{
+    struct dma_plan_step *s = step < plan->num_steps ? plan->steps + step : NULL;
+
+    if (s == NULL || (s->op != DMA_PLAN_TO_DEVICE && s->op != DMA_PLAN_FROM_DEVICE))
+    {
+        printf("%s: step %u is not a transaction\n", __func__, step);
+        return -1;
+    }
+    if (check_transfer(s->engine, s->buf, offset, length) != 0)
+    {
+        return -1;
+    }
+    /* the address shadows in the engine tell at replay whether the registers need writing */
+    s->addr = s->buf->paddr + offset;
+    s->length = length;
+    return 0;
+}
+
+void dma_plan_invalidate(struct dma_plan *plan)
+{
+    unsigned i;
+    for (i = 0; i < plan->num_steps; i++)
+    {
+        plan->steps[i].dirty = 1;
+    }
+}
+
+/* control register of a channel, followed by the others as in @ref axi_direct_dma_regs */
+static volatile uint32_t *channel_regs(struct dma_engine *engine, int to_dev)
+{
+    return (volatile uint32_t *)engine->regs_vaddr + (to_dev ? 0 :
+        offsetof(struct axi_direct_dma_regs, s2mm_control) / sizeof(uint32_t));
+}
+
+static enum dma_err_status run_transfer(struct dma_plan_step *step)
+{
+    int to_dev = step->op == DMA_PLAN_TO_DEVICE;
+    volatile uint32_t *regs = channel_regs(step->engine, to_dev);
+    struct dma_transaction *trans = to_dev ? &step->engine->to_dev : &step->engine->from_dev;
+    struct dma_stats_engine *stats = step->engine->stats;
+    uint32_t addr_low = (uint32_t)step->addr, addr_high = (uint32_t)(step->addr >> 32);
+
+    if (trans->status == STARTED)
+    {
+        return DMA_TRANS_RUNNING;
+    }
+    if (step->dirty || trans->addr_low != addr_low || trans->addr_high != addr_high)
+    {
+        *(regs + 6) = trans->addr_low = addr_low;
+        *(regs + 7) = trans->addr_high = addr_high;
+    }
+    /* the run bit stays set until the engine is reset or halts on an error */
+    if (step->dirty)
+    {
+        SET_BIT(*regs, 0);
+        step->dirty = 0;
+    }
+    trans->length = step->length;
+    if (stats != NULL)
+    {
+        (to_dev ? &stats->to_dev : &stats->from_dev)->started_ns = dma_stats_now();
+    }
+    __doorbell_barrier();
+    /* reserved bits are written as 0, saving the read of a read-modify-write */
+    *(regs + 10) = step->length;
+    trans->status = STARTED;
+    DMA_TRACE(step->engine, to_dev ? DMA_TRACE_TO_DEV : DMA_TRACE_FROM_DEV, DMA_TRACE_START,
+        step->length);
+    return NO_ERROR;
+}
+
+static enum dma_err_status run_wait(struct dma_plan_step *step, uint64_t deadline_ns)
+{
+    int to_dev = step->op == DMA_PLAN_WAIT_TO_DEVICE;
+    enum dma_trace_track track = to_dev ? DMA_TRACE_TO_DEV : DMA_TRACE_FROM_DEV;
+    volatile uint32_t *status_reg = channel_regs(step->engine, to_dev) + 1;
+    struct dma_transaction *trans = to_dev ? &step->engine->to_dev : &step->engine->from_dev;
+    struct dma_stats_channel *stats = step->engine->stats == NULL ? NULL :
+        (to_dev ? &step->engine->stats->to_dev : &step->engine->stats->from_dev);
+    unsigned usleep_timeout = dma_tune_usleep(step->engine, trans->length, step->usleep_timeout);
+    uint64_t begin = 0, spins = 1;
+    uint32_t status;
+    enum dma_err_status err = NO_ERROR;
+
+    if (trans->status != STARTED)
+    {
+        return DMA_TRANS_NOT_STARTED;
+    }
+    if (stats != NULL)
+    {
+        begin = dma_stats_now();
+    }
+    DMA_TRACE(step->engine, track, DMA_TRACE_WAIT_BEGIN, 0);
+    /* idle at the end, or halted on an error */
+    while ( !BIT(status = *status_reg, 1) && (status & HALT_ERR_MASK) == 0 )
+    {
+        if (deadline_ns != DMA_NO_DEADLINE && dma_stats_now() >= deadline_ns)
+        {
+            err = DMA_TRANS_TIMEOUT;
+            break;
+        }
+        spins++;
+        if (usleep_timeout != 0)
+        {
+            usleep_nano(usleep_timeout);
+        }
+    }
+    if (err == NO_ERROR)
+    {
+        __mmio_rmb();
+        trans->status = PROGRAMMED;
+        if ((status & HALT_ERR_MASK) != 0)
+        {
+            err = DMA_TRANS_ERROR;
+        }
+    }
+    if (stats != NULL)
+    {
+        uint64_t end = dma_stats_now();
+        stats->wait_ns += end - begin;
+        stats->spins += spins;
+        if (err != DMA_TRANS_TIMEOUT)
+        {
+            dma_stats_complete(stats, err == NO_ERROR ? trans->length : 0, status, end);
+        }
+    }
+    if (err == NO_ERROR)
+    {
+        DMA_TRACE(step->engine, track, DMA_TRACE_COMPLETE, 0);
+    }
+    DMA_TRACE(step->engine, track, DMA_TRACE_WAIT_END, 0);
+    return err;
+}
+
+static void run_kernel(struct dma_plan_step *step)
+{
+    volatile struct axi_control_base_regs *regs =
+        (volatile struct axi_control_base_regs *)step->ctrl_intf->control_regs_vaddr;
+    struct dma_stats_kernel *stats = step->ctrl_intf->stats;
+
+    if (stats != NULL)
+    {
+        stats->invocations++;
+        stats->started_ns = dma_stats_now();
+    }
+    __doorbell_barrier();
+    /* auto-restart is not used: ap_start is written alone, with no read-modify-write */
+    regs->control = 1U;
+    DMA_TRACE(step->ctrl_intf, DMA_TRACE_KERNEL, DMA_TRACE_START, 0);
+}
+
+static enum dma_err_status run_wait_kernel(struct dma_plan_step *step, uint64_t deadline_ns)
+{
+    volatile struct axi_control_base_regs *regs =
+        (volatile struct axi_control_base_regs *)step->ctrl_intf->control_regs_vaddr;
+    struct dma_stats_kernel *stats = step->ctrl_intf->stats;
+    uint64_t begin = 0, spins = 1;
+    enum dma_err_status err = NO_ERROR;
+
+    if (stats != NULL)
+    {
+        begin = dma_stats_now();
+    }
+    DMA_TRACE(step->ctrl_intf, DMA_TRACE_KERNEL, DMA_TRACE_WAIT_BEGIN, 0);
+    while (BIT(regs->control, 0) != 0)
+    {
+        if (deadline_ns != DMA_NO_DEADLINE && dma_stats_now() >= deadline_ns)
+        {
+            err = DMA_TRANS_TIMEOUT;
+            break;
+        }
+        spins++;
+        if (step->usleep_timeout != 0)
+        {
+            usleep_nano(step->usleep_timeout);
+        }
+    }
+    __mmio_rmb();
+    if (stats != NULL)
+    {
+        uint64_t end = dma_stats_now();
+        stats->wait_ns += end - begin;
+        stats->spins += spins;
+        if (err == NO_ERROR && stats->started_ns != 0)
+        {
+            stats->busy_ns += end - stats->started_ns;
+            stats->started_ns = 0;
+        }
+    }
+    if (err == NO_ERROR)
+    {
+        DMA_TRACE(step->ctrl_intf, DMA_TRACE_KERNEL, DMA_TRACE_COMPLETE, 0);
+    }
+    DMA_TRACE(step->ctrl_intf, DMA_TRACE_KERNEL, DMA_TRACE_WAIT_END, 0);
+    return err;
+}
+
+enum dma_err_status dma_plan_run(struct dma_plan *plan)
+{
+    return dma_plan_run_until(plan, DMA_NO_DEADLINE);
+}
+
+enum dma_err_status dma_plan_run_until(struct dma_plan *plan, uint64_t deadline_ns)
+{
+    enum dma_err_status err = NO_ERROR;
+    unsigned i;
+
+    for (i = 0; i < plan->num_steps && err == NO_ERROR; i++)
+    {
+        struct dma_plan_step *step = plan->steps + i;
+
+        switch (step->op)
+        {
+        case DMA_PLAN_TO_DEVICE:
+        case DMA_PLAN_FROM_DEVICE:
+            err = run_transfer(step);
+            break;
+        case DMA_PLAN_WAIT_TO_DEVICE:
+        case DMA_PLAN_WAIT_FROM_DEVICE:
+            err = run_wait(step, deadline_ns);
+            break;
+        case DMA_PLAN_ARG_UINT:
+            if (step->dirty)
+            {
+                set_kernel_argument_uint(step->ctrl_intf, step->offset, (uint32_t)step->value);
+                step->dirty = 0;
+            }
+            break;
+        case DMA_PLAN_ARG_ULONG:
+            if (step->dirty)
+            {
+                set_kernel_argument_ulong(step->ctrl_intf, step->offset, step->value);
+                step->dirty = 0;
+            }
+            break;
+        case DMA_PLAN_START_KERNEL:
+            run_kernel(step);
+            break;
+        case DMA_PLAN_WAIT_KERNEL:
+            err = run_wait_kernel(step, deadline_ns);
+            break;
+        }
+    }
+    if (err != NO_ERROR)
+    {
+        printf("%s: step %u failed (error %d)\n", __func__, i - 1, (int)err);
+        /* a halted or cancelled engine needs its run bit set again */
+        if (err == DMA_TRANS_ERROR || err == DMA_TRANS_TIMEOUT)
+        {
+            dma_plan_invalidate(plan);
+        }
+        return err;
+    }
+    plan->replays++;
+    return NO_ERROR;
+}
+
+void dma_plan_destroy(struct dma_plan *plan)
+{
+    free(plan->steps);
+    memset(plan, 0, sizeof(*plan));
+}
@@ -0,0 +1,219 @@
+
+#ifndef DMA_PLAN_H_
+#define DMA_PLAN_H_
+
+/**
+ * @file dma_plan.h
+ * @author Alberto Scolari
+ * @brief Header with API to record a job (DMA transactions, kernel arguments, kernel start
+ * and the waits among them) once into a plan, and to replay it many times with the fewest
+ * register accesses.
+ *
+ * Jobs repeating the same shape on the same engines and buffers reprogram, at each call,
+ * registers that already hold the right values. A plan keeps its steps in order and, at replay,
+ * writes the addresses of a transaction only if the engine was last programmed elsewhere
+ * (as tracked by @ref dma_engine.to_dev and @ref dma_engine.from_dev), kernel arguments only
+ * if they have been overridden since the last replay, and the run bit of an engine only on the
+ * first replay or after an error: a transaction then costs a barrier and the length write,
+ * which starts it, plus the status reads of its wait; the length register is written whole,
+ * with no read-modify-write.
+ *
+ * Argument values and transactions offsets and lengths can be overridden between replays
+ * via @ref dma_plan_set_arg and @ref dma_plan_set_transfer, using the step index returned
+ * when recording. Kernel argument registers are not tracked: if the kernels or engines of a plan
+ * are re-initialized or their arguments written outside of it, @ref dma_plan_invalidate makes
+ * the next replay write everything.
+ *
+ * A plan does not check whether the engine is busy: a plan must end with the waits of all
+ * its transactions and kernel runs, and not be replayed concurrently with other users
+ * of the same engines.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "dma_engine_buf.h"
+
+/**
+ * @brief kinds of steps of a plan
+ */
+enum dma_plan_op { DMA_PLAN_TO_DEVICE = 0, /**< transaction to device, programmed and started */
+                   DMA_PLAN_FROM_DEVICE, /**< transaction from device, programmed and started */
+                   DMA_PLAN_WAIT_TO_DEVICE, /**< wait for the transaction to device */
+                   DMA_PLAN_WAIT_FROM_DEVICE, /**< wait for the transaction from device */
+                   DMA_PLAN_ARG_UINT, /**< 32 bits kernel argument */
+                   DMA_PLAN_ARG_ULONG, /**< 64 bits kernel argument */
+                   DMA_PLAN_START_KERNEL, /**< kernel start */
+                   DMA_PLAN_WAIT_KERNEL /**< wait for the kernel to be done */
+                 };
+
+/**
+ * @brief The dma_plan_step struct stores a step of a plan
+ */
+struct dma_plan_step {
+    enum dma_plan_op op; /**< kind of step */
+    struct dma_engine *engine; /**< DMA engine of transactions and their waits */
+    struct control_interface *ctrl_intf; /**< control interface of arguments and kernel steps */
+    struct udmabuf *buf; /**< UDMA buffer of transactions */
+    phys_addr_t addr; /**< physical address of transactions */
+    unsigned length; /**< length of transactions */
+    unsigned offset; /**< argument offset, as for @ref set_kernel_argument_uint */
+    uint64_t value; /**< argument value */
+    unsigned usleep_timeout; /**< sleeping interval of waits, as for the wait calls */
+    int dirty; /**< 1 if the registers of the step must be written at the next replay */
+};
+
+/**
+ * @brief The dma_plan struct stores a recorded job
+ */
+struct dma_plan {
+    struct dma_plan_step *steps; /**< steps, in replay order */
+    unsigned num_steps; /**< number of recorded steps */
+    unsigned max_steps; /**< capacity of @ref steps */
+    unsigned replays; /**< number of completed replays */
+};
+
+/**
+ * @brief dma_plan_init prepares an empty plan for up to @p max_steps steps
+ *
+ * @param plan the user-allocated struct to initialize
+ * @param max_steps maximum number of steps
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_plan_init(struct dma_plan *plan, unsigned max_steps);
+
+/**
+ * @brief dma_plan_transfer_to_device records a transaction of @p length bytes from @p offset
+ * of @p buf to the FPGA logic, started when the step is replayed
+ *
+ * @return the index of the step, negative if the plan is full or the transaction invalid,
+ * as for @ref set_simple_transfer_to_device
+ */
+int dma_plan_transfer_to_device(struct dma_plan *plan, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned length);
+
+/**
+ * @brief dma_plan_transfer_from_device records a transaction of @p length bytes from the FPGA logic
+ * to @p offset of @p buf, started when the step is replayed
+ *
+ * @return the index of the step, negative if the plan is full or the transaction invalid,
+ * as for @ref set_simple_transfer_from_device
+ */
+int dma_plan_transfer_from_device(struct dma_plan *plan, struct dma_engine *engine,
+    struct udmabuf *buf, unsigned offset, unsigned length);
+
+/**
+ * @brief dma_plan_wait_to_device records a wait for the transaction to device of @p engine
+ *
+ * @param usleep_timeout sleeping interval, as for @ref wait_simple_transfer_to_device;
+ * DMA_USLEEP_AUTO is resolved at each replay, on the current transaction length
+ * @return the index of the step, negative if the plan is full
+ */
+int dma_plan_wait_to_device(struct dma_plan *plan, struct dma_engine *engine, unsigned usleep_timeout);
+
+/**
+ * @brief dma_plan_wait_from_device records a wait for the transaction from device of @p engine
+ *
+ * @param usleep_timeout sleeping interval, as for @ref wait_simple_transfer_from_device
+ * @return the index of the step, negative if the plan is full
+ */
+int dma_plan_wait_from_device(struct dma_plan *plan, struct dma_engine *engine,
+    unsigned usleep_timeout);
+
+/**
+ * @brief dma_plan_kernel_arg_uint records the 32 bits @p value for the argument at @p offset,
+ * as for @ref set_kernel_argument_uint
+ *
+ * @return the index of the step, negative if the plan is full
+ */
+int dma_plan_kernel_arg_uint(struct dma_plan *plan, struct control_interface *ctrl_intf,
+    unsigned offset, uint32_t value);
+
+/**
+ * @brief dma_plan_kernel_arg_ulong records the 64 bits @p value for the argument at @p offset,
+ * as for @ref set_kernel_argument_ulong
+ *
+ * @return the index of the step, negative if the plan is full
+ */
+int dma_plan_kernel_arg_ulong(struct dma_plan *plan, struct control_interface *ctrl_intf,
+    unsigned offset, uint64_t value);
+
+/**
+ * @brief dma_plan_start_kernel records the start of the kernel behind @p ctrl_intf
+ *
+ * @return the index of the step, negative if the plan is full
+ */
+int dma_plan_start_kernel(struct dma_plan *plan, struct control_interface *ctrl_intf);
+
+/**
+ * @brief dma_plan_wait_kernel records a wait for the kernel behind @p ctrl_intf,
+ * as for @ref wait_kernel
+ *
+ * @return the index of the step, negative if the plan is full
+ */
+int dma_plan_wait_kernel(struct dma_plan *plan, struct control_interface *ctrl_intf,
+    unsigned usleep_timeout);
+
+/**
+ * @brief dma_plan_set_arg overrides the value of the argument recorded at step @p step,
+ * written at the next replay only if it changes
+ *
+ * @return 0 for success, non-0 if @p step is not an argument
+ */
+int dma_plan_set_arg(struct dma_plan *plan, unsigned step, uint64_t value);
+
+/**
+ * @brief dma_plan_set_transfer overrides offset and length of the transaction recorded
+ * at step @p step; its addresses are written at the next replay only if they change
+ *
+ * @return 0 for success, non-0 if @p step is not a transaction or the new one is invalid
+ */
+int dma_plan_set_transfer(struct dma_plan *plan, unsigned step, unsigned offset, unsigned length);
+
+/**
+ * @brief dma_plan_invalidate makes the next replay of @p plan write all the registers
+ * of its steps, e.g. after its engines or control interfaces have been re-initialized
+ */
+void dma_plan_invalidate(struct dma_plan *plan);
+
+/**
+ * @brief dma_plan_run replays all the steps of @p plan, in order
+ *
+ * Telemetry and the tracer see the transactions and kernel runs as from the single calls.
+ * An engine halting on an error in a wait stops the replay with DMA_TRANS_ERROR and
+ * invalidates the plan: the engine takes new transactions once recovered via
+ * @ref cancel_simple_transfer_to_device (or from_device) or @ref reset_dma_engine, after which
+ * the plan can be replayed again.
+ *
+ * @return NO_ERROR for success; DMA_TRANS_RUNNING if a transaction is started on a channel
+ * that is still running, DMA_TRANS_NOT_STARTED if a wait finds no transaction started,
+ * DMA_TRANS_ERROR if an engine halted on an error; the replay stops at the failing step
+ */
+enum dma_err_status dma_plan_run(struct dma_plan *plan);
+
+/**
+ * @brief dma_plan_run_until replays @p plan like @ref dma_plan_run, giving up at @p deadline_ns
+ *
+ * @param plan the plan
+ * @param deadline_ns absolute deadline of the whole replay, as for
+ * @ref wait_simple_transfer_to_device_until
+ * @return as @ref dma_plan_run, or DMA_TRANS_TIMEOUT if a wait did not end by the deadline:
+ * the transaction or kernel run it waited for is still running, the replay stops there and
+ * the plan is invalidated; transactions can be cancelled via @ref cancel_simple_transfer_to_device
+ * (or from_device)
+ */
+enum dma_err_status dma_plan_run_until(struct dma_plan *plan, uint64_t deadline_ns);
+
+/**
+ * @brief dma_plan_destroy releases the steps of @p plan
+ */
+void dma_plan_destroy(struct dma_plan *plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_PLAN_H_ */
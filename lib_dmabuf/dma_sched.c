@@ -0,0 +1,344 @@
+
+/**
+ * @file dma_sched.c
+ * @author Alberto Scolari
+ * @brief Implementation of the priority scheduler of DMA engines.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dma_sched.h"
+#include "dma_stats.h"
+#include "dma_tune.h"
+#include "wait_internals.h"
+
+/* pieces of unsplit requests are kept aligned */
+#define PIECE_ALIGN 64U
+
+#define DEF_URGENT_SHARE 1U
+#define DEF_BULK_SHARE 3U
+
+static void sched_lock(struct dma_sched *sched)
+{
+    while (__sync_lock_test_and_set(&sched->lock, 1))
+    {
+        while (*(volatile int *)&sched->lock)
+        {
+        }
+    }
+}
+
+static void sched_unlock(struct dma_sched *sched)
+{
+    __sync_lock_release(&sched->lock);
+}
+
+/* largest piece of a class, within the largest transaction of the engine */
+static unsigned piece_size(const struct dma_sched *sched, const struct dma_sched_class_cfg *cfg)
+{
+    unsigned max_piece = dma_max_length(sched->engine) & ~(PIECE_ALIGN - 1U);
+    return cfg->piece_size == 0 || cfg->piece_size > max_piece ? max_piece : cfg->piece_size;
+}
+
+int dma_sched_init(struct dma_sched *sched, struct dma_engine *engine, unsigned num_classes,
+    const struct dma_sched_class_cfg *classes)
+{
+    unsigned i;
+
+    memset(sched, 0, sizeof(*sched));
+    sched->engine = engine;
+    if (classes == NULL)
+    {
+        num_classes = 2;
+        sched->classes[DMA_SCHED_URGENT].piece_size = 0;
+        sched->classes[DMA_SCHED_URGENT].share = DEF_URGENT_SHARE;
+        sched->classes[DMA_SCHED_BULK].piece_size = engine->tuning.chunk_size;
+        sched->classes[DMA_SCHED_BULK].share = DEF_BULK_SHARE;
+    } else if (num_classes == 0 || num_classes > DMA_SCHED_MAX_CLASSES)
+    {
+        printf("%s: from 1 to %u classes are supported\n", __func__, DMA_SCHED_MAX_CLASSES);
+        return -1;
+    } else
+    {
+        memcpy(sched->classes, classes, num_classes * sizeof(*classes));
+    }
+    for (i = 0; i < num_classes; i++)
+    {
+        if (sched->classes[i].share == 0)
+        {
+            printf("%s: class %u has no bandwidth share\n", __func__, i);
+            return -1;
+        }
+        /* a split class gets at least a piece per refill, an unsplit one a calibrated chunk */
+        if (sched->classes[i].piece_size != 0 && sched->classes[i].piece_size > sched->quantum)
+        {
+            sched->quantum = piece_size(sched, sched->classes + i);
+        }
+    }
+    if (sched->quantum == 0)
+    {
+        sched->quantum = engine->tuning.chunk_size;
+    }
+    sched->num_classes = num_classes;
+    return 0;
+}
+
+int dma_sched_submit(struct dma_sched *sched, struct dma_sched_req *req, unsigned cls,
+    enum dma_sched_dir dir, struct udmabuf *buf, unsigned offset, unsigned length)
+{
+    struct dma_sched_queue *queue;
+
+    if (cls >= sched->num_classes || (dir != DMA_SCHED_TO_DEV && dir != DMA_SCHED_FROM_DEV))
+    {
+        printf("%s: invalid class %u or direction %d\n", __func__, cls, (int)dir);
+        return -1;
+    }
+    if (length == 0 || (unsigned long)offset + length > buf->size)
+    {
+        printf("%s: transaction of %u bytes at offset %u does not fit\n", __func__, length, offset);
+        return -1;
+    }
+    if (req->status == DMA_SCHED_QUEUED || req->status == DMA_SCHED_RUNNING)
+    {
+        printf("%s: request is already submitted\n", __func__);
+        return -1;
+    }
+    req->cls = cls;
+    req->dir = dir;
+    req->buf = buf;
+    req->offset = offset;
+    req->length = length;
+    req->done = 0;
+    req->err_mask = 0;
+    req->complete_ns = 0;
+    req->next = NULL;
+    req->submit_ns = dma_stats_now();
+    req->status = DMA_SCHED_QUEUED;
+
+    sched_lock(sched);
+    queue = sched->channels[dir].queues + cls;
+    if (queue->tail != NULL)
+    {
+        queue->tail->next = req;
+    } else
+    {
+        queue->head = req;
+    }
+    queue->tail = req;
+    sched_unlock(sched);
+    dma_sched_progress(sched);
+    return 0;
+}
+
+/* the class of the next piece, refilling credits when no queued class has any left */
+static int pick_class(struct dma_sched *sched, struct dma_sched_channel *ch)
+{
+    unsigned c;
+    int queued = 0;
+
+    while (1)
+    {
+        for (c = 0; c < sched->num_classes; c++)
+        {
+            struct dma_sched_queue *queue = ch->queues + c;
+
+            if (queue->head != NULL)
+            {
+                if (queue->credit > 0)
+                {
+                    return (int)c;
+                }
+                queued = 1;
+            }
+        }
+        if ( !queued )
+        {
+            return -1;
+        }
+        /* idle classes keep up to a refill, so that closed-loop submitters get their share */
+        for (c = 0; c < sched->num_classes; c++)
+        {
+            long long refill = (long long)sched->quantum * sched->classes[c].share;
+
+            ch->queues[c].credit += refill;
+            if (ch->queues[c].credit > refill)
+            {
+                ch->queues[c].credit = refill;
+            }
+        }
+    }
+}
+
+/* dequeues @p req from the head of its queue, once done */
+static void complete_req(struct dma_sched_channel *ch, struct dma_sched_req *req, uint64_t now)
+{
+    struct dma_sched_queue *queue = ch->queues + req->cls;
+
+    queue->head = req->next;
+    if (queue->head == NULL)
+    {
+        queue->tail = NULL;
+    }
+    req->next = NULL;
+    req->complete_ns = now;
+    __sync_synchronize();
+    req->status = DMA_SCHED_DONE;
+}
+
+/* starts the next piece on @p dir, if any; returns 1 if its request failed to start */
+static unsigned start_piece(struct dma_sched *sched, enum dma_sched_dir dir)
+{
+    struct dma_sched_channel *ch = sched->channels + dir;
+    struct dma_sched_req *req;
+    struct dma_sched_queue *queue;
+    enum dma_err_status err;
+    unsigned piece;
+    int cls = pick_class(sched, ch);
+
+    if (cls < 0)
+    {
+        return 0;
+    }
+    queue = ch->queues + cls;
+    req = queue->head;
+    piece = req->length - req->done;
+    if (piece > piece_size(sched, sched->classes + cls))
+    {
+        piece = piece_size(sched, sched->classes + cls);
+    }
+    if (dir == DMA_SCHED_TO_DEV)
+    {
+        err = set_simple_transfer_to_device(sched->engine, req->buf, req->offset + req->done, piece);
+        if (err == NO_ERROR)
+        {
+            err = start_simple_transfer_to_device(sched->engine);
+        }
+    } else
+    {
+        err = set_simple_transfer_from_device(sched->engine, req->buf, req->offset + req->done, piece);
+        if (err == NO_ERROR)
+        {
+            err = start_simple_transfer_from_device(sched->engine);
+        }
+    }
+    /* a request that cannot start is failed, not retried forever */
+    if (err != NO_ERROR)
+    {
+        printf("%s: cannot start DMA transaction (error %d)\n", __func__, (int)err);
+        req->err_mask = ~0U;
+        complete_req(ch, req, dma_stats_now());
+        return 1;
+    }
+    queue->credit -= piece;
+    req->status = DMA_SCHED_RUNNING;
+    ch->current = req;
+    ch->piece = piece;
+    return 0;
+}
+
+/* collects the piece in flight on @p dir, if complete; returns 1 if its request is done */
+static unsigned collect_piece(struct dma_sched *sched, enum dma_sched_dir dir)
+{
+    struct dma_sched_channel *ch = sched->channels + dir;
+    struct dma_sched_req *req = ch->current;
+    unsigned err_mask, got;
+
+    if (req == NULL)
+    {
+        return 0;
+    }
+    if (dir == DMA_SCHED_TO_DEV)
+    {
+        if (poll_simple_transfer_to_device(sched->engine) == DMA_TRANS_RUNNING)
+        {
+            return 0;
+        }
+        err_mask = err_status_to_device(sched->engine);
+        got = ch->piece;
+    } else
+    {
+        if (poll_simple_transfer_from_device(sched->engine) == DMA_TRANS_RUNNING)
+        {
+            return 0;
+        }
+        err_mask = err_status_from_device(sched->engine);
+        /* the FPGA logic may end the piece early by asserting TLAST */
+        got = err_mask == 0 ? transferred_length_from_device(sched->engine) : 0;
+        if (got > ch->piece)
+        {
+            got = ch->piece;
+        }
+        ch->queues[req->cls].credit += ch->piece - got;
+    }
+    ch->queues[req->cls].bytes += got;
+    ch->queues[req->cls].pieces++;
+    ch->current = NULL;
+    req->done += got;
+    req->err_mask |= err_mask;
+    /*
+     * the engine halts on errors: the rest of the request is not attempted;
+     * a short piece ends the stream of the FPGA logic, and the request with it
+     */
+    if (req->done == req->length || err_mask != 0 || got < ch->piece)
+    {
+        complete_req(ch, req, dma_stats_now());
+        return 1;
+    }
+    return 0;
+}
+
+unsigned dma_sched_progress(struct dma_sched *sched)
+{
+    unsigned completed = 0;
+    int dir;
+
+    sched_lock(sched);
+    for (dir = DMA_SCHED_TO_DEV; dir <= DMA_SCHED_FROM_DEV; dir++)
+    {
+        completed += collect_piece(sched, (enum dma_sched_dir)dir);
+        if (sched->channels[dir].current == NULL)
+        {
+            completed += start_piece(sched, (enum dma_sched_dir)dir);
+        }
+    }
+    sched_unlock(sched);
+    return completed;
+}
+
+unsigned dma_sched_wait(struct dma_sched *sched, struct dma_sched_req *req, unsigned usleep_timeout)
+{
+    usleep_timeout = dma_tune_usleep(sched->engine, req->length, usleep_timeout);
+    while (req->status == DMA_SCHED_QUEUED || req->status == DMA_SCHED_RUNNING)
+    {
+        if (dma_sched_progress(sched) == 0 && usleep_timeout != 0)
+        {
+            usleep_nano(usleep_timeout);
+        }
+    }
+    req->status = DMA_SCHED_IDLE;
+    return req->err_mask;
+}
+
+void dma_sched_destroy(struct dma_sched *sched)
+{
+    unsigned c;
+    int dir, pending = 1;
+
+    while (pending)
+    {
+        dma_sched_progress(sched);
+        pending = 0;
+        for (dir = DMA_SCHED_TO_DEV; dir <= DMA_SCHED_FROM_DEV; dir++)
+        {
+            pending |= sched->channels[dir].current != NULL;
+            for (c = 0; c < sched->num_classes; c++)
+            {
+                pending |= sched->channels[dir].queues[c].head != NULL;
+            }
+        }
+    }
+    memset(sched, 0, sizeof(*sched));
+}
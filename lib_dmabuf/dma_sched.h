@@ -0,0 +1,181 @@
+
+#ifndef DMA_SCHED_H_
+#define DMA_SCHED_H_
+
+/**
+ * @file dma_sched.h
+ * @author Alberto Scolari
+ * @brief Header with API to share a DMA engine among submitters of different priority classes,
+ * queueing their transactions and scheduling them with bounded latency for urgent work.
+ *
+ * In Direct Register Mode an engine runs one transaction per direction, and a long bulk
+ * transaction delays any other one for its whole duration. The scheduler queues requests per
+ * class and direction and splits them into pieces of at most the piece size of their class,
+ * choosing the next piece at every piece boundary.
+ *
+ * Classes are ordered by priority (0 is the highest). Each class has a share of the bandwidth,
+ * enforced by deficit round robin: a class sends pieces while it has credit, and credits are
+ * refilled proportionally to the shares once no class with queued requests has any left.
+ * Among classes with credit, the one with the highest priority goes first, so that urgent
+ * requests jump ahead of bulk ones but cannot take more than their share while bulk requests
+ * are queued; the bandwidth of classes with no queued requests goes to the others, and
+ * idle classes accumulate at most the credit of a refill.
+ *
+ * An urgent request whose class has credit left thus waits at most for the piece in flight.
+ * A piece larger than the credit left takes the credit below zero, as unsplit urgent requests
+ * do: after a piece of s bytes, the class needs up to ceil(s / (quantum * share)) refills to be
+ * back in credit, and before each refill every other queued class sends at most its own refill
+ * (quantum * share bytes, rounded up to a whole piece), the quantum being the largest piece size
+ * of the split classes. With the default classes and urgent requests up to the calibrated chunk,
+ * an urgent request waits for at most the piece in flight and 3 bulk pieces.
+ *
+ * Each piece is a transaction of its own. Towards the FPGA logic, every piece ends with TLAST,
+ * so that the logic sees a split request as a sequence of packets: requests that must reach it
+ * as a single packet go to a class that is not split (piece size 0), and are then at most
+ * @ref dma_max_length bytes long. From the FPGA logic, a piece the logic ends early via TLAST
+ * ends its request, which holds in @ref dma_sched_req.done the bytes actually received.
+ *
+ * Requests are progressed by @ref dma_sched_progress and @ref dma_sched_wait, which any submitter
+ * can call; calls are serialized by a spinlock, so that threads can share a scheduler.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "dma_engine_buf.h"
+
+#define DMA_SCHED_MAX_CLASSES 4U /**< maximum number of priority classes */
+#define DMA_SCHED_URGENT 0U /**< class of latency-critical requests, in the default configuration */
+#define DMA_SCHED_BULK 1U /**< class of bulk requests, in the default configuration */
+
+/**
+ * @brief direction of a scheduled request
+ */
+enum dma_sched_dir { DMA_SCHED_TO_DEV = 0, /**< transaction to FPGA logic */
+                     DMA_SCHED_FROM_DEV /**< transaction from FPGA logic */
+                   };
+
+/**
+ * @brief status of a scheduled request
+ */
+enum dma_sched_status { DMA_SCHED_IDLE = 0, /**< not submitted, or its completion was consumed */
+                        DMA_SCHED_QUEUED, /**< submitted, no piece started yet */
+                        DMA_SCHED_RUNNING, /**< at least one piece started */
+                        DMA_SCHED_DONE /**< all pieces complete */
+                      };
+
+/**
+ * @brief The dma_sched_class_cfg struct configures a priority class
+ */
+struct dma_sched_class_cfg {
+    unsigned piece_size; /**< largest piece requests are split into, each ending with TLAST
+        towards FPGA logic; 0 for no split */
+    unsigned share; /**< relative share of the bandwidth (weight), at least 1 */
+};
+
+/**
+ * @brief The dma_sched_req struct describes a request; it is user-allocated and must stay valid
+ * until the request is done
+ */
+struct dma_sched_req {
+    unsigned cls; /**< priority class */
+    enum dma_sched_dir dir; /**< direction */
+    struct udmabuf *buf; /**< UDMA buffer to transfer from or to */
+    unsigned offset; /**< offset within @ref buf */
+    unsigned length; /**< number of bytes */
+    unsigned done; /**< bytes of the pieces completed so far; once done, less than @ref length
+        if the FPGA logic ended a request from device early */
+    unsigned err_mask; /**< OR of the hardware error bitmasks of the pieces */
+    volatile enum dma_sched_status status; /**< status, DMA_SCHED_DONE once complete */
+    uint64_t submit_ns; /**< submission time, as from @ref dma_stats_now */
+    uint64_t complete_ns; /**< completion time of the last piece */
+    struct dma_sched_req *next; /**< next request in the queue (internal) */
+};
+
+/**
+ * @brief The dma_sched_queue struct stores the state of a class in one direction
+ */
+struct dma_sched_queue {
+    struct dma_sched_req *head; /**< oldest queued request */
+    struct dma_sched_req *tail; /**< newest queued request */
+    long long credit; /**< bytes the class can still send before the next refill */
+    unsigned long long bytes; /**< bytes sent so far */
+    unsigned long long pieces; /**< pieces sent so far */
+};
+
+/**
+ * @brief The dma_sched_channel struct stores the state of a direction of the engine
+ */
+struct dma_sched_channel {
+    struct dma_sched_queue queues[DMA_SCHED_MAX_CLASSES]; /**< per-class queues */
+    struct dma_sched_req *current; /**< request of the piece in flight, NULL if idle */
+    unsigned piece; /**< length of the piece in flight */
+};
+
+/**
+ * @brief The dma_sched struct stores the state of the scheduler of a DMA engine
+ */
+struct dma_sched {
+    struct dma_engine *engine; /**< scheduled engine, used exclusively by the scheduler */
+    unsigned num_classes; /**< number of priority classes */
+    struct dma_sched_class_cfg classes[DMA_SCHED_MAX_CLASSES]; /**< class configuration */
+    unsigned quantum; /**< credit refilled per unit of share */
+    struct dma_sched_channel channels[2]; /**< state per direction, indexed by @ref dma_sched_dir */
+    int lock; /**< spinlock serializing the calls */
+};
+
+/**
+ * @brief dma_sched_init prepares a scheduler in front of @p engine
+ *
+ * @param sched the user-allocated struct to initialize
+ * @param engine the DMA engine, in Direct Register Mode; its channels must not be used outside
+ * the scheduler while it has requests in the same direction
+ * @param num_classes number of classes in @p classes, from 1 to @ref DMA_SCHED_MAX_CLASSES
+ * @param classes configuration of each class, highest priority first; if NULL, two classes:
+ * urgent (@ref DMA_SCHED_URGENT), not split with share 1, and bulk (@ref DMA_SCHED_BULK),
+ * split into chunks of the size calibrated for @p engine with share 3
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_sched_init(struct dma_sched *sched, struct dma_engine *engine, unsigned num_classes,
+    const struct dma_sched_class_cfg *classes);
+
+/**
+ * @brief dma_sched_submit queues @p req, of class @p cls, to transfer @p length bytes
+ * from (or to) @p offset of @p buf, and starts it if the channel is idle
+ *
+ * @return 0 for success, non-0 if the class or the transaction is invalid, or @p req is in use
+ */
+int dma_sched_submit(struct dma_sched *sched, struct dma_sched_req *req, unsigned cls,
+    enum dma_sched_dir dir, struct udmabuf *buf, unsigned offset, unsigned length);
+
+/**
+ * @brief dma_sched_progress collects the pieces complete in both directions and starts
+ * the next ones, without waiting
+ *
+ * @return number of requests completed by this call
+ */
+unsigned dma_sched_progress(struct dma_sched *sched);
+
+/**
+ * @brief dma_sched_wait progresses the scheduler until @p req is done, and marks it as idle
+ * for re-use
+ *
+ * @param usleep_timeout sleeping interval between progress calls; 0 means busy wait,
+ * DMA_USLEEP_AUTO the policy calibrated for the engine, on the length of @p req
+ * @return the hardware error bitmask of the request, 0 for success
+ */
+unsigned dma_sched_wait(struct dma_sched *sched, struct dma_sched_req *req, unsigned usleep_timeout);
+
+/**
+ * @brief dma_sched_destroy waits for all the queued requests
+ */
+void dma_sched_destroy(struct dma_sched *sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_SCHED_H_ */
@@ -0,0 +1,289 @@
+
+/**
+ * @file dma_spool.c
+ * @author Alberto Scolari
+ * @brief Implementation of FPGA-to-file spooling via io_uring writes from UDMA slices.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dma_stream_io.h"
+#include "dma_stats.h"
+#include "uring_internals.h"
+
+int dma_spool_init(struct dma_spool *spool, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slice_size, unsigned num_slices,
+    dma_slice_callback on_slice, void *cb_arg)
+{
+    unsigned long area;
+
+    /* calibrated values, or defaults, for the engine */
+    if (slice_size == 0)
+    {
+        slice_size = engine->tuning.chunk_size;
+    }
+    if (num_slices == 0)
+    {
+        num_slices = engine->tuning.depth;
+    }
+    area = (unsigned long)slice_size * num_slices;
+    if (num_slices < 2 || slice_size == 0 || offset + area > buf->size)
+    {
+        printf("%s: slices do not fit into the UDMA buffer\n", __func__);
+        return -1;
+    }
+    memset(spool, 0, sizeof(*spool));
+    spool->ring = malloc(sizeof(struct dma_uring));
+    spool->pending = calloc(num_slices, sizeof(unsigned));
+    spool->written = calloc(num_slices, sizeof(unsigned));
+    spool->file_offsets = calloc(num_slices, sizeof(unsigned long long));
+    if (spool->ring == NULL || spool->pending == NULL || spool->written == NULL
+        || spool->file_offsets == NULL)
+    {
+        printf("%s: cannot allocate pipeline state\n", __func__);
+        goto err_alloc;
+    }
+    if (dma_uring_init(spool->ring, num_slices) != 0)
+    {
+        goto err_alloc;
+    }
+    /* pinning may fail on uncached UDMA mappings: plain writes are used then */
+    dma_uring_register_buffer(spool->ring, (char *)buf->vaddr + offset, area);
+
+    spool->engine = engine;
+    spool->buf = buf;
+    spool->offset = offset;
+    spool->slice_size = slice_size;
+    spool->num_slices = num_slices;
+    spool->on_slice = on_slice;
+    spool->cb_arg = cb_arg;
+    spool->slice_timeout_ns = DMA_STREAM_SLICE_TIMEOUT_NS;
+    return 0;
+
+err_alloc:
+    free(spool->ring);
+    free(spool->pending);
+    free(spool->written);
+    free(spool->file_offsets);
+    spool->ring = NULL;
+    return -1;
+}
+
+static int queue_write(struct dma_spool *spool, int fd, unsigned slice)
+{
+    struct io_uring_sqe *sqe = dma_uring_get_sqe(spool->ring);
+    unsigned done = spool->written[slice];
+
+    if (sqe == NULL)
+    {
+        return -1;
+    }
+    sqe->opcode = spool->ring->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->off = spool->file_offsets[slice] == DMA_SPOOL_CUR_POS ?
+        DMA_SPOOL_CUR_POS : spool->file_offsets[slice] + done;
+    sqe->addr = (unsigned long)((char *)spool->buf->vaddr + spool->offset
+        + (unsigned long)slice * spool->slice_size + done);
+    sqe->len = spool->pending[slice];
+    sqe->buf_index = 0;
+    sqe->user_data = slice;
+    spool->writes_in_flight++;
+    return dma_uring_submit(spool->ring, 0) < 0 ? -1 : 0;
+}
+
+/*
+ * reap one write completion, re-queueing the remainder of short writes;
+ * the slice becomes free when all its bytes are on file
+ */
+static int reap_write(struct dma_spool *spool, int fd)
+{
+    struct io_uring_cqe *cqe = dma_uring_wait_cqe(spool->ring);
+    unsigned s;
+    int res;
+
+    if (cqe == NULL)
+    {
+        return -1;
+    }
+    s = (unsigned)cqe->user_data;
+    res = cqe->res;
+    dma_uring_cqe_seen(spool->ring);
+    spool->writes_in_flight--;
+    if (res <= 0)
+    {
+        printf("%s: write failed: %s\n", __func__, res < 0 ? strerror(-res) : "no progress");
+        return -1;
+    }
+    spool->written[s] += (unsigned)res;
+    spool->pending[s] -= (unsigned)res;
+    if (spool->pending[s] > 0)
+    {
+        return queue_write(spool, fd, s);
+    }
+    return 0;
+}
+
+/*
+ * reap the writes in flight without re-queueing them and free all slices, so that
+ * the next call starts from a clean pipeline after an error
+ */
+static int reset_slices(struct dma_spool *spool)
+{
+    while (spool->writes_in_flight > 0)
+    {
+        if (dma_uring_wait_cqe(spool->ring) == NULL)
+        {
+            return -1;
+        }
+        dma_uring_cqe_seen(spool->ring);
+        spool->writes_in_flight--;
+    }
+    memset(spool->pending, 0, spool->num_slices * sizeof(unsigned));
+    memset(spool->written, 0, spool->num_slices * sizeof(unsigned));
+    return 0;
+}
+
+/*
+ * wait for the slice being received: the engine halts on errors, and the slice content is not
+ * valid; a halted or stuck engine is recovered for the next stream
+ */
+static int wait_dma(struct dma_spool *spool, unsigned usleep_timeout)
+{
+    uint64_t deadline = spool->slice_timeout_ns == 0 ? DMA_NO_DEADLINE
+        : dma_stats_now() + spool->slice_timeout_ns;
+    enum dma_err_status err = wait_simple_transfer_from_device_until(spool->engine,
+        usleep_timeout, deadline);
+
+    if (err == NO_ERROR)
+    {
+        return 0;
+    }
+    if (err == DMA_TRANS_ERROR)
+    {
+        printf("%s: DMA engine reported error 0x%x\n", __func__,
+            err_status_from_device(spool->engine));
+    } else if (err == DMA_TRANS_TIMEOUT)
+    {
+        printf("%s: DMA transaction not over in %llu ms\n", __func__,
+            (unsigned long long)(spool->slice_timeout_ns / 1000000ULL));
+    } else
+    {
+        printf("%s: cannot wait for DMA transaction (error %d)\n", __func__, (int)err);
+        return -1;
+    }
+    cancel_simple_transfer_from_device(spool->engine);
+    return -1;
+}
+
+long long dma_spool_file(struct dma_spool *spool, int fd, unsigned long long file_offset,
+    unsigned long long length, unsigned usleep_timeout)
+{
+    unsigned long long received = 0;
+    unsigned slice = 0;
+    int ordered = file_offset == DMA_SPOOL_CUR_POS;
+    enum dma_err_status err;
+    unsigned got;
+
+    /* a previous call failed with writes still in flight */
+    if (spool->writes_in_flight > 0 && reset_slices(spool) != 0)
+    {
+        printf("%s: writes of a previous stream cannot be reaped\n", __func__);
+        return -1;
+    }
+    while (received < length)
+    {
+        unsigned long long left = length - received;
+        unsigned chunk = left < spool->slice_size ? (unsigned)left : spool->slice_size;
+
+        /* recycle the slice only once its previous content is on file */
+        while (spool->pending[slice] > 0)
+        {
+            if (reap_write(spool, fd) != 0)
+            {
+                goto err;
+            }
+        }
+
+        err = set_simple_transfer_from_device(spool->engine, spool->buf,
+            spool->offset + slice * spool->slice_size, chunk);
+        if (err == NO_ERROR && spool->on_slice != NULL)
+        {
+            spool->on_slice(spool->cb_arg, slice, chunk);
+        }
+        if (err == NO_ERROR)
+        {
+            err = start_simple_transfer_from_device(spool->engine);
+        }
+        if (err != NO_ERROR)
+        {
+            printf("%s: cannot start DMA transaction (error %d)\n", __func__, (int)err);
+            goto err;
+        }
+        if (wait_dma(spool, usleep_timeout) != 0)
+        {
+            goto err;
+        }
+        /* the FPGA logic may end the stream early by asserting TLAST */
+        got = transferred_length_from_device(spool->engine);
+
+        /* in ordered mode, at most one write is in flight */
+        while (ordered && spool->writes_in_flight > 0)
+        {
+            if (reap_write(spool, fd) != 0)
+            {
+                goto err;
+            }
+        }
+        spool->written[slice] = 0;
+        if (got == 0)
+        {
+            break;
+        }
+        spool->pending[slice] = got;
+        spool->file_offsets[slice] = ordered ? DMA_SPOOL_CUR_POS : file_offset + received;
+        if (queue_write(spool, fd, slice) != 0)
+        {
+            goto err;
+        }
+        received += got;
+        slice = (slice + 1) % spool->num_slices;
+        if (got < chunk)
+        {
+            break;
+        }
+    }
+
+    while (spool->writes_in_flight > 0)
+    {
+        if (reap_write(spool, fd) != 0)
+        {
+            goto err;
+        }
+    }
+    return (long long)received;
+
+err:
+    /* the stream stops: the writes in flight are reaped and the slices freed */
+    if (reset_slices(spool) != 0)
+    {
+        printf("%s: writes in flight cannot be reaped\n", __func__);
+    }
+    return -1;
+}
+
+void dma_spool_destroy(struct dma_spool *spool)
+{
+    if (spool->ring != NULL)
+    {
+        dma_uring_exit(spool->ring);
+        free(spool->ring);
+        spool->ring = NULL;
+    }
+    free(spool->pending);
+    free(spool->written);
+    free(spool->file_offsets);
+    spool->pending = spool->written = NULL;
+    spool->file_offsets = NULL;
+}
@@ -0,0 +1,226 @@
+
+/**
+ * @file dma_stats.c
+ * @author Alberto Scolari
+ * @brief Implementation of the shared-memory segment of telemetry counters.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats_internals.h"
+
+/* 0 if the segment has not been created yet, -1 if disabled or failed */
+static int segment_state = 0;
+int dma_stats_timed = 0;
+static struct dma_stats_segment *segment;
+static char segment_path[64];
+
+uint64_t dma_stats_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static void remove_segment(void)
+{
+    unlink(segment_path);
+}
+
+/*
+ * segments are plain files under /dev/shm, as shm_open() would create,
+ * so that applications need not link librt
+ */
+static struct dma_stats_segment *get_segment(void)
+{
+    const char *env = getenv("DMA_STATS");
+    struct dma_stats_segment *seg;
+    FILE *comm;
+    int fd;
+
+    if (segment_state != 0)
+    {
+        return segment;
+    }
+    segment_state = -1;
+    if (env != NULL && strcmp(env, "0") == 0)
+    {
+        return NULL;
+    }
+    snprintf(segment_path, sizeof(segment_path), "%s/%s%d", DMA_STATS_SHM_DIR,
+        DMA_STATS_SHM_PREFIX, (int)getpid());
+    /*
+     * the segment is created anew, never through a link planted by another user; a segment
+     * left by a previous process with the same id is removed first, which the sticky
+     * directory allows only to its owner
+     */
+    fd = open(segment_path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0644);
+    if (fd == -1 && errno == EEXIST && unlink(segment_path) == 0)
+    {
+        fd = open(segment_path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0644);
+    }
+    if (fd == -1)
+    {
+        printf("%s: impossible to create %s, telemetry disabled\n", __func__, segment_path);
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(*seg)) != 0)
+    {
+        printf("%s: impossible to size %s, telemetry disabled\n", __func__, segment_path);
+        close(fd);
+        unlink(segment_path);
+        return NULL;
+    }
+    seg = mmap(NULL, sizeof(*seg), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED)
+    {
+        printf("%s: impossible to mmap %s, telemetry disabled\n", __func__, segment_path);
+        unlink(segment_path);
+        return NULL;
+    }
+    seg->pid = (int32_t)getpid();
+    comm = fopen("/proc/self/comm", "r");
+    if (comm != NULL)
+    {
+        if (fgets(seg->comm, sizeof(seg->comm), comm) != NULL)
+        {
+            seg->comm[strcspn(seg->comm, "\n")] = '\0';
+        }
+        fclose(comm);
+    }
+    /* timestamps cost a system call on some platforms: times are only taken on request */
+    dma_stats_timed = env != NULL && strcmp(env, "time") == 0;
+    seg->timed = (uint32_t)dma_stats_timed;
+    seg->version = DMA_STATS_VERSION;
+    __sync_synchronize();
+    /* written last, so that monitors see a complete header */
+    seg->magic = DMA_STATS_MAGIC;
+    atexit(remove_segment);
+    segment = seg;
+    segment_state = 1;
+    return segment;
+}
+
+/* head shared by the slots of engines and kernels */
+struct slot_head {
+    uint64_t phys_addr;
+    uint32_t in_use;
+    uint32_t reserved;
+};
+
+/*
+ * takes a free slot, preferring the one that held @p phys_addr, so that counters survive
+ * re-mappings; slots previously used for other addresses are cleared
+ */
+static void *take_slot(void *slots, size_t stride, unsigned num_slots, phys_addr_t phys_addr)
+{
+    unsigned i, pass;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < num_slots; i++)
+        {
+            struct slot_head *head = (struct slot_head *)((char *)slots + i * stride);
+
+            if ((pass == 1 || head->phys_addr == phys_addr)
+                && __sync_bool_compare_and_swap(&head->in_use, 0, 1))
+            {
+                if (head->phys_addr != phys_addr)
+                {
+                    memset(head + 1, 0, stride - sizeof(*head));
+                    head->phys_addr = phys_addr;
+                }
+                return head;
+            }
+        }
+    }
+    return NULL;
+}
+
+struct dma_stats_engine *dma_stats_engine_slot(phys_addr_t phys_addr)
+{
+    struct dma_stats_segment *seg = get_segment();
+
+    if (seg == NULL)
+    {
+        return NULL;
+    }
+    return take_slot(seg->engines, sizeof(seg->engines[0]), DMA_STATS_MAX_ENGINES, phys_addr);
+}
+
+struct dma_stats_kernel *dma_stats_kernel_slot(phys_addr_t phys_addr)
+{
+    struct dma_stats_segment *seg = get_segment();
+
+    if (seg == NULL)
+    {
+        return NULL;
+    }
+    return take_slot(seg->kernels, sizeof(seg->kernels[0]), DMA_STATS_MAX_KERNELS, phys_addr);
+}
+
+void dma_stats_release(uint32_t *in_use)
+{
+    if (in_use != NULL)
+    {
+        __sync_lock_release(in_use);
+    }
+}
+
+void dma_stats_complete(struct dma_stats_channel *stats, unsigned bytes, uint32_t status,
+    uint64_t now_ns)
+{
+    static const unsigned error_bits[DMA_STATS_NUM_ERRORS] = { 4, 5, 6, 8, 9, 10 };
+    unsigned i;
+
+    stats->bytes += bytes;
+    stats->transfers++;
+    if (stats->started_ns != 0 && now_ns > stats->started_ns)
+    {
+        stats->busy_ns += now_ns - stats->started_ns;
+    }
+    stats->started_ns = 0;
+    if ((status & 0x770U) == 0)
+    {
+        return;
+    }
+    for (i = 0; i < DMA_STATS_NUM_ERRORS; i++)
+    {
+        if (status & (1U << error_bits[i]))
+        {
+            stats->errors[i]++;
+        }
+    }
+}
+
+int dma_stats_read(int pid, struct dma_stats_segment *snapshot)
+{
+    char path[64];
+    ssize_t got;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s%d", DMA_STATS_SHM_DIR, DMA_STATS_SHM_PREFIX, pid);
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    got = pread(fd, snapshot, sizeof(*snapshot), 0);
+    close(fd);
+    if (got != (ssize_t)sizeof(*snapshot) || snapshot->magic != DMA_STATS_MAGIC
+        || snapshot->version != DMA_STATS_VERSION)
+    {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+
+#ifndef DMA_STATS_H_
+#define DMA_STATS_H_
+
+/**
+ * @file dma_stats.h
+ * @author Alberto Scolari
+ * @brief Header with the layout of the shared-memory segment where each process
+ * keeps telemetry counters of its DMA engines and kernels, for live monitoring.
+ *
+ * Telemetry is on unless the environment variable DMA_STATS is set to 0. The segment is
+ * created by the library when the first DMA engine or control interface is mapped, as
+ * DMA_STATS_SHM_DIR/DMA_STATS_SHM_PREFIX<pid>, and is removed at process exit; no call is
+ * needed from the application. Counters are updated with plain stores by the threads using
+ * the engines, and are meant to be sampled by monitors like the dma_top tool: values
+ * read while being updated may be slightly off, but are never reset.
+ *
+ * By default only the counters of bytes, transfers, status reads and errors are kept, which
+ * cost a few stores per transaction. Busy and waiting times need a clock read on every start
+ * and wait, which is a system call where the vDSO has no usable clock (e.g. on some Cortex-A9
+ * kernels) and would double the cost of short transactions: they are taken only with
+ * DMA_STATS=time, as @ref dma_stats_segment.timed tells monitors.
+ *
+ * Busy time runs from the start of a transaction (or kernel) to the moment its completion
+ * is observed, in wait and poll calls; waiting time is the time threads spend in wait calls,
+ * where spin iterations count the reads of the status register.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define DMA_STATS_SHM_DIR "/dev/shm" /**< directory of shared-memory segments */
+#define DMA_STATS_SHM_PREFIX "dmabuf_stats." /**< name of segments, followed by the process id */
+#define DMA_STATS_MAGIC 0x53414d44U /**< marks valid segments */
+#define DMA_STATS_VERSION 2U /**< version of the layout */
+#define DMA_STATS_MAX_ENGINES 16 /**< DMA engines accounted for per process */
+#define DMA_STATS_MAX_KERNELS 16 /**< control interfaces accounted for per process */
+
+/**
+ * @brief errors of DMA transfers, decoded from the bits of the status register
+ * that @ref err_status_to_device and @ref err_status_from_device return
+ */
+enum dma_stats_error { DMA_STATS_DMA_INT_ERR = 0, /**< DMAIntErr, bit 4 */
+                       DMA_STATS_DMA_SLV_ERR, /**< DMASlvErr, bit 5 */
+                       DMA_STATS_DMA_DEC_ERR, /**< DMADecErr, bit 6 */
+                       DMA_STATS_SG_INT_ERR, /**< SGIntErr, bit 8 */
+                       DMA_STATS_SG_SLV_ERR, /**< SGSlvErr, bit 9 */
+                       DMA_STATS_SG_DEC_ERR, /**< SGDecErr, bit 10 */
+                       DMA_STATS_NUM_ERRORS /**< number of errors */
+                     };
+
+/**
+ * @brief The dma_stats_channel struct stores the counters of a direction of a DMA engine
+ */
+struct dma_stats_channel {
+    uint64_t bytes; /**< bytes transferred, as programmed */
+    uint64_t transfers; /**< transfers completed */
+    uint64_t busy_ns; /**< nanoseconds from the start to the completion of transfers */
+    uint64_t wait_ns; /**< nanoseconds threads spent waiting for transfers */
+    uint64_t spins; /**< status register reads while waiting */
+    uint64_t errors[DMA_STATS_NUM_ERRORS]; /**< transfers completed with each error */
+    uint64_t started_ns; /**< start time of the running transfer, 0 if none */
+};
+
+/**
+ * @brief The dma_stats_engine struct stores the counters of a DMA engine
+ */
+struct dma_stats_engine {
+    uint64_t phys_addr; /**< physical address of the engine registers */
+    uint32_t in_use; /**< 1 if the engine is mapped */
+    uint32_t reserved;
+    struct dma_stats_channel to_dev; /**< MM2S counters */
+    struct dma_stats_channel from_dev; /**< S2MM counters */
+};
+
+/**
+ * @brief The dma_stats_kernel struct stores the counters of a kernel
+ */
+struct dma_stats_kernel {
+    uint64_t phys_addr; /**< physical address of the control interface */
+    uint32_t in_use; /**< 1 if the control interface is mapped */
+    uint32_t reserved;
+    uint64_t invocations; /**< kernel starts */
+    uint64_t busy_ns; /**< nanoseconds from the start to the observed end of runs */
+    uint64_t wait_ns; /**< nanoseconds threads spent waiting for the kernel */
+    uint64_t spins; /**< control register reads while waiting */
+    uint64_t started_ns; /**< start time of the current run, 0 if none */
+};
+
+/**
+ * @brief The dma_stats_segment struct is the layout of the shared-memory segment
+ */
+struct dma_stats_segment {
+    uint32_t magic; /**< DMA_STATS_MAGIC */
+    uint32_t version; /**< DMA_STATS_VERSION */
+    int32_t pid; /**< process owning the segment */
+    uint32_t timed; /**< 1 if busy and waiting times are taken (DMA_STATS=time), 0 if they stay 0 */
+    char comm[16]; /**< name of the process */
+    struct dma_stats_engine engines[DMA_STATS_MAX_ENGINES]; /**< counters of DMA engines */
+    struct dma_stats_kernel kernels[DMA_STATS_MAX_KERNELS]; /**< counters of kernels */
+};
+
+/**
+ * @brief dma_stats_read copies the segment of process @p pid into @p snapshot
+ *
+ * @param pid the process id
+ * @param snapshot the user-allocated struct to fill
+ * @return 0 for success, non-0 if the segment does not exist or is invalid
+ */
+int dma_stats_read(int pid, struct dma_stats_segment *snapshot);
+
+/**
+ * @brief dma_stats_now returns the time counters are based on, in nanoseconds
+ */
+uint64_t dma_stats_now(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_STATS_H_ */
@@ -0,0 +1,204 @@
+
+#ifndef DMA_STREAM_IO_H_
+#define DMA_STREAM_IO_H_
+
+/**
+ * @file dma_stream_io.h
+ * @author Alberto Scolari
+ * @brief Header with API to stream file data to the FPGA logic through UDMA buffers,
+ * and results from the FPGA logic to files, using io_uring to overlap storage accesses
+ * with DMA transactions.
+ *
+ * The UDMA buffer is split into slices: file data are read directly into the slices
+ * (with no staging copy) and each filled slice is sent to the FPGA logic while the reads
+ * of the next slices are already in flight. Symmetrically, results are written to file
+ * directly from the slices they were received into, while the next transaction from the
+ * FPGA logic is running.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dma_engine_buf.h"
+
+struct dma_uring;
+
+/**
+ * @brief default of @ref dma_ingest.slice_timeout_ns and @ref dma_spool.slice_timeout_ns
+ */
+#define DMA_STREAM_SLICE_TIMEOUT_NS 1000000000ULL
+
+/**
+ * @brief callback invoked on each filled slice, right before its DMA transaction is started
+ *
+ * It allows users to prepare the FPGA logic for the incoming data (e.g. programming the transaction
+ * from device or setting kernel arguments).
+ *
+ * @param arg user argument, as given in @ref dma_ingest_init
+ * @param slice index of the slice within the ring
+ * @param length number of valid bytes in the slice
+ */
+typedef void (*dma_slice_callback)(void *arg, unsigned slice, unsigned length);
+
+/**
+ * @brief The dma_ingest struct stores the state of a file-to-FPGA streaming pipeline
+ */
+struct dma_ingest {
+    struct dma_uring *ring; /**< io_uring instance reading file data */
+    struct dma_engine *engine; /**< DMA engine sending slices to FPGA logic */
+    struct udmabuf *buf; /**< UDMA buffer hosting the slices */
+    unsigned offset; /**< offset of the first slice within @ref buf */
+    unsigned slice_size; /**< size of each slice in bytes */
+    unsigned num_slices; /**< number of slices */
+    unsigned *filled; /**< bytes read so far into each slice */
+    unsigned *wanted; /**< bytes requested for each slice */
+    unsigned reads_in_flight; /**< number of read requests not completed yet */
+    uint64_t slice_timeout_ns; /**< longest wait for the DMA transaction of a slice, 0 for none;
+        @ref dma_ingest_init sets @ref DMA_STREAM_SLICE_TIMEOUT_NS */
+    dma_slice_callback on_slice; /**< optional callback, may be NULL */
+    void *cb_arg; /**< argument of @ref on_slice */
+};
+
+/**
+ * @brief dma_ingest_init prepares a streaming pipeline over @p num_slices slices of
+ * @p slice_size bytes each, starting at @p offset inside @p buf
+ *
+ * The slices area is registered as io_uring fixed buffer, so that reads target it directly;
+ * if the UDMA mapping cannot be registered, plain reads into the slices are used.
+ * To read files opened with O_DIRECT, @p offset and @p slice_size must be multiples of the
+ * logical block size of the storage device.
+ *
+ * @param ingest the user-allocated struct to initialize
+ * @param engine the DMA engine to send data with
+ * @param buf the UDMA buffer hosting the slices
+ * @param offset offset of the first slice within @p buf
+ * @param slice_size size of each slice, which is also the maximum size of a DMA transaction;
+ * 0 for the chunk size calibrated for @p engine (see dma_tune.h)
+ * @param num_slices number of slices (i.e. the pipeline depth); at least 2, or 0 for the depth
+ * calibrated for @p engine
+ * @param on_slice optional callback invoked before each slice is sent, may be NULL
+ * @param cb_arg argument for @p on_slice
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_ingest_init(struct dma_ingest *ingest, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slice_size, unsigned num_slices,
+    dma_slice_callback on_slice, void *cb_arg);
+
+/**
+ * @brief dma_ingest_file streams @p length bytes of @p fd, starting at @p file_offset,
+ * to the FPGA logic, and returns once the last DMA transaction is complete
+ *
+ * Reads are queued for all free slices; as soon as the oldest slice is filled, it is sent
+ * via DMA and, once the transaction is over, the slice is recycled for the next read.
+ * Streaming stops early if the end of file is reached.
+ * On error, the reads still in flight are reaped before returning, so that the pipeline
+ * can stream again; if they cannot be reaped, the following calls fail as well.
+ * A DMA transaction reporting an error, or not over within @ref dma_ingest.slice_timeout_ns,
+ * is cancelled via @ref cancel_simple_transfer_to_device, which may reset the engine.
+ *
+ * @param ingest the streaming pipeline
+ * @param fd file descriptor to read from (possibly opened with O_DIRECT)
+ * @param file_offset offset in the file to start reading from
+ * @param length number of bytes to stream
+ * @param usleep_timeout sleeping intervals to wait for DMA transactions; 0 means busy wait,
+ * DMA_USLEEP_AUTO the calibrated policy
+ * @return number of bytes sent to FPGA logic, negative value on error, also if a read fails,
+ * the DMA engine reports an error (see @ref err_status_to_device) or a transaction times out
+ */
+long long dma_ingest_file(struct dma_ingest *ingest, int fd, unsigned long long file_offset,
+    unsigned long long length, unsigned usleep_timeout);
+
+/**
+ * @brief dma_ingest_destroy releases the resources of the streaming pipeline
+ */
+void dma_ingest_destroy(struct dma_ingest *ingest);
+
+/**
+ * @brief file offset value for @ref dma_spool_file to write at the current file position,
+ * as needed for pipes, sockets and files opened with O_APPEND
+ */
+#define DMA_SPOOL_CUR_POS (~0ULL)
+
+/**
+ * @brief The dma_spool struct stores the state of an FPGA-to-file spooling pipeline
+ */
+struct dma_spool {
+    struct dma_uring *ring; /**< io_uring instance writing file data */
+    struct dma_engine *engine; /**< DMA engine receiving slices from FPGA logic */
+    struct udmabuf *buf; /**< UDMA buffer hosting the slices */
+    unsigned offset; /**< offset of the first slice within @ref buf */
+    unsigned slice_size; /**< size of each slice in bytes */
+    unsigned num_slices; /**< number of slices */
+    unsigned *pending; /**< bytes of each slice still to be written to file; 0 if the slice is free */
+    unsigned *written; /**< bytes of each slice already written to file */
+    unsigned long long *file_offsets; /**< file offset each slice is written to */
+    unsigned writes_in_flight; /**< number of write requests not completed yet */
+    uint64_t slice_timeout_ns; /**< longest wait for the DMA transaction of a slice, 0 for none;
+        @ref dma_spool_init sets @ref DMA_STREAM_SLICE_TIMEOUT_NS */
+    dma_slice_callback on_slice; /**< optional callback, may be NULL */
+    void *cb_arg; /**< argument of @ref on_slice */
+};
+
+/**
+ * @brief dma_spool_init prepares a spooling pipeline over @p num_slices slices of
+ * @p slice_size bytes each, starting at @p offset inside @p buf
+ *
+ * As for @ref dma_ingest_init, the slices area is registered as io_uring fixed buffer
+ * if the UDMA mapping allows it.
+ *
+ * @param spool the user-allocated struct to initialize
+ * @param engine the DMA engine to receive data with
+ * @param buf the UDMA buffer hosting the slices
+ * @param offset offset of the first slice within @p buf
+ * @param slice_size size of each slice, which is also the size of each DMA transaction;
+ * 0 for the chunk size calibrated for @p engine (see dma_tune.h)
+ * @param num_slices number of slices (i.e. the pipeline depth); at least 2, or 0 for the depth
+ * calibrated for @p engine
+ * @param on_slice optional callback invoked after a transaction into a slice is programmed
+ * and before it is started, may be NULL
+ * @param cb_arg argument for @p on_slice
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_spool_init(struct dma_spool *spool, struct dma_engine *engine, struct udmabuf *buf,
+    unsigned offset, unsigned slice_size, unsigned num_slices,
+    dma_slice_callback on_slice, void *cb_arg);
+
+/**
+ * @brief dma_spool_file receives @p length bytes from the FPGA logic and writes them to @p fd,
+ * starting at @p file_offset, returning once all data are on file
+ *
+ * Each slice is written to file as soon as its DMA transaction is over, and is programmed
+ * for a new transaction from device only after its write has completed.
+ * With @ref DMA_SPOOL_CUR_POS, writes are issued one at a time to preserve their order,
+ * still overlapping with DMA transactions.
+ * Only the bytes actually received are written: if the FPGA logic ends a transaction early
+ * by asserting TLAST, spooling stops after that transaction.
+ * On error (a failed write, or an error reported by the DMA engine, see
+ * @ref err_status_from_device), spooling stops once the writes in flight are over, and all
+ * slices are freed for the next call. A DMA transaction reporting an error, or not over within
+ * @ref dma_spool.slice_timeout_ns, is cancelled via @ref cancel_simple_transfer_from_device,
+ * which may reset the engine.
+ *
+ * @param spool the spooling pipeline
+ * @param fd file descriptor to write to (file, pipe or socket)
+ * @param file_offset offset in the file to start writing at, or @ref DMA_SPOOL_CUR_POS
+ * @param length number of bytes to receive
+ * @param usleep_timeout sleeping intervals to wait for DMA transactions; 0 means busy wait,
+ * DMA_USLEEP_AUTO the calibrated policy
+ * @return number of bytes written to file (less than @p length if the stream ended early),
+ * negative value on error
+ */
+long long dma_spool_file(struct dma_spool *spool, int fd, unsigned long long file_offset,
+    unsigned long long length, unsigned usleep_timeout);
+
+/**
+ * @brief dma_spool_destroy releases the resources of the spooling pipeline
+ */
+void dma_spool_destroy(struct dma_spool *spool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_STREAM_IO_H_ */
@@ -0,0 +1,414 @@
+
+/**
+ * @file dma_trace.c
+ * @author Alberto Scolari
+ * @brief Implementation of the timeline tracer of DMA transactions and kernel runs.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "dma_trace.h"
+#include "trace_internals.h"
+
+#define MAX_NAME_LEN 32
+#define MAX_NAMED 64
+
+/* pid of the tracks of engines and kernels, and of the tracks of threads */
+#define HW_PID 1
+#define THREADS_PID 2
+
+struct trace_event {
+    uint64_t ns;
+    const void *obj;
+    unsigned bytes;
+    unsigned char track;
+    unsigned char event;
+    unsigned short thread;
+};
+
+struct trace_buffer {
+    struct trace_buffer *next;
+    unsigned thread;
+    unsigned count;
+    unsigned long dropped;
+    struct trace_event events[];
+};
+
+struct trace_name {
+    const void *obj;
+    int is_kernel;
+    char name[MAX_NAME_LEN];
+};
+
+/* an engine direction or a kernel appearing in the trace */
+struct trace_track {
+    const void *obj;
+    unsigned track;
+    int busy;
+};
+
+int dma_trace_active = 0;
+
+static unsigned capacity;
+static unsigned generation;
+static unsigned num_threads;
+static uint64_t origin_ns;
+static struct trace_buffer *buffers;
+static __thread struct trace_buffer *thread_buf;
+static __thread unsigned thread_generation;
+
+static struct trace_name names[MAX_NAMED];
+static unsigned num_names;
+
+static const char *const track_suffix[] = { "mm2s", "s2mm", "" };
+
+static uint64_t now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static struct trace_buffer *new_thread_buffer(void)
+{
+    struct trace_buffer *buf = malloc(sizeof(*buf) + capacity * sizeof(struct trace_event));
+
+    if (buf == NULL)
+    {
+        return NULL;
+    }
+    buf->thread = __sync_fetch_and_add(&num_threads, 1);
+    buf->count = 0;
+    buf->dropped = 0;
+    /* push onto the list of buffers, which threads may do concurrently */
+    do {
+        buf->next = buffers;
+    } while ( !__sync_bool_compare_and_swap(&buffers, buf->next, buf) );
+    return buf;
+}
+
+void dma_trace_record(const void *obj, enum dma_trace_track track, enum dma_trace_event event,
+    unsigned bytes)
+{
+    struct trace_buffer *buf = thread_buf;
+    struct trace_event *ev;
+
+    /* the buffers of previous traces have been released */
+    if (thread_generation != generation)
+    {
+        thread_generation = generation;
+        thread_buf = buf = new_thread_buffer();
+    }
+    if (buf == NULL)
+    {
+        return;
+    }
+    if (buf->count == capacity)
+    {
+        buf->dropped++;
+        return;
+    }
+    ev = buf->events + buf->count++;
+    ev->ns = now_ns();
+    ev->obj = obj;
+    ev->bytes = bytes;
+    ev->track = (unsigned char)track;
+    ev->event = (unsigned char)event;
+    ev->thread = (unsigned short)buf->thread;
+}
+
+int dma_trace_start(unsigned events_per_thread)
+{
+    if (dma_trace_active)
+    {
+        printf("%s: tracer already running\n", __func__);
+        return -1;
+    }
+    capacity = events_per_thread == 0 ? DMA_TRACE_DEF_EVENTS : events_per_thread;
+    generation++;
+    num_threads = 0;
+    buffers = NULL;
+    origin_ns = now_ns();
+    __sync_synchronize();
+    dma_trace_active = 1;
+    return 0;
+}
+
+static void set_name(const void *obj, int is_kernel, const char *name)
+{
+    unsigned i;
+    char *c;
+
+    for (i = 0; i < num_names; i++)
+    {
+        if (names[i].obj == obj && names[i].is_kernel == is_kernel)
+        {
+            break;
+        }
+    }
+    if (i == MAX_NAMED)
+    {
+        printf("%s: too many named tracks\n", __func__);
+        return;
+    }
+    if (i == num_names)
+    {
+        num_names++;
+    }
+    names[i].obj = obj;
+    names[i].is_kernel = is_kernel;
+    strncpy(names[i].name, name, MAX_NAME_LEN - 1);
+    names[i].name[MAX_NAME_LEN - 1] = '\0';
+    /* keep the JSON valid */
+    for (c = names[i].name; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20)
+        {
+            *c = '_';
+        }
+    }
+}
+
+void dma_trace_name_engine(struct dma_engine *engine, const char *name)
+{
+    set_name(engine, 0, name);
+}
+
+void dma_trace_name_kernel(struct control_interface *ctrl_intf, const char *name)
+{
+    set_name(ctrl_intf, 1, name);
+}
+
+static int compare_events(const void *a, const void *b)
+{
+    const struct trace_event *ea = a, *eb = b;
+    return ea->ns < eb->ns ? -1 : ea->ns > eb->ns;
+}
+
+static unsigned find_track(struct trace_track *tracks, unsigned *num_tracks,
+    const struct trace_event *ev)
+{
+    unsigned i;
+    for (i = 0; i < *num_tracks; i++)
+    {
+        if (tracks[i].obj == ev->obj && tracks[i].track == ev->track)
+        {
+            return i;
+        }
+    }
+    tracks[i].obj = ev->obj;
+    tracks[i].track = ev->track;
+    tracks[i].busy = 0;
+    (*num_tracks)++;
+    return i;
+}
+
+/* name of a track: user-given, or numbered by order of appearance of engines or kernels */
+static void track_name(struct trace_track *tracks, unsigned index, char *name, size_t len)
+{
+    int is_kernel = tracks[index].track == DMA_TRACE_KERNEL;
+    unsigned i, first, number = 0;
+
+    for (i = 0; i < num_names; i++)
+    {
+        if (names[i].obj == tracks[index].obj && names[i].is_kernel == is_kernel)
+        {
+            snprintf(name, len, "%s%s%s", names[i].name, is_kernel ? "" : " ",
+                track_suffix[tracks[index].track]);
+            return;
+        }
+    }
+    /* both directions of an engine share the number of its first appearance */
+    for (first = 0; tracks[first].obj != tracks[index].obj; first++);
+    for (i = 0; i < first; i++)
+    {
+        unsigned j;
+        int seen = 0;
+        for (j = 0; j < i; j++)
+        {
+            seen |= tracks[j].obj == tracks[i].obj;
+        }
+        number += !seen && (tracks[i].track == DMA_TRACE_KERNEL) == is_kernel;
+    }
+    snprintf(name, len, "%s %u%s%s", is_kernel ? "kernel" : "dma", number, is_kernel ? "" : " ",
+        track_suffix[tracks[index].track]);
+}
+
+static void print_ts(FILE *out, uint64_t ns)
+{
+    uint64_t rel = ns > origin_ns ? ns - origin_ns : 0;
+    /* timestamps are in microseconds */
+    fprintf(out, "%llu.%03u", (unsigned long long)(rel / 1000), (unsigned)(rel % 1000));
+}
+
+static void write_event(FILE *out, struct trace_track *tracks, unsigned index,
+    const struct trace_event *ev, int *first)
+{
+    char name[2 * MAX_NAME_LEN];
+    const char *what = tracks[index].track == DMA_TRACE_KERNEL ? "run" : "transfer";
+
+    switch (ev->event)
+    {
+    case DMA_TRACE_SET:
+        fprintf(out, "%s\n{\"name\":\"set\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%u,\"ts\":",
+            *first ? "" : ",", HW_PID, index + 1);
+        print_ts(out, ev->ns);
+        fprintf(out, ",\"args\":{\"bytes\":%u}}", ev->bytes);
+        break;
+    case DMA_TRACE_START:
+        if (tracks[index].busy)
+        {
+            return;
+        }
+        tracks[index].busy = 1;
+        fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"B\",\"pid\":%d,\"tid\":%u,\"ts\":",
+            *first ? "" : ",", what, HW_PID, index + 1);
+        print_ts(out, ev->ns);
+        if (tracks[index].track == DMA_TRACE_KERNEL)
+        {
+            fprintf(out, "}");
+        } else
+        {
+            fprintf(out, ",\"args\":{\"bytes\":%u}}", ev->bytes);
+        }
+        break;
+    case DMA_TRACE_COMPLETE:
+        /* completions without a start, e.g. waiting twice, carry no information */
+        if ( !tracks[index].busy )
+        {
+            return;
+        }
+        tracks[index].busy = 0;
+        fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"E\",\"pid\":%d,\"tid\":%u,\"ts\":",
+            *first ? "" : ",", what, HW_PID, index + 1);
+        print_ts(out, ev->ns);
+        fprintf(out, "}");
+        break;
+    case DMA_TRACE_WAIT_BEGIN:
+    case DMA_TRACE_WAIT_END:
+        track_name(tracks, index, name, sizeof(name));
+        fprintf(out, "%s\n{\"name\":\"wait %s\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%u,\"ts\":",
+            *first ? "" : ",", name, ev->event == DMA_TRACE_WAIT_BEGIN ? "B" : "E",
+            THREADS_PID, ev->thread + 1U);
+        print_ts(out, ev->ns);
+        fprintf(out, "}");
+        break;
+    default:
+        return;
+    }
+    *first = 0;
+}
+
+static int write_trace(const char *path, struct trace_event *events, unsigned long num_events,
+    unsigned long dropped)
+{
+    struct trace_track *tracks;
+    unsigned num_tracks = 0, i;
+    unsigned long e;
+    char name[2 * MAX_NAME_LEN];
+    int first = 1, err;
+    FILE *out = fopen(path, "w");
+
+    if (out == NULL)
+    {
+        printf("%s: impossible to open %s\n", __func__, path);
+        return -1;
+    }
+    tracks = malloc((num_events > 0 ? num_events : 1) * sizeof(*tracks));
+    if (tracks == NULL)
+    {
+        printf("%s: cannot allocate the tracks\n", __func__);
+        fclose(out);
+        return -1;
+    }
+    qsort(events, num_events, sizeof(*events), compare_events);
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%lu},"
+        "\"traceEvents\":[", dropped);
+    for (e = 0; e < num_events; e++)
+    {
+        write_event(out, tracks, find_track(tracks, &num_tracks, events + e), events + e, &first);
+    }
+    /* metadata naming processes and tracks, in order of appearance */
+    fprintf(out, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+        "\"args\":{\"name\":\"DMA engines and kernels\"}}", first ? "" : ",", HW_PID);
+    fprintf(out, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+        "\"args\":{\"name\":\"threads\"}}", THREADS_PID);
+    for (i = 0; i < num_tracks; i++)
+    {
+        track_name(tracks, i, name, sizeof(name));
+        fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+            "\"args\":{\"name\":\"%s\"}}", HW_PID, i + 1, name);
+        fprintf(out, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+            "\"args\":{\"sort_index\":%u}}", HW_PID, i + 1, i);
+    }
+    for (i = 0; i < num_threads; i++)
+    {
+        fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+            "\"args\":{\"name\":\"thread %u\"}}", THREADS_PID, i + 1, i);
+    }
+    fprintf(out, "\n]}\n");
+    free(tracks);
+    err = ferror(out);
+    if (fclose(out) != 0 || err)
+    {
+        printf("%s: error writing %s\n", __func__, path);
+        return -1;
+    }
+    return 0;
+}
+
+int dma_trace_stop(const char *path)
+{
+    struct trace_buffer *buf, *next;
+    struct trace_event *events = NULL;
+    unsigned long num_events = 0, dropped = 0;
+    int ret = 0;
+
+    if ( !dma_trace_active )
+    {
+        printf("%s: tracer not running\n", __func__);
+        return -1;
+    }
+    dma_trace_active = 0;
+    __sync_synchronize();
+
+    for (buf = buffers; buf != NULL; buf = buf->next)
+    {
+        num_events += buf->count;
+        dropped += buf->dropped;
+    }
+    if (path != NULL)
+    {
+        events = malloc((num_events > 0 ? num_events : 1) * sizeof(*events));
+        if (events == NULL)
+        {
+            printf("%s: cannot allocate %lu events\n", __func__, num_events);
+            ret = -1;
+        }
+    }
+    /* merge the per-thread buffers and release them */
+    num_events = 0;
+    for (buf = buffers; buf != NULL; buf = next)
+    {
+        next = buf->next;
+        if (events != NULL)
+        {
+            memcpy(events + num_events, buf->events, buf->count * sizeof(*events));
+            num_events += buf->count;
+        }
+        free(buf);
+    }
+    buffers = NULL;
+    if (events != NULL)
+    {
+        ret = write_trace(path, events, num_events, dropped);
+        free(events);
+    }
+    return ret;
+}
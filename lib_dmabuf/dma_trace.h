@@ -0,0 +1,76 @@
+
+#ifndef DMA_TRACE_H_
+#define DMA_TRACE_H_
+
+/**
+ * @file dma_trace.h
+ * @author Alberto Scolari
+ * @brief Header with API to trace DMA transactions and kernel runs on a timeline,
+ * exported in the Chrome trace-event format.
+ *
+ * Once started, the tracer records an event whenever a transaction is set, started or observed
+ * to be complete, and whenever a thread begins or ends waiting for it, for every direction
+ * of every @ref dma_engine and every @ref control_interface. Events are appended to a
+ * per-thread buffer, with no locking, and are written out by @ref dma_trace_stop as JSON that
+ * chrome://tracing and https://ui.perfetto.dev can open: each engine direction and each kernel
+ * is a track showing when it was busy, while each thread is a track showing when it was blocked,
+ * so that idle gaps and serialization among engines become visible.
+ *
+ * Completion is recorded when the library observes it, i.e. in wait and poll calls;
+ * hence, busy intervals may end later than the actual hardware completion.
+ * When the tracer is stopped, each call costs a single test of a global flag.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dma_engine_buf.h"
+
+/**
+ * @brief default number of events each thread can record, used if @ref dma_trace_start
+ * is given 0
+ */
+#define DMA_TRACE_DEF_EVENTS 65536U
+
+/**
+ * @brief dma_trace_start starts recording events, discarding those of a previous trace
+ *
+ * @param events_per_thread maximum number of events each thread can record;
+ * further events are dropped and counted
+ * @return 0 for success, non-0 if the tracer is already running
+ */
+int dma_trace_start(unsigned events_per_thread);
+
+/**
+ * @brief dma_trace_stop stops recording events and writes them to @p path as Chrome
+ * trace-event JSON; threads must not use DMA engines or kernels while it runs
+ *
+ * @param path file to write the trace into; if NULL, the trace is discarded
+ * @return 0 for success, non-0 if the tracer is not running or the file cannot be written
+ */
+int dma_trace_stop(const char *path);
+
+/**
+ * @brief dma_trace_name_engine names the tracks of @p engine, which appear as
+ * "<name> mm2s" and "<name> s2mm"; unnamed engines are numbered in order of appearance
+ *
+ * @param engine the DMA engine
+ * @param name the name, truncated to 31 characters
+ */
+void dma_trace_name_engine(struct dma_engine *engine, const char *name);
+
+/**
+ * @brief dma_trace_name_kernel names the track of the kernel behind @p ctrl_intf;
+ * unnamed kernels are numbered in order of appearance
+ *
+ * @param ctrl_intf the control interface of the kernel
+ * @param name the name, truncated to 31 characters
+ */
+void dma_trace_name_kernel(struct control_interface *ctrl_intf, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_TRACE_H_ */
@@ -0,0 +1,378 @@
+
+/**
+ * @file dma_tune.c
+ * @author Alberto Scolari
+ * @brief Implementation of the calibration of DMA engines and of their tuning profile.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dma_tune.h"
+#include "dma_stats.h"
+
+#define MAX_PROFILE_ENGINES 64
+#define MAX_LINE 256
+
+/* sizes measured, doubling from the smallest one up to the largest transaction of the engine */
+#define MIN_CAL_SIZE 4096U
+#define MAX_CAL_SIZES 14
+#define CAL_TIMEOUT_NS 1000000000ULL
+#define MAX_DEPTH 8U
+
+struct profile_entry {
+    phys_addr_t phys_addr;
+    struct dma_tuning tuning;
+};
+
+static struct profile_entry profile[MAX_PROFILE_ENGINES];
+static unsigned profile_size;
+static int profile_loaded = 0;
+
+static const struct dma_tuning default_tuning = {
+    DMA_TUNE_DEF_CHUNK, DMA_TUNE_DEF_DEPTH, 0, 0, 0, 0, 0
+};
+
+static const char *profile_path(const char *path)
+{
+    const char *env = getenv(DMA_TUNE_PROFILE_ENV);
+
+    if (path != NULL)
+    {
+        return path;
+    }
+    return env != NULL ? env : DMA_TUNE_DEF_PROFILE;
+}
+
+static int parse_line(char *line, struct profile_entry *entry)
+{
+    unsigned long long addr;
+    char *token, *save, *end;
+
+    if (sscanf(line, "%llx", &addr) != 1)
+    {
+        return -1;
+    }
+    entry->phys_addr = (phys_addr_t)addr;
+    entry->tuning = default_tuning;
+    strtok_r(line, " \t\n", &save);
+    while ((token = strtok_r(NULL, " \t\n", &save)) != NULL)
+    {
+        char *value = strchr(token, '=');
+        unsigned long v;
+
+        if (value == NULL)
+        {
+            return -1;
+        }
+        *value++ = '\0';
+        v = strtoul(value, &end, 0);
+        if (*end != '\0')
+        {
+            return -1;
+        }
+        if (strcmp(token, "chunk") == 0)
+        {
+            entry->tuning.chunk_size = (unsigned)v;
+        } else if (strcmp(token, "depth") == 0)
+        {
+            entry->tuning.depth = (unsigned)v;
+        } else if (strcmp(token, "usleep") == 0)
+        {
+            entry->tuning.usleep_timeout = (unsigned)v;
+        } else if (strcmp(token, "setup_ns") == 0)
+        {
+            entry->tuning.setup_ns = (unsigned)v;
+        } else if (strcmp(token, "latency_ns") == 0)
+        {
+            entry->tuning.latency_ns = (unsigned)v;
+        } else if (strcmp(token, "sleep_ns") == 0)
+        {
+            entry->tuning.sleep_ns = (unsigned)v;
+        } else if (strcmp(token, "bw") == 0)
+        {
+            entry->tuning.bytes_per_us = (unsigned)v;
+        }
+        /* unknown keys are skipped, for newer profiles to be usable */
+    }
+    if (entry->tuning.chunk_size == 0 || entry->tuning.depth < 2)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int dma_tune_load(const char *path)
+{
+    const char *file = profile_path(path);
+    char line[MAX_LINE];
+    unsigned line_num = 0;
+    FILE *in;
+
+    profile_loaded = 1;
+    profile_size = 0;
+    in = fopen(file, "r");
+    if (in == NULL)
+    {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), in) != NULL && profile_size < MAX_PROFILE_ENGINES)
+    {
+        line_num++;
+        if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t\n")] == '\0')
+        {
+            continue;
+        }
+        if (parse_line(line, profile + profile_size) != 0)
+        {
+            printf("%s: skipping invalid line %u of %s\n", __func__, line_num, file);
+            continue;
+        }
+        profile_size++;
+    }
+    fclose(in);
+    return (int)profile_size;
+}
+
+static struct profile_entry *find_entry(phys_addr_t phys_addr)
+{
+    unsigned i;
+    for (i = 0; i < profile_size; i++)
+    {
+        if (profile[i].phys_addr == phys_addr)
+        {
+            return profile + i;
+        }
+    }
+    return NULL;
+}
+
+int dma_tune_save(const char *path, const phys_addr_t *phys_addrs, const struct dma_tuning *tunings,
+    unsigned num)
+{
+    const char *file = profile_path(path);
+    unsigned i;
+    int err;
+    FILE *out;
+
+    dma_tune_load(file);
+    for (i = 0; i < num; i++)
+    {
+        struct profile_entry *entry = find_entry(phys_addrs[i]);
+
+        if (entry == NULL)
+        {
+            if (profile_size == MAX_PROFILE_ENGINES)
+            {
+                printf("%s: too many engines in the profile\n", __func__);
+                return -1;
+            }
+            entry = profile + profile_size++;
+        }
+        entry->phys_addr = phys_addrs[i];
+        entry->tuning = tunings[i];
+    }
+
+    out = fopen(file, "w");
+    if (out == NULL)
+    {
+        printf("%s: impossible to open %s\n", __func__, file);
+        return -1;
+    }
+    fprintf(out, "# DMA engine tuning profile, written by dma_tune_save()\n");
+    for (i = 0; i < profile_size; i++)
+    {
+        const struct dma_tuning *t = &profile[i].tuning;
+        fprintf(out, "0x%llx chunk=%u depth=%u usleep=%u setup_ns=%u latency_ns=%u sleep_ns=%u bw=%u\n",
+            (unsigned long long)profile[i].phys_addr, t->chunk_size, t->depth, t->usleep_timeout,
+            t->setup_ns, t->latency_ns, t->sleep_ns, t->bytes_per_us);
+    }
+    err = ferror(out);
+    if (fclose(out) != 0 || err)
+    {
+        printf("%s: error writing %s\n", __func__, file);
+        return -1;
+    }
+    return 0;
+}
+
+void dma_tune_apply(struct dma_engine *engine)
+{
+    struct profile_entry *entry;
+
+    if ( !profile_loaded )
+    {
+        dma_tune_load(NULL);
+    }
+    entry = find_entry(engine->phys_addr);
+    engine->tuning = entry != NULL ? entry->tuning : default_tuning;
+}
+
+unsigned dma_tune_usleep(const struct dma_engine *engine, unsigned length, unsigned usleep_timeout)
+{
+    const struct dma_tuning *t = &engine->tuning;
+    unsigned long long expected_ns;
+
+    if (usleep_timeout != DMA_USLEEP_AUTO)
+    {
+        return usleep_timeout;
+    }
+    if (t->bytes_per_us == 0)
+    {
+        return t->usleep_timeout;
+    }
+    expected_ns = (unsigned long long)length * 1000ULL / t->bytes_per_us + t->latency_ns;
+    /* sleeping longer than the transaction only adds latency */
+    if (expected_ns < 2ULL * t->sleep_ns)
+    {
+        return 0;
+    }
+    return expected_ns / 4000ULL > 0 ? (unsigned)(expected_ns / 4000ULL) : 1;
+}
+
+static uint64_t measure_sleep(void)
+{
+    struct timespec shortest = { 0, 1000 };
+    uint64_t begin = dma_stats_now();
+    unsigned i;
+
+    for (i = 0; i < 16; i++)
+    {
+        nanosleep(&shortest, NULL);
+    }
+    return (dma_stats_now() - begin) / 16;
+}
+
+static int poll_until(struct dma_engine *engine, enum dma_err_status (*poll)(struct dma_engine *),
+    uint64_t deadline)
+{
+    while (poll(engine) == DMA_TRANS_RUNNING)
+    {
+        if (dma_stats_now() > deadline)
+        {
+            printf("%s: transaction not complete after %llu ms, is the engine in a loopback design?\n",
+                __func__, CAL_TIMEOUT_NS / 1000000ULL);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* leaves no transaction started nor error latched after a failed round */
+static int abort_round(struct dma_engine *engine)
+{
+    if (reset_dma_engine(engine) != DMA_ENGINE_RESET)
+    {
+        printf("%s: the engine does not complete its reset\n", __func__);
+    }
+    return -1;
+}
+
+/* one transfer of @p size bytes through the loopback, from the start of @p buf to its half */
+static int loopback_round(struct dma_engine *engine, struct udmabuf *buf, unsigned size,
+    uint64_t *setup_ns, uint64_t *total_ns)
+{
+    uint64_t t0, t1, t2;
+
+    t0 = dma_stats_now();
+    if (set_simple_transfer_from_device(engine, buf, (unsigned)(buf->size / 2), size) != NO_ERROR
+        || start_simple_transfer_from_device(engine) != NO_ERROR
+        || set_simple_transfer_to_device(engine, buf, 0, size) != NO_ERROR
+        || start_simple_transfer_to_device(engine) != NO_ERROR)
+    {
+        printf("%s: cannot start transactions of %u bytes\n", __func__, size);
+        return abort_round(engine);
+    }
+    t1 = dma_stats_now();
+    if (poll_until(engine, poll_simple_transfer_to_device, t1 + CAL_TIMEOUT_NS) != 0
+        || poll_until(engine, poll_simple_transfer_from_device, t1 + CAL_TIMEOUT_NS) != 0)
+    {
+        return abort_round(engine);
+    }
+    t2 = dma_stats_now();
+    if (err_status_to_device(engine) != 0 || err_status_from_device(engine) != 0)
+    {
+        printf("%s: engine error on transactions of %u bytes\n", __func__, size);
+        return abort_round(engine);
+    }
+    /* two transactions are set up */
+    *setup_ns = (t1 - t0) / 2;
+    *total_ns = t2 - t0;
+    return 0;
+}
+
+int dma_tune_calibrate(struct dma_engine *engine, struct udmabuf *buf, struct dma_tuning *tuning)
+{
+    unsigned sizes[MAX_CAL_SIZES];
+    uint64_t totals[MAX_CAL_SIZES], setup = ~0ULL, latency, chunk_ns;
+    unsigned num_sizes = 0, size, i, chunk;
+    double bytes_per_ns;
+
+    for (size = MIN_CAL_SIZE; size <= buf->size / 2 && size <= dma_max_length(engine)
+        && num_sizes < MAX_CAL_SIZES; size *= 2)
+    {
+        /* the minimum filters out preemptions */
+        unsigned rep, reps = size <= 65536U ? 32 : 8;
+
+        totals[num_sizes] = ~0ULL;
+        for (rep = 0; rep < reps; rep++)
+        {
+            uint64_t s, t;
+            if (loopback_round(engine, buf, size, &s, &t) != 0)
+            {
+                return -1;
+            }
+            setup = s < setup ? s : setup;
+            totals[num_sizes] = t < totals[num_sizes] ? t : totals[num_sizes];
+        }
+        sizes[num_sizes++] = size;
+    }
+    if (num_sizes < 2)
+    {
+        printf("%s: the UDMA buffer must hold at least %u bytes\n", __func__, 4 * MIN_CAL_SIZE);
+        return -1;
+    }
+
+    /* the marginal cost of the largest transfers gives the bandwidth */
+    i = num_sizes - 1;
+    if (totals[i] > totals[i - 1])
+    {
+        bytes_per_ns = (double)(sizes[i] - sizes[i - 1]) / (double)(totals[i] - totals[i - 1]);
+    } else
+    {
+        bytes_per_ns = (double)sizes[i] / (double)totals[i];
+    }
+    /* what the smallest transfer costs beyond setup and data movement */
+    latency = (double)totals[0] > 2.0 * (double)setup + sizes[0] / bytes_per_ns ?
+        (uint64_t)((double)totals[0] - 2.0 * (double)setup - sizes[0] / bytes_per_ns) : 0;
+
+    chunk = sizes[num_sizes - 1];
+    for (i = 0; i < num_sizes; i++)
+    {
+        if ((double)sizes[i] / (double)totals[i] >= 0.9 * bytes_per_ns)
+        {
+            chunk = sizes[i];
+            break;
+        }
+    }
+    chunk_ns = (uint64_t)(chunk / bytes_per_ns);
+
+    memset(tuning, 0, sizeof(*tuning));
+    tuning->chunk_size = chunk;
+    tuning->setup_ns = (unsigned)setup;
+    tuning->latency_ns = (unsigned)latency;
+    tuning->sleep_ns = (unsigned)measure_sleep();
+    tuning->bytes_per_us = (unsigned)(bytes_per_ns * 1000.0 + 0.5);
+    if (tuning->bytes_per_us == 0)
+    {
+        tuning->bytes_per_us = 1;
+    }
+    /* enough chunks in flight to hide setup and completion while one is transferred */
+    tuning->depth = 2 + (unsigned)((2 * setup + latency) / (chunk_ns > 0 ? chunk_ns : 1));
+    tuning->depth = tuning->depth > MAX_DEPTH ? MAX_DEPTH : tuning->depth;
+    tuning->usleep_timeout = chunk_ns < 2ULL * tuning->sleep_ns ? 0 : (unsigned)(chunk_ns / 4000ULL);
+    return 0;
+}
@@ -0,0 +1,100 @@
+
+#ifndef DMA_TUNE_H_
+#define DMA_TUNE_H_
+
+/**
+ * @file dma_tune.h
+ * @author Alberto Scolari
+ * @brief Header with API to calibrate DMA engines and to store their tuning in a profile,
+ * which the library reads when engines are mapped.
+ *
+ * Calibration measures, on a loopback design (the MM2S stream of the engine connected
+ * to its S2MM stream, as in the passthrough test), the cost of setting up a transaction,
+ * the steady-state bandwidth, the latency to observe completions and the actual duration
+ * of the shortest sleep, and derives from them:
+ * - the chunk size, as the smallest transaction size reaching 90% of the peak bandwidth
+ * - the pipeline depth, as the number of chunks in flight hiding setup and completion latency
+ * - the wait policy: waits given DMA_USLEEP_AUTO busy wait if the transaction is expected to end
+ *   within two sleeps, and otherwise sleep for a quarter of the expected duration at a time
+ *
+ * The profile is a text file with a line per engine, e.g.
+ * @code
+ * 0x40400000 chunk=65536 depth=2 usleep=0 setup_ns=2100 latency_ns=800 sleep_ns=60000 bw=580
+ * @endcode
+ * with bandwidth in bytes per microsecond (i.e. MB/s); it is read from the path in
+ * the environment variable DMA_TUNE_PROFILE, if set, or from DMA_TUNE_DEF_PROFILE.
+ * Engines not in the profile use defaults: 64 KiB chunks, depth 2 and busy waits.
+ * The tools/dma_calibrate tool calibrates engines and writes the profile.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dma_engine_buf.h"
+
+#define DMA_TUNE_PROFILE_ENV "DMA_TUNE_PROFILE" /**< variable with the path of the profile */
+#define DMA_TUNE_DEF_PROFILE "/etc/dmabuf_tune.profile" /**< default path of the profile */
+#define DMA_TUNE_DEF_CHUNK (64U * 1024U) /**< chunk size of uncalibrated engines */
+#define DMA_TUNE_DEF_DEPTH 2U /**< pipeline depth of uncalibrated engines */
+
+/**
+ * @brief dma_tune_calibrate measures @p engine, which must be in a loopback design,
+ * using @p buf, and fills @p tuning
+ *
+ * @param engine the DMA engine, in Direct Register Mode
+ * @param buf the UDMA buffer to transfer from and to; its size bounds the sizes measured
+ * (half of it is sent, to the other half), as does @ref dma_max_length
+ * @param tuning the user-allocated struct to fill
+ * @return 0 for success, non-0 if transactions fail or do not complete within a second,
+ * e.g. because the engine is not in a loopback design; the engine is then reset, so that
+ * no transaction is left running
+ */
+int dma_tune_calibrate(struct dma_engine *engine, struct udmabuf *buf, struct dma_tuning *tuning);
+
+/**
+ * @brief dma_tune_load (re)loads the tuning profile from @p path, which following calls
+ * to @ref get_dma_interfaces and @ref dma_tune_apply use
+ *
+ * @param path the profile; if NULL, the path from DMA_TUNE_PROFILE or the default one
+ * @return the number of engines in the profile, negative value if it cannot be read
+ */
+int dma_tune_load(const char *path);
+
+/**
+ * @brief dma_tune_save stores the tuning of @p num engines into the profile at @p path,
+ * replacing their previous entries and keeping those of other engines
+ *
+ * @param path the profile; if NULL, the path from DMA_TUNE_PROFILE or the default one
+ * @param phys_addrs physical addresses of the engines
+ * @param tunings tuning of each engine
+ * @param num number of engines
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_tune_save(const char *path, const phys_addr_t *phys_addrs, const struct dma_tuning *tunings,
+    unsigned num);
+
+/**
+ * @brief dma_tune_apply sets the tuning of @p engine from the profile, loading it
+ * on first use, or the defaults
+ *
+ * @param engine the DMA engine, whose @ref dma_engine.phys_addr identifies it in the profile
+ */
+void dma_tune_apply(struct dma_engine *engine);
+
+/**
+ * @brief dma_tune_usleep resolves DMA_USLEEP_AUTO into the sleeping interval to wait for
+ * a transaction of @p length bytes on @p engine; other values are returned unchanged
+ *
+ * @param engine the DMA engine
+ * @param length length of the transaction
+ * @param usleep_timeout the interval given to the wait call
+ * @return the sleeping interval, 0 for busy wait
+ */
+unsigned dma_tune_usleep(const struct dma_engine *engine, unsigned length, unsigned usleep_timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_TUNE_H_ */
@@ -0,0 +1,217 @@
+
+/**
+ * @file dma_uring.c
+ * @author Alberto Scolari
+ * @brief Implementation of the minimal io_uring wrapper used by the streaming utilities.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "uring_internals.h"
+
+/* syscall numbers are shared by all architectures since Linux 5.1 */
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+#define __load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define __store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int dma_uring_init(struct dma_uring *ring, unsigned entries)
+{
+    struct io_uring_params params;
+    char *sq, *cq;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = sys_io_uring_setup(entries, &params);
+    if (ring->fd < 0)
+    {
+        printf("%s: io_uring_setup failed: %s\n", __func__, strerror(errno));
+        return -1;
+    }
+    ring->entries = params.sq_entries;
+
+    ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cq_len > ring->sq_len)
+        {
+            ring->sq_len = ring->cq_len;
+        }
+        ring->cq_len = ring->sq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED)
+    {
+        printf("%s: cannot mmap submission queue\n", __func__);
+        close(ring->fd);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->cq_ptr = ring->sq_ptr;
+    } else
+    {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED)
+        {
+            printf("%s: cannot mmap completion queue\n", __func__);
+            munmap(ring->sq_ptr, ring->sq_len);
+            close(ring->fd);
+            return -1;
+        }
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        printf("%s: cannot mmap submission entries\n", __func__);
+        if (ring->cq_ptr != ring->sq_ptr)
+        {
+            munmap(ring->cq_ptr, ring->cq_len);
+        }
+        munmap(ring->sq_ptr, ring->sq_len);
+        close(ring->fd);
+        return -1;
+    }
+
+    sq = (char *)ring->sq_ptr;
+    cq = (char *)ring->cq_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    ring->sqe_tail = *ring->sq_tail;
+    return 0;
+}
+
+void dma_uring_exit(struct dma_uring *ring)
+{
+    munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr != ring->sq_ptr)
+    {
+        munmap(ring->cq_ptr, ring->cq_len);
+    }
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->fd);
+}
+
+int dma_uring_register_buffer(struct dma_uring *ring, void *addr, size_t len)
+{
+    struct iovec iov;
+
+    iov.iov_base = addr;
+    iov.iov_len = len;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+    {
+        return -1;
+    }
+    ring->fixed = 1;
+    return 0;
+}
+
+struct io_uring_sqe *dma_uring_get_sqe(struct dma_uring *ring)
+{
+    struct io_uring_sqe *sqe;
+    unsigned head = __load_acquire(ring->sq_head);
+
+    if (ring->sqe_tail - head >= ring->entries)
+    {
+        return NULL;
+    }
+    sqe = ring->sqes + (ring->sqe_tail & *ring->sq_mask);
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[ring->sqe_tail & *ring->sq_mask] = ring->sqe_tail & *ring->sq_mask;
+    ring->sqe_tail++;
+    return sqe;
+}
+
+int dma_uring_submit(struct dma_uring *ring, unsigned wait_nr)
+{
+    unsigned to_submit;
+    int ret;
+
+    __store_release(ring->sq_tail, ring->sqe_tail);
+    /* entries published by a failed call are still to be consumed by the kernel */
+    to_submit = ring->sqe_tail - __load_acquire(ring->sq_head);
+    if (to_submit == 0 && wait_nr == 0)
+    {
+        return 0;
+    }
+    do {
+        ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr,
+            wait_nr != 0 ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? -errno : ret;
+}
+
+struct io_uring_cqe *dma_uring_peek_cqe(struct dma_uring *ring)
+{
+    unsigned head = *ring->cq_head;
+
+    if (head == __load_acquire(ring->cq_tail))
+    {
+        return NULL;
+    }
+    return ring->cqes + (head & *ring->cq_mask);
+}
+
+struct io_uring_cqe *dma_uring_wait_cqe(struct dma_uring *ring)
+{
+    struct io_uring_cqe *cqe;
+
+    while ( (cqe = dma_uring_peek_cqe(ring)) == NULL )
+    {
+        int ret = dma_uring_submit(ring, 1);
+        if (ret < 0)
+        {
+            printf("%s: io_uring_enter failed: %s\n", __func__, strerror(-ret));
+            return NULL;
+        }
+    }
+    return cqe;
+}
+
+void dma_uring_cqe_seen(struct dma_uring *ring)
+{
+    __store_release(ring->cq_head, *ring->cq_head + 1);
+}
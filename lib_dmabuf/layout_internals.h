@@ -0,0 +1,47 @@
+#ifndef LAYOUT_INTERNALS_H_
+#define LAYOUT_INTERNALS_H_
+
+/**
+ * @file layout_internals.h
+ * @author Alberto Scolari
+ * @brief Header for the vectorized loops of dma_layout.c that are built in translation units
+ * of their own, with the compiler flags enabling their instruction set (see copy_internals.h).
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dma_layout.h"
+
+/* bytes of a narrow value of type @p type */
+static inline unsigned narrow_size(enum dma_narrow_type type)
+{
+    return type == DMA_NARROW_S8 || type == DMA_NARROW_U8 ? 1U : 2U;
+}
+
+#if defined(__aarch64__) || defined(__arm__)
+#define LAYOUT_NEON
+
+/*
+ * the loops have the semantics of the split, merge, widen and narrow members of layout_impl
+ * in dma_layout.c: they return how many records or values they converted, from the first
+ */
+size_t dma_layout_neon_split(uint32_t *const *dsts, const unsigned char *src, unsigned fields,
+    size_t count);
+size_t dma_layout_neon_merge(unsigned char *dst, const uint32_t *const *srcs, unsigned fields,
+    size_t count);
+size_t dma_layout_neon_widen(uint32_t *dst, const unsigned char *src, enum dma_narrow_type type,
+    size_t count);
+size_t dma_layout_neon_narrow(unsigned char *dst, enum dma_narrow_type type, const uint32_t *src,
+    size_t count);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LAYOUT_INTERNALS_H_ */
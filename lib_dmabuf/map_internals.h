@@ -0,0 +1,41 @@
+
+#ifndef MAP_INTERNALS_H_
+#define MAP_INTERNALS_H_
+
+/**
+ * @file map_internals.h
+ * @author Alberto Scolari
+ * @brief Header for the internal utility mapping UDMA buffers and register areas
+ * according to the mapping policy set via @ref set_mapping_policy.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief map_device_memory mmap()s @p length bytes of @p fd from @p offset, for read and write,
+ * applying the current mapping policy
+ *
+ * @param fd file descriptor to map from
+ * @param length length of the mapping
+ * @param offset offset in the file
+ * @param prefault 1 to also fault the pages in by reading them when pre-population is requested;
+ * it must be 0 for register areas, where reads may have side effects
+ * @return the mapped address, MAP_FAILED on error
+ */
+void *map_device_memory(int fd, size_t length, off_t offset, int prefault);
+
+/**
+ * @brief unmap_device_memory releases a mapping created via @ref map_device_memory
+ */
+void unmap_device_memory(void *addr, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAP_INTERNALS_H_ */
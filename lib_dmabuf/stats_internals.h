@@ -0,0 +1,67 @@
+
+#ifndef STATS_INTERNALS_H_
+#define STATS_INTERNALS_H_
+
+/**
+ * @file stats_internals.h
+ * @author Alberto Scolari
+ * @brief Header for the internal hooks updating the telemetry counters
+ * described in @ref dma_stats.h.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dma_engine_buf.h"
+#include "dma_stats.h"
+
+/**
+ * @brief non-0 if the counters of time are taken (DMA_STATS=time), set when the segment
+ * is created
+ */
+extern int dma_stats_timed;
+
+/**
+ * @brief dma_stats_time returns the time to account busy and waiting times with:
+ * @ref dma_stats_now if they are taken, 0 otherwise, so that no clock is read
+ */
+static inline uint64_t dma_stats_time(void)
+{
+    return dma_stats_timed ? dma_stats_now() : 0;
+}
+
+/**
+ * @brief dma_stats_engine_slot takes the counters for the engine at @p phys_addr,
+ * creating the segment if needed
+ * @return the counters, NULL if telemetry is disabled or no slot is left
+ */
+struct dma_stats_engine *dma_stats_engine_slot(phys_addr_t phys_addr);
+
+/**
+ * @brief dma_stats_kernel_slot takes the counters for the control interface at @p phys_addr,
+ * creating the segment if needed
+ * @return the counters, NULL if telemetry is disabled or no slot is left
+ */
+struct dma_stats_kernel *dma_stats_kernel_slot(phys_addr_t phys_addr);
+
+/**
+ * @brief dma_stats_release gives back a slot taken via @ref dma_stats_engine_slot
+ * or @ref dma_stats_kernel_slot, whose counters stay visible until reused
+ *
+ * @param in_use the in_use field of the slot, or NULL
+ */
+void dma_stats_release(uint32_t *in_use);
+
+/**
+ * @brief dma_stats_complete accounts for a transfer of @p bytes, whose completion has been
+ * observed at @p now_ns with status register @p status
+ */
+void dma_stats_complete(struct dma_stats_channel *stats, unsigned bytes, uint32_t status,
+    uint64_t now_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATS_INTERNALS_H_ */
@@ -0,0 +1,61 @@
+
+#ifndef TRACE_INTERNALS_H_
+#define TRACE_INTERNALS_H_
+
+/**
+ * @file trace_internals.h
+ * @author Alberto Scolari
+ * @brief Header for the internal hooks recording events into the timeline
+ * started via @ref dma_trace_start.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief kinds of objects owning a track
+ */
+enum dma_trace_track { DMA_TRACE_TO_DEV = 0, /**< MM2S direction of a DMA engine */
+                       DMA_TRACE_FROM_DEV, /**< S2MM direction of a DMA engine */
+                       DMA_TRACE_KERNEL /**< kernel behind a control interface */
+                     };
+
+/**
+ * @brief kinds of events
+ */
+enum dma_trace_event { DMA_TRACE_SET = 0, /**< transaction programmed */
+                       DMA_TRACE_START, /**< transaction or kernel started */
+                       DMA_TRACE_COMPLETE, /**< completion observed */
+                       DMA_TRACE_WAIT_BEGIN, /**< calling thread starts waiting */
+                       DMA_TRACE_WAIT_END /**< calling thread stops waiting */
+                     };
+
+/**
+ * @brief 1 while the tracer is running
+ */
+extern int dma_trace_active;
+
+/**
+ * @brief dma_trace_record appends an event to the buffer of the calling thread
+ *
+ * @param obj the DMA engine or control interface owning the track
+ * @param track kind of @p obj and direction
+ * @param event kind of event
+ * @param bytes number of bytes of the transaction, if any
+ */
+void dma_trace_record(const void *obj, enum dma_trace_track track, enum dma_trace_event event,
+    unsigned bytes);
+
+/**
+ * @brief DMA_TRACE records an event only if the tracer is running
+ */
+#define DMA_TRACE(obj, track, event, bytes) do { \
+        if (dma_trace_active) dma_trace_record(obj, track, event, bytes); \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_INTERNALS_H_ */
@@ -0,0 +1,106 @@
+
+#ifndef URING_INTERNALS_H_
+#define URING_INTERNALS_H_
+
+/**
+ * @file uring_internals.h
+ * @author Alberto Scolari
+ * @brief Header for the minimal io_uring wrapper used internally by the streaming
+ * ingest and spooling utilities.
+ *
+ * The library does not depend on liburing: rings are set up and driven directly
+ * via the io_uring system calls and the shared submission/completion queues.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/**
+ * @brief The dma_uring struct stores the state of an io_uring instance mmap()ed
+ * into the process memory.
+ */
+struct dma_uring {
+    int fd; /**< file descriptor returned by io_uring_setup() */
+    unsigned entries; /**< number of entries of the submission queue */
+    void *sq_ptr; /**< mapping of the submission queue ring */
+    size_t sq_len; /**< length of the submission queue ring mapping */
+    void *cq_ptr; /**< mapping of the completion queue ring (may be equal to sq_ptr) */
+    size_t cq_len; /**< length of the completion queue ring mapping */
+    struct io_uring_sqe *sqes; /**< array of submission queue entries */
+    size_t sqes_len; /**< length of the submission queue entries mapping */
+    unsigned *sq_head; /**< submission queue head, written by kernel */
+    unsigned *sq_tail; /**< submission queue tail, written by the library */
+    unsigned *sq_mask; /**< submission queue index mask */
+    unsigned *sq_array; /**< submission queue indirection array */
+    unsigned *cq_head; /**< completion queue head, written by the library */
+    unsigned *cq_tail; /**< completion queue tail, written by kernel */
+    unsigned *cq_mask; /**< completion queue index mask */
+    struct io_uring_cqe *cqes; /**< array of completion queue entries */
+    unsigned sqe_tail; /**< local tail of acquired but not yet submitted entries */
+    int fixed; /**< 1 if a buffer has been registered for fixed I/O */
+};
+
+/**
+ * @brief dma_uring_init creates an io_uring instance with @p entries submission entries
+ * and maps its queues
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_uring_init(struct dma_uring *ring, unsigned entries);
+
+/**
+ * @brief dma_uring_exit unmaps the queues and closes the io_uring instance
+ */
+void dma_uring_exit(struct dma_uring *ring);
+
+/**
+ * @brief dma_uring_register_buffer registers [@p addr, @p addr + @p len) as fixed buffer 0
+ *
+ * Registration pins the pages of the buffer; it fails for mappings that cannot be pinned
+ * (e.g. some PFN-mapped device memory), in which case callers should fall back to
+ * non-fixed operations.
+ *
+ * @return 0 for success, non-0 otherwise
+ */
+int dma_uring_register_buffer(struct dma_uring *ring, void *addr, size_t len);
+
+/**
+ * @brief dma_uring_get_sqe returns a zeroed submission entry to be filled, or NULL
+ * if the submission queue is full
+ */
+struct io_uring_sqe *dma_uring_get_sqe(struct dma_uring *ring);
+
+/**
+ * @brief dma_uring_submit publishes the acquired entries to the kernel and optionally
+ * waits for @p wait_nr completions; entries published by a previous call that failed are
+ * submitted again
+ * @return number of submitted entries, negative errno value on error
+ */
+int dma_uring_submit(struct dma_uring *ring, unsigned wait_nr);
+
+/**
+ * @brief dma_uring_peek_cqe returns the oldest completion entry without waiting,
+ * or NULL if none is available; the entry must be released via @ref dma_uring_cqe_seen
+ */
+struct io_uring_cqe *dma_uring_peek_cqe(struct dma_uring *ring);
+
+/**
+ * @brief dma_uring_wait_cqe waits for a completion entry to be available and returns it;
+ * the entry must be released via @ref dma_uring_cqe_seen
+ * @return the completion entry, NULL on error
+ */
+struct io_uring_cqe *dma_uring_wait_cqe(struct dma_uring *ring);
+
+/**
+ * @brief dma_uring_cqe_seen releases the oldest completion entry to the kernel
+ */
+void dma_uring_cqe_seen(struct dma_uring *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* URING_INTERNALS_H_ */
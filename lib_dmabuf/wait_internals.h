@@ -0,0 +1,71 @@
+#ifndef WAIT_INTERNALS_H_
+#define WAIT_INTERNALS_H_
+
+/**
+ * @file wait_internals.h
+ * @author Alberto Scolari
+ * @brief Header for the internal sleep of the waits polling status registers and for the
+ * bounded wait of engine resets; including translation units must request POSIX.1b
+ * (_POSIX_C_SOURCE 199309L or later) for nanosleep().
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <time.h>
+
+#include "dma_engine_buf.h"
+#include "dma_stats.h"
+
+/**
+ * @brief usleep_nano sleeps @p utime microseconds between two polls
+ *
+ * Waits on engines resolve DMA_USLEEP_AUTO via @ref dma_tune_usleep beforehand; the other
+ * waits (kernels, CDMA and MCDMA engines) have nothing calibrated, and get the policy of
+ * uncalibrated engines: DMA_USLEEP_AUTO, like 0, busy waits.
+ */
+static inline void usleep_nano(unsigned utime)
+{
+    struct timespec __time;
+
+    if (utime == 0 || utime == DMA_USLEEP_AUTO)
+    {
+        return;
+    }
+    __time.tv_sec = utime / 1000000;
+    __time.tv_nsec = (utime % 1000000) * 1000;
+    nanosleep(&__time, NULL);
+}
+
+/**
+ * @brief time given to the resets of engines, which take a few cycles of their clocks
+ */
+#define DMA_RESET_TIMEOUT_NS 10000000ULL
+
+/**
+ * @brief dma_reset_done waits for the reset bit (bit 2) of the control register @p control
+ * of an AXI DMA, CDMA or MCDMA channel to clear, for DMA_RESET_TIMEOUT_NS at most; it never
+ * clears if the clocks of the engine or of its streams are stopped
+ *
+ * @return 0 if the reset completed, -1 otherwise
+ */
+static inline int dma_reset_done(volatile uint32_t *control)
+{
+    uint64_t deadline = dma_stats_now() + DMA_RESET_TIMEOUT_NS;
+
+    while ((*control & 4U) != 0)
+    {
+        if (dma_stats_now() >= deadline)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAIT_INTERNALS_H_ */
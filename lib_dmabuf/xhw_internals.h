@@ -37,24 +37,71 @@ extern "C" {
     (v) |= ( (new_val) << start) & __base_mask;                        \
     } while (0)
 
-#define __mem_sw_barrier() do {         \
-        asm volatile ("" ::: "memory"); \
+#define __mem_sw_barrier() do {                 \
+        __asm__ __volatile__ ("" ::: "memory"); \
     } while (0)
 
 #define __mem_full_barrier() __sync_synchronize()
 
+/*
+ * Barriers for accesses to device registers (uncached, mapped from /dev/mem) and to UDMA buffers
+ * (cached or not, read by the devices), with the weakest instruction each architecture allows:
+ * - __mmio_wmb() orders register writes before following register writes
+ * - __mmio_rmb() orders register reads before following reads, e.g. a status read before reading
+ *   the memory the engine has just written
+ * - __mmio_mb() orders all accesses before all following ones, e.g. a register write before
+ *   a read that depends on it
+ * - __doorbell_barrier() precedes the write starting the device (length, tail descriptor or
+ *   ap_start): it makes all previous writes, to registers and to memory, visible to the device
+ * On ARM, registers are Device memory, whose accesses to the same peripheral are already in order,
+ * and only the outer-shareable domain is involved; x86 keeps stores and uncached accesses in order,
+ * so that only the compiler must be stopped, except for the store-load ordering.
+ * Building with -DDMA_BARRIER_FULL uses __mem_full_barrier() everywhere, for comparison.
+ */
+#if defined(DMA_BARRIER_FULL)
+#define __mmio_wmb() __mem_full_barrier()
+#define __mmio_rmb() __mem_full_barrier()
+#define __mmio_mb() __mem_full_barrier()
+#define __doorbell_barrier() __mem_full_barrier()
+#elif defined(__aarch64__)
+#define __mmio_wmb() __asm__ __volatile__ ("dmb oshst" ::: "memory")
+#define __mmio_rmb() __asm__ __volatile__ ("dmb oshld" ::: "memory")
+#define __mmio_mb() __asm__ __volatile__ ("dmb osh" ::: "memory")
+#define __doorbell_barrier() __asm__ __volatile__ ("dsb st" ::: "memory")
+#elif defined(__arm__) && defined(__ARM_ARCH) && __ARM_ARCH >= 7
+/* ARMv7 has no load-only barrier */
+#define __mmio_wmb() __asm__ __volatile__ ("dmb oshst" ::: "memory")
+#define __mmio_rmb() __asm__ __volatile__ ("dmb osh" ::: "memory")
+#define __mmio_mb() __asm__ __volatile__ ("dmb osh" ::: "memory")
+#define __doorbell_barrier() __asm__ __volatile__ ("dsb st" ::: "memory")
+#elif defined(__x86_64__) || defined(__i386__)
+#define __mmio_wmb() __mem_sw_barrier()
+#define __mmio_rmb() __mem_sw_barrier()
+#define __mmio_mb() __asm__ __volatile__ ("mfence" ::: "memory")
+/* orders also non-temporal stores into UDMA buffers */
+#define __doorbell_barrier() __asm__ __volatile__ ("sfence" ::: "memory")
+#else
+#define __mmio_wmb() __mem_full_barrier()
+#define __mmio_rmb() __mem_full_barrier()
+#define __mmio_mb() __mem_full_barrier()
+#define __doorbell_barrier() __mem_full_barrier()
+#endif
+
 /*
  * --------- AXI DMA --------- 
  */
 /**
  * @brief The axi_direct_dma_regs struct describes the physical layout of Xilinx AXI DMA registers
  * for Direct Mode, as from https://www.xilinx.com/support/documentation/ip_documentation/axi_dma/v7_1/pg021_axi_dma.pdf
- * page 12
+ * page 12; the descriptor pointers are used only in Scatter/Gather mode
  */
 struct axi_direct_dma_regs {
     uint32_t mm2s_control;
     uint32_t mm2s_status;
-    uint32_t mm2s_reserved1[4];
+    uint32_t mm2s_cur_desc_low;
+    uint32_t mm2s_cur_desc_high;
+    uint32_t mm2s_tail_desc_low;
+    uint32_t mm2s_tail_desc_high;
     uint32_t mm2s_source_addr_low;
     uint32_t mm2s_source_addr_high;
     uint32_t mm2s_reserved2[2];
@@ -64,16 +111,149 @@ struct axi_direct_dma_regs {
 
     uint32_t s2mm_control;
     uint32_t s2mm_status;
-    uint32_t s2mm_reserved4[4];
+    uint32_t s2mm_cur_desc_low;
+    uint32_t s2mm_cur_desc_high;
+    uint32_t s2mm_tail_desc_low;
+    uint32_t s2mm_tail_desc_high;
     uint32_t s2mm_dest_addr_low;
     uint32_t s2mm_dest_addr_high;
     uint32_t s2mm_reserved[2];
     uint32_t s2mm_length;
 } __attribute__((packed));
 
+/**
+ * @brief The axi_dma_sg_desc struct describes the layout of a Scatter/Gather descriptor
+ * of Xilinx AXI DMA in memory, as from PG021 page 38;
+ * descriptors must be aligned to @ref AXI_DMA_SG_DESC_ALIGN
+ */
+struct axi_dma_sg_desc {
+    uint32_t next_desc_low;
+    uint32_t next_desc_high;
+    uint32_t buffer_addr_low;
+    uint32_t buffer_addr_high;
+    uint32_t reserved[2];
+    uint32_t control;
+    uint32_t status;
+    uint32_t app[5];
+} __attribute__((packed));
+
+#define AXI_DMA_SG_DESC_ALIGN 64
 #define AXI_DMA_REGISTER_LOCATION 0x40400000
 #define DESCRIPTOR_REGISTERS_SIZE 0x10000
 
+/*
+ * --------- AXI CDMA ---------
+ */
+/**
+ * @brief The axi_cdma_regs struct describes the physical layout of Xilinx AXI Central DMA registers,
+ * as from https://www.xilinx.com/support/documentation/ip_documentation/axi_cdma/v4_1/pg034-axi-cdma.pdf
+ * page 14
+ */
+struct axi_cdma_regs {
+    uint32_t control;
+    uint32_t status;
+    uint32_t cur_desc_low;
+    uint32_t cur_desc_high;
+    uint32_t tail_desc_low;
+    uint32_t tail_desc_high;
+    uint32_t source_addr_low;
+    uint32_t source_addr_high;
+    uint32_t dest_addr_low;
+    uint32_t dest_addr_high;
+    uint32_t bytes_to_transfer;
+} __attribute__((packed));
+
+/**
+ * @brief The axi_cdma_sg_desc struct describes the layout of a Scatter/Gather descriptor
+ * of AXI Central DMA in memory; descriptors must be aligned to @ref AXI_CDMA_SG_DESC_ALIGN
+ */
+struct axi_cdma_sg_desc {
+    uint32_t next_desc_low;
+    uint32_t next_desc_high;
+    uint32_t source_addr_low;
+    uint32_t source_addr_high;
+    uint32_t dest_addr_low;
+    uint32_t dest_addr_high;
+    uint32_t control;
+    uint32_t status;
+} __attribute__((packed));
+
+#define AXI_CDMA_SG_DESC_ALIGN 64
+#define AXI_CDMA_REGISTER_LOCATION 0x7E200000
+
+/*
+ * --------- AXI MCDMA ---------
+ */
+#define AXI_MCDMA_MAX_CHANNELS 16
+
+/**
+ * @brief The axi_mcdma_channel_regs struct describes the registers of a single channel
+ * of Xilinx AXI Multichannel DMA, as from
+ * https://www.xilinx.com/support/documentation/ip_documentation/axi_mcdma/v1_0/pg288-axi-mcdma.pdf
+ * page 17; the last words hold packet counters, whose meaning depends on the direction
+ */
+struct axi_mcdma_channel_regs {
+    uint32_t control;
+    uint32_t status;
+    uint32_t cur_desc_low;
+    uint32_t cur_desc_high;
+    uint32_t tail_desc_low;
+    uint32_t tail_desc_high;
+    uint32_t packet_stats[2];
+    uint32_t reserved[8];
+} __attribute__((packed));
+
+/**
+ * @brief The axi_mcdma_common_regs struct describes the registers shared among all the channels
+ * of one direction of Xilinx AXI Multichannel DMA; the scheduler registers exist only in the
+ * MM2S direction, while the S2MM direction has there the packet drop and completion registers
+ */
+struct axi_mcdma_common_regs {
+    uint32_t control;
+    uint32_t status;
+    uint32_t channel_enable;
+    uint32_t channel_in_progress;
+    uint32_t error;
+    uint32_t sched_type;
+    uint32_t wrr_weights[2];
+    uint32_t reserved[8];
+} __attribute__((packed));
+
+/**
+ * @brief The axi_mcdma_regs struct describes the physical layout of Xilinx AXI Multichannel DMA
+ * registers: common registers and per-channel registers of MM2S, followed by the same for S2MM
+ */
+struct axi_mcdma_regs {
+    struct axi_mcdma_common_regs mm2s_common;
+    struct axi_mcdma_channel_regs mm2s_channels[AXI_MCDMA_MAX_CHANNELS];
+    uint32_t reserved[48];
+    struct axi_mcdma_common_regs s2mm_common;
+    struct axi_mcdma_channel_regs s2mm_channels[AXI_MCDMA_MAX_CHANNELS];
+} __attribute__((packed));
+
+/**
+ * @brief The axi_mcdma_sg_desc struct describes the layout of a Scatter/Gather descriptor
+ * of Xilinx AXI Multichannel DMA in memory; descriptors must be aligned to @ref AXI_MCDMA_SG_DESC_ALIGN.
+ * MM2S descriptors have the sideband control word before the status word, S2MM descriptors
+ * have the status word first: @ref AXI_MCDMA_MM2S_STATUS and @ref AXI_MCDMA_S2MM_STATUS index them
+ */
+struct axi_mcdma_sg_desc {
+    uint32_t next_desc_low;
+    uint32_t next_desc_high;
+    uint32_t buffer_addr_low;
+    uint32_t buffer_addr_high;
+    uint32_t reserved;
+    uint32_t control;
+    uint32_t words[2];
+} __attribute__((packed));
+
+#define AXI_MCDMA_MM2S_STATUS 1
+#define AXI_MCDMA_S2MM_STATUS 0
+#define AXI_MCDMA_SG_DESC_ALIGN 64
+#define AXI_MCDMA_SCHED_RR 0
+#define AXI_MCDMA_SCHED_WRR 2
+#define AXI_MCDMA_REGISTER_LOCATION 0x40400000
+
 /*
  * --------- AXI CONTROL --------- 
  */
@@ -6,12 +6,20 @@
 
 set curdir [ file dirname [ file normalize [ info script ] ] ]
 
+# 32 bits values per stream word (1, 2 or 4), matching the stream width of the DMA engines
+if { [info exists ::env(VEC_2D_SUM_LANES)] } {
+	set lanes $::env(VEC_2D_SUM_LANES)
+} else {
+	set lanes 1
+}
+
 open_project -reset pynq_vec_2d_sum
 set_top top_vec_2d_sum
-add_files $curdir/src/vec_2d_sum.cpp
+add_files $curdir/src/vec_2d_sum.cpp -cflags "-DLANES=$lanes"
 add_files $curdir/src/io_utils.hpp
 add_files $curdir/src/stream_utils.hpp
-add_files -tb $curdir/src/vec_2d_sum_tb.cpp
+add_files $curdir/src/vec_2d_sum.hpp
+add_files -tb $curdir/src/vec_2d_sum_tb.cpp -cflags "-DLANES=$lanes"
 open_solution -reset "solution1"
 set_part {xc7z020clg400-3} -tool vivado
 create_clock -period 10 -name default
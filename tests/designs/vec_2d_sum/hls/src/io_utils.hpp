@@ -9,6 +9,23 @@
 typedef int32_t data_t;
 
 #define DATA_WIDTH ( ((int)sizeof(data_t)) * 8 )
-//#define MORE_THAN_32B
 
-typedef struct ap_axiu<DATA_WIDTH, 1, 1, 1> data_axis;
+// values per stream word: 1, 2 or 4 lanes, for 32, 64 or 128 bits AXI-Stream interfaces;
+// the AXI DMA engines of the block design must have the same stream width
+#ifndef LANES
+#define LANES 1
+#endif
+
+// AXI-Stream word carrying N values
+template<int N> struct stream_word
+{
+	typedef ap_axiu<DATA_WIDTH * N, 1, 1, 1> type;
+};
+
+// values of a word, processed in parallel
+template<int N> struct lanes_t
+{
+	data_t v[N];
+};
+
+typedef stream_word<LANES>::type data_axis;
@@ -1,4 +1,3 @@
-
 #pragma once
 
 #include <hls_stream.h>
@@ -11,60 +10,103 @@
 #define VAL2(x) x
 #define VAL(x) VAL2(x)
 
+// number of words carrying length values, the last one possibly partial
+template<int N> uint32_t num_words(const uint32_t length)
+{
+#pragma HLS INLINE
+	return (length + N - 1) / N;
+}
 
-template<typename DestT> void pump_data_in(hls::stream<data_axis> &inStream,
-		hls::stream<DestT>  &outStream,
-		const uint32_t length)
+// TKEEP of a word whose first valid lanes carry values: the bytes of the other lanes are null
+template<int N> ap_uint<N * DATA_WIDTH / 8> keep_mask(const uint32_t valid)
+{
+#pragma HLS INLINE
+	ap_uint<N * DATA_WIDTH / 8> keep = 0;
+	for (int l = 0; l < N; l++)
+	{
+#pragma HLS UNROLL
+		if ((uint32_t)l < valid)
+		{
+			keep.range(l * DATA_WIDTH / 8 + DATA_WIDTH / 8 - 1, l * DATA_WIDTH / 8) = (1 << (DATA_WIDTH / 8)) - 1;
+		}
+	}
+	return keep;
+}
+
+// value of lane l of data, lane 0 being the least significant (first in memory)
+template<int W> data_t get_lane(const ap_uint<W> &data, const int l)
+{
+#pragma HLS INLINE
+	union {uint32_t in; data_t out;} tmp;
+
+	tmp.in = (uint32_t)data.range(l * DATA_WIDTH + DATA_WIDTH - 1, l * DATA_WIDTH).to_uint();
+	return tmp.out;
+}
+
+template<int W> void set_lane(ap_uint<W> &data, const int l, const data_t value)
 {
+#pragma HLS INLINE
+	union {data_t in; uint32_t out;} tmp;
 
-#ifndef MORE_THAN_32B
-	typedef uint32_t bridge_t;
-#else
-	typedef uint64_t bridge_t;
-#endif
+	tmp.in = value;
+	data.range(l * DATA_WIDTH + DATA_WIDTH - 1, l * DATA_WIDTH) = tmp.out;
+}
 
-	for(uint32_t i = 0; i < length; i++)
+// reads the words carrying length values, lanes past the end (TKEEP null) being ignored
+template<int N> void pump_data_in(hls::stream<typename stream_word<N>::type> &inStream,
+		hls::stream<lanes_t<N> >  &outStream,
+		const uint32_t length)
+{
+	for(uint32_t i = 0; i < num_words<N>(length); i++)
 	{
 #pragma HLS PIPELINE II=1
-		union {bridge_t in; DestT out;} tmp;
-
-		tmp.in = (bridge_t)(inStream.read().data.to_uint());
-		outStream.write(tmp.out);
+		typename stream_word<N>::type inData = inStream.read();
+		lanes_t<N> out;
+
+		for (int l = 0; l < N; l++)
+		{
+#pragma HLS UNROLL
+			out.v[l] = get_lane(inData.data, l);
+		}
+		outStream.write(out);
 	}
 }
 
-template<typename T> void set_data_axis(data_axis &d, T data, int last)
+template<int N> void set_data_axis(typename stream_word<N>::type &d,
+		const ap_uint<DATA_WIDTH * N> &data, int last, uint32_t valid)
 {
 #pragma HLS INLINE
-	d.data = ap_uint<DATA_WIDTH>(data);
+	d.data = data;
 	d.dest = 0;
 	d.id = 0;
-	d.keep = (1 << (DATA_WIDTH / 8)) - 1;
-	d.strb = (1 << (DATA_WIDTH / 8)) - 1;
+	d.keep = keep_mask<N>(valid);
+	d.strb = keep_mask<N>(valid);
 	d.user = 0;
 	d.last = (last != 0)? ap_uint<1>(1) : ap_uint<1>(0);
 }
 
-template<typename InT> void pump_data_out(hls::stream<InT> &inStream,
-		hls::stream<data_axis>  &outStream,
+// writes length values, the last word keeping only the lanes carrying values
+template<int N> void pump_data_out(hls::stream<lanes_t<N> > &inStream,
+		hls::stream<typename stream_word<N>::type>  &outStream,
 		const uint32_t length)
 {
+	const uint32_t words = num_words<N>(length);
 
-#ifndef MORE_THAN_32B
-	typedef uint32_t bridge_t;
-#else
-	typedef uint64_t bridge_t;
-#endif
-
-	for(uint32_t i = 0; i < length; i++)
+	for(uint32_t i = 0; i < words; i++)
 	{
 #pragma HLS PIPELINE II=1
-		union {InT in; bridge_t out;} tmp;
-
-		tmp.in = inStream.read();
-
-		data_axis outData;
-		set_data_axis<bridge_t>(outData, tmp.out, i == length - 1);
+		lanes_t<N> in = inStream.read();
+		ap_uint<DATA_WIDTH * N> data = 0;
+		int last = i == words - 1;
+
+		for (int l = 0; l < N; l++)
+		{
+#pragma HLS UNROLL
+			set_lane(data, l, in.v[l]);
+		}
+
+		typename stream_word<N>::type outData;
+		set_data_axis<N>(outData, data, last, last ? length - i * N : N);
 
 		outStream.write(outData);
 	}
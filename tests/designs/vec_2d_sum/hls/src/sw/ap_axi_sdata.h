@@ -0,0 +1,17 @@
+#pragma once
+
+// Software stand-in of the AXI-Stream side-channel struct of Vivado HLS,
+// for C simulation without Vivado HLS
+
+#include "ap_int.h"
+
+template<int D, int U, int TI, int TD> struct ap_axiu
+{
+	ap_uint<D> data;
+	ap_uint<(D + 7) / 8> keep;
+	ap_uint<(D + 7) / 8> strb;
+	ap_uint<U> user;
+	ap_uint<1> last;
+	ap_uint<TI> id;
+	ap_uint<TD> dest;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+// Software stand-in of the arbitrary precision unsigned integers of Vivado HLS, covering what
+// the kernels and testbenches of this repository use, for C simulation without Vivado HLS;
+// bit ranges are at most 64 bits wide
+
+#include <stdint.h>
+
+template<int W> class ap_uint;
+
+// read-only bit range [hi, lo] of an ap_uint
+template<int W> class ap_range_cref
+{
+public:
+	ap_range_cref(const ap_uint<W> &value, int hi, int lo) : value(value), hi(hi), lo(lo) {}
+
+	unsigned long long to_uint64() const { return value.get_range(hi, lo); }
+	unsigned to_uint() const { return (unsigned)to_uint64(); }
+	operator unsigned long long() const { return to_uint64(); }
+
+private:
+	const ap_uint<W> &value;
+	int hi, lo;
+};
+
+// bit range [hi, lo] of an ap_uint, assignable
+template<int W> class ap_range_ref
+{
+public:
+	ap_range_ref(ap_uint<W> &value, int hi, int lo) : value(value), hi(hi), lo(lo) {}
+
+	ap_range_ref &operator=(unsigned long long bits)
+	{
+		value.set_range(hi, lo, bits);
+		return *this;
+	}
+	unsigned long long to_uint64() const { return value.get_range(hi, lo); }
+	unsigned to_uint() const { return (unsigned)to_uint64(); }
+	operator unsigned long long() const { return to_uint64(); }
+
+private:
+	ap_uint<W> &value;
+	int hi, lo;
+};
+
+template<int W> class ap_uint
+{
+public:
+	ap_uint(unsigned long long v = 0)
+	{
+		for (int i = 0; i < WORDS; i++)
+		{
+			words[i] = 0;
+		}
+		set_range(W < 64 ? W - 1 : 63, 0, v);
+	}
+
+	unsigned long long get_range(int hi, int lo) const
+	{
+		unsigned long long bits = 0;
+		for (int b = hi; b >= lo; b--)
+		{
+			bits = (bits << 1) | ((words[b / 64] >> (b % 64)) & 1ULL);
+		}
+		return bits;
+	}
+
+	void set_range(int hi, int lo, unsigned long long bits)
+	{
+		for (int b = lo; b <= hi; b++)
+		{
+			uint64_t mask = 1ULL << (b % 64);
+			if ((bits >> (b - lo)) & 1ULL)
+			{
+				words[b / 64] |= mask;
+			}
+			else
+			{
+				words[b / 64] &= ~mask;
+			}
+		}
+	}
+
+	ap_range_ref<W> range(int hi, int lo) { return ap_range_ref<W>(*this, hi, lo); }
+	ap_range_cref<W> range(int hi, int lo) const { return ap_range_cref<W>(*this, hi, lo); }
+
+	unsigned long long to_uint64() const { return get_range(W < 64 ? W - 1 : 63, 0); }
+	unsigned to_uint() const { return (unsigned)to_uint64(); }
+	operator unsigned long long() const { return to_uint64(); }
+
+private:
+	static const int WORDS = (W + 63) / 64;
+	uint64_t words[WORDS];
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+// Software stand-in of hls::stream of Vivado HLS, for C simulation without Vivado HLS:
+// an unbounded FIFO, as functions of a dataflow region run one after the other in simulation
+
+#include <deque>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace hls
+{
+
+template<typename T> class stream
+{
+public:
+	stream() : name("") {}
+	explicit stream(const char *name) : name(name) {}
+
+	T read()
+	{
+		T value;
+		if (fifo.empty())
+		{
+			// a read blocking forever in hardware
+			printf("hls::stream %s: read while empty\n", name);
+			exit(-1);
+		}
+		value = fifo.front();
+		fifo.pop_front();
+		return value;
+	}
+	void read(T &value) { value = read(); }
+	void write(const T &value) { fifo.push_back(value); }
+	bool empty() const { return fifo.empty(); }
+	bool full() const { return false; }
+	size_t size() const { return fifo.size(); }
+
+	stream &operator>>(T &value)
+	{
+		read(value);
+		return *this;
+	}
+	stream &operator<<(const T &value)
+	{
+		write(value);
+		return *this;
+	}
+
+private:
+	// streams are channels between functions, not values
+	stream(const stream &);
+	stream &operator=(const stream &);
+
+	std::deque<T> fifo;
+	const char *name;
+};
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <hls_stream.h>
+#include <stdint.h>
+
+#include "io_utils.hpp"
+#include "stream_utils.hpp"
+
+
+// computes the N lanes of a word per cycle
+template<int N> void compute(hls::stream<lanes_t<N> > &inStream1,
+		hls::stream<lanes_t<N> > &inStream2,
+		hls::stream<lanes_t<N> > &outStream,
+		uint32_t num,
+		data_t a,
+		data_t b,
+		data_t c)
+{
+	for(uint32_t i = 0; i < num_words<N>(num); i++)
+	{
+#pragma HLS PIPELINE II=1
+#pragma HLS latency min=2
+
+		lanes_t<N> in1 = inStream1.read();
+		lanes_t<N> in2 = inStream2.read();
+		lanes_t<N> out;
+
+		for (int l = 0; l < N; l++)
+		{
+#pragma HLS UNROLL
+			out.v[l] = a * in1.v[l] + b * in2.v[l] + c;
+		}
+
+		outStream.write(out);
+	}
+}
+
+
+// the kernel with N lanes per stream word; the top function instantiates it with LANES
+template<int N> void vec_2d_sum(hls::stream<typename stream_word<N>::type> &inStream1,
+		hls::stream<typename stream_word<N>::type> &inStream2,
+		hls::stream<typename stream_word<N>::type> &outStream,
+		const uint32_t num,
+		data_t a,
+		data_t b,
+		data_t c)
+{
+#pragma HLS DATAFLOW
+
+	hls::stream<lanes_t<N> > inData1("x_stream"), inData2("y_stream"), outData("z_stream");
+
+#pragma HLS STREAM variable=inData1 depth=1 dim=1
+#pragma HLS STREAM variable=inData2 depth=1 dim=1
+#pragma HLS STREAM variable=outData depth=1 dim=1
+#pragma HLS DATA_PACK variable=inData1
+#pragma HLS DATA_PACK variable=inData2
+#pragma HLS DATA_PACK variable=outData
+
+	pump_data_in<N>(inStream1, inData1, num);
+	pump_data_in<N>(inStream2, inData2, num);
+
+	compute<N>(inData1, inData2, outData, num, a, b, c);
+
+	pump_data_out<N>(outData, outStream, num);
+}
@@ -1,12 +1,12 @@
-
 #include <stdio.h>
 #include <stdint.h>
 #include <hls_stream.h>
 #include <ap_int.h>
 
 #include "stream_utils.hpp"
+#include "vec_2d_sum.hpp"
 
-#define NUM 25
+#define MAX_NUM 67
 #define A 1
 #define B 2
 #define C 3
@@ -19,63 +19,127 @@ extern void top_vec_2d_sum(hls::stream<data_axis> &inStream1,
 		data_t b,
 		data_t c);
 
-int main()
+// lengths covering single and multiple words, full and partial last words
+static const uint32_t lengths[] = { 1, 2, 3, 4, 5, 7, 8, 25, 64, 67 };
+
+// packs num values into words of N lanes, as the DMA engine reads them from memory
+template<int N> void pack(const int32_t *values, uint32_t num,
+		hls::stream<typename stream_word<N>::type> &stream)
 {
-	int32_t in1[NUM], in2[NUM], out[NUM];
-	unsigned i;
-	hls::stream<data_axis> inStream1, inStream2, outStream;
-	int errval = 0;
+	const uint32_t words = num_words<N>(num);
 
-	for (i = 0; i < NUM; i++)
+	for (uint32_t w = 0; w < words; w++)
 	{
-		in1[i] = -i;
-		in2[i] = NUM - i;
-		out[i] = 0;
-	}
+		ap_uint<DATA_WIDTH * N> data = 0;
+		uint32_t valid = w == words - 1 ? num - w * N : N;
+		typename stream_word<N>::type d;
 
-	// pump data to core
-	for (i = 0; i < NUM; i++)
-	{
-		data_axis da1, da2;
-		set_data_axis<uint32_t>(da1, 0, 0);
-		set_data_axis<uint32_t>(da2, 0, 0);
-
-		da1.data = ap_uint<32>(in1[i]);
-		inStream1.write(da1);
-		da2.data = ap_uint<32>(in2[i]);
-		inStream2.write(da2);
+		for (uint32_t l = 0; l < valid; l++)
+		{
+			set_lane(data, (int)l, values[w * N + l]);
+		}
+		set_data_axis<N>(d, data, w == words - 1, valid);
+		stream.write(d);
 	}
+}
 
-	top_vec_2d_sum(inStream1, inStream2, outStream, NUM, A, B, C);
+// checks the values, TKEEP and TLAST of the words the kernel wrote
+template<int N> int check(const int32_t *in1, const int32_t *in2, uint32_t num,
+		hls::stream<typename stream_word<N>::type> &stream)
+{
+	const uint32_t words = num_words<N>(num);
+	int errval = 0;
 
-	for (i = 0; i < NUM; i++)
+	for (uint32_t w = 0; w < words; w++)
 	{
-		union {uint32_t u; int32_t i;} u2i;
-		data_axis out = outStream.read();
-		u2i.u = out.data.to_uint();
+		typename stream_word<N>::type out;
+		uint32_t valid = w == words - 1 ? num - w * N : N;
 
-		int32_t oracle = A * in1[i] + B * in2[i] + C;
-		if (u2i.i != oracle)
+		if (stream.empty())
 		{
-			printf("index %u: received %d instead of %d\n", i, u2i.i, oracle);
-			errval = -1;
+			printf("%d lanes, %u values: word %u missing\n", N, num, w);
+			return -1;
 		}
-		if (i < NUM - 1 && out.last)
+		out = stream.read();
+		for (uint32_t l = 0; l < valid; l++)
 		{
-			printf("value %u set TLAST!\n", i);
-			errval = -1;
+			uint32_t i = w * N + l;
+			int32_t oracle = A * in1[i] + B * in2[i] + C;
+			if (get_lane(out.data, (int)l) != oracle)
+			{
+				printf("%d lanes, %u values: index %u received %d instead of %d\n", N, num, i,
+						get_lane(out.data, (int)l), oracle);
+				errval = -1;
+			}
 		}
-		if (i == NUM - 1 && !out.last)
+		if (out.keep.to_uint() != keep_mask<N>(valid).to_uint())
 		{
-			printf("last value did NOT set TLAST!\n");
+			printf("%d lanes, %u values: word %u has TKEEP 0x%x instead of 0x%x\n", N, num, w,
+					out.keep.to_uint(), keep_mask<N>(valid).to_uint());
 			errval = -1;
 		}
-		if (i == NUM - 1 && out.last)
+		if ((out.last.to_uint() != 0) != (w == words - 1))
 		{
-			printf("last value properly set TLAST!\n");
+			printf("%d lanes, %u values: word %u has TLAST %u\n", N, num, w, out.last.to_uint());
+			errval = -1;
 		}
 	}
+	if (!stream.empty())
+	{
+		printf("%d lanes, %u values: more than %u words written\n", N, num, words);
+		errval = -1;
+	}
+	return errval;
+}
 
+template<int N> int run_test(uint32_t num,
+		void (*kernel)(hls::stream<typename stream_word<N>::type> &,
+				hls::stream<typename stream_word<N>::type> &,
+				hls::stream<typename stream_word<N>::type> &,
+				const uint32_t, data_t, data_t, data_t))
+{
+	int32_t in1[MAX_NUM], in2[MAX_NUM];
+	hls::stream<typename stream_word<N>::type> inStream1, inStream2, outStream;
+
+	for (uint32_t i = 0; i < num; i++)
+	{
+		in1[i] = -(int32_t)i;
+		in2[i] = (int32_t)(num - i);
+	}
+	pack<N>(in1, num, inStream1);
+	pack<N>(in2, num, inStream2);
+
+	kernel(inStream1, inStream2, outStream, num, A, B, C);
+
+	return check<N>(in1, in2, num, outStream);
+}
+
+template<int N> int run_lengths()
+{
+	int errval = 0;
+
+	for (unsigned t = 0; t < sizeof(lengths) / sizeof(lengths[0]); t++)
+	{
+		errval |= run_test<N>(lengths[t], vec_2d_sum<N>);
+	}
+	printf("%d lanes: %s\n", N, errval ? "ERRORS" : "ok");
+	return errval;
+}
+
+int main()
+{
+	int errval = 0;
+
+	errval |= run_lengths<1>();
+	errval |= run_lengths<2>();
+	errval |= run_lengths<4>();
+
+	// the synthesized top function, with the LANES of the build
+	for (unsigned t = 0; t < sizeof(lengths) / sizeof(lengths[0]); t++)
+	{
+		errval |= run_test<LANES>(lengths[t], top_vec_2d_sum);
+	}
+	printf("top function, %d lanes: %s\n", LANES, errval ? "ERRORS" : "ok");
 
 	if (!errval)
 	{
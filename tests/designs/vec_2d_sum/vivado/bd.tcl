@@ -53,6 +53,16 @@ if { $list_projs eq "" } {
 
 set curdir [ file dirname [ file normalize [ info script ] ] ]
 set repo_dir [ file dirname $curdir ]
+
+# stream width of the DMA engines, matching the lanes of the HLS kernel (see hls/hls.tcl);
+# the realignment engines support streams up to 64 bits
+if { [info exists ::env(VEC_2D_SUM_LANES)] } {
+   set lanes $::env(VEC_2D_SUM_LANES)
+} else {
+   set lanes 1
+}
+set stream_width [expr {32 * $lanes}]
+set stream_dre [expr {$stream_width <= 64 ? 1 : 0}]
 append repo_dir "/hls/pynq_vec_2d_sum/solution1"
 
 
@@ -176,10 +186,14 @@ proc create_root_design { parentCell } {
   # Create instance: axi_dma_0, and set properties
   set axi_dma_0 [ create_bd_cell -type ip -vlnv xilinx.com:ip:axi_dma:7.1 axi_dma_0 ]
   set_property -dict [ list \
-CONFIG.c_include_mm2s_dre {1} \
+CONFIG.c_include_mm2s_dre $::stream_dre \
 CONFIG.c_include_s2mm {1} \
-CONFIG.c_include_s2mm_dre {1} \
+CONFIG.c_include_s2mm_dre $::stream_dre \
 CONFIG.c_include_sg {0} \
+CONFIG.c_m_axi_mm2s_data_width $::stream_width \
+CONFIG.c_m_axis_mm2s_tdata_width $::stream_width \
+CONFIG.c_m_axi_s2mm_data_width $::stream_width \
+CONFIG.c_s_axis_s2mm_tdata_width $::stream_width \
 CONFIG.c_mm2s_burst_size {256} \
 CONFIG.c_s2mm_burst_size {256} \
 CONFIG.c_sg_include_stscntrl_strm {0} \
@@ -189,10 +203,12 @@ CONFIG.c_sg_length_width {23} \
   # Create instance: axi_dma_1, and set properties
   set axi_dma_1 [ create_bd_cell -type ip -vlnv xilinx.com:ip:axi_dma:7.1 axi_dma_1 ]
   set_property -dict [ list \
-CONFIG.c_include_mm2s_dre {1} \
+CONFIG.c_include_mm2s_dre $::stream_dre \
 CONFIG.c_include_s2mm {0} \
 CONFIG.c_include_s2mm_dre {0} \
 CONFIG.c_include_sg {0} \
+CONFIG.c_m_axi_mm2s_data_width $::stream_width \
+CONFIG.c_m_axis_mm2s_tdata_width $::stream_width \
 CONFIG.c_mm2s_burst_size {256} \
 CONFIG.c_s2mm_burst_size {16} \
 CONFIG.c_sg_include_stscntrl_strm {0} \
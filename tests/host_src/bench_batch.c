@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_batch.h"
+#include "dma_copy.h"
+#include "xhw_internals.h"
+#include "utils.h"
+
+/*
+ * Benchmark of small messages sent through a loopback one transaction each, against
+ * the same messages coalesced into batches; the loopback echoes each batch, whose
+ * messages are checked as results.
+ * To be run as sudo, with the passthrough bitstream loaded.
+ *
+ * USAGE: bench_batch [-a DMA physical address] [-n messages] [-s batch size] [message size]
+ */
+
+#define DEF_MSG_SIZE 256U
+#define DEF_MESSAGES 100000UL
+#define DEF_BATCH_SIZE (64U * 1024U)
+
+struct results {
+    unsigned long received;
+    unsigned long wrong;
+    unsigned msg_size;
+};
+
+static void check_result(void *arg, uint32_t tag, const void *data, unsigned length)
+{
+    struct results *res = (struct results *)arg;
+    uint32_t first;
+
+    memcpy(&first, data, sizeof(first));
+    if (length != res->msg_size || first != tag)
+    {
+        res->wrong++;
+    }
+    res->received++;
+}
+
+static void report(const char *what, unsigned long messages, unsigned msg_size, uint64_t ns)
+{
+    printf("%-22s %10.2f us/message %10.1f MiB/s\n", what, (double)ns / 1e3 / (double)messages,
+        (double)messages * msg_size / ((double)ns / 1e9) / (1024.0 * 1024.0));
+}
+
+int main(int argc, char **argv)
+{
+    phys_addr_t dma_addr = AXI_DMA_REGISTER_LOCATION;
+    unsigned long messages = DEF_MESSAGES, m, buf_size;
+    unsigned msg_size = DEF_MSG_SIZE, batch_size = DEF_BATCH_SIZE;
+    struct results res = { 0, 0, 0 };
+    struct udmabuf buffer;
+    struct dma_engine engine;
+    struct dma_batch batch;
+    uint32_t *msg;
+    uint64_t start;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:n:s:")) != -1)
+    {
+        if (opt == 'a')
+        {
+            dma_addr = (phys_addr_t)strtoull(optarg, NULL, 0);
+        } else if (opt == 'n')
+        {
+            messages = strtoul(optarg, NULL, 0);
+        } else if (opt == 's')
+        {
+            batch_size = (unsigned)strtoul(optarg, NULL, 0);
+        }
+    }
+    if (optind < argc)
+    {
+        msg_size = (unsigned)strtoul(argv[optind], NULL, 0);
+    }
+    if (msg_size < sizeof(uint32_t) || messages == 0 || batch_size < 2 * msg_size)
+    {
+        printf("messages must hold at least 4 bytes, batches at least two messages\n");
+        return -1;
+    }
+    res.msg_size = msg_size;
+    buf_size = 2UL * batch_size;
+    msg = calloc(1, msg_size);
+    if (msg == NULL || load_udma_buffers(1, &buf_size, &buffer) != 0
+        || get_dma_interfaces(1, &dma_addr, NULL, &engine) != 0)
+    {
+        return -1;
+    }
+    printf("=== %lu loopback messages of %u bytes ===\n", messages, msg_size);
+
+    start = time_ns();
+    for (m = 0; m < messages; m++)
+    {
+        msg[0] = (uint32_t)m;
+        udmabuf_copy_in(&buffer, 0, msg, msg_size);
+        check_err(set_simple_transfer_from_device(&engine, &buffer, batch_size, msg_size));
+        check_err(start_simple_transfer_from_device(&engine));
+        check_err(set_simple_transfer_to_device(&engine, &buffer, 0, msg_size));
+        check_err(start_simple_transfer_to_device(&engine));
+        check_err(wait_simple_transfer_to_device(&engine, 0));
+        check_err(wait_simple_transfer_from_device(&engine, 0));
+        check_result(&res, (uint32_t)m, (char *)buffer.vaddr + batch_size, msg_size);
+    }
+    report("one transaction each", messages, msg_size, time_ns() - start);
+
+    if (dma_batch_init(&batch, &engine, &buffer, 0, batch_size, 0, 0, 0, check_result, &res) != 0)
+    {
+        return -1;
+    }
+    start = time_ns();
+    for (m = 0; m < messages; m++)
+    {
+        msg[0] = (uint32_t)m;
+        if (dma_batch_add(&batch, (uint32_t)m, msg, msg_size) < 0)
+        {
+            return -1;
+        }
+    }
+    if (dma_batch_flush(&batch) < 0)
+    {
+        return -1;
+    }
+    report("batched", messages, msg_size, time_ns() - start);
+    printf("%llu batches, %lu results, %lu wrong\n", batch.batches, res.received, res.wrong);
+
+    dma_batch_destroy(&batch);
+    destroy_dma_interfaces(1, &engine);
+    unload_udma_buffers(1, &buffer);
+    free(msg);
+    return res.wrong != 0 || res.received != 2 * messages;
+}
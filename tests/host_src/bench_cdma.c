@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_cdma.h"
+#include "dma_copy.h"
+#include "xhw_internals.h"
+#include "utils.h"
+
+/*
+ * Benchmark of UDMA buffer-to-buffer copies via AXI CDMA (simple and Scatter/Gather)
+ * against the CPU, via memcpy() and udmabuf_copy(), on the same buffers.
+ * To be run as sudo, with a bitstream including an AXI CDMA engine.
+ *
+ * USAGE: bench_cdma [-a CDMA physical address] [-c S/G chunk size] [size in bytes]
+ */
+
+#define DEF_SIZE (4U * 1024U * 1024U)
+#define DEF_CHUNK (64U * 1024U)
+#define MAX_CHUNK (32U * 1024U * 1024U)
+#define REPS 20U
+
+static void report(const char *what, unsigned long size, uint64_t ns)
+{
+    double mbs = (double)size * REPS / ((double)ns / 1e9) / (1024.0 * 1024.0);
+    printf("%-22s %10.1f MiB/s\n", what, mbs);
+}
+
+static void check_copy(const char *what, struct udmabuf *src, struct udmabuf *dst,
+    unsigned long size)
+{
+    if (memcmp(src->vaddr, dst->vaddr, size) != 0)
+    {
+        printf("ERROR: %s copy is wrong\n", what);
+    }
+    udmabuf_fill(dst, 0, 0, size);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long size = DEF_SIZE, chunk = DEF_CHUNK, sizes[3];
+    phys_addr_t cdma_addr = AXI_CDMA_REGISTER_LOCATION;
+    struct udmabuf buffers[3];
+    struct cdma_engine engine;
+    unsigned long done;
+    unsigned i, r, num_chunks;
+    uint32_t *src;
+    uint64_t start;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:c:")) != -1)
+    {
+        if (opt == 'a')
+        {
+            cdma_addr = (phys_addr_t)strtoull(optarg, NULL, 0);
+        } else if (opt == 'c')
+        {
+            chunk = strtoul(optarg, NULL, 0);
+        }
+    }
+    if (optind < argc)
+    {
+        size = strtoul(argv[optind], NULL, 0);
+    }
+    if (chunk == 0 || chunk > MAX_CHUNK || size % 64 != 0)
+    {
+        printf("chunk size must be in (0, %u], size a multiple of 64\n", MAX_CHUNK);
+        return -1;
+    }
+    num_chunks = (unsigned)((size + chunk - 1) / chunk);
+    sizes[0] = sizes[1] = size;
+    sizes[2] = (unsigned long)num_chunks * 64;
+    if (load_udma_buffers(3, sizes, buffers) != 0
+        || get_cdma_interfaces(1, &cdma_addr, NULL, &engine) != 0)
+    {
+        return -1;
+    }
+
+    src = (uint32_t *)buffers[0].vaddr;
+    for (i = 0; i < size / sizeof(uint32_t); i++)
+    {
+        src[i] = i;
+    }
+    udmabuf_fill(buffers + 1, 0, 0, size);
+    printf("=== UDMA buffer to UDMA buffer, %lu bytes ===\n", size);
+
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        memcpy(buffers[1].vaddr, buffers[0].vaddr, size);
+    }
+    report("memcpy", size, time_ns() - start);
+    check_copy("memcpy", buffers, buffers + 1, size);
+
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        udmabuf_copy(buffers + 1, 0, buffers, 0, size);
+    }
+    report("udmabuf_copy", size, time_ns() - start);
+    check_copy("udmabuf_copy", buffers, buffers + 1, size);
+
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        for (done = 0; done < size; done += MAX_CHUNK)
+        {
+            unsigned len = (unsigned)(size - done < MAX_CHUNK ? size - done : MAX_CHUNK);
+            check_err(set_simple_copy(&engine, buffers + 1, done, buffers, done, len));
+            check_err(start_simple_copy(&engine));
+            check_err(wait_simple_copy(&engine, 0));
+        }
+    }
+    report("CDMA simple", size, time_ns() - start);
+    if (err_status_copy(&engine) != 0)
+    {
+        printf("CDMA error status: 0x%x\n", err_status_copy(&engine));
+    }
+    check_copy("CDMA simple", buffers, buffers + 1, size);
+
+    if (set_sg_descriptors(&engine, buffers + 2, 0, num_chunks) == 0)
+    {
+        start = time_ns();
+        for (r = 0; r < REPS; r++)
+        {
+            for (done = 0; done < size; done += chunk)
+            {
+                unsigned len = (unsigned)(size - done < chunk ? size - done : chunk);
+                check_err(add_sg_copy(&engine, buffers + 1, done, buffers, done, len));
+            }
+            check_err(start_sg_copy(&engine));
+            check_err(wait_sg_copy(&engine, 0));
+        }
+        report("CDMA S/G", size, time_ns() - start);
+        if (err_status_copy(&engine) != 0)
+        {
+            printf("CDMA error status: 0x%x\n", err_status_copy(&engine));
+        }
+        check_copy("CDMA S/G", buffers, buffers + 1, size);
+    }
+
+    destroy_cdma_interfaces(1, &engine);
+    unload_udma_buffers(3, buffers);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_copy.h"
+#include "utils.h"
+
+/*
+ * Benchmark of the UDMA copy and fill routines against memcpy()/memset(),
+ * on cached memory and (with -u, as sudo) on an uncached UDMA buffer.
+ *
+ * USAGE: bench_copy [-u] [size in bytes]
+ */
+
+#define DEF_SIZE (1024U * 1024U)
+#define REPS 20U
+
+static const char *impl_names[] = { "scalar", "neon", "sse2", "avx" };
+
+#define NUM_IMPLS (sizeof(impl_names) / sizeof(impl_names[0]))
+
+static void report(const char *what, const char *impl, size_t size, uint64_t ns)
+{
+    double mbs = (double)size * REPS / ((double)ns / 1e9) / (1024.0 * 1024.0);
+    printf("%-22s %-7s %10.1f MiB/s\n", what, impl, mbs);
+}
+
+static void bench(void *uncached, size_t size)
+{
+    char *src = malloc(size), *dst = malloc(size);
+    uint64_t start;
+    unsigned i, r;
+
+    if (src == NULL || dst == NULL)
+    {
+        printf("cannot allocate %lu bytes\n", (unsigned long)size);
+        exit(-1);
+    }
+    for (i = 0; i < size; i++)
+    {
+        src[i] = (char)i;
+    }
+
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        memcpy(uncached, src, size);
+    }
+    report("memcpy in", "libc", size, time_ns() - start);
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        memcpy(dst, uncached, size);
+    }
+    report("memcpy out", "libc", size, time_ns() - start);
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        memset(uncached, 0, size);
+    }
+    report("memset", "libc", size, time_ns() - start);
+
+    for (i = 0; i < NUM_IMPLS; i++)
+    {
+        if (udmabuf_copy_select(impl_names[i]) != 0)
+        {
+            continue;
+        }
+        start = time_ns();
+        for (r = 0; r < REPS; r++)
+        {
+            copy_to_uncached(uncached, src, size);
+        }
+        report("copy_to_uncached", impl_names[i], size, time_ns() - start);
+        start = time_ns();
+        for (r = 0; r < REPS; r++)
+        {
+            copy_from_uncached(dst, uncached, size);
+        }
+        report("copy_from_uncached", impl_names[i], size, time_ns() - start);
+        if (memcmp(dst, src, size) != 0)
+        {
+            printf("ERROR: %s copies are wrong\n", impl_names[i]);
+        }
+        start = time_ns();
+        for (r = 0; r < REPS; r++)
+        {
+            fill_uncached(uncached, 0, size);
+        }
+        report("fill_uncached", impl_names[i], size, time_ns() - start);
+    }
+    free(src);
+    free(dst);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long size = DEF_SIZE;
+    int use_udma = 0, opt;
+    void *cached;
+
+    while ((opt = getopt(argc, argv, "u")) != -1)
+    {
+        if (opt == 'u')
+        {
+            use_udma = 1;
+        }
+    }
+    if (optind < argc)
+    {
+        size = strtoul(argv[optind], NULL, 0);
+    }
+
+    printf("=== cached memory, %lu bytes ===\n", size);
+    cached = malloc(size);
+    if (cached == NULL)
+    {
+        return -1;
+    }
+    bench(cached, size);
+    free(cached);
+
+    if (use_udma)
+    {
+        struct udmabuf buffer;
+        if (load_udma_buffers(1, &size, &buffer) != 0)
+        {
+            return -1;
+        }
+        printf("\n=== uncached UDMA buffer, %lu bytes ===\n", size);
+        bench(buffer.vaddr, size);
+        unload_udma_buffers(1, &buffer);
+    }
+    return 0;
+}
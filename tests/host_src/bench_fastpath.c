@@ -0,0 +1,150 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* the fast path as in release builds */
+#define DMA_FAST_CHECKS 0
+
+#include "dma_engine_buf.h"
+#include "dma_engine_fast.h"
+#include "xhw_internals.h"
+#include "utils.h"
+
+/*
+ * Benchmark of the per-call cost of the library calls issuing transactions and starting kernels
+ * against their inline versions of dma_engine_fast.h.
+ * By default the registers of the engine and of the kernel are plain memory, always reporting
+ * the engine idle, so that only the software cost is measured, with no hardware and no bitstream
+ * needed.
+ * With -a, transactions of 64 bytes run on the engine at the given address, which must be in
+ * a loopback design like the passthrough test (to be run as sudo).
+ * Building everything with LTO=1 lets the linker inline the library calls as well.
+ *
+ * USAGE: bench_fastpath [-a DMA physical address] [-n iterations]
+ */
+
+#define DEF_ITERATIONS 1000000UL
+#define TRANSFER_SIZE 64U
+
+static void report(const char *what, uint64_t ns, unsigned long iters)
+{
+    printf("%-34s %8.1f ns\n", what, (double)ns / (double)iters);
+}
+
+int main(int argc, char **argv)
+{
+    static uint32_t regs[FAKE_REGS], kernel_regs[FAKE_REGS];
+    unsigned long iters = DEF_ITERATIONS, i, sizes[1] = { 2 * TRANSFER_SIZE };
+    phys_addr_t dma_addr = 0;
+    struct dma_engine engine;
+    struct control_interface kernel;
+    struct udmabuf buf;
+    uint64_t start, errors = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:n:")) != -1)
+    {
+        if (opt == 'a')
+        {
+            dma_addr = (phys_addr_t)strtoull(optarg, NULL, 0);
+        } else if (opt == 'n')
+        {
+            iters = strtoul(optarg, NULL, 0);
+        } else
+        {
+            printf("USAGE: %s [-a DMA physical address] [-n iterations]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (iters == 0)
+    {
+        printf("iterations must be positive\n");
+        return -1;
+    }
+
+    if (dma_addr != 0)
+    {
+        if (load_udma_buffers(1, sizes, &buf) != 0
+            || get_dma_interfaces(1, &dma_addr, NULL, &engine) != 0)
+        {
+            return -1;
+        }
+        printf("=== engine at 0x%llx, %u bytes transactions ===\n",
+            (unsigned long long)dma_addr, TRANSFER_SIZE);
+    }
+    else
+    {
+        fake_engine(&engine, regs);
+        /* both channels idle */
+        regs[1] = 2;
+        regs[13] = 2;
+        buf.fd = -1;
+        buf.vaddr = NULL;
+        buf.paddr = 0x10000000U;
+        buf.size = 2 * TRANSFER_SIZE;
+        printf("=== simulated engine ===\n");
+    }
+
+    /* a transaction each way, as a loopback round trip */
+    start = time_ns();
+    for (i = 0; i < iters; i++)
+    {
+        errors += set_simple_transfer_from_device(&engine, &buf, TRANSFER_SIZE, TRANSFER_SIZE);
+        errors += start_simple_transfer_from_device(&engine);
+        errors += set_simple_transfer_to_device(&engine, &buf, 0, TRANSFER_SIZE);
+        errors += start_simple_transfer_to_device(&engine);
+        errors += wait_simple_transfer_to_device(&engine, 0);
+        errors += wait_simple_transfer_from_device(&engine, 0);
+    }
+    report("library round trip", time_ns() - start, iters);
+
+    start = time_ns();
+    for (i = 0; i < iters; i++)
+    {
+        errors += dma_fast_set_from_device(&engine, &buf, TRANSFER_SIZE, TRANSFER_SIZE);
+        errors += dma_fast_start_from_device(&engine);
+        errors += dma_fast_set_to_device(&engine, &buf, 0, TRANSFER_SIZE);
+        errors += dma_fast_start_to_device(&engine);
+        errors += dma_fast_wait_to_device(&engine);
+        errors += dma_fast_wait_from_device(&engine);
+    }
+    report("fast path round trip", time_ns() - start, iters);
+
+    if (dma_addr != 0)
+    {
+        destroy_dma_interfaces(1, &engine);
+        unload_udma_buffers(1, &buf);
+    }
+    else
+    {
+        /* the kernel never runs: ap_start is cleared by hand, as the kernel would */
+        memset(&kernel, 0, sizeof(kernel));
+        kernel.fd = -1;
+        kernel.control_regs_vaddr = (volatile char *)kernel_regs;
+        start = time_ns();
+        for (i = 0; i < iters; i++)
+        {
+            start_kernel(&kernel);
+            kernel_regs[0] = 0;
+            wait_kernel(&kernel, 0);
+        }
+        report("library kernel start and wait", time_ns() - start, iters);
+        start = time_ns();
+        for (i = 0; i < iters; i++)
+        {
+            dma_fast_start_kernel(&kernel);
+            kernel_regs[0] = 0;
+            dma_fast_wait_kernel(&kernel);
+        }
+        report("fast path kernel start and wait", time_ns() - start, iters);
+    }
+
+    if (errors != 0)
+    {
+        printf("%llu calls failed\n", (unsigned long long)errors);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_layout.h"
+#include "utils.h"
+
+/*
+ * Benchmark of the layout conversions (records split into one buffer per field and merged back,
+ * 8/16 bits integers widened into 32 bits lanes and narrowed back) against plain scalar loops,
+ * on cached memory and (with -u, as sudo) on uncached UDMA buffers; all results are checked.
+ *
+ * USAGE: bench_layout [-u] [number of values per field]
+ */
+
+#define DEF_COUNT (256U * 1024U)
+#define REPS 20U
+#define MAX_FIELDS 4U
+
+static const char *impl_names[] = { "scalar", "neon", "sse2" };
+
+#define NUM_IMPLS (sizeof(impl_names) / sizeof(impl_names[0]))
+
+static const char *type_names[] = { "int8", "uint8", "int16", "uint16" };
+
+static unsigned wrong;
+
+static void report(const char *what, const char *impl, size_t bytes, uint64_t ns)
+{
+    double mbs = (double)bytes * REPS / ((double)ns / 1e9) / (1024.0 * 1024.0);
+    printf("%-22s %-7s %10.1f MiB/s\n", what, impl, mbs);
+}
+
+/* the loops an application would write, as reference */
+static void loop_split(uint32_t **dsts, const uint32_t *src, unsigned fields, size_t count)
+{
+    size_t i;
+    unsigned f;
+    for (i = 0; i < count; i++)
+    {
+        for (f = 0; f < fields; f++)
+        {
+            dsts[f][i] = src[i * fields + f];
+        }
+    }
+}
+
+static void loop_merge(uint32_t *dst, uint32_t **srcs, unsigned fields, size_t count)
+{
+    size_t i;
+    unsigned f;
+    for (i = 0; i < count; i++)
+    {
+        for (f = 0; f < fields; f++)
+        {
+            dst[i * fields + f] = srcs[f][i];
+        }
+    }
+}
+
+static void loop_widen(uint32_t *dst, const int16_t *src, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        dst[i] = (uint32_t)(int32_t)src[i];
+    }
+}
+
+static void loop_narrow(int16_t *dst, const uint32_t *src, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        dst[i] = (int16_t)(uint16_t)src[i];
+    }
+}
+
+static void bench_fields(void **uncached, unsigned fields, size_t count)
+{
+    size_t bytes = fields * count * sizeof(uint32_t), i, r;
+    uint32_t *records = malloc(bytes), *back = malloc(bytes);
+    char what[32];
+    uint64_t start;
+    unsigned n;
+
+    if (records == NULL || back == NULL)
+    {
+        printf("cannot allocate %lu bytes\n", (unsigned long)bytes);
+        exit(-1);
+    }
+    for (i = 0; i < fields * count; i++)
+    {
+        records[i] = (uint32_t)(i * 2654435761U);
+    }
+
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        loop_split((uint32_t **)uncached, records, fields, count);
+    }
+    sprintf(what, "split %u fields", fields);
+    report(what, "loop", bytes, time_ns() - start);
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        loop_merge(back, (uint32_t **)uncached, fields, count);
+    }
+    sprintf(what, "merge %u fields", fields);
+    report(what, "loop", bytes, time_ns() - start);
+
+    for (n = 0; n < NUM_IMPLS; n++)
+    {
+        if (udmabuf_layout_select(impl_names[n]) != 0)
+        {
+            continue;
+        }
+        start = time_ns();
+        for (r = 0; r < REPS; r++)
+        {
+            split_to_uncached(uncached, records, fields, count);
+        }
+        sprintf(what, "split %u fields", fields);
+        report(what, impl_names[n], bytes, time_ns() - start);
+        memset(back, 0, bytes);
+        start = time_ns();
+        for (r = 0; r < REPS; r++)
+        {
+            merge_from_uncached(back, (const void *const *)uncached, fields, count);
+        }
+        sprintf(what, "merge %u fields", fields);
+        report(what, impl_names[n], bytes, time_ns() - start);
+        if (memcmp(back, records, bytes) != 0)
+        {
+            printf("ERROR: %s conversions of %u fields are wrong\n", impl_names[n], fields);
+            wrong++;
+        }
+    }
+    free(records);
+    free(back);
+}
+
+static void bench_types(void *uncached, size_t count)
+{
+    int16_t *values = malloc(count * sizeof(int16_t)), *back = malloc(count * sizeof(int16_t));
+    int8_t *bytes = malloc(count);
+    size_t bytes_out = count * sizeof(uint32_t), i, r;
+    char what[32];
+    uint64_t start;
+    unsigned n, t;
+
+    if (values == NULL || back == NULL || bytes == NULL)
+    {
+        printf("cannot allocate %lu values\n", (unsigned long)count);
+        exit(-1);
+    }
+    for (i = 0; i < count; i++)
+    {
+        values[i] = (int16_t)(i * 40503U);
+        bytes[i] = (int8_t)values[i];
+    }
+
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        loop_widen((uint32_t *)uncached, values, count);
+    }
+    report("widen int16", "loop", bytes_out, time_ns() - start);
+    start = time_ns();
+    for (r = 0; r < REPS; r++)
+    {
+        loop_narrow(back, (const uint32_t *)uncached, count);
+    }
+    report("narrow int16", "loop", bytes_out, time_ns() - start);
+
+    for (n = 0; n < NUM_IMPLS; n++)
+    {
+        if (udmabuf_layout_select(impl_names[n]) != 0)
+        {
+            continue;
+        }
+        for (t = DMA_NARROW_S8; t <= DMA_NARROW_U16; t++)
+        {
+            const void *src = t == DMA_NARROW_S8 || t == DMA_NARROW_U8 ?
+                (const void *)bytes : (const void *)values;
+            size_t size = t == DMA_NARROW_S8 || t == DMA_NARROW_U8 ? 1 : 2;
+
+            start = time_ns();
+            for (r = 0; r < REPS; r++)
+            {
+                widen_to_uncached(uncached, src, (enum dma_narrow_type)t, count);
+            }
+            sprintf(what, "widen %s", type_names[t]);
+            report(what, impl_names[n], bytes_out, time_ns() - start);
+            memset(back, 0, count * sizeof(int16_t));
+            start = time_ns();
+            for (r = 0; r < REPS; r++)
+            {
+                narrow_from_uncached(back, (enum dma_narrow_type)t, uncached, count);
+            }
+            sprintf(what, "narrow %s", type_names[t]);
+            report(what, impl_names[n], bytes_out, time_ns() - start);
+            if (memcmp(back, src, count * size) != 0)
+            {
+                printf("ERROR: %s conversions of %s are wrong\n", impl_names[n], type_names[t]);
+                wrong++;
+            }
+        }
+    }
+    free(values);
+    free(back);
+    free(bytes);
+}
+
+static void bench(void **uncached, size_t count)
+{
+    unsigned fields;
+    for (fields = 2; fields <= MAX_FIELDS; fields++)
+    {
+        bench_fields(uncached, fields, count);
+    }
+    bench_types(uncached[0], count);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long count = DEF_COUNT, sizes[MAX_FIELDS];
+    int use_udma = 0, opt;
+    void *fields[MAX_FIELDS];
+    unsigned f;
+
+    while ((opt = getopt(argc, argv, "u")) != -1)
+    {
+        if (opt == 'u')
+        {
+            use_udma = 1;
+        }
+    }
+    if (optind < argc)
+    {
+        count = strtoul(argv[optind], NULL, 0);
+    }
+
+    printf("=== cached memory, %lu values per field ===\n", count);
+    for (f = 0; f < MAX_FIELDS; f++)
+    {
+        fields[f] = malloc(count * sizeof(uint32_t));
+        if (fields[f] == NULL)
+        {
+            return -1;
+        }
+    }
+    bench(fields, count);
+    for (f = 0; f < MAX_FIELDS; f++)
+    {
+        free(fields[f]);
+    }
+
+    if (use_udma)
+    {
+        struct udmabuf buffers[MAX_FIELDS];
+        for (f = 0; f < MAX_FIELDS; f++)
+        {
+            sizes[f] = count * sizeof(uint32_t);
+        }
+        if (load_udma_buffers(MAX_FIELDS, sizes, buffers) != 0)
+        {
+            return -1;
+        }
+        for (f = 0; f < MAX_FIELDS; f++)
+        {
+            fields[f] = buffers[f].vaddr;
+        }
+        printf("\n=== uncached UDMA buffers, %lu values per field ===\n", count);
+        bench(fields, count);
+        unload_udma_buffers(MAX_FIELDS, buffers);
+    }
+    return wrong != 0;
+}
@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "xhw_internals.h"
+#include "utils.h"
+
+/*
+ * Microbenchmark of the operations issuing a DMA transfer: uncached reads and writes of the
+ * engine registers and the barriers of xhw_internals.h, alone and after a register access,
+ * with __mem_full_barrier() as reference. Build the library with CFLAGS=-DDMA_BARRIER_FULL
+ * to compare against full barriers everywhere.
+ * To be run as sudo, with a bitstream including an AXI DMA engine; no transfer is started.
+ *
+ * USAGE: bench_mmio [-a DMA physical address] [-n iterations]
+ */
+
+#define DEF_ITERATIONS 1000000UL
+
+/* runs @p op @p iters times and prints its average cost, net of the loop */
+#define TIME_OP(name, op) do {                                              \
+        unsigned long __i;                                                  \
+        uint64_t __start = time_ns();                                       \
+        for (__i = 0; __i < iters; __i++)                                   \
+        {                                                                   \
+            op;                                                             \
+        }                                                                   \
+        report(name, time_ns() - __start, iters, loop_ns);                  \
+    } while (0)
+
+static void report(const char *what, uint64_t ns, unsigned long iters, double loop_ns)
+{
+    double per_op = (double)ns / (double)iters - loop_ns;
+    printf("%-34s %8.1f ns\n", what, per_op > 0.0 ? per_op : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    phys_addr_t dma_addr = AXI_DMA_REGISTER_LOCATION;
+    unsigned long iters = DEF_ITERATIONS, i;
+    volatile struct axi_direct_dma_regs *regs;
+    struct dma_engine engine;
+    uint32_t value, sink = 0;
+    double loop_ns = 0.0;
+    uint64_t start;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:n:")) != -1)
+    {
+        if (opt == 'a')
+        {
+            dma_addr = (phys_addr_t)strtoull(optarg, NULL, 0);
+        } else if (opt == 'n')
+        {
+            iters = strtoul(optarg, NULL, 0);
+        } else
+        {
+            printf("USAGE: %s [-a DMA physical address] [-n iterations]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (iters == 0)
+    {
+        printf("iterations must be positive\n");
+        return -1;
+    }
+    if (get_dma_interfaces(1, &dma_addr, NULL, &engine) != 0)
+    {
+        return -1;
+    }
+    regs = (volatile struct axi_direct_dma_regs *)engine.regs_vaddr;
+    /* the source address register is written back with its own value: harmless while halted */
+    value = regs->mm2s_source_addr_low;
+
+    start = time_ns();
+    for (i = 0; i < iters; i++)
+    {
+        __mem_sw_barrier();
+    }
+    loop_ns = (double)(time_ns() - start) / (double)iters;
+
+#ifdef DMA_BARRIER_FULL
+    printf("=== MMIO costs, %lu iterations, full barriers ===\n", iters);
+#else
+    printf("=== MMIO costs, %lu iterations, per-architecture barriers ===\n", iters);
+#endif
+    TIME_OP("register read", sink += regs->mm2s_status);
+    TIME_OP("register write", regs->mm2s_source_addr_low = value);
+    TIME_OP("__mmio_wmb", __mmio_wmb());
+    TIME_OP("__mmio_rmb", __mmio_rmb());
+    TIME_OP("__mmio_mb", __mmio_mb());
+    TIME_OP("__doorbell_barrier", __doorbell_barrier());
+    TIME_OP("__mem_full_barrier", __mem_full_barrier());
+    TIME_OP("read + __mmio_rmb", sink += regs->mm2s_status; __mmio_rmb());
+    TIME_OP("write + __mmio_wmb", regs->mm2s_source_addr_low = value; __mmio_wmb());
+    TIME_OP("write + __mmio_mb", regs->mm2s_source_addr_low = value; __mmio_mb());
+    TIME_OP("write + __doorbell_barrier", regs->mm2s_source_addr_low = value; __doorbell_barrier());
+    TIME_OP("write + __mem_full_barrier", regs->mm2s_source_addr_low = value; __mem_full_barrier());
+    /* the register accesses of a simple transfer issue, without the length write starting it */
+    TIME_OP("issue: 2 writes, RMW, doorbell", regs->mm2s_source_addr_low = value;
+        regs->mm2s_source_addr_high = 0; regs->mm2s_control |= 0; __doorbell_barrier());
+    TIME_OP("write + read back", regs->mm2s_source_addr_low = value; __mmio_mb();
+        sink += regs->mm2s_source_addr_low);
+
+    destroy_dma_interfaces(1, &engine);
+    /* keeps the reads from being optimized out */
+    return sink == 0xFFFFFFFFU ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_offload.h"
+#include "xhw_internals.h"
+#include "utils.h"
+#include "utils_vec_2d_sum.h"
+
+/*
+ * Benchmark of the 2D Vector Sum kernel on the CPU (scalar and vectorized), on the FPGA and
+ * through the offload dispatcher, which picks either or splits each call between the two
+ * according to the costs it measured; all results are checked against the scalar CPU ones.
+ * To be run as sudo, with the vec_2d_sum bitstream loaded.
+ *
+ * USAGE: bench_offload [-r repetitions] [largest number of values]
+ */
+
+#define DEF_MAX_VALUES (1U << 20)
+#define DEF_REPS 20U
+#define MIN_VALUES 16U
+/* values per 64 bytes, to keep the DMA transactions of split calls aligned */
+#define GRANULE 16U
+
+#define A 3
+#define B -7
+#define C 11
+
+/* average time of @p reps runs of @p num values with @p on_fpga of them on the FPGA */
+static double run(struct dma_offload *off, unsigned num, unsigned on_fpga, unsigned reps)
+{
+    uint64_t start = time_ns();
+    unsigned r;
+
+    for (r = 0; r < reps; r++)
+    {
+        if (on_fpga > 0 && vec_2d_sum_fpga_start(off->ctx, 0, on_fpga) != 0)
+        {
+            exit(-1);
+        }
+        if (on_fpga < num)
+        {
+            vec_2d_sum_cpu_run(off->ctx, on_fpga, num - on_fpga);
+        }
+        if (on_fpga > 0 && vec_2d_sum_fpga_wait(off->ctx) != 0)
+        {
+            exit(-1);
+        }
+    }
+    return (double)(time_ns() - start) / 1e3 / (double)reps;
+}
+
+static unsigned check(const int32_t *out, const int32_t *oracle, unsigned num)
+{
+    unsigned i, wrong = 0;
+    for (i = 0; i < num; i++)
+    {
+        wrong += out[i] != oracle[i];
+    }
+    return wrong;
+}
+
+int main(int argc, char **argv)
+{
+    phys_addr_t dmas[] = { 0x40400000, 0x40410000 };
+    unsigned dma_lengths[] = { AXI_CONTROL_REGS_LEN_DEF, AXI_CONTROL_REGS_LEN_DEF };
+    unsigned max_values = DEF_MAX_VALUES, reps = DEF_REPS, num, i, wrong = 0;
+    unsigned long sizes[3];
+    struct udmabuf buffers[3];
+    struct dma_engine engines[2];
+    struct control_interface kernel;
+    struct vec_2d_sum call;
+    struct dma_offload off;
+    int32_t *in1, *in2, *out, *oracle;
+    const char *best_impl;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1)
+    {
+        if (opt == 'r')
+        {
+            reps = (unsigned)strtoul(optarg, NULL, 0);
+        }
+    }
+    if (optind < argc)
+    {
+        max_values = (unsigned)strtoul(argv[optind], NULL, 0);
+    }
+    if (max_values < MIN_VALUES || max_values >= (1U << 24) || reps == 0)
+    {
+        printf("values must be from %u to 16M, repetitions positive\n", MIN_VALUES);
+        return -1;
+    }
+    in1 = malloc(max_values * sizeof(int32_t));
+    in2 = malloc(max_values * sizeof(int32_t));
+    out = malloc(max_values * sizeof(int32_t));
+    oracle = malloc(max_values * sizeof(int32_t));
+    if (in1 == NULL || in2 == NULL || out == NULL || oracle == NULL)
+    {
+        return -1;
+    }
+    for (i = 0; i < max_values; i++)
+    {
+        in1[i] = (int32_t)i;
+        in2[i] = (int32_t)(max_values - i);
+    }
+    best_impl = vec_2d_sum_cpu_impl();
+    vec_2d_sum_cpu_select("scalar");
+    vec_2d_sum_cpu(in1, in2, oracle, max_values, A, B, C);
+    vec_2d_sum_cpu_select(best_impl);
+
+    sizes[0] = sizes[1] = sizes[2] = max_values * sizeof(int32_t);
+    if (load_udma_buffers(3, sizes, buffers) != 0
+        || get_dma_interfaces(2, dmas, dma_lengths, engines) != 0
+        || get_control_interface(0x43C00000, AXI_CONTROL_REGS_LEN_DEF, &kernel) != 0)
+    {
+        return -1;
+    }
+    call.in1 = in1;
+    call.in2 = in2;
+    call.out = out;
+    call.a = A;
+    call.b = B;
+    call.c = C;
+    call.buffers = buffers;
+    call.engines = engines;
+    call.kernel = &kernel;
+    if (dma_offload_init(&off, vec_2d_sum_cpu_run, vec_2d_sum_fpga_start, vec_2d_sum_fpga_wait,
+        &call, max_values, GRANULE) != 0 || dma_offload_calibrate(&off, max_values, 3) != 0)
+    {
+        return -1;
+    }
+    printf("CPU implementation: %s\n", vec_2d_sum_cpu_impl());
+    printf("model: CPU %.0f ns + %.2f ns/value, FPGA %.0f ns + %.2f ns/value\n",
+        off.cpu.fixed_ns, off.cpu.ns_per_item, off.fpga.fixed_ns, off.fpga.ns_per_item);
+    printf("%10s %12s %12s %12s %12s %10s\n", "values", "scalar us", "CPU us", "FPGA us",
+        "dispatch us", "planned");
+
+    for (num = MIN_VALUES; num <= max_values; num *= 4)
+    {
+        double scalar_us, cpu_us, fpga_us, dispatch_us;
+        unsigned on_fpga = dma_offload_plan(&off, num);
+        uint64_t start;
+
+        vec_2d_sum_cpu_select("scalar");
+        scalar_us = run(&off, num, 0, reps);
+        vec_2d_sum_cpu_select(best_impl);
+        memset(out, 0, num * sizeof(int32_t));
+        cpu_us = run(&off, num, 0, reps);
+        wrong += check(out, oracle, num);
+        memset(out, 0, num * sizeof(int32_t));
+        fpga_us = run(&off, num, num, reps);
+        wrong += check(out, oracle, num);
+        memset(out, 0, num * sizeof(int32_t));
+        start = time_ns();
+        for (i = 0; i < reps; i++)
+        {
+            if (dma_offload_run(&off, num) != 0)
+            {
+                return -1;
+            }
+        }
+        dispatch_us = (double)(time_ns() - start) / 1e3 / (double)reps;
+        wrong += check(out, oracle, num);
+        printf("%10u %12.1f %12.1f %12.1f %12.1f %10u\n", num, scalar_us, cpu_us, fpga_us,
+            dispatch_us, on_fpga);
+    }
+    printf("%llu calls on the CPU, %llu on the FPGA, %llu split; %u wrong values\n",
+        off.cpu_calls, off.fpga_calls, off.split_calls, wrong);
+
+    destroy_control_interface(&kernel);
+    destroy_dma_interfaces(2, engines);
+    unload_udma_buffers(3, buffers);
+    free(in1);
+    free(in2);
+    free(out);
+    free(oracle);
+    return wrong != 0;
+}
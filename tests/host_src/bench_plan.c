@@ -0,0 +1,139 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_plan.h"
+#include "xhw_internals.h"
+#include "utils.h"
+
+/*
+ * Benchmark of the host overhead of small, frequent jobs: a loopback transaction pair
+ * issued via the single calls against the same pair recorded into a plan and replayed,
+ * changing the offset of the transactions at each job.
+ * To be run as sudo, with the passthrough bitstream loaded.
+ *
+ * USAGE: bench_plan [-a DMA physical address] [-n jobs] [job size in bytes]
+ */
+
+#define DEF_SIZE 256U
+#define DEF_JOBS 100000UL
+#define NUM_OFFSETS 16U
+
+static void report(const char *what, unsigned long jobs, uint64_t ns)
+{
+    printf("%-16s %10.2f us/job\n", what, (double)ns / 1e3 / (double)jobs);
+}
+
+static int check(struct udmabuf *buf, unsigned size)
+{
+    if (memcmp(buf->vaddr, (char *)buf->vaddr + buf->size / 2, size) != 0)
+    {
+        printf("ERROR: data received differ from data sent\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    phys_addr_t dma_addr = AXI_DMA_REGISTER_LOCATION;
+    unsigned long jobs = DEF_JOBS, j, buf_size;
+    unsigned size = DEF_SIZE, half, offset, i;
+    struct udmabuf buffer;
+    struct dma_engine engine;
+    struct dma_plan plan;
+    int opt, to_step, from_step, err = 0;
+    uint64_t start;
+
+    while ((opt = getopt(argc, argv, "a:n:")) != -1)
+    {
+        if (opt == 'a')
+        {
+            dma_addr = (phys_addr_t)strtoull(optarg, NULL, 0);
+        } else if (opt == 'n')
+        {
+            jobs = strtoul(optarg, NULL, 0);
+        }
+    }
+    if (optind < argc)
+    {
+        size = (unsigned)strtoul(argv[optind], NULL, 0);
+    }
+    if (size == 0 || size % 64 != 0 || jobs == 0)
+    {
+        printf("size must be a non-0 multiple of 64, jobs positive\n");
+        return -1;
+    }
+    buf_size = 2UL * size * NUM_OFFSETS;
+    half = (unsigned)(buf_size / 2);
+    if (load_udma_buffers(1, &buf_size, &buffer) != 0
+        || get_dma_interfaces(1, &dma_addr, NULL, &engine) != 0)
+    {
+        return -1;
+    }
+    for (i = 0; i < half; i++)
+    {
+        ((unsigned char *)buffer.vaddr)[i] = (unsigned char)(i * 7U);
+    }
+    printf("=== %lu loopback jobs of %u bytes ===\n", jobs, size);
+
+    start = time_ns();
+    for (j = 0; j < jobs; j++)
+    {
+        offset = (unsigned)(j % NUM_OFFSETS) * size;
+        check_err(set_simple_transfer_from_device(&engine, &buffer, half + offset, size));
+        check_err(start_simple_transfer_from_device(&engine));
+        check_err(set_simple_transfer_to_device(&engine, &buffer, offset, size));
+        check_err(start_simple_transfer_to_device(&engine));
+        check_err(wait_simple_transfer_to_device(&engine, 0));
+        check_err(wait_simple_transfer_from_device(&engine, 0));
+    }
+    report("single calls", jobs, time_ns() - start);
+    err |= check(&buffer, half);
+    memset((char *)buffer.vaddr + half, 0, half);
+
+    if (dma_plan_init(&plan, 4) != 0)
+    {
+        return -1;
+    }
+    from_step = dma_plan_transfer_from_device(&plan, &engine, &buffer, half, size);
+    to_step = dma_plan_transfer_to_device(&plan, &engine, &buffer, 0, size);
+    dma_plan_wait_to_device(&plan, &engine, 0);
+    dma_plan_wait_from_device(&plan, &engine, 0);
+    if (from_step < 0 || to_step < 0)
+    {
+        return -1;
+    }
+    start = time_ns();
+    for (j = 0; j < jobs; j++)
+    {
+        offset = (unsigned)(j % NUM_OFFSETS) * size;
+        dma_plan_set_transfer(&plan, (unsigned)from_step, half + offset, size);
+        dma_plan_set_transfer(&plan, (unsigned)to_step, offset, size);
+        check_err(dma_plan_run(&plan));
+    }
+    report("plan replays", jobs, time_ns() - start);
+    err |= check(&buffer, half);
+
+    /* the same transactions at each job: only lengths are written */
+    start = time_ns();
+    for (j = 0; j < jobs; j++)
+    {
+        check_err(dma_plan_run(&plan));
+    }
+    report("plan, same job", jobs, time_ns() - start);
+
+    if (err_status_to_device(&engine) != 0 || err_status_from_device(&engine) != 0)
+    {
+        printf("DMA error status: 0x%x 0x%x\n", err_status_to_device(&engine),
+            err_status_from_device(&engine));
+        err = 1;
+    }
+    dma_plan_destroy(&plan);
+    destroy_dma_interfaces(1, &engine);
+    unload_udma_buffers(1, &buffer);
+    return err;
+}
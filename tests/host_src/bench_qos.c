@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_sched.h"
+#include "dma_stats.h"
+#include "xhw_internals.h"
+#include "utils.h"
+
+/*
+ * Benchmark of the latency of small urgent transactions while bulk transactions saturate
+ * the engine towards the device, with a single FIFO class (no split) and with the default
+ * urgent and bulk classes of the scheduler. The data looped back are drained into a scratch
+ * area of the buffer.
+ * To be run as sudo, with the passthrough bitstream loaded.
+ *
+ * USAGE: bench_qos [-a DMA physical address] [-b bulk size] [-n urgent requests] [urgent size]
+ */
+
+#define DEF_URGENT_SIZE 4096U
+#define DEF_BULK_SIZE (4U * 1024U * 1024U)
+#define DEF_REQUESTS 2000U
+/* urgent requests are spaced, as interactive ones */
+#define URGENT_GAP_NS 200000ULL
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * keeps a transaction from device armed on the scratch area, to consume the looped back data;
+ * each transaction to device ends with TLAST, hence completes the one from device
+ */
+static void drain(struct dma_engine *engine, struct udmabuf *buf, unsigned scratch, unsigned size,
+    int *armed)
+{
+    if (*armed && poll_simple_transfer_from_device(engine) == DMA_TRANS_RUNNING)
+    {
+        return;
+    }
+    check_err(set_simple_transfer_from_device(engine, buf, scratch, size));
+    check_err(start_simple_transfer_from_device(engine));
+    *armed = 1;
+}
+
+static void run(const char *what, struct dma_sched *sched, struct udmabuf *buf, unsigned bulk_size,
+    unsigned urgent_size, unsigned num_requests, uint64_t *latencies, int *armed)
+{
+    struct dma_sched_req bulk, urgent;
+    unsigned long long bulk_bytes = 0;
+    unsigned done = 0;
+    uint64_t start, last = 0, elapsed;
+
+    memset(&bulk, 0, sizeof(bulk));
+    memset(&urgent, 0, sizeof(urgent));
+    start = dma_stats_now();
+    while (done < num_requests)
+    {
+        uint64_t now = dma_stats_now();
+
+        drain(sched->engine, buf, bulk_size + urgent_size, bulk_size, armed);
+        if (bulk.status == DMA_SCHED_DONE || bulk.status == DMA_SCHED_IDLE)
+        {
+            bulk_bytes += bulk.status == DMA_SCHED_DONE ? bulk_size : 0;
+            bulk.status = DMA_SCHED_IDLE;
+            dma_sched_submit(sched, &bulk, sched->num_classes - 1, DMA_SCHED_TO_DEV, buf, 0, bulk_size);
+        }
+        if (urgent.status == DMA_SCHED_DONE)
+        {
+            latencies[done++] = urgent.complete_ns - urgent.submit_ns;
+            urgent.status = DMA_SCHED_IDLE;
+        }
+        if (urgent.status == DMA_SCHED_IDLE && now - last >= URGENT_GAP_NS)
+        {
+            dma_sched_submit(sched, &urgent, 0, DMA_SCHED_TO_DEV, buf, bulk_size, urgent_size);
+            last = now;
+        }
+        dma_sched_progress(sched);
+    }
+    elapsed = dma_stats_now() - start;
+    /* the transaction from device stays armed, consuming the rest of the data */
+    while (bulk.status != DMA_SCHED_DONE || urgent.status == DMA_SCHED_QUEUED
+        || urgent.status == DMA_SCHED_RUNNING)
+    {
+        drain(sched->engine, buf, bulk_size + urgent_size, bulk_size, armed);
+        dma_sched_progress(sched);
+    }
+
+    qsort(latencies, num_requests, sizeof(uint64_t), compare_u64);
+    printf("%-14s urgent p50 %8.1f us p99 %8.1f us max %8.1f us, bulk %8.1f MiB/s\n", what,
+        latencies[num_requests / 2] / 1e3, latencies[num_requests * 99 / 100] / 1e3,
+        latencies[num_requests - 1] / 1e3,
+        (double)bulk_bytes / ((double)elapsed / 1e9) / (1024.0 * 1024.0));
+}
+
+int main(int argc, char **argv)
+{
+    phys_addr_t dma_addr = AXI_DMA_REGISTER_LOCATION;
+    unsigned urgent_size = DEF_URGENT_SIZE, bulk_size = DEF_BULK_SIZE, num_requests = DEF_REQUESTS;
+    struct dma_sched_class_cfg fifo = { 0, 1 };
+    struct udmabuf buffer;
+    struct dma_engine engine;
+    struct dma_sched sched;
+    unsigned long buf_size;
+    uint64_t *latencies;
+    int opt, armed = 0;
+
+    while ((opt = getopt(argc, argv, "a:b:n:")) != -1)
+    {
+        if (opt == 'a')
+        {
+            dma_addr = (phys_addr_t)strtoull(optarg, NULL, 0);
+        } else if (opt == 'b')
+        {
+            bulk_size = (unsigned)strtoul(optarg, NULL, 0);
+        } else if (opt == 'n')
+        {
+            num_requests = (unsigned)strtoul(optarg, NULL, 0);
+        }
+    }
+    if (optind < argc)
+    {
+        urgent_size = (unsigned)strtoul(argv[optind], NULL, 0);
+    }
+    if (urgent_size == 0 || bulk_size < urgent_size || bulk_size >= (1U << 26) || num_requests == 0)
+    {
+        printf("sizes must be non-0, the bulk one larger and below 64 MiB, requests positive\n");
+        return -1;
+    }
+    buf_size = 2UL * bulk_size + urgent_size;
+    latencies = calloc(num_requests, sizeof(uint64_t));
+    if (latencies == NULL || load_udma_buffers(1, &buf_size, &buffer) != 0
+        || get_dma_interfaces(1, &dma_addr, NULL, &engine) != 0)
+    {
+        return -1;
+    }
+    printf("=== %u urgent requests of %u bytes against bulk ones of %u bytes ===\n", num_requests,
+        urgent_size, bulk_size);
+
+    /* a single class: urgent requests queue behind whole bulk transactions */
+    if (dma_sched_init(&sched, &engine, 1, &fifo) != 0)
+    {
+        return -1;
+    }
+    run("FIFO", &sched, &buffer, bulk_size, urgent_size, num_requests, latencies, &armed);
+    dma_sched_destroy(&sched);
+
+    if (dma_sched_init(&sched, &engine, 0, NULL) != 0)
+    {
+        return -1;
+    }
+    run("urgent/bulk", &sched, &buffer, bulk_size, urgent_size, num_requests, latencies, &armed);
+    printf("bulk pieces of %u bytes, urgent share %u, bulk share %u\n",
+        sched.classes[DMA_SCHED_BULK].piece_size, sched.classes[DMA_SCHED_URGENT].share,
+        sched.classes[DMA_SCHED_BULK].share);
+    dma_sched_destroy(&sched);
+
+    if (err_status_to_device(&engine) != 0 || err_status_from_device(&engine) != 0)
+    {
+        printf("DMA error status: 0x%x 0x%x\n", err_status_to_device(&engine),
+            err_status_from_device(&engine));
+    }
+    destroy_dma_interfaces(1, &engine);
+    unload_udma_buffers(1, &buffer);
+    free(latencies);
+    return 0;
+}
@@ -0,0 +1,247 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "dma_broker.h"
+#include "broker_internals.h"
+#include "utils.h"
+
+/*
+ * Test of the broker side of dma_broker.h, with no broker, no socket path and no hardware:
+ * a client submits jobs through rings in plain memory, with its doorbells going through a
+ * socket pair, and the test consumes them as the broker does, checking the order of jobs and
+ * completions and that full rings stop both sides. It then checks the slices granted and the
+ * jobs accepted: a job must lie within the slices of its client, a buffer belongs to one client
+ * at a time and goes to another only once the process of its former owner exited.
+ *
+ * USAGE: test_broker
+ */
+
+#define BUF_SIZE (1024U * 1024U)
+#define PAGE 4096U
+
+static struct dma_broker_rings rings;
+
+static struct dma_broker_job job_of(uint64_t cookie)
+{
+    struct dma_broker_job job;
+
+    memset(&job, 0, sizeof(job));
+    job.cookie = cookie;
+    job.kernel = -1;
+    return job;
+}
+
+/* the broker consumes the doorbells of the client */
+static unsigned drain(int sock)
+{
+    struct dma_broker_msg msg;
+    unsigned n = 0;
+
+    while (recv(sock, &msg, sizeof(msg), MSG_DONTWAIT) == (ssize_t)sizeof(msg))
+    {
+        n += msg.type == DMA_BROKER_DOORBELL;
+    }
+    return n;
+}
+
+static void test_rings(void)
+{
+    struct dma_broker_client client;
+    struct dma_broker_completion *compl, done;
+    struct dma_broker_job job, taken;
+    int sv[2];
+    unsigned i;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0)
+    {
+        printf("cannot create a socket pair\n");
+        expect_failures++;
+        return;
+    }
+    memset(&client, 0, sizeof(client));
+    client.sock = sv[0];
+    client.rings = &rings;
+
+    /* nothing to run */
+    EXPECT(dma_broker_take_job(&rings, &taken) == NULL);
+
+    /* the submission ring takes DMA_BROKER_RING_SIZE jobs, each rung on the socket */
+    for (i = 0; i < DMA_BROKER_RING_SIZE; i++)
+    {
+        job = job_of(i);
+        EXPECT(dma_broker_submit(&client, &job) == 0);
+    }
+    job = job_of(DMA_BROKER_RING_SIZE);
+    EXPECT(dma_broker_submit(&client, &job) != 0);
+    EXPECT(drain(sv[1]) == DMA_BROKER_RING_SIZE);
+
+    /* the broker takes them in order, and the client changing a slot changes no job taken */
+    for (i = 0; i < DMA_BROKER_RING_SIZE; i++)
+    {
+        compl = dma_broker_take_job(&rings, &taken);
+        EXPECT(compl != NULL && taken.cookie == i);
+        rings.sq[i % DMA_BROKER_RING_SIZE].cookie = ~0ULL;
+        if (compl != NULL)
+        {
+            compl->cookie = taken.cookie;
+            compl->status = (int32_t)i;
+            dma_broker_post_completion(&rings);
+        }
+    }
+    EXPECT(dma_broker_take_job(&rings, &taken) == NULL);
+
+    /* with the completion ring full, jobs queued wait for the client to consume completions */
+    job = job_of(DMA_BROKER_RING_SIZE);
+    EXPECT(dma_broker_submit(&client, &job) == 0);
+    EXPECT(dma_broker_take_job(&rings, &taken) == NULL);
+    EXPECT(dma_broker_wait(&client, &done) == 0);
+    EXPECT(done.cookie == 0 && done.status == 0);
+    compl = dma_broker_take_job(&rings, &taken);
+    EXPECT(compl != NULL && taken.cookie == DMA_BROKER_RING_SIZE);
+    if (compl != NULL)
+    {
+        compl->cookie = taken.cookie;
+        compl->status = 0;
+        dma_broker_post_completion(&rings);
+    }
+    for (i = 1; i <= DMA_BROKER_RING_SIZE; i++)
+    {
+        EXPECT(dma_broker_wait(&client, &done) == 0);
+        EXPECT(done.cookie == i);
+    }
+    EXPECT(rings.cq_head == rings.cq_tail && rings.sq_head == rings.sq_tail);
+    drain(sv[1]);
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
+/* @return the pid of a process that exited */
+static pid_t exited_pid(void)
+{
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+    return pid;
+}
+
+static void test_slices(void)
+{
+    static const unsigned long sizes[2] = { BUF_SIZE, BUF_SIZE };
+    static struct dma_broker_table table;
+    struct dma_broker_job job;
+    pid_t self = getpid(), gone = exited_pid();
+    unsigned off0, off1, off;
+    int granted;
+
+    dma_broker_table_init(&table, 2, sizes, 2, 1);
+
+    /* client 0 gets buffer 0, its slices one after the other */
+    EXPECT(dma_broker_slice_alloc(&table, 0, self, 0, PAGE, &off0, &granted) == 0);
+    EXPECT(off0 == 0 && granted == 1);
+    EXPECT(dma_broker_slice_alloc(&table, 0, self, 0, 2 * PAGE, &off1, &granted) == 0);
+    EXPECT(off1 == PAGE && granted == 0);
+    /* no more than the buffer, and not from buffers that do not exist */
+    EXPECT(dma_broker_slice_alloc(&table, 0, self, 0, BUF_SIZE, &off, &granted) != 0);
+    EXPECT(dma_broker_slice_alloc(&table, 0, self, 0, 0, &off, &granted) != 0);
+    EXPECT(dma_broker_slice_alloc(&table, 0, self, 2, PAGE, &off, &granted) != 0);
+    /* buffer 0 is client 0's: client 1 gets buffer 1 */
+    EXPECT(dma_broker_slice_alloc(&table, 1, gone, 0, PAGE, &off, &granted) != 0);
+    EXPECT(dma_broker_slice_alloc(&table, 1, gone, 1, PAGE, &off, &granted) == 0);
+    EXPECT(off == 0 && granted == 1);
+
+    /* a job within a slice runs */
+    job = job_of(0);
+    job.num_xfers = 2;
+    job.xfers[0].engine = 0;
+    job.xfers[0].dir = DMA_BROKER_TO_DEV;
+    job.xfers[0].offset = 100;
+    job.xfers[0].length = PAGE - 100;
+    job.xfers[1].engine = 1;
+    job.xfers[1].dir = DMA_BROKER_FROM_DEV;
+    job.xfers[1].offset = off1;
+    job.xfers[1].length = 2 * PAGE;
+    job.kernel = 0;
+    job.num_args = DMA_BROKER_MAX_ARGS;
+    EXPECT(dma_broker_check_job(&table, 0, &job) == 0);
+    /* but not for another client */
+    EXPECT(dma_broker_check_job(&table, 1, &job) != 0);
+
+    /* across two slices, past a slice, or wrapping around */
+    job.num_xfers = 1;
+    job.xfers[0].length = PAGE;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.xfers[0].offset = off1;
+    job.xfers[0].length = 2 * PAGE + 1;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.xfers[0].offset = off1 + PAGE;
+    job.xfers[0].length = 0xFFFFFFFFU;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.xfers[0].offset = 0xFFFFF000U;
+    job.xfers[0].length = 0x2000U;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.xfers[0].offset = 0;
+    job.xfers[0].length = PAGE;
+    EXPECT(dma_broker_check_job(&table, 0, &job) == 0);
+
+    /* resources the broker does not have */
+    job.xfers[0].engine = 2;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.xfers[0].engine = 0;
+    job.xfers[0].dir = 2;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.xfers[0].dir = DMA_BROKER_TO_DEV;
+    job.xfers[0].buf = 2;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.xfers[0].buf = 0;
+    job.kernel = 1;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.kernel = -2;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.kernel = 0;
+    job.num_args = DMA_BROKER_MAX_ARGS + 1;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.num_args = 0;
+    job.num_xfers = DMA_BROKER_MAX_XFERS + 1;
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    job.num_xfers = 1;
+
+    /* slices are freed by their client only, and jobs on them are refused afterwards */
+    EXPECT(dma_broker_slice_free(&table, 1, 0, off0) != 0);
+    EXPECT(dma_broker_slice_free(&table, 0, 0, off0) == 0);
+    EXPECT(dma_broker_slice_free(&table, 0, 0, off0) != 0);
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    /* the space is reused, the buffer stays with its client */
+    EXPECT(dma_broker_slice_alloc(&table, 0, self, 0, PAGE, &off, &granted) == 0);
+    EXPECT(off == off0 && granted == 0);
+    EXPECT(dma_broker_slice_alloc(&table, 1, gone, 0, PAGE, &off, &granted) != 0);
+
+    /* the process of client 0 is alive: its buffer goes to it only */
+    dma_broker_client_gone(&table, 0);
+    EXPECT(dma_broker_check_job(&table, 0, &job) != 0);
+    EXPECT(dma_broker_slice_alloc(&table, 2, gone, 0, PAGE, &off, &granted) != 0);
+    EXPECT(dma_broker_slice_alloc(&table, 3, self, 0, PAGE, &off, &granted) == 0);
+    EXPECT(off == 0 && granted == 1);
+
+    /* the process of client 1 exited: its buffer goes to anyone */
+    dma_broker_client_gone(&table, 1);
+    EXPECT(dma_broker_slice_alloc(&table, 4, self, 1, 4 * PAGE, &off, &granted) == 0);
+    EXPECT(off == 0 && granted == 1);
+}
+
+int main(void)
+{
+    test_rings();
+    test_slices();
+
+    return expect_report();
+}
@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dma_capture.h"
+#include "dma_cdma.h"
+#include "dma_engine_buf.h"
+#include "dma_mcdma.h"
+#include "dma_plan.h"
+#include "dma_stats.h"
+#include "xhw_internals.h"
+#include "utils.h"
+
+/*
+ * Test of the deadline waits, cancellation and recovery against simulated hanging engines:
+ * the registers of two DMA engines and of a kernel are plain memory, so that transactions
+ * never end, channels halt only when the test says so and resets never complete.
+ * It needs no hardware and no bitstream. It also checks that waits, 2D transfers, plan
+ * replays, CDMA copies and MCDMA transfers stop and report the errors the engines raise,
+ * and that captures do not reset an engine running a transaction towards the device.
+ *
+ * USAGE: test_hang
+ */
+
+#define DEADLINE_NS 2000000ULL
+/* bound of any wait, including the halt and reset timeouts of the library */
+#define MAX_WAIT_NS 500000000ULL
+
+int main(__unused__ int argc, __unused__ char **argv)
+{
+    static uint32_t regs_a[FAKE_REGS], regs_b[FAKE_REGS], regs_c[FAKE_REGS], kernel_regs[FAKE_REGS];
+    struct udmabuf buf;
+    struct dma_engine a, b, c;
+    struct control_interface kernel;
+    struct dma_plan plan;
+    struct cdma_engine cdma;
+    static struct axi_mcdma_regs mcdma_regs;
+    static uint64_t descs[4 * AXI_MCDMA_SG_DESC_ALIGN / sizeof(uint64_t)];
+    struct udmabuf desc_buf;
+    struct mcdma_engine mcdma;
+    struct mcdma_completion compl;
+    struct dma_capture cap;
+    enum dma_err_status err;
+    uint64_t start, elapsed;
+
+    buf.fd = -1;
+    buf.vaddr = NULL;
+    buf.paddr = 0x10000000U;
+    buf.size = 4096;
+    fake_engine(&a, regs_a);
+    fake_engine(&b, regs_b);
+    fake_engine(&c, regs_c);
+
+    /* a transaction that never ends times out at the deadline, and is still awaited */
+    check_err(set_simple_transfer_to_device(&a, &buf, 0, 1024));
+    check_err(start_simple_transfer_to_device(&a));
+    start = dma_stats_now();
+    err = wait_simple_transfer_to_device_until(&a, 0, start + DEADLINE_NS);
+    elapsed = dma_stats_now() - start;
+    EXPECT(err == DMA_TRANS_TIMEOUT);
+    EXPECT(elapsed >= DEADLINE_NS && elapsed < MAX_WAIT_NS);
+    EXPECT(poll_simple_transfer_to_device(&a) == DMA_TRANS_RUNNING);
+    printf("wait timed out after %.1f us\n", (double)elapsed / 1e3);
+
+    /* a channel that halts is cancelled alone: the other direction keeps running */
+    check_err(set_simple_transfer_from_device(&a, &buf, 2048, 1024));
+    check_err(start_simple_transfer_from_device(&a));
+    regs_a[1] = 1;
+    err = cancel_simple_transfer_to_device(&a);
+    EXPECT(err == NO_ERROR);
+    EXPECT(a.to_dev.status == PROGRAMMED);
+    EXPECT(BIT(regs_a[0], 0) == 0 && BIT(regs_a[0], 2) == 0);
+    EXPECT(a.from_dev.status == STARTED && BIT(regs_a[12], 0) == 1);
+    EXPECT(cancel_simple_transfer_to_device(&a) == DMA_TRANS_NOT_STARTED);
+
+    /* engine b runs a transaction while engine a hangs */
+    check_err(set_simple_transfer_to_device(&b, &buf, 0, 512));
+    check_err(start_simple_transfer_to_device(&b));
+
+    /* a channel that never halts needs the reset, which a hung engine never completes */
+    start = dma_stats_now();
+    err = cancel_simple_transfer_from_device(&a);
+    elapsed = dma_stats_now() - start;
+    EXPECT(err == DMA_ENGINE_HUNG);
+    EXPECT(elapsed < MAX_WAIT_NS);
+    EXPECT(a.to_dev.status == NOT_STARTED && a.from_dev.status == NOT_STARTED);
+    EXPECT(reset_dma_engine(&a) == DMA_ENGINE_HUNG);
+    printf("hung engine given up after %.1f us\n", (double)elapsed / 1e3);
+
+    /* ... and engine b is untouched, its transaction completing as usual */
+    EXPECT(b.to_dev.status == STARTED && regs_b[0] == 1U && regs_b[10] == 512U);
+    regs_b[1] = 2;
+    EXPECT(wait_simple_transfer_to_device_until(&b, 0, dma_stats_now() + DEADLINE_NS) == NO_ERROR);
+    EXPECT(b.to_dev.status == PROGRAMMED);
+
+    /* a kernel that never ends times out as well */
+    memset(&kernel, 0, sizeof(kernel));
+    memset(kernel_regs, 0, sizeof(kernel_regs));
+    kernel.fd = -1;
+    kernel.control_regs_vaddr = (volatile char *)kernel_regs;
+    start_kernel(&kernel);
+    start = dma_stats_now();
+    err = wait_kernel_until(&kernel, 100, start + DEADLINE_NS);
+    elapsed = dma_stats_now() - start;
+    EXPECT(err == DMA_TRANS_TIMEOUT);
+    EXPECT(elapsed >= DEADLINE_NS && elapsed < MAX_WAIT_NS);
+    /* kernels are not calibrated: the automatic policy busy waits */
+    start = dma_stats_now();
+    err = wait_kernel_until(&kernel, DMA_USLEEP_AUTO, start + DEADLINE_NS);
+    elapsed = dma_stats_now() - start;
+    EXPECT(err == DMA_TRANS_TIMEOUT);
+    EXPECT(elapsed >= DEADLINE_NS && elapsed < MAX_WAIT_NS);
+    kernel_regs[0] = 0;
+    EXPECT(wait_kernel_until(&kernel, 0, dma_stats_now() + DEADLINE_NS) == NO_ERROR);
+
+    /* an engine halting on an error ends the wait, even without deadline ... */
+    check_err(set_simple_transfer_to_device(&c, &buf, 0, 1024));
+    check_err(start_simple_transfer_to_device(&c));
+    regs_c[1] = 1 | (1U << 4);
+    EXPECT(wait_simple_transfer_to_device(&c, 0) == DMA_TRANS_ERROR);
+    EXPECT(c.to_dev.status == PROGRAMMED);
+    EXPECT(err_status_to_device(&c) != 0);
+    check_err(start_simple_transfer_to_device(&c));
+    EXPECT(poll_simple_transfer_to_device(&c) == DMA_TRANS_ERROR);
+    /* ... and the cancellation recovers the halted channel via a reset */
+    EXPECT(cancel_simple_transfer_to_device(&c) == DMA_ENGINE_HUNG);
+    EXPECT(BIT(regs_c[0], 2) == 1);
+
+    /* a 2D transfer stops on the first row the engine reports an error for */
+    regs_b[1] = 1 | (1U << 4);
+    EXPECT(transfer_2d_to_device(&b, &buf, 0, 64, 3, 128, 0) == DMA_TRANS_ERROR);
+    EXPECT(regs_b[10] == 64U && regs_b[6] == 0x10000000U);
+    EXPECT(err_status_to_device(&b) != 0);
+    regs_b[1] = 2;
+    EXPECT(transfer_2d_to_device(&b, &buf, 0, 64, 3, 128, 0) == NO_ERROR);
+    EXPECT(regs_b[6] == 0x10000000U + 256U);
+
+    /* a 2D transfer gives up at its deadline, leaving the row in flight to a wait */
+    regs_b[1] = 0;
+    start = dma_stats_now();
+    err = transfer_2d_to_device_until(&b, &buf, 0, 64, 3, 128, 0, start + DEADLINE_NS);
+    elapsed = dma_stats_now() - start;
+    EXPECT(err == DMA_TRANS_TIMEOUT && b.to_dev.status == STARTED);
+    EXPECT(elapsed >= DEADLINE_NS && elapsed < MAX_WAIT_NS);
+    regs_b[1] = 2;
+    EXPECT(wait_simple_transfer_to_device(&b, 0) == NO_ERROR);
+
+    /* lengths are bound by the width of the length register */
+    set_dma_length_width(&b, 11);
+    EXPECT(set_simple_transfer_to_device(&b, &buf, 0, 4096) == DMA_TRANS_NOT_PROGRAMMED);
+    EXPECT(transfer_2d_to_device(&b, &buf, 0, 1024, 4, 1024, 0) == NO_ERROR);
+    EXPECT(regs_b[10] == 1024U && regs_b[6] == 0x10000000U + 3072U);
+
+    /* a replayed plan stops on an engine error, and gives up at its deadline */
+    if (dma_plan_init(&plan, 2) != 0 || dma_plan_transfer_to_device(&plan, &b, &buf, 0, 1024) < 0
+        || dma_plan_wait_to_device(&plan, &b, 0) < 0)
+    {
+        printf("cannot record the plan\n");
+        return -1;
+    }
+    EXPECT(dma_plan_run(&plan) == NO_ERROR);
+    regs_b[1] = 1 | (1U << 5);
+    EXPECT(dma_plan_run(&plan) == DMA_TRANS_ERROR);
+    EXPECT(b.to_dev.status == PROGRAMMED && plan.steps[0].dirty);
+    regs_b[1] = 0;
+    start = dma_stats_now();
+    err = dma_plan_run_until(&plan, start + DEADLINE_NS);
+    elapsed = dma_stats_now() - start;
+    EXPECT(err == DMA_TRANS_TIMEOUT && b.to_dev.status == STARTED);
+    EXPECT(elapsed >= DEADLINE_NS && elapsed < MAX_WAIT_NS);
+    regs_b[1] = 2;
+    EXPECT(wait_simple_transfer_to_device(&b, 0) == NO_ERROR);
+    dma_plan_destroy(&plan);
+
+    /* a CDMA copy ends on an engine error, gives up at its deadline, and the reset is bounded */
+    memset(&cdma, 0, sizeof(cdma));
+    memset(regs_c, 0, sizeof(regs_c));
+    cdma.fd = -1;
+    cdma.regs_vaddr = (volatile char *)regs_c;
+    check_err(set_simple_copy(&cdma, &buf, 2048, &buf, 0, 1024));
+    check_err(start_simple_copy(&cdma));
+    start = dma_stats_now();
+    err = wait_simple_copy_until(&cdma, 0, start + DEADLINE_NS);
+    elapsed = dma_stats_now() - start;
+    EXPECT(err == DMA_TRANS_TIMEOUT && cdma.copy.status == STARTED);
+    EXPECT(elapsed >= DEADLINE_NS && elapsed < MAX_WAIT_NS);
+    regs_c[1] = 1U << 6;
+    EXPECT(wait_simple_copy(&cdma, 0) == DMA_TRANS_ERROR);
+    EXPECT(err_status_copy(&cdma) != 0 && cdma.copy.status == PROGRAMMED);
+    start = dma_stats_now();
+    EXPECT(reset_cdma_engine(&cdma) == DMA_ENGINE_HUNG);
+    EXPECT(dma_stats_now() - start < MAX_WAIT_NS);
+
+    /* so does an MCDMA transfer, whose descriptor never completes */
+    memset(&mcdma, 0, sizeof(mcdma));
+    memset(&mcdma_regs, 0, sizeof(mcdma_regs));
+    mcdma.fd = -1;
+    mcdma.regs_vaddr = (volatile char *)&mcdma_regs;
+    desc_buf.fd = -1;
+    desc_buf.vaddr = descs;
+    desc_buf.paddr = 0x20000000U;
+    desc_buf.size = sizeof(descs);
+    EXPECT(set_mcdma_channel(&mcdma, MCDMA_TO_DEVICE, 0, &desc_buf, 0, 4) == 0);
+    EXPECT(submit_mcdma_transfer(&mcdma, MCDMA_TO_DEVICE, 0, &buf, 0, 1024) == NO_ERROR);
+    start = dma_stats_now();
+    err = wait_mcdma_completion_until(&mcdma, MCDMA_TO_DEVICE, 0, &compl, 0, start + DEADLINE_NS);
+    elapsed = dma_stats_now() - start;
+    EXPECT(err == DMA_TRANS_TIMEOUT);
+    EXPECT(elapsed >= DEADLINE_NS && elapsed < MAX_WAIT_NS);
+    mcdma_regs.mm2s_channels[0].status = 1U << 7;
+    EXPECT(wait_mcdma_completion(&mcdma, MCDMA_TO_DEVICE, 0, &compl, 0) == DMA_TRANS_ERROR);
+    start = dma_stats_now();
+    EXPECT(reset_mcdma_engine(&mcdma) == DMA_ENGINE_HUNG);
+    EXPECT(dma_stats_now() - start < MAX_WAIT_NS);
+
+    /* the reset of a capture spares a transaction towards the device, and is bounded */
+    fake_engine(&c, regs_c);
+    c.sg_mode = 1;
+    check_err(dma_capture_init(&cap, &c, &buf, 0, 1024, 2, &desc_buf, 0));
+    c.to_dev.status = STARTED;
+    EXPECT(dma_capture_start(&cap) == DMA_TRANS_RUNNING && !cap.running);
+    c.to_dev.status = PROGRAMMED;
+    start = dma_stats_now();
+    EXPECT(dma_capture_start(&cap) == DMA_ENGINE_HUNG && !cap.running);
+    EXPECT(dma_stats_now() - start < MAX_WAIT_NS);
+    EXPECT(c.to_dev.status == NOT_STARTED);
+    dma_capture_destroy(&cap);
+
+    return expect_report();
+}
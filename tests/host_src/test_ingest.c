@@ -0,0 +1,133 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_stream_io.h"
+#include "xhw_internals.h"
+#include "utils.h"
+
+/*
+ * Test of the file-to-FPGA streaming against a simulated DMA engine, whose registers are
+ * plain memory always reporting the engine idle, and a UDMA buffer in plain memory:
+ * a file is streamed and the data of each slice checked, then streams failing on reads and
+ * on engine errors or timeouts must leave the pipeline usable for the next stream.
+ * It needs no hardware and no bitstream, but a kernel with io_uring (5.6 or later).
+ *
+ * USAGE: test_ingest
+ */
+
+#define FILE_SIZE 10007U
+#define SLICE_SIZE 1024U
+#define NUM_SLICES 4U
+
+struct received {
+    struct udmabuf *buf;
+    unsigned char data[FILE_SIZE];
+    unsigned length;
+};
+
+/* the engine would send the slice right after: collect it as the FPGA logic would */
+static void on_slice(void *arg, unsigned slice, unsigned length)
+{
+    struct received *rx = (struct received *)arg;
+    if (rx->length + length > FILE_SIZE)
+    {
+        printf("FAILED: slices beyond the file size\n");
+        expect_failures++;
+        return;
+    }
+    memcpy(rx->data + rx->length, (char *)rx->buf->vaddr + slice * SLICE_SIZE, length);
+    rx->length += length;
+}
+
+static void expect_stream(struct dma_ingest *ingest, struct received *rx, int fd,
+    const unsigned char *content)
+{
+    rx->length = 0;
+    EXPECT(dma_ingest_file(ingest, fd, 0, FILE_SIZE, 0) == (long long)FILE_SIZE);
+    EXPECT(rx->length == FILE_SIZE && memcmp(rx->data, content, FILE_SIZE) == 0);
+    EXPECT(ingest->reads_in_flight == 0);
+}
+
+int main(void)
+{
+    static uint32_t regs[FAKE_REGS];
+    static unsigned char content[FILE_SIZE];
+    static struct received rx;
+    char path[] = "/tmp/test_ingestXXXXXX";
+    struct dma_engine engine;
+    struct dma_ingest ingest;
+    struct udmabuf buf;
+    unsigned i;
+    int fd, dir_fd;
+
+    fake_engine(&engine, regs);
+    /* both channels idle: transactions end as soon as they start */
+    regs[1] = 2;
+    regs[13] = 2;
+    buf.fd = -1;
+    buf.size = SLICE_SIZE * NUM_SLICES;
+    buf.vaddr = malloc(buf.size);
+    buf.paddr = 0x10000000U;
+    rx.buf = &buf;
+
+    for (i = 0; i < FILE_SIZE; i++)
+    {
+        content[i] = (unsigned char)(i * 7U + (i >> 8));
+    }
+    fd = mkstemp(path);
+    dir_fd = open("/", O_RDONLY);
+    if (buf.vaddr == NULL || fd < 0 || dir_fd < 0
+        || write(fd, content, FILE_SIZE) != (ssize_t)FILE_SIZE)
+    {
+        printf("cannot prepare the test file\n");
+        return -1;
+    }
+    unlink(path);
+    if (dma_ingest_init(&ingest, &engine, &buf, 0, SLICE_SIZE, NUM_SLICES, on_slice, &rx) != 0)
+    {
+        printf("cannot create the pipeline: is io_uring available?\n");
+        return -1;
+    }
+
+    /* all data go through the slices, in order */
+    expect_stream(&ingest, &rx, fd, content);
+    EXPECT(engine.to_dev.status == PROGRAMMED);
+    EXPECT(regs[10] == FILE_SIZE % SLICE_SIZE);
+
+    /* reads failing on all slices: the failed reads are reaped, none is left for later */
+    printf("a failing stream is expected to print errors\n");
+    EXPECT(dma_ingest_file(&ingest, dir_fd, 0, FILE_SIZE, 0) < 0);
+    EXPECT(ingest.reads_in_flight == 0);
+    expect_stream(&ingest, &rx, fd, content);
+
+    /* the engine reports an error on the first slice */
+    regs[1] = 2 | (1U << 4);
+    rx.length = 0;
+    EXPECT(dma_ingest_file(&ingest, fd, 0, FILE_SIZE, 0) < 0);
+    EXPECT(ingest.reads_in_flight == 0);
+    EXPECT(engine.to_dev.status != STARTED);
+    regs[1] = 2;
+    expect_stream(&ingest, &rx, fd, content);
+
+    /* the first slice is never sent: its transaction is cancelled at the timeout */
+    regs[1] = 0;
+    rx.length = 0;
+    ingest.slice_timeout_ns = 2000000ULL;
+    EXPECT(dma_ingest_file(&ingest, fd, 0, FILE_SIZE, 0) < 0);
+    EXPECT(ingest.reads_in_flight == 0);
+    EXPECT(engine.to_dev.status != STARTED);
+    regs[1] = 2;
+    expect_stream(&ingest, &rx, fd, content);
+
+    dma_ingest_destroy(&ingest);
+    close(fd);
+    close(dir_fd);
+    free(buf.vaddr);
+
+    return expect_report();
+}
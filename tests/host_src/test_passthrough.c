@@ -3,6 +3,7 @@
 #include <unistd.h>
 
 #include "dma_engine_buf.h"
+#include "dma_copy.h"
 #include "xhw_internals.h"
 #include "utils.h"
 
@@ -20,7 +21,10 @@ int main(__unused__ int argc, __unused__ char **argv)
     int *b1, *b2;
     enum dma_err_status err_retval;
 
-    load_udma_buffers( NUM_BUFFERS, sizes, buffers);
+    if (load_udma_buffers( NUM_BUFFERS, sizes, buffers) != 0)
+    {
+        return -1;
+    }
 
     printf("DMA buffers created\n");
 
@@ -36,8 +40,8 @@ int main(__unused__ int argc, __unused__ char **argv)
     b2 = (int*)buffers[1].vaddr;
     for(i = 0; i < BUFSIZE / sizeof(int); i++) {
         b1[i] = (int)i + PLUS;
-        b2[i] = 0;
     }
+    udmabuf_fill(buffers + 1, 0, 0, BUFSIZE);
 
     /*
      * initiate DMA transaction from device
@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dma_engine_buf.h"
+#include "dma_sched.h"
+#include "utils.h"
+
+/*
+ * Test of the order in which the scheduler starts pieces, against a simulated DMA engine
+ * whose registers are plain memory: the piece in flight completes only when the test marks
+ * the engine idle, so that each step runs exactly one piece, and the piece started is read
+ * back from the address register. It checks that an urgent request with credit goes right
+ * after the piece in flight, that one out of credit waits no longer than the bound documented
+ * in dma_sched.h, and that classes get their shares while both are queued. From the device,
+ * it checks that a request advances by the bytes received and ends with a short piece.
+ * It needs no hardware and no bitstream.
+ *
+ * USAGE: test_sched
+ */
+
+#define QUANTUM 4096U
+#define BULK_SHARE 3U
+#define URGENT_SHARE 1U
+#define BULK_SIZE (8U * 1024U * 1024U)
+#define URGENT_OFFSET BULK_SIZE
+#define BUF_PADDR 0x10000000U
+
+#define STEPS 400U
+
+static uint32_t regs[FAKE_REGS];
+
+/* keeps the piece in flight running, e.g. while requests are submitted */
+static void hold(void)
+{
+    regs[1] = 0;
+}
+
+/* completes the piece in flight and returns whether the next one started is urgent */
+static int step(struct dma_sched *sched)
+{
+    regs[1] = 2;
+    dma_sched_progress(sched);
+    hold();
+    return regs[6] >= BUF_PADDR + URGENT_OFFSET;
+}
+
+/*
+ * keeps urgent requests of @p urgent_size bytes queued behind a bulk request for STEPS pieces;
+ * returns the longest run of bulk pieces between two urgent ones and the bytes of each class
+ */
+static unsigned run(struct dma_sched *sched, struct udmabuf *buf, unsigned urgent_size,
+    unsigned long long *urgent_bytes, unsigned long long *bulk_bytes)
+{
+    struct dma_sched_req bulk, urgent;
+    unsigned i, gap = 0, max_gap = 0;
+
+    memset(&bulk, 0, sizeof(bulk));
+    memset(&urgent, 0, sizeof(urgent));
+    *urgent_bytes = *bulk_bytes = 0;
+    hold();
+    EXPECT(dma_sched_submit(sched, &bulk, DMA_SCHED_BULK, DMA_SCHED_TO_DEV, buf, 0,
+        BULK_SIZE) == 0);
+    EXPECT(dma_sched_submit(sched, &urgent, DMA_SCHED_URGENT, DMA_SCHED_TO_DEV, buf,
+        URGENT_OFFSET, urgent_size) == 0);
+    for (i = 0; i < STEPS; i++)
+    {
+        if (step(sched))
+        {
+            *urgent_bytes += regs[10];
+            max_gap = gap > max_gap ? gap : max_gap;
+            gap = 0;
+        } else
+        {
+            *bulk_bytes += regs[10];
+            gap++;
+        }
+        /* a closed-loop urgent submitter */
+        if (urgent.status == DMA_SCHED_DONE)
+        {
+            urgent.status = DMA_SCHED_IDLE;
+            EXPECT(dma_sched_submit(sched, &urgent, DMA_SCHED_URGENT, DMA_SCHED_TO_DEV, buf,
+                URGENT_OFFSET, urgent_size) == 0);
+        }
+    }
+    EXPECT(bulk.status == DMA_SCHED_RUNNING);
+    /* let everything end, for the next run */
+    regs[1] = 2;
+    dma_sched_wait(sched, &bulk, 0);
+    dma_sched_wait(sched, &urgent, 0);
+    return max_gap;
+}
+
+/* the bytes of the two classes are in the ratio of their shares, but for a request and a refill */
+static int shares_kept(unsigned long long urgent_bytes, unsigned long long bulk_bytes,
+    unsigned urgent_size)
+{
+    unsigned long long u = urgent_bytes * BULK_SHARE, b = bulk_bytes * URGENT_SHARE;
+    unsigned long long tolerance = (unsigned long long)(urgent_size + QUANTUM) * BULK_SHARE;
+
+    return (u > b ? u - b : b - u) <= tolerance;
+}
+
+int main(void)
+{
+    static const struct dma_sched_class_cfg classes[2] = {
+        { 0, URGENT_SHARE }, /* urgent, not split */
+        { QUANTUM, BULK_SHARE } /* bulk */
+    };
+    struct dma_engine engine;
+    struct udmabuf buf;
+    struct dma_sched sched;
+    struct dma_sched_req bulk, urgent;
+    unsigned long long urgent_bytes, bulk_bytes;
+    unsigned gap;
+
+    fake_engine(&engine, regs);
+    buf.fd = -1;
+    buf.vaddr = NULL;
+    buf.paddr = BUF_PADDR;
+    buf.size = 2 * BULK_SIZE;
+    if (dma_sched_init(&sched, &engine, 2, classes) != 0)
+    {
+        printf("cannot create the scheduler\n");
+        return -1;
+    }
+    EXPECT(sched.quantum == QUANTUM);
+
+    /* an urgent request with credit goes right after the bulk piece in flight */
+    memset(&bulk, 0, sizeof(bulk));
+    memset(&urgent, 0, sizeof(urgent));
+    hold();
+    EXPECT(dma_sched_submit(&sched, &bulk, DMA_SCHED_BULK, DMA_SCHED_TO_DEV, &buf, 0,
+        BULK_SIZE) == 0);
+    EXPECT(regs[6] == BUF_PADDR && regs[10] == QUANTUM);
+    EXPECT( !step(&sched) );
+    EXPECT(dma_sched_submit(&sched, &urgent, DMA_SCHED_URGENT, DMA_SCHED_TO_DEV, &buf,
+        URGENT_OFFSET, 1024) == 0);
+    EXPECT(step(&sched));
+    EXPECT(regs[10] == 1024U);
+    regs[1] = 2;
+    EXPECT(dma_sched_wait(&sched, &urgent, 0) == 0);
+    EXPECT(dma_sched_wait(&sched, &bulk, 0) == 0);
+    EXPECT(bulk.done == BULK_SIZE);
+
+    /* from FPGA logic, a request advances by the bytes received, and a short piece ends it */
+    memset(&bulk, 0, sizeof(bulk));
+    regs[13] = 0;
+    EXPECT(dma_sched_submit(&sched, &bulk, DMA_SCHED_BULK, DMA_SCHED_FROM_DEV, &buf, 0,
+        3 * QUANTUM) == 0);
+    EXPECT(regs[18] == BUF_PADDR && regs[22] == QUANTUM);
+    regs[13] = 2;
+    dma_sched_progress(&sched);
+    regs[13] = 0;
+    EXPECT(bulk.done == QUANTUM && regs[18] == BUF_PADDR + QUANTUM);
+    /* the FPGA logic asserts TLAST after 100 bytes */
+    regs[22] = 100;
+    regs[13] = 2;
+    EXPECT(dma_sched_wait(&sched, &bulk, 0) == 0);
+    EXPECT(bulk.done == QUANTUM + 100);
+    EXPECT(regs[18] == BUF_PADDR + QUANTUM && sched.channels[DMA_SCHED_FROM_DEV].current == NULL);
+
+    /* urgent requests of a quantum: out of credit, they wait for at most a bulk refill */
+    gap = run(&sched, &buf, QUANTUM, &urgent_bytes, &bulk_bytes);
+    printf("urgent requests of %u bytes: up to %u bulk pieces in between, %llu / %llu bytes\n",
+        QUANTUM, gap, urgent_bytes, bulk_bytes);
+    EXPECT(gap <= BULK_SHARE);
+    EXPECT(shares_kept(urgent_bytes, bulk_bytes, QUANTUM));
+
+    /* larger urgent requests take the credit below zero, and wait for more refills */
+    gap = run(&sched, &buf, 4 * QUANTUM, &urgent_bytes, &bulk_bytes);
+    printf("urgent requests of %u bytes: up to %u bulk pieces in between, %llu / %llu bytes\n",
+        4 * QUANTUM, gap, urgent_bytes, bulk_bytes);
+    EXPECT(gap <= 4 * BULK_SHARE);
+    EXPECT(shares_kept(urgent_bytes, bulk_bytes, 4 * QUANTUM));
+
+    dma_sched_destroy(&sched);
+
+    return expect_report();
+}
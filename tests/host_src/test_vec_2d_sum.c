@@ -3,20 +3,23 @@
 #include <unistd.h>
 
 #include "dma_engine_buf.h"
+#include "dma_trace.h"
 #include "xhw_internals.h"
 #include "utils.h"
+#include "utils_vec_2d_sum.h"
 
 #define NUM_BUFFERS 3
 
-#define NUM_VALUES 256U
-#define BUFSIZE ( NUM_VALUES * 4U)
+/* not a multiple of the lanes, so that the last stream word is partial */
+#define NUM_VALUES 253U
 #define A 1
 #define B 52
 #define C 4
 
-int main(__unused__ int argc, __unused__ char **argv)
+int main(int argc, char **argv)
 {
-    unsigned long sizes[NUM_BUFFERS] = { BUFSIZE, BUFSIZE, BUFSIZE };
+    unsigned stream_bytes = vec_2d_sum_stream_bytes(NUM_VALUES);
+    unsigned long sizes[NUM_BUFFERS] = { stream_bytes, stream_bytes, stream_bytes };
     struct udmabuf buffers[NUM_BUFFERS];
 
     phys_addr_t dmas[] = {0x40400000, 0x40410000};
@@ -29,7 +32,10 @@ int main(__unused__ int argc, __unused__ char **argv)
     int *in1, *in2, *out;
     enum dma_err_status err_retval;
 
-    load_udma_buffers( NUM_BUFFERS, sizes, buffers);
+    if (load_udma_buffers( NUM_BUFFERS, sizes, buffers) != 0)
+    {
+        return -1;
+    }
 
     printf("DMA buffers created\n");
 
@@ -44,6 +50,15 @@ int main(__unused__ int argc, __unused__ char **argv)
 
     printf("2D VecSum kernel interface created\n");
 
+    /* optionally trace the run, to see how engines and kernel overlap */
+    if (argc > 1)
+    {
+        dma_trace_name_engine(engine, "dma0");
+        dma_trace_name_engine(engine + 1, "dma1");
+        dma_trace_name_kernel(&vec_sum, "vec_2d_sum");
+        dma_trace_start(0);
+    }
+
     /* init buffers */
     in1 = (int*)buffers[0].vaddr;
     in2 = (int*)buffers[1].vaddr;
@@ -53,6 +68,10 @@ int main(__unused__ int argc, __unused__ char **argv)
         in2[i] = (int)NUM_VALUES - (int)i;
         out[i] = 0;
     }
+    /* padding of the last stream word */
+    for(; i < stream_bytes / 4U; i++) {
+        in1[i] = in2[i] = out[i] = 0;
+    }
 
     /*
      * set kernel arguments
@@ -67,7 +86,7 @@ int main(__unused__ int argc, __unused__ char **argv)
      * initiate DMA transaction from device
      */
     printf("\nstarting transfer from device 0...\n");
-    err_retval = set_simple_transfer_from_device(engine, buffers + 2, 0, BUFSIZE);
+    err_retval = set_simple_transfer_from_device(engine, buffers + 2, 0, stream_bytes);
     check_err(err_retval);
     err_retval = start_simple_transfer_from_device(engine);
     check_err(err_retval);
@@ -77,14 +96,14 @@ int main(__unused__ int argc, __unused__ char **argv)
      * initiate DMA transaction to devices
      */
     printf("\nstarting transfer to device 0...\n");
-    err_retval = set_simple_transfer_to_device(engine, buffers, 0, BUFSIZE);
+    err_retval = set_simple_transfer_to_device(engine, buffers, 0, stream_bytes);
     check_err(err_retval);
     err_retval = start_simple_transfer_to_device(engine);
     check_err(err_retval);
     printf("transfer to device 0 started\n");
 
     printf("\nstarting transfer to device 1...\n");
-    err_retval = set_simple_transfer_to_device(engine + 1, buffers + 1, 0, BUFSIZE);
+    err_retval = set_simple_transfer_to_device(engine + 1, buffers + 1, 0, stream_bytes);
     check_err(err_retval);
     err_retval = start_simple_transfer_to_device(engine + 1);
     check_err(err_retval);
@@ -115,6 +134,11 @@ int main(__unused__ int argc, __unused__ char **argv)
     err_retval = wait_simple_transfer_from_device(engine, 0);
     check_err(err_retval);
 
+    if (argc > 1 && dma_trace_stop(argv[1]) == 0)
+    {
+        printf("\ntrace written to %s\n", argv[1]);
+    }
+
     /*
      * check results
      */
@@ -5,20 +5,24 @@
  * @brief Implementation of debugging utilities.
  */
 
+#define _POSIX_C_SOURCE 199309L
 #include <stdio.h>
-#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "xhw_internals.h"
+#include "dma_bitstream.h"
+#include "utils.h"
 
 int flash_bitstream(const char *path)
 {
-    int retval;
-    char *command = malloc( 2048 * sizeof(char) );
-    sprintf(command, "cat %s > /dev/xdevcfg\n", path);
-    retval = system(command);
+    int retval = dma_bitstream_load(path, 0);
 
-    free(command);
-    return retval;
+    if (retval == 1)
+    {
+        printf("%s already loaded\n", path);
+    }
+    return retval < 0 ? -1 : 0;
 }
 
 void check_err(enum dma_err_status err)
@@ -86,8 +90,8 @@ void print_err_mask(unsigned mask)
 
 void print_buffer_status(int buf_id, struct udmabuf *buf)
 {
-    printf("ubuffer %d:\n\tphys addr %lx\n\tvirt mapping %p\n\tlength %lu\n",
-        buf_id, (unsigned long)buf->paddr, buf->vaddr, buf->size);
+    printf("ubuffer %d:\n\tphys addr %llx\n\tvirt mapping %p\n\tlength %lu\n",
+        buf_id, (unsigned long long)buf->paddr, buf->vaddr, buf->size);
 }
 
 void print_kernel_status(struct control_interface *ctrl_intf)
@@ -98,3 +102,33 @@ void print_kernel_status(struct control_interface *ctrl_intf)
         "IP interrupt %x\n\tIP interrupt status %x\n",
         regs->control, regs->global_int, regs->ip_int, regs->ip_int_status);
 }
+
+uint64_t time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void fake_engine(struct dma_engine *engine, uint32_t *regs)
+{
+    memset(regs, 0, FAKE_REGS * sizeof(uint32_t));
+    memset(engine, 0, sizeof(*engine));
+    engine->fd = -1;
+    engine->regs_vaddr = (volatile char *)regs;
+    engine->addr_width = 32;
+    engine->length_width = DMA_DEF_LENGTH_WIDTH;
+}
+
+unsigned expect_failures;
+
+int expect_report(void)
+{
+    if (expect_failures != 0)
+    {
+        printf("%u checks failed\n", expect_failures);
+        return -1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -28,7 +28,10 @@
 extern "C" {
 #endif
 
-
+/*
+ * programs the FPGA with the bitstream at @p path, unless already loaded (see dma_bitstream.h);
+ * returns non-0 on failure
+ */
 int flash_bitstream(const char *path);
 
 void check_err(enum dma_err_status err);
@@ -41,6 +44,44 @@ void print_buffer_status(int buf_id, struct udmabuf *buf);
 
 void print_kernel_status(struct control_interface *ctrl_intf);
 
+/*
+ * monotonic time in nanoseconds, for benchmarks
+ */
+uint64_t time_ns(void);
+
+/*
+ * number of registers of the simulated engines of @ref fake_engine
+ */
+#define FAKE_REGS 64
+
+/*
+ * sets @p engine up as a simulated DMA engine in Direct Register Mode, whose registers are
+ * the FAKE_REGS words at @p regs, cleared: the channels neither end transactions nor halt
+ * until the caller sets their status words (1 and 13), and resets never complete
+ */
+void fake_engine(struct dma_engine *engine, uint32_t *regs);
+
+/*
+ * number of failed checks, as counted by EXPECT
+ */
+extern unsigned expect_failures;
+
+/*
+ * checks @p cond, printing it and counting a failure if false; tests go on after a failure
+ */
+#define EXPECT(cond) do {                                                   \
+        if ( !(cond) )                                                      \
+        {                                                                   \
+            printf("FAILED: %s (line %d)\n", #cond, __LINE__);              \
+            expect_failures++;                                              \
+        }                                                                   \
+    } while (0)
+
+/*
+ * prints the outcome of the checks; returns the exit code of the test, 0 if all passed
+ */
+int expect_report(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,280 @@
+
+/**
+ * @file utils_vec_2d_sum.c
+ * @author Alberto Scolari
+ * @brief Implementation of the CPU and FPGA backends of the 2D Vector Sum kernel.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+
+#include "utils_vec_2d_sum.h"
+#include "dma_copy.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SUM_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__arm__)
+/* the NEON loop is in utils_vec_2d_sum_neon.c, the only file built with NEON enabled */
+#define SUM_NEON
+#ifndef __aarch64__
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+#endif
+
+/* kernel arguments, as in the control interface of the design */
+#define ARG_NUM 0
+#define ARG_A 1
+#define ARG_B 2
+#define ARG_C 3
+
+struct sum_impl {
+    const char *name;
+    int (*available)(void);
+    void (*sum)(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+        int32_t a, int32_t b, int32_t c);
+};
+
+static int always_available(void)
+{
+    return 1;
+}
+
+/* unsigned arithmetic wraps around like the kernel, without undefined behaviour */
+static void scalar_sum(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+    int32_t a, int32_t b, int32_t c)
+{
+    unsigned i;
+    for (i = 0; i < num; i++)
+    {
+        out[i] = (int32_t)((uint32_t)a * (uint32_t)in1[i] + (uint32_t)b * (uint32_t)in2[i]
+            + (uint32_t)c);
+    }
+}
+
+#ifdef SUM_X86
+
+static int sse41_available(void)
+{
+    return __builtin_cpu_supports("sse4.1");
+}
+
+__attribute__((target("sse4.1")))
+static void sse41_sum(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+    int32_t a, int32_t b, int32_t c)
+{
+    __m128i va = _mm_set1_epi32(a), vb = _mm_set1_epi32(b), vc = _mm_set1_epi32(c);
+    unsigned i;
+    for (i = 0; i + 4 <= num; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in1 + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(in2 + i));
+        __m128i r = _mm_add_epi32(_mm_mullo_epi32(va, x), _mm_mullo_epi32(vb, y));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi32(r, vc));
+    }
+    scalar_sum(in1 + i, in2 + i, out + i, num - i, a, b, c);
+}
+
+static int avx2_available(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static void avx2_sum(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+    int32_t a, int32_t b, int32_t c)
+{
+    __m256i va = _mm256_set1_epi32(a), vb = _mm256_set1_epi32(b), vc = _mm256_set1_epi32(c);
+    unsigned i;
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in1 + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(in2 + i));
+        __m256i r = _mm256_add_epi32(_mm256_mullo_epi32(va, x), _mm256_mullo_epi32(vb, y));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi32(r, vc));
+    }
+    scalar_sum(in1 + i, in2 + i, out + i, num - i, a, b, c);
+}
+
+#endif /* SUM_X86 */
+
+#ifdef SUM_NEON
+
+static int neon_available(void)
+{
+#ifdef __aarch64__
+    return 1;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+
+static void neon_sum(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+    int32_t a, int32_t b, int32_t c)
+{
+    unsigned i = vec_2d_sum_neon(in1, in2, out, num, a, b, c);
+    scalar_sum(in1 + i, in2 + i, out + i, num - i, a, b, c);
+}
+
+#endif /* SUM_NEON */
+
+/* ordered from the least to the most preferred */
+static const struct sum_impl impls[] = {
+    { "scalar", always_available, scalar_sum },
+#ifdef SUM_NEON
+    { "neon", neon_available, neon_sum },
+#endif
+#ifdef SUM_X86
+    { "sse4.1", sse41_available, sse41_sum },
+    { "avx2", avx2_available, avx2_sum },
+#endif
+};
+
+#define NUM_IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+static const struct sum_impl *current_impl;
+
+static const struct sum_impl *get_impl(void)
+{
+    if (current_impl == NULL)
+    {
+        unsigned i;
+        const struct sum_impl *best = impls;
+#ifdef SUM_X86
+        __builtin_cpu_init();
+#endif
+        for (i = 1; i < NUM_IMPLS; i++)
+        {
+            if (impls[i].available())
+            {
+                best = impls + i;
+            }
+        }
+        current_impl = best;
+    }
+    return current_impl;
+}
+
+void vec_2d_sum_cpu(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+    int32_t a, int32_t b, int32_t c)
+{
+    get_impl()->sum(in1, in2, out, num, a, b, c);
+}
+
+const char *vec_2d_sum_cpu_impl(void)
+{
+    return get_impl()->name;
+}
+
+int vec_2d_sum_cpu_select(const char *name)
+{
+    unsigned i;
+#ifdef SUM_X86
+    __builtin_cpu_init();
+#endif
+    for (i = 0; i < NUM_IMPLS; i++)
+    {
+        if (strcmp(impls[i].name, name) == 0 && impls[i].available())
+        {
+            current_impl = impls + i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int vec_2d_sum_cpu_run(void *ctx, unsigned first, unsigned count)
+{
+    struct vec_2d_sum *call = (struct vec_2d_sum *)ctx;
+
+    vec_2d_sum_cpu(call->in1 + first, call->in2 + first, call->out + first, count,
+        call->a, call->b, call->c);
+    return 0;
+}
+
+int vec_2d_sum_fpga_start(void *ctx, unsigned first, unsigned count)
+{
+    struct vec_2d_sum *call = (struct vec_2d_sum *)ctx;
+    unsigned bytes = count * (unsigned)sizeof(int32_t);
+    unsigned stream_bytes = vec_2d_sum_stream_bytes(count);
+    enum dma_err_status err;
+
+    if (stream_bytes > call->buffers[0].size || stream_bytes > call->buffers[1].size
+        || stream_bytes > call->buffers[2].size)
+    {
+        printf("%s: %u items do not fit into the UDMA buffers\n", __func__, count);
+        return -1;
+    }
+    udmabuf_copy_in(call->buffers, 0, call->in1 + first, bytes);
+    udmabuf_copy_in(call->buffers + 1, 0, call->in2 + first, bytes);
+    if (stream_bytes > bytes)
+    {
+        udmabuf_fill(call->buffers, bytes, 0, stream_bytes - bytes);
+        udmabuf_fill(call->buffers + 1, bytes, 0, stream_bytes - bytes);
+    }
+    set_kernel_argument_uint(call->kernel, ARG_NUM, count);
+    set_kernel_argument_uint(call->kernel, ARG_A, (uint32_t)call->a);
+    set_kernel_argument_uint(call->kernel, ARG_B, (uint32_t)call->b);
+    set_kernel_argument_uint(call->kernel, ARG_C, (uint32_t)call->c);
+
+    err = set_simple_transfer_from_device(call->engines, call->buffers + 2, 0, stream_bytes);
+    if (err == NO_ERROR)
+    {
+        err = start_simple_transfer_from_device(call->engines);
+    }
+    if (err == NO_ERROR)
+    {
+        err = set_simple_transfer_to_device(call->engines, call->buffers, 0, stream_bytes);
+    }
+    if (err == NO_ERROR)
+    {
+        err = start_simple_transfer_to_device(call->engines);
+    }
+    if (err == NO_ERROR)
+    {
+        err = set_simple_transfer_to_device(call->engines + 1, call->buffers + 1, 0,
+            stream_bytes);
+    }
+    if (err == NO_ERROR)
+    {
+        err = start_simple_transfer_to_device(call->engines + 1);
+    }
+    if (err != NO_ERROR)
+    {
+        printf("%s: cannot start DMA transactions (error %d)\n", __func__, (int)err);
+        return -1;
+    }
+    start_kernel(call->kernel);
+    call->fpga_first = first;
+    call->fpga_count = count;
+    return 0;
+}
+
+int vec_2d_sum_fpga_wait(void *ctx)
+{
+    struct vec_2d_sum *call = (struct vec_2d_sum *)ctx;
+    int ret = 0;
+
+    wait_kernel(call->kernel, 0);
+    if (wait_simple_transfer_to_device(call->engines, 0) != NO_ERROR
+        || wait_simple_transfer_to_device(call->engines + 1, 0) != NO_ERROR
+        || wait_simple_transfer_from_device(call->engines, 0) != NO_ERROR)
+    {
+        ret = -1;
+    }
+    if (err_status_to_device(call->engines) != 0 || err_status_to_device(call->engines + 1) != 0
+        || err_status_from_device(call->engines) != 0)
+    {
+        printf("%s: DMA engine error 0x%x 0x%x 0x%x\n", __func__,
+            err_status_to_device(call->engines), err_status_to_device(call->engines + 1),
+            err_status_from_device(call->engines));
+        ret = -1;
+    }
+    udmabuf_copy_out(call->out + call->fpga_first, call->buffers + 2, 0,
+        call->fpga_count * sizeof(int32_t));
+    return ret;
+}
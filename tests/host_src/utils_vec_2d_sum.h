@@ -0,0 +1,96 @@
+
+/**
+ * @file utils_vec_2d_sum.h
+ * @author Alberto Scolari
+ * @brief Header with the CPU and FPGA backends of the 2D Vector Sum kernel
+ * (out = a * in1 + b * in2 + c, on 32 bits integers wrapping around as in the HLS kernel),
+ * with the interface of the offload dispatcher (see dma_offload.h).
+ */
+
+#ifndef DMA_UTILS_VEC_2D_SUM_H_
+#define DMA_UTILS_VEC_2D_SUM_H_
+
+#include <stdint.h>
+
+#include "dma_engine_buf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * values per stream word of the kernel, as its LANES (see the DESIGN.md of vec_2d_sum):
+ * the streams move whole words, so transactions are padded to a multiple of the word
+ */
+#ifndef VEC_2D_SUM_LANES
+#define VEC_2D_SUM_LANES 1U
+#endif
+
+/*
+ * bytes of the stream words carrying @p count values, padding included
+ */
+static inline unsigned vec_2d_sum_stream_bytes(unsigned count)
+{
+    return (count + VEC_2D_SUM_LANES - 1U) / VEC_2D_SUM_LANES * VEC_2D_SUM_LANES
+        * (unsigned)sizeof(int32_t);
+}
+
+/*
+ * a call of the kernel on cached arrays, and the hardware of the vec_2d_sum design:
+ * engine 0 sends in1 and receives out, engine 1 sends in2, via UDMA buffers 0, 1 and 2
+ */
+struct vec_2d_sum {
+    const int32_t *in1;
+    const int32_t *in2;
+    int32_t *out;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+    struct udmabuf *buffers;
+    struct dma_engine *engines;
+    struct control_interface *kernel;
+    unsigned fpga_first; /* range in flight on the FPGA */
+    unsigned fpga_count;
+};
+
+/*
+ * vectorized CPU implementation, with NEON on ARM and SSE4.1/AVX2 on x86,
+ * chosen at runtime according to the CPU capabilities
+ */
+void vec_2d_sum_cpu(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+    int32_t a, int32_t b, int32_t c);
+
+/*
+ * NEON loop of vec_2d_sum_cpu, built in utils_vec_2d_sum_neon.c with NEON enabled;
+ * returns how many elements it computed, from the first
+ */
+unsigned vec_2d_sum_neon(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+    int32_t a, int32_t b, int32_t c);
+
+/*
+ * name of the CPU implementation in use ("scalar", "neon", "sse4.1" or "avx2")
+ */
+const char *vec_2d_sum_cpu_impl(void);
+
+/*
+ * forces the CPU implementation named @p name; returns non-0 if not available
+ */
+int vec_2d_sum_cpu_select(const char *name);
+
+/*
+ * backends of the dispatcher, on items [first, first + count) of the call in @p ctx,
+ * a struct vec_2d_sum; the FPGA one copies the inputs into the UDMA buffers, starts
+ * the engines and the kernel, and copies the output back when waited for; the inputs
+ * are padded with zeros to whole stream words
+ */
+int vec_2d_sum_cpu_run(void *ctx, unsigned first, unsigned count);
+
+int vec_2d_sum_fpga_start(void *ctx, unsigned first, unsigned count);
+
+int vec_2d_sum_fpga_wait(void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_UTILS_VEC_2D_SUM_H_ */
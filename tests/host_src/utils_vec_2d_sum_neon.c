@@ -0,0 +1,28 @@
+/**
+ * @file utils_vec_2d_sum_neon.c
+ * @author Alberto Scolari
+ * @brief Implementation of the NEON loop of the CPU backend of the 2D Vector Sum kernel.
+ */
+
+#include "utils_vec_2d_sum.h"
+
+#if defined(__aarch64__) || defined(__arm__)
+#include <arm_neon.h>
+
+unsigned vec_2d_sum_neon(const int32_t *in1, const int32_t *in2, int32_t *out, unsigned num,
+    int32_t a, int32_t b, int32_t c)
+{
+    int32x4_t vc = vdupq_n_s32(c);
+    unsigned i;
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        int32x4_t r0 = vmlaq_n_s32(vmlaq_n_s32(vc, vld1q_s32(in1 + i), a), vld1q_s32(in2 + i), b);
+        int32x4_t r1 = vmlaq_n_s32(vmlaq_n_s32(vc, vld1q_s32(in1 + i + 4), a),
+            vld1q_s32(in2 + i + 4), b);
+        vst1q_s32(out + i, r0);
+        vst1q_s32(out + i + 4, r1);
+    }
+    return i;
+}
+
+#endif
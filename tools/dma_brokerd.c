@@ -0,0 +1,672 @@
+
+/**
+ * @file dma_brokerd.c
+ * @author Alberto Scolari
+ * @brief Broker daemon owning UDMA buffers, DMA engines and AXI control interfaces,
+ * and running jobs on behalf of many client processes.
+ *
+ * USAGE: dma_brokerd [-a] [-l] [-s socket] [-g group] [-t job timeout ms]
+ *        -b <buffer size> [-b ...] [-d <DMA address> ...] [-k <control interface address> ...]
+ *
+ * With -a, the UDMA buffers of the udmabuf module already loaded are mapped again and engines
+ * and control interfaces are attached to without being reset, to restart the broker without
+ * disrupting the FPGA logic; for this, the broker leaves the module loaded at exit. With -l, all mappings are pre-faulted and locked.
+ * The socket (DMA_BROKER_DEF_SOCKET by default) is accessible only to root, or also to the
+ * members of the group given with -g; its directory must be writable by root only, so that no one
+ * can replace the socket.
+ * Jobs not over within the timeout (1 s by default, 0 for none) fail with DMA_TRANS_TIMEOUT,
+ * and their transactions are cancelled; the control interface of a kernel not over is not used
+ * until the kernel ends.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_broker.h"
+#include "broker_internals.h"
+#include "dma_copy.h"
+#include "dma_stats.h"
+
+#define MAX_BUFFERS DMA_BROKER_MAX_BUFFERS
+#define MAX_ENGINES 8
+#define MAX_CTRL 8
+#define MAX_CLIENTS 64
+/* jobs run for a client before serving the others */
+#define JOBS_PER_ROUND 8U
+#define DEF_JOB_TIMEOUT_MS 1000UL
+
+struct client {
+    int sock; /* -1 if the slot is unused */
+    pid_t pid; /* process of the client, which keeps its buffers mapped until it exits */
+    int rings_fd;
+    struct dma_broker_rings *rings;
+};
+
+static struct udmabuf buffers[MAX_BUFFERS];
+static unsigned long buffer_sizes[MAX_BUFFERS];
+static unsigned num_buffers;
+
+static struct dma_engine engines[MAX_ENGINES];
+static phys_addr_t engine_addrs[MAX_ENGINES];
+static unsigned num_engines;
+
+static struct control_interface ctrls[MAX_CTRL];
+static phys_addr_t ctrl_addrs[MAX_CTRL];
+/* a kernel not over in time still runs: its arguments cannot be written until it ends */
+static int ctrl_busy[MAX_CTRL];
+static unsigned num_ctrl;
+
+static struct dma_broker_table table;
+static struct client clients[MAX_CLIENTS];
+
+static uint64_t job_timeout_ns = DEF_JOB_TIMEOUT_MS * 1000000ULL;
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static unsigned page_round(unsigned size)
+{
+    unsigned page = (unsigned)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+/*
+ * create an anonymous shared-memory segment of @p size bytes, mapped at @p addr
+ * @return its file descriptor, negative on error
+ */
+static int shm_create(const char *kind, int index, size_t size, void **addr)
+{
+    char name[64];
+    int fd;
+
+    sprintf(name, "/zu_dma_broker.%s.%d.%d", kind, (int)getpid(), index);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    shm_unlink(name);
+    if (ftruncate(fd, (off_t)size) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (*addr == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void client_drop(int c)
+{
+    dma_broker_client_gone(&table, c);
+    munmap(clients[c].rings, sizeof(struct dma_broker_rings));
+    close(clients[c].rings_fd);
+    close(clients[c].sock);
+    clients[c].sock = -1;
+}
+
+static int client_add(int sock)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    int c, fd;
+    void *rings;
+
+    for (c = 0; c < MAX_CLIENTS && clients[c].sock >= 0; c++);
+    if (c == MAX_CLIENTS || getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+    {
+        return -1;
+    }
+    fd = shm_create("rings", c, sizeof(struct dma_broker_rings), &rings);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    memset(rings, 0, sizeof(struct dma_broker_rings));
+    clients[c].sock = sock;
+    clients[c].pid = cred.pid;
+    clients[c].rings_fd = fd;
+    clients[c].rings = (struct dma_broker_rings *)rings;
+    return c;
+}
+
+/*
+ * wait for a transaction of a job until @p deadline; a transaction still running is cancelled,
+ * which resets the engine if the channel does not halt, as is a channel halted on an error
+ */
+static enum dma_err_status wait_xfer(const struct dma_broker_xfer *x, uint64_t deadline,
+    struct dma_broker_completion *compl)
+{
+    struct dma_engine *engine = engines + x->engine;
+    enum dma_err_status ret;
+
+    if (x->dir == DMA_BROKER_TO_DEV)
+    {
+        ret = wait_simple_transfer_to_device_until(engine, 0, deadline);
+        if (ret == NO_ERROR || ret == DMA_TRANS_ERROR)
+        {
+            compl->err_mask |= err_status_to_device(engine);
+        }
+        if (ret == DMA_TRANS_TIMEOUT || ret == DMA_TRANS_ERROR)
+        {
+            cancel_simple_transfer_to_device(engine);
+        }
+    } else
+    {
+        ret = wait_simple_transfer_from_device_until(engine, 0, deadline);
+        if (ret == NO_ERROR || ret == DMA_TRANS_ERROR)
+        {
+            compl->err_mask |= err_status_from_device(engine);
+        }
+        if (ret == DMA_TRANS_TIMEOUT || ret == DMA_TRANS_ERROR)
+        {
+            cancel_simple_transfer_from_device(engine);
+        }
+    }
+    return ret;
+}
+
+/*
+ * @return non-0 if the kernel of control interface @p k ran over the timeout of a job
+ * and did not end since
+ */
+static int kernel_busy(int k)
+{
+    if (ctrl_busy[k] && wait_kernel_until(ctrls + k, 0, dma_stats_now()) == NO_ERROR)
+    {
+        ctrl_busy[k] = 0;
+    }
+    return ctrl_busy[k];
+}
+
+static void run_job(int c, const struct dma_broker_job *job, struct dma_broker_completion *compl)
+{
+    enum dma_err_status err = NO_ERROR, ret;
+    uint64_t deadline = DMA_NO_DEADLINE;
+    unsigned i, pass;
+
+    compl->cookie = job->cookie;
+    compl->err_mask = 0;
+    if (dma_broker_check_job(&table, c, job) != 0)
+    {
+        compl->status = -1;
+        return;
+    }
+    if (job->kernel >= 0 && kernel_busy(job->kernel))
+    {
+        compl->status = DMA_TRANS_RUNNING;
+        return;
+    }
+    if (job->kernel >= 0)
+    {
+        for (i = 0; i < job->num_args; i++)
+        {
+            set_kernel_argument_uint(ctrls + job->kernel, i, job->args[i]);
+        }
+    }
+    if (job_timeout_ns != 0)
+    {
+        deadline = dma_stats_now() + job_timeout_ns;
+    }
+    /* arm receivers first, then senders */
+    for (pass = 0; pass < 2; pass++)
+    {
+        uint32_t dir = pass == 0 ? DMA_BROKER_FROM_DEV : DMA_BROKER_TO_DEV;
+        for (i = 0; i < job->num_xfers && err == NO_ERROR; i++)
+        {
+            const struct dma_broker_xfer *x = job->xfers + i;
+            if (x->dir != dir)
+            {
+                continue;
+            }
+            if (dir == DMA_BROKER_FROM_DEV)
+            {
+                err = set_simple_transfer_from_device(engines + x->engine, buffers + x->buf,
+                    x->offset, x->length);
+                if (err == NO_ERROR)
+                {
+                    err = start_simple_transfer_from_device(engines + x->engine);
+                }
+            } else
+            {
+                err = set_simple_transfer_to_device(engines + x->engine, buffers + x->buf,
+                    x->offset, x->length);
+                if (err == NO_ERROR)
+                {
+                    err = start_simple_transfer_to_device(engines + x->engine);
+                }
+            }
+        }
+    }
+    if (err == NO_ERROR && job->kernel >= 0)
+    {
+        start_kernel(ctrls + job->kernel);
+        /* a kernel cannot be aborted: the transactions feeding it are cancelled below */
+        err = wait_kernel_until(ctrls + job->kernel, 0, deadline);
+        ctrl_busy[job->kernel] = err == DMA_TRANS_TIMEOUT;
+    }
+    /* wait for whatever was started, even on error */
+    for (i = 0; i < job->num_xfers; i++)
+    {
+        const struct dma_broker_xfer *x = job->xfers + i;
+        ret = wait_xfer(x, deadline, compl);
+        if ((ret == DMA_TRANS_TIMEOUT || ret == DMA_TRANS_ERROR) && err == NO_ERROR)
+        {
+            err = ret;
+        }
+    }
+    if (err == DMA_TRANS_TIMEOUT)
+    {
+        printf("job %llu of client %d timed out\n", (unsigned long long)job->cookie, c);
+    }
+    compl->status = (int32_t)err;
+}
+
+/*
+ * run up to JOBS_PER_ROUND jobs of client @p c
+ * @return 1 if jobs are left in the ring, 0 otherwise, negative if the client is unreachable
+ */
+static int serve_jobs(int c)
+{
+    struct dma_broker_rings *rings = clients[c].rings;
+    struct dma_broker_completion *compl = NULL;
+    struct dma_broker_msg msg;
+    struct dma_broker_job job;
+    unsigned done = 0;
+
+    /* a client not consuming its completions gets no more jobs run */
+    while (done < JOBS_PER_ROUND && (compl = dma_broker_take_job(rings, &job)) != NULL)
+    {
+        run_job(c, &job, compl);
+        dma_broker_post_completion(rings);
+        done++;
+    }
+    if (done > 0)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.type = DMA_BROKER_DOORBELL;
+        /*
+         * client sockets are non-blocking, so that a client not reading stalls no one:
+         * with its queue full, it has doorbells to read already
+         */
+        if (dma_broker_send_msg(clients[c].sock, &msg, -1) != 0
+            && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            return -1;
+        }
+    }
+    return done == JOBS_PER_ROUND;
+}
+
+/*
+ * @return 0 if the client is still connected, non-0 otherwise
+ */
+static int serve_msg(int c)
+{
+    struct dma_broker_msg msg;
+    int fd = -1, granted;
+
+    if (dma_broker_recv_msg(clients[c].sock, &msg, NULL) != 0)
+    {
+        return -1;
+    }
+    msg.status = 0;
+    switch (msg.type)
+    {
+    case DMA_BROKER_HELLO:
+        msg.buf = num_engines;
+        msg.offset = num_ctrl;
+        msg.size = sizeof(struct dma_broker_rings);
+        fd = clients[c].rings_fd;
+        break;
+    case DMA_BROKER_ALLOC:
+        if (msg.buf >= num_buffers || msg.size == 0)
+        {
+            msg.status = -1;
+            break;
+        }
+        msg.size = page_round(msg.size);
+        if (dma_broker_slice_alloc(&table, c, clients[c].pid, msg.buf, msg.size, &msg.offset,
+            &granted) != 0)
+        {
+            msg.status = -1;
+            break;
+        }
+        if (granted)
+        {
+            /* nothing of the former owner is left */
+            fill_uncached(buffers[msg.buf].vaddr, 0, buffers[msg.buf].size);
+        }
+        msg.paddr = (uint64_t)buffers[msg.buf].paddr + msg.offset;
+        fd = buffers[msg.buf].fd;
+        break;
+    case DMA_BROKER_FREE:
+        msg.status = dma_broker_slice_free(&table, c, msg.buf, msg.offset);
+        break;
+    case DMA_BROKER_DOORBELL:
+        /* jobs are served by the main loop */
+        return 0;
+    default:
+        msg.status = -1;
+        break;
+    }
+    /* a client not reading its replies is dropped */
+    return dma_broker_send_msg(clients[c].sock, &msg, fd);
+}
+
+/*
+ * the socket is unlinked and bound again at each start: in a directory others can write to
+ * (e.g. /tmp), they could put their own socket in between; the default directory is created
+ * @return 0 if the directory of @p path is writable only by the broker's user, non-0 otherwise
+ */
+static int check_socket_dir(const char *path)
+{
+    char dir[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    struct stat st;
+
+    if (slash == NULL)
+    {
+        strcpy(dir, ".");
+    } else if (slash == path)
+    {
+        strcpy(dir, "/");
+    } else if ((size_t)(slash - path) < sizeof(dir))
+    {
+        memcpy(dir, path, (size_t)(slash - path));
+        dir[slash - path] = '\0';
+    } else
+    {
+        return -1;
+    }
+    if (strcmp(path, DMA_BROKER_DEF_SOCKET) == 0 && mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        return -1;
+    }
+    if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid()
+        || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+    {
+        printf("%s must be a directory of user %u, writable by it only\n", dir,
+            (unsigned)geteuid());
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * listen on @p path, accessible only to the owner (root) and, if @p group is not NULL,
+ * to its members
+ */
+static int open_listener(const char *path, const struct group *group)
+{
+    struct sockaddr_un addr;
+    int sock;
+    mode_t mask;
+    int ret;
+
+    if (strlen(path) >= sizeof(addr.sun_path) || check_socket_dir(path) != 0)
+    {
+        return -1;
+    }
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+    {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    /* the socket is created with no access for others, leaving no window to connect */
+    mask = umask(0177);
+    ret = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if (ret == 0 && group != NULL)
+    {
+        ret = chown(path, (uid_t)-1, group->gr_gid);
+        if (ret == 0)
+        {
+            ret = chmod(path, 0660);
+        }
+    }
+    if (ret != 0 || listen(sock, 16) != 0)
+    {
+        close(sock);
+        unlink(path);
+        return -1;
+    }
+    return sock;
+}
+
+static void usage(const char *name)
+{
+    printf("USAGE: %s [-a] [-l] [-s socket] [-g group] [-t job timeout ms] -b <buffer size> "
+        "[-b ...] [-d <DMA address> ...] [-k <control interface address> ...]\n", name);
+}
+
+static void serve(int listener)
+{
+    struct pollfd fds[MAX_CLIENTS + 1];
+    int pending[MAX_CLIENTS];
+    int map[MAX_CLIENTS + 1];
+    int c;
+
+    memset(pending, 0, sizeof(pending));
+    while (!stop)
+    {
+        int nfds = 1, any_pending = 0, i;
+
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (c = 0; c < MAX_CLIENTS; c++)
+        {
+            if (clients[c].sock >= 0)
+            {
+                fds[nfds].fd = clients[c].sock;
+                fds[nfds].events = POLLIN;
+                map[nfds++] = c;
+                any_pending |= pending[c];
+            }
+        }
+        if (poll(fds, (nfds_t)nfds, any_pending ? 0 : -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            int sock = accept4(listener, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (sock >= 0 && client_add(sock) < 0)
+            {
+                close(sock);
+            }
+        }
+        for (i = 1; i < nfds; i++)
+        {
+            c = map[i];
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                client_drop(c);
+                pending[c] = 0;
+                continue;
+            }
+            if ((fds[i].revents & POLLIN) && serve_msg(c) != 0)
+            {
+                client_drop(c);
+                pending[c] = 0;
+                continue;
+            }
+        }
+        /* round-robin over clients, a bounded number of jobs each */
+        for (c = 0; c < MAX_CLIENTS; c++)
+        {
+            if (clients[c].sock >= 0)
+            {
+                pending[c] = serve_jobs(c);
+                if (pending[c] < 0)
+                {
+                    client_drop(c);
+                    pending[c] = 0;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = DMA_BROKER_DEF_SOCKET;
+    struct group *group = NULL;
+    int opt, listener, c, attach = 0;
+    unsigned i;
+
+    while ((opt = getopt(argc, argv, "als:g:t:b:d:k:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            attach = 1;
+            break;
+        case 'l':
+            set_mapping_policy(DMA_MAP_POPULATE | DMA_MAP_LOCK | DMA_MAP_HUGE);
+            break;
+        case 's':
+            path = optarg;
+            break;
+        case 'g':
+            group = getgrnam(optarg);
+            if (group == NULL)
+            {
+                printf("unknown group %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 't':
+            job_timeout_ns = strtoull(optarg, NULL, 0) * 1000000ULL;
+            break;
+        case 'b':
+            if (num_buffers == MAX_BUFFERS)
+            {
+                usage(argv[0]);
+                return -1;
+            }
+            buffer_sizes[num_buffers++] = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            if (num_engines == MAX_ENGINES)
+            {
+                usage(argv[0]);
+                return -1;
+            }
+            engine_addrs[num_engines++] = (phys_addr_t)strtoull(optarg, NULL, 0);
+            break;
+        case 'k':
+            if (num_ctrl == MAX_CTRL)
+            {
+                usage(argv[0]);
+                return -1;
+            }
+            ctrl_addrs[num_ctrl++] = (phys_addr_t)strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (num_buffers == 0)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+    if (num_engines == 0)
+    {
+        engine_addrs[num_engines++] = 0x40400000;
+    }
+
+    dma_broker_table_init(&table, num_buffers, buffer_sizes, num_engines, num_ctrl);
+    for (c = 0; c < MAX_CLIENTS; c++)
+    {
+        clients[c].sock = -1;
+    }
+
+    /* reloading the module would free the buffers under the transactions found running */
+    if ((attach ? attach_udma_buffers : load_udma_buffers)(num_buffers, buffer_sizes,
+        buffers) != 0)
+    {
+        return -1;
+    }
+    if ((attach ? attach_dma_interfaces : get_dma_interfaces)(num_engines, engine_addrs,
+        NULL, engines) != 0)
+    {
+        detach_udma_buffers(num_buffers, buffers);
+        return -1;
+    }
+    for (i = 0; i < num_ctrl; i++)
+    {
+        if ((attach ? attach_control_interface : get_control_interface)(ctrl_addrs[i], 0,
+            ctrls + i) != 0)
+        {
+            printf("cannot get control interface %u\n", i);
+            num_ctrl = i;
+            goto out;
+        }
+    }
+
+    listener = open_listener(path, group);
+    if (listener < 0)
+    {
+        printf("cannot listen on %s\n", path);
+        goto out;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    printf("broker listening on %s\n", path);
+
+    serve(listener);
+
+    for (c = 0; c < MAX_CLIENTS; c++)
+    {
+        if (clients[c].sock >= 0)
+        {
+            client_drop(c);
+        }
+    }
+    close(listener);
+    unlink(path);
+
+out:
+    for (i = 0; i < num_ctrl; i++)
+    {
+        destroy_control_interface(ctrls + i);
+    }
+    destroy_dma_interfaces(num_engines, engines);
+    detach_udma_buffers(num_buffers, buffers);
+    return 0;
+}
@@ -0,0 +1,117 @@
+
+/**
+ * @file dma_calibrate.c
+ * @author Alberto Scolari
+ * @brief Tool calibrating DMA engines and writing their tuning into the profile
+ * the library reads at startup (see dma_tune.h).
+ *
+ * USAGE: dma_calibrate [-o profile] [-s buffer size] [-n] -d <DMA address> [-d ...]
+ *
+ * Each engine must be in a loopback design, e.g. the passthrough bitstream.
+ * The profile is written to the path given with -o, or to the one the library reads;
+ * with -n, results are only printed.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dma_engine_buf.h"
+#include "dma_tune.h"
+
+#define MAX_ENGINES 8
+#define DEF_BUFFER_SIZE (8UL * 1024UL * 1024UL)
+
+static void usage(const char *name)
+{
+    printf("USAGE: %s [-o profile] [-s buffer size] [-n] -d <DMA address> [-d ...]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    phys_addr_t addrs[MAX_ENGINES];
+    struct dma_engine engines[MAX_ENGINES];
+    struct dma_tuning tunings[MAX_ENGINES];
+    struct udmabuf buffer;
+    unsigned long size = DEF_BUFFER_SIZE;
+    const char *path = NULL;
+    unsigned num_engines = 0, i;
+    int opt, dry_run = 0, ret = 0;
+
+    while ((opt = getopt(argc, argv, "o:s:nd:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            path = optarg;
+            break;
+        case 's':
+            size = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            dry_run = 1;
+            break;
+        case 'd':
+            if (num_engines == MAX_ENGINES)
+            {
+                printf("at most %u engines\n", MAX_ENGINES);
+                return -1;
+            }
+            addrs[num_engines++] = (phys_addr_t)strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+    if (num_engines == 0)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (load_udma_buffers(1, &size, &buffer) != 0)
+    {
+        return -1;
+    }
+    if (get_dma_interfaces(num_engines, addrs, NULL, engines) != 0)
+    {
+        unload_udma_buffers(1, &buffer);
+        return -1;
+    }
+    for (i = 0; i < num_engines && ret == 0; i++)
+    {
+        struct dma_tuning *t = tunings + i;
+
+        printf("calibrating engine at 0x%llx...\n", (unsigned long long)addrs[i]);
+        ret = dma_tune_calibrate(engines + i, &buffer, t);
+        if (ret == 0)
+        {
+            printf("  setup %u ns, completion latency %u ns, bandwidth %u MB/s, shortest sleep %u ns\n",
+                t->setup_ns, t->latency_ns, t->bytes_per_us, t->sleep_ns);
+            printf("  chunk %u bytes, depth %u, wait %s", t->chunk_size, t->depth,
+                t->usleep_timeout == 0 ? "busy\n" : "sleeping ");
+            if (t->usleep_timeout != 0)
+            {
+                printf("%u us\n", t->usleep_timeout);
+            }
+        }
+    }
+    destroy_dma_interfaces(num_engines, engines);
+    unload_udma_buffers(1, &buffer);
+    if (ret != 0)
+    {
+        return -1;
+    }
+    if ( !dry_run )
+    {
+        if (dma_tune_save(path, addrs, tunings, num_engines) != 0)
+        {
+            return -1;
+        }
+        printf("profile written to %s\n", path != NULL ? path :
+            (getenv(DMA_TUNE_PROFILE_ENV) != NULL ? getenv(DMA_TUNE_PROFILE_ENV) : DMA_TUNE_DEF_PROFILE));
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+
+/**
+ * @file dma_flash.c
+ * @author Alberto Scolari
+ * @brief Tool programming the FPGA with a bitstream, unless the same image is already
+ * loaded (see dma_bitstream.h).
+ *
+ * USAGE: dma_flash [-f] <bitstream> | -s | -c
+ *
+ * With -f, the FPGA is programmed anyway; -s prints the image recorded as loaded and
+ * the interface available, -c clears the record, e.g. after programming by other means.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dma_bitstream.h"
+
+static void usage(const char *name)
+{
+    printf("USAGE: %s [-f] <bitstream> | -s | -c\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    enum dma_bitstream_method method;
+    unsigned flags = 0;
+    uint64_t hash;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "fsch")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            flags |= DMA_BITSTREAM_FORCE;
+            break;
+        case 's':
+            if (dma_bitstream_loaded(&hash, &method) == 0)
+            {
+                printf("loaded: %016llx via %s\n", (unsigned long long)hash,
+                    dma_bitstream_method_name(method));
+            }
+            else
+            {
+                printf("loaded: unknown\n");
+            }
+            printf("interface: %s\n", dma_bitstream_method_name(dma_bitstream_method("")));
+            return 0;
+        case 'c':
+            dma_bitstream_forget();
+            return 0;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    ret = dma_bitstream_load(argv[optind], flags);
+    if (ret < 0)
+    {
+        return -1;
+    }
+    printf("%s %s via %s\n", argv[optind], ret == 1 ? "already loaded" : "loaded",
+        dma_bitstream_method_name(dma_bitstream_method(argv[optind])));
+    return 0;
+}
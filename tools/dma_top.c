@@ -0,0 +1,269 @@
+
+/**
+ * @file dma_top.c
+ * @author Alberto Scolari
+ * @brief Live monitor of the DMA engines and kernels used by the processes linking libdmabuf,
+ * reading the telemetry counters they keep in shared memory unless run with DMA_STATS=0.
+ *
+ * USAGE: dma_top [-d <seconds>] [-n <iterations>] [-p <pid>]
+ *
+ * Every -d seconds (1 by default), it shows for each engine direction and kernel the throughput,
+ * the transfers (or kernel runs) per second, the share of time it was busy and the share of time
+ * threads spent waiting for it (for processes run with DMA_STATS=time, "-" otherwise), the status
+ * register reads per second and the errors so far. With -n, it stops after the given number of refreshes and does not clear the screen;
+ * with -p, it shows only the given process.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dma_stats.h"
+
+#define MAX_PROCS 64
+
+struct proc_sample {
+    int valid;
+    struct dma_stats_segment seg;
+};
+
+static const char *const error_names[DMA_STATS_NUM_ERRORS] = {
+    "DMAIntErr", "DMASlvErr", "DMADecErr", "SGIntErr", "SGSlvErr", "SGDecErr"
+};
+
+static struct proc_sample samples[2][MAX_PROCS];
+
+/* reads the segments of live processes, returning how many */
+static unsigned read_segments(struct proc_sample *procs, int only_pid)
+{
+    DIR *dir = opendir(DMA_STATS_SHM_DIR);
+    struct dirent *entry;
+    size_t prefix_len = strlen(DMA_STATS_SHM_PREFIX);
+    unsigned num = 0;
+
+    if (dir == NULL)
+    {
+        printf("%s: impossible to open %s\n", __func__, DMA_STATS_SHM_DIR);
+        return 0;
+    }
+    while ((entry = readdir(dir)) != NULL && num < MAX_PROCS)
+    {
+        int pid;
+
+        if (strncmp(entry->d_name, DMA_STATS_SHM_PREFIX, prefix_len) != 0)
+        {
+            continue;
+        }
+        pid = atoi(entry->d_name + prefix_len);
+        if (pid <= 0 || (only_pid != 0 && pid != only_pid))
+        {
+            continue;
+        }
+        /* segments of crashed processes are left behind */
+        if (kill(pid, 0) != 0 && errno == ESRCH)
+        {
+            continue;
+        }
+        if (dma_stats_read(pid, &procs[num].seg) == 0)
+        {
+            procs[num].valid = 1;
+            num++;
+        }
+    }
+    closedir(dir);
+    return num;
+}
+
+static const struct dma_stats_segment *find_previous(struct proc_sample *prev, unsigned num_prev,
+    int pid)
+{
+    unsigned i;
+    for (i = 0; i < num_prev; i++)
+    {
+        if (prev[i].valid && prev[i].seg.pid == pid)
+        {
+            return &prev[i].seg;
+        }
+    }
+    return NULL;
+}
+
+static double percent(uint64_t ns, double interval_ns)
+{
+    double p = 100.0 * (double)ns / interval_ns;
+    /* busy time is accounted at completion, hence in bursts */
+    return p > 100.0 ? 100.0 : p;
+}
+
+/* the shares of busy and waiting time, which only processes run with DMA_STATS=time take */
+static void print_times(const struct dma_stats_segment *seg, uint64_t busy_ns, uint64_t wait_ns,
+    double interval_ns)
+{
+    if ( !seg->timed )
+    {
+        printf("%6s %6s ", "-", "-");
+        return;
+    }
+    printf("%6.1f %6.1f ", percent(busy_ns, interval_ns), percent(wait_ns, interval_ns));
+}
+
+static void print_errors(const uint64_t *errors)
+{
+    unsigned i;
+    int none = 1;
+
+    for (i = 0; i < DMA_STATS_NUM_ERRORS; i++)
+    {
+        if (errors[i] != 0)
+        {
+            printf("%s%s:%llu", none ? "" : ",", error_names[i], (unsigned long long)errors[i]);
+            none = 0;
+        }
+    }
+    printf("%s\n", none ? "-" : "");
+}
+
+static void print_channel(const struct dma_stats_segment *seg, const struct dma_stats_engine *engine,
+    const char *dir, const struct dma_stats_channel *cur, const struct dma_stats_channel *old,
+    double interval_ns)
+{
+    double seconds = interval_ns / 1e9;
+
+    printf("%-7d %-16s dma  0x%-10llx %-4s ", (int)seg->pid, seg->comm,
+        (unsigned long long)engine->phys_addr, dir);
+    if (old == NULL)
+    {
+        printf("%9s %9s %6s %6s %9s ", "-", "-", "-", "-", "-");
+    } else
+    {
+        printf("%9.2f %9.0f ", (double)(cur->bytes - old->bytes) / seconds / 1e6,
+            (double)(cur->transfers - old->transfers) / seconds);
+        print_times(seg, cur->busy_ns - old->busy_ns, cur->wait_ns - old->wait_ns, interval_ns);
+        printf("%9.0f ", (double)(cur->spins - old->spins) / seconds);
+    }
+    print_errors(cur->errors);
+}
+
+static void print_kernel(const struct dma_stats_segment *seg, const struct dma_stats_kernel *cur,
+    const struct dma_stats_kernel *old, double interval_ns)
+{
+    double seconds = interval_ns / 1e9;
+
+    printf("%-7d %-16s krnl 0x%-10llx %-4s ", (int)seg->pid, seg->comm,
+        (unsigned long long)cur->phys_addr, "-");
+    if (old == NULL)
+    {
+        printf("%9s %9s %6s %6s %9s -\n", "-", "-", "-", "-", "-");
+        return;
+    }
+    printf("%9s %9.0f ", "-", (double)(cur->invocations - old->invocations) / seconds);
+    print_times(seg, cur->busy_ns - old->busy_ns, cur->wait_ns - old->wait_ns, interval_ns);
+    printf("%9.0f -\n", (double)(cur->spins - old->spins) / seconds);
+}
+
+static void print_process(const struct dma_stats_segment *seg, const struct dma_stats_segment *prev,
+    double interval_ns)
+{
+    unsigned i;
+
+    for (i = 0; i < DMA_STATS_MAX_ENGINES; i++)
+    {
+        const struct dma_stats_engine *engine = seg->engines + i;
+        /* a slot re-used for another engine has no meaningful previous values */
+        const struct dma_stats_engine *old = prev != NULL
+            && prev->engines[i].phys_addr == engine->phys_addr ? prev->engines + i : NULL;
+
+        if ( !engine->in_use )
+        {
+            continue;
+        }
+        print_channel(seg, engine, "mm2s", &engine->to_dev, old ? &old->to_dev : NULL, interval_ns);
+        print_channel(seg, engine, "s2mm", &engine->from_dev, old ? &old->from_dev : NULL, interval_ns);
+    }
+    for (i = 0; i < DMA_STATS_MAX_KERNELS; i++)
+    {
+        const struct dma_stats_kernel *kernel = seg->kernels + i;
+        const struct dma_stats_kernel *old = prev != NULL
+            && prev->kernels[i].phys_addr == kernel->phys_addr ? prev->kernels + i : NULL;
+
+        if (kernel->in_use)
+        {
+            print_kernel(seg, kernel, old, interval_ns);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double delay = 1.0;
+    long iterations = -1;
+    int opt, only_pid = 0, cur = 0;
+    unsigned num_prev, num_cur, i;
+    uint64_t prev_ns, cur_ns;
+    struct timespec pause;
+
+    while ((opt = getopt(argc, argv, "d:n:p:")) != -1)
+    {
+        if (opt == 'd')
+        {
+            delay = strtod(optarg, NULL);
+        } else if (opt == 'n')
+        {
+            iterations = strtol(optarg, NULL, 0);
+        } else if (opt == 'p')
+        {
+            only_pid = atoi(optarg);
+        } else
+        {
+            printf("USAGE: %s [-d <seconds>] [-n <iterations>] [-p <pid>]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (delay <= 0.0)
+    {
+        printf("delay must be positive\n");
+        return -1;
+    }
+    pause.tv_sec = (time_t)delay;
+    pause.tv_nsec = (long)((delay - (double)pause.tv_sec) * 1e9);
+
+    num_prev = read_segments(samples[cur], only_pid);
+    prev_ns = dma_stats_now();
+    while (iterations != 0)
+    {
+        nanosleep(&pause, NULL);
+        cur ^= 1;
+        memset(samples[cur], 0, sizeof(samples[cur]));
+        num_cur = read_segments(samples[cur], only_pid);
+        cur_ns = dma_stats_now();
+
+        if (iterations < 0)
+        {
+            /* clear the screen, as top does */
+            printf("\033[H\033[2J");
+        }
+        printf("dma_top - %u processes, refresh %.1f s\n\n", num_cur, delay);
+        printf("%-7s %-16s %-4s %-12s %-4s %9s %9s %6s %6s %9s %s\n", "PID", "COMMAND", "TYPE",
+            "ADDRESS", "DIR", "MB/s", "ops/s", "busy%", "wait%", "spins/s", "ERRORS");
+        for (i = 0; i < num_cur; i++)
+        {
+            print_process(&samples[cur][i].seg,
+                find_previous(samples[cur ^ 1], num_prev, samples[cur][i].seg.pid),
+                (double)(cur_ns - prev_ns));
+        }
+        fflush(stdout);
+        num_prev = num_cur;
+        prev_ns = cur_ns;
+        if (iterations > 0)
+        {
+            iterations--;
+        }
+    }
+    return 0;
+}